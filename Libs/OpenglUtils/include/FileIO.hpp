@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "FileMapping.h"
+
+namespace fileUtils {
+
+// Read the whole file in binary mode, with a single read of its exact size.
+// The buffer keeps its capacity, reading many files with the same buffer doesn't allocate. It is empty if the file can't be read.
+bool readFile(const std::string& filePath, std::vector<char>& buffer);
+// Same, in a new array. The content isn't null terminated, use its size
+std::vector<char> readFile(const std::string& filePath);
+
+// Content of a file : read in a reusable buffer if the file is small, mapped in memory if it is big.
+// Mapping a small file costs more than reading it, reading a big file costs a copy the mapping doesn't do.
+class FileContent
+{
+public:
+	enum : size_t
+	{
+		s_defaultMappingThreshold = 256 * 1024,
+	};
+
+private:
+	FileMapping m_mapping;
+	std::vector<char> m_buffer;
+	bool m_isMapped;
+	bool m_isOpen;
+
+public:
+	FileContent()
+		: m_isMapped(false)
+		, m_isOpen(false)
+	{}
+	FileContent(const FileContent& other) = delete;
+	FileContent& operator=(const FileContent& other) = delete;
+
+	// the previous content is released, the buffer is kept for the next file
+	bool open(const std::string& filePath, size_t mappingThreshold = s_defaultMappingThreshold);
+	void close();
+
+	bool isOpen() const
+	{
+		return m_isOpen;
+	}
+	bool isMapped() const
+	{
+		return m_isMapped;
+	}
+	const unsigned char* getData() const
+	{
+		return m_isMapped ? m_mapping.getData() : (const unsigned char*)m_buffer.data();
+	}
+	size_t getSize() const
+	{
+		return m_isMapped ? m_mapping.getSize() : m_buffer.size();
+	}
+};
+
+// Files read by a background thread, in the order they are requested.
+// The files needed at startup are prefetched at once, and taken when they are used : their reads overlap the rest of the initialization.
+class AsyncFileReader
+{
+private:
+	struct PendingFile
+	{
+		std::string filePath;
+		std::vector<char> content;
+		bool isDone;
+		bool isRead;
+
+		PendingFile(const std::string& _filePath)
+			: filePath(_filePath)
+			, isDone(false)
+			, isRead(false)
+		{}
+	};
+
+	std::mutex m_mutex;
+	// wakes the reader thread
+	std::condition_variable m_requestCondition;
+	// wakes the threads waiting for a file
+	std::condition_variable m_doneCondition;
+	// requested and not started, the reader thread takes them all at once
+	std::vector<std::shared_ptr<PendingFile>> m_requests;
+	// requested and not taken yet
+	std::map<std::string, std::shared_ptr<PendingFile>> m_files;
+	bool m_isStopping;
+	std::thread m_thread;
+
+public:
+	AsyncFileReader();
+	// the files not read yet are dropped
+	~AsyncFileReader();
+	AsyncFileReader(const AsyncFileReader& other) = delete;
+	AsyncFileReader& operator=(const AsyncFileReader& other) = delete;
+
+	// the files already requested and not taken are skipped
+	void prefetch(const std::vector<std::string>& filePaths);
+	// The content of a prefetched file, waits until the file is read. The file is forgotten by the reader.
+	// A file which wasn't prefetched is read by the calling thread. Return false if the file can't be read
+	bool take(const std::string& filePath, std::vector<char>& content);
+	// files requested and not read yet
+	size_t getPendingCount();
+
+private:
+	void run();
+};
+
+} // namespace fileUtils
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read only view of a whole file, mapped in memory.
+// The pages are loaded by the system when they are read, nothing is copied.
+class FileMapping
+{
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	bool m_isOpen;
+#ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mapping;
+#else
+	int m_file;
+#endif
+
+public:
+	FileMapping()
+		: m_data(nullptr)
+		, m_size(0)
+		, m_isOpen(false)
+#ifdef _WIN32
+		, m_file(INVALID_HANDLE_VALUE)
+		, m_mapping(nullptr)
+#else
+		, m_file(-1)
+#endif
+	{}
+	~FileMapping()
+	{
+		close();
+	}
+	FileMapping(const FileMapping& other) = delete;
+	FileMapping& operator=(const FileMapping& other) = delete;
+
+	bool open(const std::string& fileName)
+	{
+		close();
+
+#ifdef _WIN32
+		m_file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_file, &fileSize))
+		{
+			close();
+			return false;
+		}
+		m_size = (size_t)fileSize.QuadPart;
+
+		// an empty file can't be mapped, but it is still a valid file
+		if (m_size > 0)
+		{
+			m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (m_mapping != nullptr)
+				m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			if (m_data == nullptr)
+			{
+				close();
+				return false;
+			}
+		}
+#else
+		m_file = ::open(fileName.c_str(), O_RDONLY);
+		if (m_file < 0)
+			return false;
+
+		struct stat fileStat;
+		if (fstat(m_file, &fileStat) != 0)
+		{
+			close();
+			return false;
+		}
+		m_size = (size_t)fileStat.st_size;
+
+		// an empty file can't be mapped, but it is still a valid file
+		if (m_size > 0)
+		{
+			void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+			if (data == MAP_FAILED)
+			{
+				close();
+				return false;
+			}
+			m_data = (const unsigned char*)data;
+		}
+#endif
+
+		m_isOpen = true;
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (m_data != nullptr)
+			UnmapViewOfFile(m_data);
+		if (m_mapping != nullptr)
+			CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+		m_mapping = nullptr;
+		m_file = INVALID_HANDLE_VALUE;
+#else
+		if (m_data != nullptr)
+			munmap((void*)m_data, m_size);
+		if (m_file >= 0)
+			::close(m_file);
+		m_file = -1;
+#endif
+		m_data = nullptr;
+		m_size = 0;
+		m_isOpen = false;
+	}
+
+	bool isOpen() const
+	{
+		return m_isOpen;
+	}
+	const unsigned char* getData() const
+	{
+		return m_data;
+	}
+	size_t getSize() const
+	{
+		return m_size;
+	}
+};
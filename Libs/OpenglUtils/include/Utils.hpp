@@ -4,9 +4,13 @@
 #include <memory>
 #include <iostream>
 #include <map>
+#include <string>
+#include <cstring>
+#include <algorithm>
 #include "glad/glad.h"
 #include "glm/glm.hpp"
 #include "stb/stb_image.h"
+#include "FileIO.hpp"
 
 //#include "ft2build.h"
 #include <ft2build.h>
@@ -59,8 +63,6 @@ struct Rect
 
 namespace glUtils {
 
-// Open and read the given file. Output its coutent in an array of char.
-std::vector<char> readFile(const std::string& filePath);
 // Load and compile a glsl shader
 GLuint loadAndCompileShader(const std::string& shaderFilePath, GLenum shaderType);
 // create an opengl shader program, attaching a vertex shader and a fragment shader
@@ -165,12 +167,40 @@ public:
 	}
 };
 
+// handle on an active uniform of a ShaderProgram, InvalidUniformHandle if the uniform isn't active
+typedef int UniformHandle;
+static const UniformHandle InvalidUniformHandle = -1;
+
+struct UniformInfo
+{
+	std::string name;
+	GLint location;
+	GLenum type;
+	GLint arraySize;
+
+	// last uploaded value, used to skip redundant uploads
+	unsigned char shadowValue[sizeof(glm::mat4)];
+	bool hasShadowValue;
+
+	UniformInfo(const std::string& _name, GLint _location, GLenum _type, GLint _arraySize)
+		: name(_name)
+		, location(_location)
+		, type(_type)
+		, arraySize(_arraySize)
+		, hasShadowValue(false)
+	{}
+};
+
 // Base class representing a shader program
 class ShaderProgram
 {
 private:
 	GLuint m_program;
 
+	// active uniforms, enumerated once at link time
+	std::vector<UniformInfo> m_uniforms;
+	std::map<std::string, UniformHandle> m_uniformHandles;
+
 public:
 	ShaderProgram()
 		: m_program(0)
@@ -193,6 +223,8 @@ public:
 			m_program = 0;
 		}
 		m_program = createShaderProgram(vertexShaderFilePath, fragmentShaderFilePath);
+
+		reflectUniforms();
 	}
 
 	void use()
@@ -204,6 +236,116 @@ public:
 	{
 		return m_program;
 	}
+
+	// uniforms
+	// resolve the handle once (ex : at init) and keep it, the lookup doesn't touch the driver
+	UniformHandle getUniformHandle(const std::string& name) const
+	{
+		auto found = m_uniformHandles.find(name);
+		if (found != m_uniformHandles.end())
+			return found->second;
+		else
+			return InvalidUniformHandle;
+	}
+	const std::vector<UniformInfo>& getUniforms() const
+	{
+		return m_uniforms;
+	}
+
+	// typed setters, the program must be in use. The upload is skipped if the value hasn't changed since the last call.
+	void setUniform(UniformHandle handle, float value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform1f(m_uniforms[handle].location, value);
+	}
+	void setUniform(UniformHandle handle, int value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform1i(m_uniforms[handle].location, value);
+	}
+	void setUniform(UniformHandle handle, const glm::vec2& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform2fv(m_uniforms[handle].location, 1, &value[0]);
+	}
+	void setUniform(UniformHandle handle, const glm::vec3& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform3fv(m_uniforms[handle].location, 1, &value[0]);
+	}
+	void setUniform(UniformHandle handle, const glm::vec4& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform4fv(m_uniforms[handle].location, 1, &value[0]);
+	}
+	void setUniform(UniformHandle handle, const glm::mat4& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniformMatrix4fv(m_uniforms[handle].location, 1, GL_FALSE, &value[0][0]);
+	}
+	// forget the shadowed values, to use if the uniforms are modified outside of these setters
+	void invalidateUniformShadowValues()
+	{
+		for (auto& uniform : m_uniforms)
+		{
+			uniform.hasShadowValue = false;
+		}
+	}
+
+private:
+	void reflectUniforms()
+	{
+		m_uniforms.clear();
+		m_uniformHandles.clear();
+
+		if (m_program == 0)
+			return;
+
+		GLint uniformCount = 0;
+		GLint maxNameLength = 0;
+		glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+		glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+		std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+		for (GLint uniformIdx = 0; uniformIdx < uniformCount; uniformIdx++)
+		{
+			GLsizei nameLength = 0;
+			GLint arraySize = 0;
+			GLenum type = 0;
+			glGetActiveUniform(m_program, uniformIdx, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+
+			std::string name(nameBuffer.data(), nameLength);
+			GLint location = glGetUniformLocation(m_program, name.c_str());
+			// uniforms inside uniform blocks have no location
+			if (location < 0)
+				continue;
+
+			// arrays are reported as "name[0]", we register them by their base name
+			const std::size_t arraySuffix = name.find('[');
+			if (arraySuffix != std::string::npos)
+				name.resize(arraySuffix);
+
+			m_uniformHandles[name] = (UniformHandle)m_uniforms.size();
+			m_uniforms.push_back(UniformInfo(name, location, type, arraySize));
+		}
+	}
+
+	template<typename T>
+	bool updateShadowValue(UniformHandle handle, const T& value)
+	{
+		static_assert(sizeof(T) <= sizeof(glm::mat4), "uniform value too big for the shadow storage");
+
+		if (handle < 0 || handle >= (UniformHandle)m_uniforms.size())
+			return false;
+
+		UniformInfo& uniform = m_uniforms[handle];
+		if (uniform.hasShadowValue && std::memcmp(uniform.shadowValue, &value, sizeof(T)) == 0)
+			return false;
+
+		std::memcpy(uniform.shadowValue, &value, sizeof(T));
+		uniform.hasShadowValue = true;
+		return true;
+	}
 };
 
 // Base class representing an opengl texture
@@ -253,8 +395,10 @@ public:
 
 		setFormatAndType(internalFormat, format, type);
 
-		int channelCountInFile;
-		m_imageDatas = stbi_load(fileName.c_str(), &m_texWidth, &m_texHeight, &channelCountInFile, desiredChannelCount);
+		// the file is read at once, stb_image reads the files by small chunks
+		fileUtils::FileContent file;
+		int channelCountInFile = 0;
+		m_imageDatas = file.open(fileName) ? stbi_load_from_memory(file.getData(), (int)file.getSize(), &m_texWidth, &m_texHeight, &channelCountInFile, desiredChannelCount) : nullptr;
 
 		assert(desiredChannelCount <= channelCountInFile);
 
@@ -406,6 +550,183 @@ struct FontAtlas
 	unsigned int m_rowCount;	
 };
 
+// charcode -> glyph index, used for each character of each text.
+// The BMP charcodes are directly indexed by pages of 256 glyph indices, only the pages which contain glyphs are stored.
+// The other charcodes go to a small open addressing table, with linear probing.
+class GlyphLookupTable
+{
+private:
+	enum : unsigned int
+	{
+		s_pageSize = 256,
+		s_bmpPageCount = 0x10000 / s_pageSize,
+
+		// glyph index 0 is the "missing glyph" of the FreeType fonts, so it also marks the empty entries
+		s_noGlyph = 0,
+		// charcode of an empty slot in the extended table, never inserted since it belongs to the BMP
+		s_emptyCharcode = 0,
+	};
+
+	// page index -> offset of the page in m_bmpGlyphs, the first page is shared by all the empty pages
+	unsigned int m_bmpPageOffsets[s_bmpPageCount];
+	std::vector<unsigned int> m_bmpGlyphs;
+
+	std::vector<unsigned long> m_extendedCharcodes;
+	std::vector<unsigned int> m_extendedGlyphs;
+	unsigned int m_extendedCount;
+	unsigned int m_extendedHashShift;
+
+	unsigned int m_count;
+
+public:
+	GlyphLookupTable()
+	{
+		clear();
+	}
+
+	void clear()
+	{
+		std::fill(m_bmpPageOffsets, m_bmpPageOffsets + s_bmpPageCount, 0);
+		m_bmpGlyphs.assign(s_pageSize, s_noGlyph);
+		m_extendedCharcodes.clear();
+		m_extendedGlyphs.clear();
+		m_extendedCount = 0;
+		m_extendedHashShift = 32;
+		m_count = 0;
+	}
+
+	void insert(unsigned long charcode, unsigned int glyphIndex)
+	{
+		if (glyphIndex == s_noGlyph)
+			return;
+
+		if (charcode < 0x10000)
+		{
+			const unsigned int pageIndex = (unsigned int)(charcode / s_pageSize);
+			if (m_bmpPageOffsets[pageIndex] == 0)
+			{
+				m_bmpPageOffsets[pageIndex] = (unsigned int)m_bmpGlyphs.size();
+				m_bmpGlyphs.resize(m_bmpGlyphs.size() + s_pageSize, s_noGlyph);
+			}
+
+			unsigned int& entry = m_bmpGlyphs[m_bmpPageOffsets[pageIndex] + charcode % s_pageSize];
+			if (entry == s_noGlyph)
+				m_count++;
+			entry = glyphIndex;
+		}
+		else
+		{
+			// keep the table at most half full so the probe sequences stay short
+			if ((m_extendedCount + 1) * 2 > m_extendedCharcodes.size())
+				growExtended();
+
+			if (insertExtended(charcode, glyphIndex))
+			{
+				m_extendedCount++;
+				m_count++;
+			}
+		}
+	}
+
+	bool find(unsigned long charcode, unsigned int& outGlyphIndex) const
+	{
+		if (charcode < 0x10000)
+		{
+			outGlyphIndex = m_bmpGlyphs[m_bmpPageOffsets[charcode / s_pageSize] + charcode % s_pageSize];
+			return outGlyphIndex != s_noGlyph;
+		}
+
+		if (m_extendedCount == 0)
+			return false;
+
+		const size_t mask = m_extendedCharcodes.size() - 1;
+		for (size_t slot = hashCharcode(charcode); m_extendedCharcodes[slot] != s_emptyCharcode; slot = (slot + 1) & mask)
+		{
+			if (m_extendedCharcodes[slot] == charcode)
+			{
+				outGlyphIndex = m_extendedGlyphs[slot];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	unsigned int size() const
+	{
+		return m_count;
+	}
+
+	// call function(charcode, glyphIndex) for each entry, the BMP charcodes first and in order
+	template<typename Function>
+	void forEach(Function function) const
+	{
+		for (unsigned int pageIndex = 0; pageIndex < s_bmpPageCount; ++pageIndex)
+		{
+			if (m_bmpPageOffsets[pageIndex] == 0)
+				continue;
+
+			for (unsigned int i = 0; i < s_pageSize; ++i)
+			{
+				const unsigned int glyphIndex = m_bmpGlyphs[m_bmpPageOffsets[pageIndex] + i];
+				if (glyphIndex != s_noGlyph)
+					function((unsigned long)(pageIndex * s_pageSize + i), glyphIndex);
+			}
+		}
+		for (size_t slot = 0; slot < m_extendedCharcodes.size(); ++slot)
+		{
+			if (m_extendedCharcodes[slot] != s_emptyCharcode)
+				function(m_extendedCharcodes[slot], m_extendedGlyphs[slot]);
+		}
+	}
+
+private:
+	size_t hashCharcode(unsigned long charcode) const
+	{
+		// fibonacci hashing : the high bits of the product index the table, the consecutive charcodes of a script are spread over it
+		return (size_t)(((unsigned int)charcode * 2654435769u) >> m_extendedHashShift);
+	}
+
+	// return true if the charcode wasn't already in the table
+	bool insertExtended(unsigned long charcode, unsigned int glyphIndex)
+	{
+		const size_t mask = m_extendedCharcodes.size() - 1;
+		size_t slot = hashCharcode(charcode);
+		while (m_extendedCharcodes[slot] != s_emptyCharcode && m_extendedCharcodes[slot] != charcode)
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		const bool isNew = m_extendedCharcodes[slot] == s_emptyCharcode;
+		m_extendedCharcodes[slot] = charcode;
+		m_extendedGlyphs[slot] = glyphIndex;
+		return isNew;
+	}
+
+	void growExtended()
+	{
+		std::vector<unsigned long> oldCharcodes;
+		std::vector<unsigned int> oldGlyphs;
+		oldCharcodes.swap(m_extendedCharcodes);
+		oldGlyphs.swap(m_extendedGlyphs);
+
+		// the capacity stays a power of two for the probe mask
+		const size_t capacity = std::max<size_t>(16, oldCharcodes.size() * 2);
+		m_extendedCharcodes.assign(capacity, s_emptyCharcode);
+		m_extendedGlyphs.assign(capacity, s_noGlyph);
+		m_extendedHashShift = 32;
+		for (size_t i = capacity; i > 1; i >>= 1)
+		{
+			m_extendedHashShift--;
+		}
+
+		for (size_t slot = 0; slot < oldCharcodes.size(); ++slot)
+		{
+			if (oldCharcodes[slot] != s_emptyCharcode)
+				insertExtended(oldCharcodes[slot], oldGlyphs[slot]);
+		}
+	}
+};
+
 class Font
 {
 private:
@@ -414,7 +735,7 @@ private:
 	float m_fontSize;
 	std::string m_fontName;
 
-	std::map<unsigned long, unsigned int> m_charToIndex; // charcode -> glyph index 
+	GlyphLookupTable m_charToIndex; // charcode -> glyph index 
 	std::vector<Glyph> m_glyphInfos; // glyphinfos
 
 public:
@@ -439,7 +760,7 @@ public:
 		glm::vec2 cursor(0, 0);
 		for (const auto& character : text)
 		{
-			success = getGlyphInfoFromChar(character, &glyph);
+			success = getGlyphInfoFromChar((unsigned char)character, &glyph);
 
 			if (!success)
 				break;
@@ -462,7 +783,7 @@ public:
 		for (int i = 0; i < cursorIdx; i++)
 		{
 			const auto& character = text[i];
-			success = getGlyphInfoFromChar(character, &glyph);
+			success = getGlyphInfoFromChar((unsigned char)character, &glyph);
 
 			if (!success)
 				break;
@@ -480,7 +801,7 @@ public:
 		for (int i = 0; i < text.size(); i++)
 		{
 			const auto& character = text[i];
-			success = getGlyphInfoFromChar(character, &glyph);
+			success = getGlyphInfoFromChar((unsigned char)character, &glyph);
 
 			if (!success)
 				break;
@@ -532,11 +853,12 @@ public:
 		unsigned char* textureDatas = new unsigned char[texPixelCount];
 
 		// populate m_charToIndex
+		m_charToIndex.clear();
 		FT_UInt index;
 		FT_ULong character = FT_Get_First_Char(face, &index);
 		while (true) {
 
-			m_charToIndex[character] = index;
+			m_charToIndex.insert(character, index);
 
 			character = FT_Get_Next_Char(face, character, &index);
 			if (!index) break;
@@ -633,16 +955,9 @@ public:
 		*outGlyph = &m_glyphInfos[glyphIndex];
 		return true;
 	}
-	bool getGlyphIndex(unsigned char charcode, unsigned int& outGlyphIndex) const
+	bool getGlyphIndex(unsigned long charcode, unsigned int& outGlyphIndex) const
 	{
-		auto& found = m_charToIndex.find(charcode);
-		if (found != m_charToIndex.end())
-		{
-			outGlyphIndex = found->second;
-			return true;
-		}
-		else
-			return false;
+		return m_charToIndex.find(charcode, outGlyphIndex);
 	}
 
 	void bindTexture() const
@@ -657,10 +972,10 @@ public:
 	void debugPrintChatToIndex() const
 	{
 		std::cout << "chat to glyph index : " << std::endl;
-		for (const auto& pair : m_charToIndex)
+		m_charToIndex.forEach([](unsigned long charcode, unsigned int glyphIndex)
 		{
-			std::cout << (char)pair.first << " : " << pair.second << std::endl;
-		}
+			std::cout << (char)charcode << " : " << glyphIndex << std::endl;
+		});
 	}
 	
 };
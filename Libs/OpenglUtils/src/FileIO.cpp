@@ -0,0 +1,247 @@
+#include "FileIO.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+
+namespace fileUtils {
+
+namespace {
+
+// A file opened for reading, closed when destroyed. The native calls skip the stream buffer : the content is read directly in the destination.
+class ReadOnlyFile
+{
+private:
+#ifdef _WIN32
+	HANDLE m_file;
+#else
+	int m_file;
+#endif
+
+public:
+	explicit ReadOnlyFile(const std::string& filePath)
+	{
+#ifdef _WIN32
+		m_file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+#else
+		m_file = ::open(filePath.c_str(), O_RDONLY);
+#endif
+	}
+	~ReadOnlyFile()
+	{
+#ifdef _WIN32
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+#else
+		if (m_file >= 0)
+			::close(m_file);
+#endif
+	}
+	ReadOnlyFile(const ReadOnlyFile& other) = delete;
+	ReadOnlyFile& operator=(const ReadOnlyFile& other) = delete;
+
+	bool isOpen() const
+	{
+#ifdef _WIN32
+		return m_file != INVALID_HANDLE_VALUE;
+#else
+		return m_file >= 0;
+#endif
+	}
+	bool getSize(size_t& size) const
+	{
+#ifdef _WIN32
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_file, &fileSize))
+			return false;
+		size = (size_t)fileSize.QuadPart;
+#else
+		struct stat fileStat;
+		if (fstat(m_file, &fileStat) != 0)
+			return false;
+		size = (size_t)fileStat.st_size;
+#endif
+		return true;
+	}
+	// the reads can return less than asked, they are repeated until size bytes are read
+	bool read(char* data, size_t size)
+	{
+		while (size > 0)
+		{
+#ifdef _WIN32
+			DWORD readSize = 0;
+			if (!ReadFile(m_file, data, (DWORD)std::min<size_t>(size, 1u << 30), &readSize, nullptr) || readSize == 0)
+				return false;
+#else
+			const ssize_t readSize = ::read(m_file, data, size);
+			if (readSize < 0 && errno == EINTR)
+				continue;
+			if (readSize <= 0)
+				return false;
+#endif
+			data += readSize;
+			size -= (size_t)readSize;
+		}
+		return true;
+	}
+};
+
+bool readOpenedFile(ReadOnlyFile& file, size_t fileSize, std::vector<char>& buffer)
+{
+	buffer.resize(fileSize);
+	if (!file.read(buffer.data(), fileSize))
+	{
+		buffer.clear();
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+bool readFile(const std::string& filePath, std::vector<char>& buffer)
+{
+	buffer.clear();
+
+	ReadOnlyFile file(filePath);
+	size_t fileSize = 0;
+	if (!file.isOpen() || !file.getSize(fileSize))
+	{
+		std::cout << "error : can't open file " << filePath.c_str() << std::endl;
+		return false;
+	}
+	return readOpenedFile(file, fileSize, buffer);
+}
+
+std::vector<char> readFile(const std::string& filePath)
+{
+	std::vector<char> output;
+	readFile(filePath, output);
+	return output;
+}
+
+bool FileContent::open(const std::string& filePath, size_t mappingThreshold)
+{
+	close();
+
+	ReadOnlyFile file(filePath);
+	size_t fileSize = 0;
+	if (!file.isOpen() || !file.getSize(fileSize))
+	{
+		std::cout << "error : can't open file " << filePath.c_str() << std::endl;
+		return false;
+	}
+
+	// the mapping failures fall back on a read
+	if (fileSize >= mappingThreshold && m_mapping.open(filePath))
+		m_isMapped = true;
+	else if (!readOpenedFile(file, fileSize, m_buffer))
+		return false;
+
+	m_isOpen = true;
+	return true;
+}
+
+void FileContent::close()
+{
+	m_mapping.close();
+	m_buffer.clear();
+	m_isMapped = false;
+	m_isOpen = false;
+}
+
+AsyncFileReader::AsyncFileReader()
+	: m_isStopping(false)
+{
+	m_thread = std::thread([this]() { run(); });
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_requestCondition.notify_one();
+	m_thread.join();
+}
+
+void AsyncFileReader::prefetch(const std::vector<std::string>& filePaths)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const auto& filePath : filePaths)
+		{
+			if (m_files.find(filePath) != m_files.end())
+				continue;
+
+			auto file = std::make_shared<PendingFile>(filePath);
+			m_files[filePath] = file;
+			m_requests.push_back(file);
+		}
+	}
+	m_requestCondition.notify_one();
+}
+
+bool AsyncFileReader::take(const std::string& filePath, std::vector<char>& content)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto found = m_files.find(filePath);
+	if (found == m_files.end())
+	{
+		lock.unlock();
+		return readFile(filePath, content);
+	}
+
+	std::shared_ptr<PendingFile> file = found->second;
+	m_files.erase(found);
+	m_doneCondition.wait(lock, [&file]() { return file->isDone; });
+
+	content.swap(file->content);
+	return file->isRead;
+}
+
+size_t AsyncFileReader::getPendingCount()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t pendingCount = 0;
+	for (const auto& file : m_files)
+	{
+		if (!file.second->isDone)
+			pendingCount++;
+	}
+	return pendingCount;
+}
+
+void AsyncFileReader::run()
+{
+	std::vector<std::shared_ptr<PendingFile>> batch;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_requestCondition.wait(lock, [this]() { return m_isStopping || !m_requests.empty(); });
+			if (m_isStopping)
+				return;
+			batch.swap(m_requests);
+		}
+
+		// the content of a file is only touched by this thread until the file is done
+		for (auto& file : batch)
+		{
+			const bool isRead = readFile(file->filePath, file->content);
+			bool isStopping = false;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				file->isRead = isRead;
+				file->isDone = true;
+				isStopping = m_isStopping;
+			}
+			m_doneCondition.notify_all();
+			if (isStopping)
+				return;
+		}
+		batch.clear();
+	}
+}
+
+} // namespace fileUtils
@@ -1,38 +1,15 @@
 #include "Utils.hpp"
-#include <fstream>
-
-std::vector<char> readFile(const std::string& filePath)
-{
-	std::vector<char> output;
-
-	std::string line;
-	std::ifstream fileIn(filePath);
-	if (fileIn.is_open())
-	{
-		fileIn.seekg(0, fileIn.end);
-		int fileSize = fileIn.tellg();
-		fileIn.seekg(0, fileIn.beg);
-
-		output.resize(fileSize);
-
-		fileIn.read(&output[0], fileSize);
-
-		fileIn.close();
-	}
-	else
-	{
-		std::cout << "error : can't open file " << filePath.c_str() << std::endl;
-	}
-
-	return output;
-}
 
 GLuint loadAndCompileShader(const std::string& shaderFilePath, GLenum shaderType)
 {
+	// reused by the successive shaders. The source isn't null terminated, its length is given
+	static thread_local std::vector<char> shaderFileContent;
+	fileUtils::readFile(shaderFilePath, shaderFileContent);
+
 	GLuint shader = glCreateShader(shaderType);
-	std::vector<char> shaderFileContent = readFile(shaderFilePath);
 	const char* shaderFileContentPtr = shaderFileContent.data();
-	glShaderSource(shader, 1, &shaderFileContentPtr, nullptr);
+	const GLint shaderFileLength = (GLint)shaderFileContent.size();
+	glShaderSource(shader, 1, &shaderFileContentPtr, &shaderFileLength);
 	glCompileShader(shader);
 
 	int  success;
@@ -31,6 +31,11 @@ public:
 	virtual void init() = 0;
 	virtual void update() = 0;
 	virtual void render() = 0;
+	// false if the last frame is still up to date, the application then sleeps until the next event
+	virtual bool needsRender()
+	{
+		return true;
+	}
 
 	static void s_keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 	{
@@ -107,12 +112,20 @@ void Application::run()
 	{
 		update();
 
-		render();
+		if (needsRender())
+		{
+			render();
 
-		/* Swap front and back buffers */
-		glfwSwapBuffers(window);
-		/* Poll for and process events */
-		glfwPollEvents();
+			/* Swap front and back buffers */
+			glfwSwapBuffers(window);
+			/* Poll for and process events */
+			glfwPollEvents();
+		}
+		else
+		{
+			/* Nothing has changed, wait for an event instead of drawing the same frame again */
+			glfwWaitEvents();
+		}
 	}
 }
 
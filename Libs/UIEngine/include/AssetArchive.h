@@ -0,0 +1,413 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include "OpenglUtils.h"
+#include "FileMapping.h"
+
+enum class AssetType : uint32_t
+{
+	BLOB, // any bytes, ex : serialized objects
+	SHADER, // shader source, not null terminated
+	TEXTURE, // decoded pixels, rows from the top
+	FONT, // font file, opened with FT_New_Memory_Face
+	FONT_ATLAS, // atlas cache written by the FontFactory
+};
+
+// Read only span on the bytes of an asset, they stay owned by the archive and are valid while it is open.
+struct AssetView
+{
+	const unsigned char* data;
+	size_t size;
+
+	AssetView()
+		: data(nullptr)
+		, size(0)
+	{}
+	AssetView(const unsigned char* _data, size_t _size)
+		: data(_data)
+		, size(_size)
+	{}
+
+	bool empty() const
+	{
+		return size == 0;
+	}
+	const unsigned char* begin() const
+	{
+		return data;
+	}
+	const unsigned char* end() const
+	{
+		return data + size;
+	}
+	const char* chars() const
+	{
+		return (const char*)data;
+	}
+};
+
+// An entry of the archive index. The index is sorted by name, the names are stored after the index.
+struct AssetArchiveEntry
+{
+	uint64_t offset; // of the blob, from the start of the archive
+	uint64_t size;
+	uint32_t nameOffset; // in the names
+	uint32_t nameLength;
+	AssetType type;
+	// textures only
+	int32_t width;
+	int32_t height;
+	int32_t channelCount;
+};
+
+struct AssetArchiveHeader
+{
+	enum : uint32_t
+	{
+		s_version = 1,
+		// the blobs start on a cache line, any value stored in them can be read in place
+		s_blobAlignment = 64,
+	};
+
+	char magic[4]; // "UIAR"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t blobAlignment;
+	uint64_t indexOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+};
+
+// Archive of assets mapped in memory : the header, the index and the names, then the blobs.
+// Opening the archive reads the index page, the blobs are loaded by the system when they are read.
+// The assets are used in place : the shaders are compiled, the textures uploaded and the fonts opened from the mapping, without any copy.
+// The archive must stay open while the textures (software drawer) and the fonts (glyphs loaded later) created from it are used.
+class AssetArchive
+{
+private:
+	FileMapping m_file;
+	const AssetArchiveEntry* m_entries;
+	const char* m_names;
+	uint32_t m_entryCount;
+
+public:
+	AssetArchive()
+		: m_entries(nullptr)
+		, m_names(nullptr)
+		, m_entryCount(0)
+	{}
+	AssetArchive(const AssetArchive& other) = delete;
+	AssetArchive& operator=(const AssetArchive& other) = delete;
+
+	// false if the file can't be mapped, or if it isn't a valid archive
+	bool open(const std::string& fileName)
+	{
+		close();
+		if (!m_file.open(fileName))
+			return false;
+
+		if (!validate())
+		{
+			std::cout << "ERROR::ASSET_ARCHIVE: invalid archive " << fileName << std::endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+	void close()
+	{
+		m_file.close();
+		m_entries = nullptr;
+		m_names = nullptr;
+		m_entryCount = 0;
+	}
+	bool isOpen() const
+	{
+		return m_entries != nullptr;
+	}
+
+	size_t getEntryCount() const
+	{
+		return m_entryCount;
+	}
+	const AssetArchiveEntry& getEntry(size_t index) const
+	{
+		return m_entries[index];
+	}
+	std::string getEntryName(const AssetArchiveEntry& entry) const
+	{
+		return std::string(m_names + entry.nameOffset, entry.nameLength);
+	}
+
+	// binary search in the sorted index, null if there is no such asset
+	const AssetArchiveEntry* find(const std::string& name) const
+	{
+		const AssetArchiveEntry* first = m_entries;
+		const AssetArchiveEntry* last = m_entries + m_entryCount;
+		const AssetArchiveEntry* found = std::lower_bound(first, last, name, [this](const AssetArchiveEntry& entry, const std::string& name) { return compareName(entry, name) < 0; });
+		if (found != last && compareName(*found, name) == 0)
+			return found;
+		else
+			return nullptr;
+	}
+
+	AssetView getView(const AssetArchiveEntry& entry) const
+	{
+		return AssetView(m_file.getData() + entry.offset, (size_t)entry.size);
+	}
+	// empty view if there is no such asset
+	AssetView getView(const std::string& name) const
+	{
+		const AssetArchiveEntry* entry = find(name);
+		return entry != nullptr ? getView(*entry) : AssetView();
+	}
+
+	// texture uploaded from the pixels in the archive, null if there is no such texture
+	std::shared_ptr<Texture> createTexture(const std::string& name, const std::vector<std::pair<GLenum, GLint>>& params) const
+	{
+		const AssetArchiveEntry* entry = find(name);
+		if (entry == nullptr || entry->type != AssetType::TEXTURE)
+			return nullptr;
+
+		GLenum format = GL_RGBA;
+		if (entry->channelCount == 1)
+			format = GL_RED;
+		else if (entry->channelCount == 2)
+			format = GL_RG;
+		else if (entry->channelCount == 3)
+			format = GL_RGB;
+
+		auto texture = std::make_shared<Texture>();
+		texture->createFromPixels(entry->width, entry->height, getView(*entry).data, params, format, format, GL_UNSIGNED_BYTE);
+		return texture;
+	}
+
+	// program compiled from the shader sources in the archive, false if one of them is missing
+	bool loadShaderProgram(ShaderProgram& program, const std::string& vertexShaderName, const std::string& fragmentShaderName) const
+	{
+		const AssetView vertexSource = getView(vertexShaderName);
+		const AssetView fragmentSource = getView(fragmentShaderName);
+		if (vertexSource.empty() || fragmentSource.empty())
+			return false;
+
+		program.loadFromSources(vertexSource.chars(), vertexSource.size, fragmentSource.chars(), fragmentSource.size);
+		return true;
+	}
+
+	// font opened from the font file in the archive, with its atlas cache if the archive has one (atlasCacheName, can be empty)
+	FontLoadRequest makeFontRequest(const std::string& fontFileName, const std::string& atlasCacheName, const std::string& fontName, unsigned int fontSize) const
+	{
+		const AssetView fontFile = getView(fontFileName);
+		FontLoadRequest request(fontFile.data, fontFile.size, fontName, fontSize);
+		request.fileName = fontFileName;
+
+		const AssetView atlasCache = atlasCacheName.empty() ? AssetView() : getView(atlasCacheName);
+		request.atlasCacheData = atlasCache.data;
+		request.atlasCacheDataSize = atlasCache.size;
+		return request;
+	}
+
+private:
+	int compareName(const AssetArchiveEntry& entry, const std::string& name) const
+	{
+		const int compared = std::memcmp(m_names + entry.nameOffset, name.data(), std::min<size_t>(entry.nameLength, name.size()));
+		if (compared != 0)
+			return compared;
+		return entry.nameLength < name.size() ? -1 : (entry.nameLength > name.size() ? 1 : 0);
+	}
+
+	// everything the lookups read must be inside the file : a truncated or corrupted archive is refused when it is opened
+	bool validate()
+	{
+		const size_t fileSize = m_file.getSize();
+		AssetArchiveHeader header;
+		if (fileSize < sizeof(header))
+			return false;
+
+		std::memcpy(&header, m_file.getData(), sizeof(header));
+		if (std::memcmp(header.magic, "UIAR", sizeof(header.magic)) != 0 || header.version != AssetArchiveHeader::s_version)
+			return false;
+		if (header.indexOffset % alignof(AssetArchiveEntry) != 0 || header.indexOffset > fileSize
+			|| header.entryCount > (fileSize - header.indexOffset) / sizeof(AssetArchiveEntry)
+			|| header.namesOffset > fileSize || header.namesSize > fileSize - header.namesOffset)
+			return false;
+
+		const AssetArchiveEntry* entries = reinterpret_cast<const AssetArchiveEntry*>(m_file.getData() + header.indexOffset);
+		m_names = (const char*)m_file.getData() + header.namesOffset;
+		for (uint32_t i = 0; i < header.entryCount; ++i)
+		{
+			const AssetArchiveEntry& entry = entries[i];
+			if ((uint64_t)entry.nameOffset + entry.nameLength > header.namesSize || entry.offset > fileSize || entry.size > fileSize - entry.offset)
+				return false;
+			if (entry.type == AssetType::TEXTURE && (entry.width < 0 || entry.height < 0 || entry.channelCount < 1 || entry.channelCount > 4
+				|| (uint64_t)entry.width * entry.height * entry.channelCount != entry.size))
+				return false;
+			if (i > 0 && compareName(entries[i - 1], getEntryName(entry)) >= 0)
+				return false;
+		}
+
+		m_entries = entries;
+		m_entryCount = header.entryCount;
+		return true;
+	}
+};
+
+// Builds an archive from files or from bytes, the tool is "UIEngine --build-asset-archive".
+// The images are decoded when the archive is built, the textures are uploaded from the archive without decoding them again.
+class AssetArchiveBuilder
+{
+private:
+	struct PendingAsset
+	{
+		std::string name;
+		AssetType type;
+		std::vector<unsigned char> bytes;
+		int width;
+		int height;
+		int channelCount;
+	};
+
+	std::vector<PendingAsset> m_assets;
+
+public:
+	// an asset added twice replaces the first one
+	void addBlob(const std::string& name, AssetType type, const unsigned char* data, size_t size, int width = 0, int height = 0, int channelCount = 0)
+	{
+		auto sameName = [&name](const PendingAsset& asset) { return asset.name == name; };
+		m_assets.erase(std::remove_if(m_assets.begin(), m_assets.end(), sameName), m_assets.end());
+
+		PendingAsset asset;
+		asset.name = name;
+		asset.type = type;
+		asset.bytes.assign(data, data + size);
+		asset.width = width;
+		asset.height = height;
+		asset.channelCount = channelCount;
+		m_assets.push_back(std::move(asset));
+	}
+
+	// the asset type comes from the file extension, the images are decoded with their own channel count.
+	// The asset is named after the file name, as given
+	bool addFile(const std::string& fileName)
+	{
+		const AssetType type = getFileType(fileName);
+		if (type == AssetType::TEXTURE)
+		{
+			int width = 0;
+			int height = 0;
+			int channelCount = 0;
+			unsigned char* pixels = stbi_load(fileName.c_str(), &width, &height, &channelCount, 0);
+			if (pixels == nullptr)
+			{
+				std::cout << "error : can't decode image " << fileName << std::endl;
+				return false;
+			}
+			addBlob(fileName, type, pixels, (size_t)width * height * channelCount, width, height, channelCount);
+			stbi_image_free(pixels);
+			return true;
+		}
+
+		FileMapping file;
+		if (!file.open(fileName))
+		{
+			std::cout << "error : can't open file " << fileName << std::endl;
+			return false;
+		}
+		addBlob(fileName, type, file.getData(), file.getSize());
+		return true;
+	}
+
+	size_t getAssetCount() const
+	{
+		return m_assets.size();
+	}
+
+	bool write(const std::string& fileName)
+	{
+		std::sort(m_assets.begin(), m_assets.end(), [](const PendingAsset& first, const PendingAsset& second) { return first.name < second.name; });
+
+		AssetArchiveHeader header;
+		std::memcpy(header.magic, "UIAR", sizeof(header.magic));
+		header.version = AssetArchiveHeader::s_version;
+		header.entryCount = (uint32_t)m_assets.size();
+		header.blobAlignment = AssetArchiveHeader::s_blobAlignment;
+		header.indexOffset = sizeof(AssetArchiveHeader);
+		header.namesOffset = header.indexOffset + m_assets.size() * sizeof(AssetArchiveEntry);
+
+		std::vector<AssetArchiveEntry> entries(m_assets.size());
+		std::string names;
+		for (size_t i = 0; i < m_assets.size(); ++i)
+		{
+			entries[i].nameOffset = (uint32_t)names.size();
+			entries[i].nameLength = (uint32_t)m_assets[i].name.size();
+			names += m_assets[i].name;
+		}
+		header.namesSize = names.size();
+
+		uint64_t offset = alignOffset(header.namesOffset + header.namesSize);
+		for (size_t i = 0; i < m_assets.size(); ++i)
+		{
+			const PendingAsset& asset = m_assets[i];
+			entries[i].offset = offset;
+			entries[i].size = asset.bytes.size();
+			entries[i].type = asset.type;
+			entries[i].width = asset.width;
+			entries[i].height = asset.height;
+			entries[i].channelCount = asset.channelCount;
+			offset = alignOffset(offset + asset.bytes.size());
+		}
+
+		std::ofstream stream(fileName, std::ios::binary | std::ios::trunc);
+		if (!stream.is_open())
+			return false;
+
+		stream.write((const char*)&header, sizeof(header));
+		if (!entries.empty())
+			stream.write((const char*)entries.data(), entries.size() * sizeof(AssetArchiveEntry));
+		stream.write(names.data(), names.size());
+
+		uint64_t writtenSize = header.namesOffset + header.namesSize;
+		for (size_t i = 0; i < m_assets.size(); ++i)
+		{
+			writePadding(stream, entries[i].offset - writtenSize);
+			if (!m_assets[i].bytes.empty())
+				stream.write((const char*)m_assets[i].bytes.data(), m_assets[i].bytes.size());
+			writtenSize = entries[i].offset + entries[i].size;
+		}
+		return (bool)stream;
+	}
+
+private:
+	static uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + AssetArchiveHeader::s_blobAlignment - 1) / AssetArchiveHeader::s_blobAlignment * AssetArchiveHeader::s_blobAlignment;
+	}
+	static void writePadding(std::ofstream& stream, uint64_t size)
+	{
+		static const char zeros[AssetArchiveHeader::s_blobAlignment] = {};
+		stream.write(zeros, (std::streamsize)size);
+	}
+	static AssetType getFileType(const std::string& fileName)
+	{
+		const size_t dot = fileName.find_last_of('.');
+		std::string extension = dot != std::string::npos ? fileName.substr(dot + 1) : "";
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char character) { return (char)std::tolower((unsigned char)character); });
+
+		if (extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "bmp" || extension == "tga")
+			return AssetType::TEXTURE;
+		if (extension == "vert" || extension == "frag" || extension == "glsl")
+			return AssetType::SHADER;
+		if (extension == "ttf" || extension == "otf")
+			return AssetType::FONT;
+		if (extension == "fontcache")
+			return AssetType::FONT_ATLAS;
+		return AssetType::BLOB;
+	}
+};
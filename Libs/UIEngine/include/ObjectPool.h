@@ -0,0 +1,230 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+
+// Blocks of one size, carved from big slabs.
+// A new slab is chained in address order, so the objects allocated one after the other (the slots of a layer, their widgets) are contiguous.
+// A freed block goes back on top of the free list and is reused by the next allocation.
+class SlabPool
+{
+private:
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	size_t m_blockSize;
+	size_t m_blocksPerSlab;
+	std::vector<std::unique_ptr<unsigned char[]>> m_slabs;
+	FreeBlock* m_freeBlocks;
+	size_t m_usedBlockCount;
+
+public:
+	SlabPool(size_t blockSize, size_t slabSize)
+		: m_blockSize(blockSize)
+		, m_blocksPerSlab(slabSize / blockSize > 0 ? slabSize / blockSize : 1)
+		, m_freeBlocks(nullptr)
+		, m_usedBlockCount(0)
+	{}
+	SlabPool(const SlabPool& other) = delete;
+	SlabPool& operator=(const SlabPool& other) = delete;
+
+	void* allocate()
+	{
+		if (m_freeBlocks == nullptr)
+			addSlab();
+
+		FreeBlock* block = m_freeBlocks;
+		m_freeBlocks = block->next;
+		m_usedBlockCount++;
+		return block;
+	}
+	void deallocate(void* pointer)
+	{
+		FreeBlock* block = static_cast<FreeBlock*>(pointer);
+		block->next = m_freeBlocks;
+		m_freeBlocks = block;
+		m_usedBlockCount--;
+	}
+
+	size_t getBlockSize() const
+	{
+		return m_blockSize;
+	}
+	size_t getSlabCount() const
+	{
+		return m_slabs.size();
+	}
+	size_t getUsedBlockCount() const
+	{
+		return m_usedBlockCount;
+	}
+
+private:
+	void addSlab()
+	{
+		// new[] of bytes is aligned for any type of the block size
+		m_slabs.push_back(std::unique_ptr<unsigned char[]>(new unsigned char[m_blockSize * m_blocksPerSlab]));
+		unsigned char* slab = m_slabs.back().get();
+
+		// chained from the end, the first block is allocated first
+		for (size_t blockIndex = m_blocksPerSlab; blockIndex > 0; --blockIndex)
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + (blockIndex - 1) * m_blockSize);
+			block->next = m_freeBlocks;
+			m_freeBlocks = block;
+		}
+	}
+};
+
+// One slab pool per size class, the widgets, slots and layers of the same size share their slabs.
+// The objects bigger than s_maxPooledSize and the arrays go to the global heap, they are counted so the benchmarks can report them.
+// Not thread safe : the items are created and destroyed on the UI thread.
+class ObjectPools
+{
+private:
+	enum : size_t
+	{
+		s_alignment = alignof(std::max_align_t),
+		s_maxPooledSize = 1024,
+		s_slabSize = 64 * 1024,
+	};
+
+	// indexed by size / alignment, created on first use
+	std::vector<std::unique_ptr<SlabPool>> m_pools;
+	// live allocations which couldn't be pooled
+	size_t m_heapAllocationCount;
+
+public:
+	ObjectPools()
+		: m_pools(s_maxPooledSize / s_alignment + 1)
+		, m_heapAllocationCount(0)
+	{}
+	ObjectPools(const ObjectPools& other) = delete;
+	ObjectPools& operator=(const ObjectPools& other) = delete;
+
+	static bool isPooled(size_t size, size_t alignment)
+	{
+		return size > 0 && size <= s_maxPooledSize && alignment <= s_alignment;
+	}
+
+	void* allocate(size_t size)
+	{
+		return getPool(size).allocate();
+	}
+	void deallocate(void* pointer, size_t size)
+	{
+		getPool(size).deallocate(pointer);
+	}
+	void* allocateFromHeap(size_t size)
+	{
+		void* pointer = ::operator new(size);
+		m_heapAllocationCount++;
+		return pointer;
+	}
+	void deallocateFromHeap(void* pointer)
+	{
+		::operator delete(pointer);
+		m_heapAllocationCount--;
+	}
+
+	size_t getSlabCount() const
+	{
+		size_t slabCount = 0;
+		for (const auto& pool : m_pools)
+		{
+			if (pool != nullptr)
+				slabCount += pool->getSlabCount();
+		}
+		return slabCount;
+	}
+	size_t getUsedBlockCount() const
+	{
+		size_t usedBlockCount = 0;
+		for (const auto& pool : m_pools)
+		{
+			if (pool != nullptr)
+				usedBlockCount += pool->getUsedBlockCount();
+		}
+		return usedBlockCount;
+	}
+	size_t getHeapAllocationCount() const
+	{
+		return m_heapAllocationCount;
+	}
+
+private:
+	SlabPool& getPool(size_t size)
+	{
+		const size_t sizeClass = (size + s_alignment - 1) / s_alignment;
+		auto& pool = m_pools[sizeClass];
+		if (pool == nullptr)
+			pool = std::make_unique<SlabPool>(sizeClass * s_alignment, s_slabSize);
+
+		return *pool;
+	}
+};
+
+// Allocator of the engine items, given to std::allocate_shared : the object and its reference counts take one pooled block.
+// Only the memory comes from the pools, the items are still owned by std::shared_ptr with its atomic reference counts and weak_ptr checks.
+// Each allocation keeps the pools alive, an item can outlive the engine which created it.
+// Without pools, it allocates on the global heap like std::make_shared.
+template<typename T>
+class PoolAllocator
+{
+	template<typename U>
+	friend class PoolAllocator;
+
+public:
+	typedef T value_type;
+
+private:
+	std::shared_ptr<ObjectPools> m_pools;
+
+public:
+	PoolAllocator(std::shared_ptr<ObjectPools> pools = nullptr)
+		: m_pools(pools)
+	{}
+	template<typename U>
+	PoolAllocator(const PoolAllocator<U>& other)
+		: m_pools(other.m_pools)
+	{}
+
+	T* allocate(size_t count)
+	{
+		if (m_pools == nullptr)
+			return static_cast<T*>(::operator new(count * sizeof(T)));
+		if (count == 1 && ObjectPools::isPooled(sizeof(T), alignof(T)))
+			return static_cast<T*>(m_pools->allocate(sizeof(T)));
+
+		return static_cast<T*>(m_pools->allocateFromHeap(count * sizeof(T)));
+	}
+	void deallocate(T* pointer, size_t count)
+	{
+		if (m_pools == nullptr)
+			::operator delete(pointer);
+		else if (count == 1 && ObjectPools::isPooled(sizeof(T), alignof(T)))
+			m_pools->deallocate(pointer, sizeof(T));
+		else
+			m_pools->deallocateFromHeap(pointer);
+	}
+
+	const std::shared_ptr<ObjectPools>& getPools() const
+	{
+		return m_pools;
+	}
+
+	template<typename U>
+	bool operator==(const PoolAllocator<U>& other) const
+	{
+		return m_pools == other.m_pools;
+	}
+	template<typename U>
+	bool operator!=(const PoolAllocator<U>& other) const
+	{
+		return m_pools != other.m_pools;
+	}
+};
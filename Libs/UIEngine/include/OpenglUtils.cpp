@@ -1,37 +1,10 @@
 #include "OpenglUtils.h"
 
-std::vector<char> readFile(const std::string& filePath)
-{
-	std::vector<char> output;
-
-	std::string line;
-	std::ifstream fileIn(filePath);
-	if (fileIn.is_open())
-	{
-		fileIn.seekg(0, fileIn.end);
-		int fileSize = fileIn.tellg();
-		fileIn.seekg(0, fileIn.beg);
-
-		output.resize(fileSize);
-
-		fileIn.read(&output[0], fileSize);
-
-		fileIn.close();
-	}
-	else
-	{
-		std::cout << "error : can't open file " << filePath.c_str() << std::endl;
-	}
-
-	return output;
-}
-
-GLuint loadAndCompileShader(const std::string& shaderFilePath, GLenum shaderType)
+GLuint compileShaderSource(const char* source, size_t sourceLength, GLenum shaderType)
 {
 	GLuint shader = glCreateShader(shaderType);
-	std::vector<char> shaderFileContent = readFile(shaderFilePath);
-	const char* shaderFileContentPtr = shaderFileContent.data();
-	glShaderSource(shader, 1, &shaderFileContentPtr, nullptr);
+	const GLint length = (GLint)sourceLength;
+	glShaderSource(shader, 1, &source, &length);
 	glCompileShader(shader);
 
 	int  success;
@@ -46,11 +19,30 @@ GLuint loadAndCompileShader(const std::string& shaderFilePath, GLenum shaderType
 	return shader;
 }
 
-GLuint createShaderProgram(const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath)
+GLuint loadAndCompileShader(const std::string& shaderFilePath, GLenum shaderType)
 {
-	GLuint vertexShader = loadAndCompileShader(vertexShaderFilePath, GL_VERTEX_SHADER);
-	GLuint fragmentShader = loadAndCompileShader(fragmentShaderFilePath, GL_FRAGMENT_SHADER);
+	// reused by the successive shaders
+	static thread_local std::vector<char> shaderFileContent;
+	fileUtils::readFile(shaderFilePath, shaderFileContent);
+	return compileShaderSource(shaderFileContent.data(), shaderFileContent.size(), shaderType);
+}
+
+unsigned char* loadImage(const std::string& fileName, int* width, int* height, int* channelCountInFile, int desiredChannelCount)
+{
+	// each thread keeps its buffer, the texture loader workers decode in parallel
+	static thread_local fileUtils::FileContent file;
+	if (!file.open(fileName))
+		return nullptr;
 
+	unsigned char* pixels = stbi_load_from_memory(file.getData(), (int)file.getSize(), width, height, channelCountInFile, desiredChannelCount);
+	// the mapping of a big image isn't kept, the buffer of the small ones is
+	if (file.isMapped())
+		file.close();
+	return pixels;
+}
+
+static GLuint linkShaderProgram(GLuint vertexShader, GLuint fragmentShader)
+{
 	GLuint shaderProgram = glCreateProgram();
 	glAttachShader(shaderProgram, vertexShader);
 	glAttachShader(shaderProgram, fragmentShader);
@@ -70,6 +62,20 @@ GLuint createShaderProgram(const std::string& vertexShaderFilePath, const std::s
 	return shaderProgram;
 }
 
+GLuint createShaderProgram(const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath)
+{
+	GLuint vertexShader = loadAndCompileShader(vertexShaderFilePath, GL_VERTEX_SHADER);
+	GLuint fragmentShader = loadAndCompileShader(fragmentShaderFilePath, GL_FRAGMENT_SHADER);
+	return linkShaderProgram(vertexShader, fragmentShader);
+}
+
+GLuint createShaderProgramFromSources(const char* vertexSource, size_t vertexSourceLength, const char* fragmentSource, size_t fragmentSourceLength)
+{
+	GLuint vertexShader = compileShaderSource(vertexSource, vertexSourceLength, GL_VERTEX_SHADER);
+	GLuint fragmentShader = compileShaderSource(fragmentSource, fragmentSourceLength, GL_FRAGMENT_SHADER);
+	return linkShaderProgram(vertexShader, fragmentShader);
+}
+
 glm::vec4 viewportTransformInPlace(const glm::vec4& rect, const glm::vec2& viewportSize)
 {
 	glm::vec4 box = rect;
@@ -10,15 +10,31 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <deque>
+#include <cstring>
+#include <algorithm>
+#include <future>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
 
 #include "Utils.h"
+#include "RectPacker.h"
+#include "FileMapping.h"
+#include "FileIO.hpp"
+#include "ThreadPool.h"
+#include "UIProfiler.h"
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
-std::vector<char> readFile(const std::string& filePath);
 GLuint loadAndCompileShader(const std::string& shaderFilePath, GLenum shaderType);
 GLuint createShaderProgram(const std::string& vertexShaderFilePath, const std::string& fragmentShaderFilePath);
+// the sources are given with their length, they don't need to be null terminated (ex : views on a mapped asset archive)
+GLuint compileShaderSource(const char* source, size_t sourceLength, GLenum shaderType);
+GLuint createShaderProgramFromSources(const char* vertexSource, size_t vertexSourceLength, const char* fragmentSource, size_t fragmentSourceLength);
+// stbi_load, with the file read at once (stb_image reads the files by small chunks). Free the pixels with stbi_image_free
+unsigned char* loadImage(const std::string& fileName, int* width, int* height, int* channelCountInFile, int desiredChannelCount);
 
 glm::vec4 viewportTransformInPlace(const glm::vec4& rect, const glm::vec2& viewportSize);
 void viewportTransform(glm::vec4& rect, const glm::vec2& viewportSize);
@@ -101,14 +117,45 @@ public:
 	}
 };
 
+// handle on an active uniform of a ShaderProgram, InvalidUniformHandle if the uniform isn't active
+typedef int UniformHandle;
+static const UniformHandle InvalidUniformHandle = -1;
+
+struct UniformInfo
+{
+	std::string name;
+	GLint location;
+	GLenum type;
+	GLint arraySize;
+
+	// last uploaded value, used to skip redundant uploads
+	unsigned char shadowValue[sizeof(glm::mat4)];
+	bool hasShadowValue;
+
+	UniformInfo(const std::string& _name, GLint _location, GLenum _type, GLint _arraySize)
+		: name(_name)
+		, location(_location)
+		, type(_type)
+		, arraySize(_arraySize)
+		, hasShadowValue(false)
+	{}
+};
+
 class ShaderProgram
 {
 private:
 	GLuint m_program;
 
+	// active uniforms, enumerated once at link time
+	std::vector<UniformInfo> m_uniforms;
+	std::map<std::string, UniformHandle> m_uniformHandles;
+	// set at each bind by the UI drawers, resolved at link time so the binds don't look it up by name
+	UniformHandle m_viewportSizeHandle;
+
 public:
 	ShaderProgram()
 		: m_program(0)
+		, m_viewportSizeHandle(InvalidUniformHandle)
 	{}
 
 	~ShaderProgram()
@@ -128,6 +175,19 @@ public:
 			m_program = 0;
 		}
 		m_program = createShaderProgram(vertexShaderFilePath, fragmentShaderFilePath);
+
+		reflectUniforms();
+	}
+	void loadFromSources(const char* vertexSource, size_t vertexSourceLength, const char* fragmentSource, size_t fragmentSourceLength)
+	{
+		if (m_program != 0)
+		{
+			glDeleteProgram(m_program);
+			m_program = 0;
+		}
+		m_program = createShaderProgramFromSources(vertexSource, vertexSourceLength, fragmentSource, fragmentSourceLength);
+
+		reflectUniforms();
 	}
 
 	void use()
@@ -139,6 +199,123 @@ public:
 	{
 		return m_program;
 	}
+
+	// uniforms
+	// resolve the handle once (ex : at init) and keep it, the lookup doesn't touch the driver
+	UniformHandle getUniformHandle(const std::string& name) const
+	{
+		auto found = m_uniformHandles.find(name);
+		if (found != m_uniformHandles.end())
+			return found->second;
+		else
+			return InvalidUniformHandle;
+	}
+	const std::vector<UniformInfo>& getUniforms() const
+	{
+		return m_uniforms;
+	}
+	UniformHandle getViewportSizeHandle() const
+	{
+		return m_viewportSizeHandle;
+	}
+
+	// typed setters, the program must be in use. The upload is skipped if the value hasn't changed since the last call.
+	void setUniform(UniformHandle handle, float value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform1f(m_uniforms[handle].location, value);
+	}
+	void setUniform(UniformHandle handle, int value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform1i(m_uniforms[handle].location, value);
+	}
+	void setUniform(UniformHandle handle, const glm::vec2& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform2fv(m_uniforms[handle].location, 1, &value[0]);
+	}
+	void setUniform(UniformHandle handle, const glm::vec3& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform3fv(m_uniforms[handle].location, 1, &value[0]);
+	}
+	void setUniform(UniformHandle handle, const glm::vec4& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniform4fv(m_uniforms[handle].location, 1, &value[0]);
+	}
+	void setUniform(UniformHandle handle, const glm::mat4& value)
+	{
+		if (updateShadowValue(handle, value))
+			glUniformMatrix4fv(m_uniforms[handle].location, 1, GL_FALSE, &value[0][0]);
+	}
+	// forget the shadowed values, to use if the uniforms are modified outside of these setters
+	void invalidateUniformShadowValues()
+	{
+		for (auto& uniform : m_uniforms)
+		{
+			uniform.hasShadowValue = false;
+		}
+	}
+
+private:
+	void reflectUniforms()
+	{
+		m_uniforms.clear();
+		m_uniformHandles.clear();
+		m_viewportSizeHandle = InvalidUniformHandle;
+
+		if (m_program == 0)
+			return;
+
+		GLint uniformCount = 0;
+		GLint maxNameLength = 0;
+		glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &uniformCount);
+		glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+		std::vector<GLchar> nameBuffer(std::max(maxNameLength, 1));
+		for (GLint uniformIdx = 0; uniformIdx < uniformCount; uniformIdx++)
+		{
+			GLsizei nameLength = 0;
+			GLint arraySize = 0;
+			GLenum type = 0;
+			glGetActiveUniform(m_program, uniformIdx, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+
+			std::string name(nameBuffer.data(), nameLength);
+			GLint location = glGetUniformLocation(m_program, name.c_str());
+			// uniforms inside uniform blocks have no location
+			if (location < 0)
+				continue;
+
+			// arrays are reported as "name[0]", we register them by their base name
+			const std::size_t arraySuffix = name.find('[');
+			if (arraySuffix != std::string::npos)
+				name.resize(arraySuffix);
+
+			m_uniformHandles[name] = (UniformHandle)m_uniforms.size();
+			m_uniforms.push_back(UniformInfo(name, location, type, arraySize));
+		}
+		m_viewportSizeHandle = getUniformHandle("viewportSize");
+	}
+
+	template<typename T>
+	bool updateShadowValue(UniformHandle handle, const T& value)
+	{
+		static_assert(sizeof(T) <= sizeof(glm::mat4), "uniform value too big for the shadow storage");
+
+		if (handle < 0 || handle >= (UniformHandle)m_uniforms.size())
+			return false;
+
+		UniformInfo& uniform = m_uniforms[handle];
+		if (uniform.hasShadowValue && std::memcmp(uniform.shadowValue, &value, sizeof(T)) == 0)
+			return false;
+
+		std::memcpy(uniform.shadowValue, &value, sizeof(T));
+		uniform.hasShadowValue = true;
+		UIENGINE_PROFILE_COUNT(UIProfileCounter::UNIFORM_UPLOADS, 1);
+		return true;
+	}
 };
 
 class Texture
@@ -148,24 +325,54 @@ private:
 	int m_texWidth;
 	int m_texHeight;
 	unsigned char* m_imageDatas;
+	// pixels owned by someone else (an atlas page), used instead of m_imageDatas
+	const unsigned char* m_pixelSource;
 
 	GLint m_internalFormat;
 	GLenum m_format;
 	GLenum m_type;
+	// never pushed to the GPU, see setCPUOnly
+	bool m_isCPUOnly;
 
 public:
 
 	Texture()
-		: m_imageDatas(nullptr)
+		: m_glId(0)
 		, m_texWidth(0)
 		, m_texHeight(0)
-		, m_glId(0)
+		, m_imageDatas(nullptr)
+		, m_pixelSource(nullptr)
+		, m_internalFormat(GL_RGBA)
+		, m_format(GL_RGBA)
+		, m_type(GL_UNSIGNED_BYTE)
+		, m_isCPUOnly(false)
 	{}
 
+	// false in the processes without opengl context (tests, software rendering) : the textures only keep their pixels on the CPU
+	static void setGPUEnabled(bool isEnabled)
+	{
+		getGPUEnabled() = isEnabled;
+	}
+	static bool isGPUEnabled()
+	{
+		return getGPUEnabled();
+	}
+	// the texture only keeps its pixels on the CPU (ex : drawn by the software drawer), even if the process has an opengl context
+	void setCPUOnly(bool isCPUOnly)
+	{
+		m_isCPUOnly = isCPUOnly;
+		if (m_isCPUOnly && m_glId != 0)
+			popFromGPU();
+	}
+	bool isCPUOnly() const
+	{
+		return m_isCPUOnly || !isGPUEnabled();
+	}
+
 	~Texture()
 	{
 		if (m_imageDatas != nullptr)
-			delete m_imageDatas;
+			stbi_image_free(m_imageDatas);
 		if (m_glId != 0)
 			popFromGPU();
 	}
@@ -181,27 +388,45 @@ public:
 	{
 
 		if (m_imageDatas != nullptr)
-			delete m_imageDatas;
+			stbi_image_free(m_imageDatas);
 		if (m_glId != 0)
 			popFromGPU();
 
 		setFormatAndType(internalFormat, format, type);
 
 		int channelCountInFile;
-		m_imageDatas = stbi_load(fileName.c_str(), &m_texWidth, &m_texHeight, &channelCountInFile, desiredChannelCount);
+		m_imageDatas = loadImage(fileName, &m_texWidth, &m_texHeight, &channelCountInFile, desiredChannelCount);
 
 		assert(desiredChannelCount <= channelCountInFile);
 
+		// the parameters need the gl texture
+		pushToGPU();
+
 		setParameters(params);
+	}
+	// same as load, from the bytes of an image file already in memory
+	void loadFromMemory(const unsigned char* fileData, size_t fileSize, int desiredChannelCount, const std::vector<std::pair<GLenum, GLint>>& params, GLint internalFormat, GLenum format, GLenum type)
+	{
+		if (m_imageDatas != nullptr)
+			stbi_image_free(m_imageDatas);
+		if (m_glId != 0)
+			popFromGPU();
+
+		setFormatAndType(internalFormat, format, type);
+
+		int channelCountInFile;
+		m_imageDatas = stbi_load_from_memory(fileData, (int)fileSize, &m_texWidth, &m_texHeight, &channelCountInFile, desiredChannelCount);
+		m_pixelSource = nullptr;
 
 		pushToGPU();
+		setParameters(params);
 	}
-	// You give the texture the ownership over datas. Texture will delete it when it is destroyed.
+	// You give the texture the ownership over datas. Texture will free it when it is destroyed, so it must come from malloc or stbi_load.
 	void create(int width, int height, unsigned char* datas, const std::vector<std::pair<GLenum, GLint>>& params, GLint internalFormat, GLenum format, GLenum type)
 	{
 
 		if (m_imageDatas != nullptr)
-			delete m_imageDatas;
+			stbi_image_free(m_imageDatas);
 		if (m_glId != 0)
 			popFromGPU();
 
@@ -211,8 +436,25 @@ public:
 		m_texWidth = width;
 		m_texHeight = height;
 
-		setParameters(params);
+		// the parameters need the gl texture
 		pushToGPU();
+		setParameters(params);
+	}
+	// Upload decoded pixels which stay owned by the caller (ex : a mapped asset archive), nothing is copied on the CPU.
+	// The pixels must outlive the texture, the software drawer reads them
+	void createFromPixels(int width, int height, const unsigned char* pixels, const std::vector<std::pair<GLenum, GLint>>& params, GLint internalFormat, GLenum format, GLenum type)
+	{
+		if (m_imageDatas != nullptr)
+			stbi_image_free(m_imageDatas);
+		m_imageDatas = nullptr;
+		if (m_glId != 0)
+			popFromGPU();
+
+		setFormatAndType(internalFormat, format, type);
+		setPixelSource(width, height, pixels, format);
+
+		pushToGPU(pixels);
+		setParameters(params);
 	}
 
 	GLuint getGLId() const
@@ -227,10 +469,54 @@ public:
 	{
 		return m_texHeight;
 	}
+	// pixels on the CPU, rows from the top, null if they have been released. Read by the software drawer
+	const unsigned char* getPixels() const
+	{
+		return m_pixelSource != nullptr ? m_pixelSource : m_imageDatas;
+	}
+	int getChannelCount() const
+	{
+		switch (m_format)
+		{
+		case GL_RED:
+			return 1;
+		case GL_RG:
+			return 2;
+		case GL_RGB:
+			return 3;
+		default:
+			return 4;
+		}
+	}
+	// the texture is uploaded from pixels which stay owned by the caller, they must outlive the texture
+	void setPixelSource(int width, int height, const unsigned char* pixels, GLenum format)
+	{
+		m_texWidth = width;
+		m_texHeight = height;
+		m_pixelSource = pixels;
+		m_format = format;
+	}
 
 	void bind()
 	{
 		glBindTexture(GL_TEXTURE_2D, m_glId);
+		UIENGINE_PROFILE_COUNT(UIProfileCounter::TEXTURE_BINDS, 1);
+	}
+	// upload a part of the texture, pixels points to the top left pixel of the part, inside rows of rowLength pixels
+	void updateSubImage(int x, int y, int width, int height, int rowLength, const unsigned char* pixels)
+	{
+		if (m_glId == 0)
+			return;
+
+		glBindTexture(GL_TEXTURE_2D, m_glId);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, m_format, m_type, pixels);
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 	void unbind()
 	{
@@ -252,14 +538,23 @@ public:
 	}
 
 	void pushToGPU()
+	{
+		pushToGPU(m_imageDatas);
+	}
+	void pushToGPU(const unsigned char* pixels)
 	{
 		if (m_glId != 0)
 			popFromGPU();
+		if (isCPUOnly())
+			return;
 
 		glGenTextures(1, &m_glId);
 		glBindTexture(GL_TEXTURE_2D, m_glId);
 
-		glTexImage2D(GL_TEXTURE_2D, 0, m_internalFormat, m_texWidth, m_texHeight, 0, m_format, m_type, m_imageDatas);
+		// the rows of the RGB images aren't aligned on 4 bytes
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, m_internalFormat, m_texWidth, m_texHeight, 0, m_format, m_type, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glBindTexture(GL_TEXTURE_2D, 0);
@@ -273,6 +568,13 @@ public:
 		}
 	}
 
+private:
+	static bool& getGPUEnabled()
+	{
+		static bool isEnabled = true;
+		return isEnabled;
+	}
+
 public:
 
 	static std::shared_ptr<Texture> load_RGB_image(const std::string& fileName)
@@ -296,18 +598,24 @@ struct Glyph
 	glm::ivec2 bearing;				// Offset from baseline to left/top of glyph
 	GLuint     advance;				// Offset to advance to next glyph
 	GLuint     advanceInPixel;		// Offset to advance to next glyph
+	int        atlasPage;			// Page of the atlas containing the bitmap, -1 for the glyphs without bitmap
+	glm::ivec2 atlasPos;			// Top left corner of the bitmap inside the page, in pixels
 
 	Glyph()
 		: size(0, 0)
 		, bearing(0, 0)
 		, advance(0)
 		, advanceInPixel(0)
+		, atlasPage(-1)
+		, atlasPos(0, 0)
 	{}
 
 	Glyph(glm::ivec2 _size, glm::ivec2 _bearing, GLuint _advance)
 		: size(_size)
 		, bearing(_bearing)
 		, advance(_advance)
+		, atlasPage(-1)
+		, atlasPos(0, 0)
 	{
 		advanceInPixel = (advance >> 6);
 	}
@@ -323,273 +631,932 @@ struct Glyph
 	}
 };
 
+// A page of an atlas (glyphs or icons), the images are packed in it and uploaded by parts
+struct AtlasPage
+{
+	std::shared_ptr<Texture> m_texture;
+	SkylinePacker m_packer;
+	std::vector<unsigned char> m_pixels;
+	int m_channelCount;
+
+	// part of the pixels modified since the last upload, empty if min >= max
+	glm::ivec2 m_dirtyMin;
+	glm::ivec2 m_dirtyMax;
+
+	AtlasPage(int size, int channelCount = 1)
+		: m_texture(std::make_shared<Texture>())
+		, m_packer(size, size)
+		, m_pixels(size * size * channelCount, 0)
+		, m_channelCount(channelCount)
+		, m_dirtyMin(0, 0)
+		, m_dirtyMax(0, 0)
+	{
+		// the pixels are never reallocated, the software drawer samples them through the texture
+		m_texture->setPixelSource(size, size, m_pixels.data(), channelCount == 1 ? GL_RED : GL_RGBA);
+	}
+
+	int getSize() const
+	{
+		return m_packer.getWidth();
+	}
+	unsigned char* getPixel(const glm::ivec2& pos)
+	{
+		return &m_pixels[(pos.y * getSize() + pos.x) * m_channelCount];
+	}
+	// send the modified part of the pixels, the texture is created by the first upload
+	void upload(GLint internalFormat, GLenum format)
+	{
+		if (!isDirty())
+			return;
+		// the software drawer already samples the pixels
+		if (m_texture->isCPUOnly())
+		{
+			m_dirtyMin = glm::ivec2(0, 0);
+			m_dirtyMax = glm::ivec2(0, 0);
+			return;
+		}
+
+		if (m_texture->getGLId() == 0)
+		{
+			m_texture->create(getSize(), getSize(), nullptr, { { GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE },{ GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE },{ GL_TEXTURE_MIN_FILTER, GL_LINEAR },{ GL_TEXTURE_MAG_FILTER, GL_LINEAR } }, internalFormat, format, GL_UNSIGNED_BYTE);
+			m_dirtyMin = glm::ivec2(0, 0);
+			m_dirtyMax = glm::ivec2(getSize(), getSize());
+		}
+
+		const glm::ivec2 dirtySize = m_dirtyMax - m_dirtyMin;
+		m_texture->updateSubImage(m_dirtyMin.x, m_dirtyMin.y, dirtySize.x, dirtySize.y, getSize(), getPixel(m_dirtyMin));
+
+		m_dirtyMin = glm::ivec2(0, 0);
+		m_dirtyMax = glm::ivec2(0, 0);
+	}
+	bool isDirty() const
+	{
+		return m_dirtyMin.x < m_dirtyMax.x && m_dirtyMin.y < m_dirtyMax.y;
+	}
+	void addDirtyRect(const glm::ivec2& pos, const glm::ivec2& size)
+	{
+		if (!isDirty())
+		{
+			m_dirtyMin = pos;
+			m_dirtyMax = pos + size;
+		}
+		else
+		{
+			m_dirtyMin = glm::min(m_dirtyMin, pos);
+			m_dirtyMax = glm::max(m_dirtyMax, pos + size);
+		}
+	}
+};
+
+// Pages are added when the previous ones are full. A packed glyph never moves, so its source rect stays valid.
 struct FontAtlas
 {
-	std::shared_ptr<Texture> m_fontTexture;
+	std::vector<std::unique_ptr<AtlasPage>> m_pages;
+	int m_pageSize;
 	float m_glyphWidth;
-	float m_glyphHeight;
-	unsigned int m_glyphCount;
-	unsigned int m_colCount;
-	unsigned int m_rowCount;	
+	float m_glyphHeight; // line height
+	float m_ascender; // from the top of a line to its baseline
+
+	FontAtlas()
+		: m_pageSize(512)
+		, m_glyphWidth(0)
+		, m_glyphHeight(0)
+		, m_ascender(0)
+	{}
 };
 
-class Font
+// charcode -> glyph index, used for each character of each text.
+// The BMP charcodes are directly indexed by pages of 256 glyph indices, only the pages which contain glyphs are stored.
+// The other charcodes go to a small open addressing table, with linear probing.
+class GlyphLookupTable
 {
 private:
-	FontAtlas m_atlas;
+	enum : unsigned int
+	{
+		s_pageSize = 256,
+		s_bmpPageCount = 0x10000 / s_pageSize,
 
-	float m_fontSize;
-	std::string m_fontName;
+		// glyph index 0 is the "missing glyph" of the FreeType fonts, so it also marks the empty entries
+		s_noGlyph = 0,
+		// charcode of an empty slot in the extended table, never inserted since it belongs to the BMP
+		s_emptyCharcode = 0,
+	};
 
-	std::map<unsigned long, unsigned int> m_charToIndex; // charcode -> glyph index 
-	std::vector<Glyph> m_glyphInfos; // glyphinfos
+	// page index -> offset of the page in m_bmpGlyphs, the first page is shared by all the empty pages
+	unsigned int m_bmpPageOffsets[s_bmpPageCount];
+	std::vector<unsigned int> m_bmpGlyphs;
 
-public:
-	void load(FT_Face face, const std::string& fontName, unsigned int fontSize)
-	{
-		m_fontSize = fontSize;
-		m_fontName = fontName;
+	std::vector<unsigned long> m_extendedCharcodes;
+	std::vector<unsigned int> m_extendedGlyphs;
+	unsigned int m_extendedCount;
+	unsigned int m_extendedHashShift;
 
-		FT_Set_Pixel_Sizes(face, 0, m_fontSize);
+	unsigned int m_count;
 
-		create(face);
-	}
-	const FontAtlas& getAtlas() const
+public:
+	GlyphLookupTable()
 	{
-		return m_atlas;
+		clear();
 	}
-	Rect computeTextBounds(const std::string& text) const
+
+	void clear()
 	{
-		const Glyph* glyph = nullptr;
-		bool success = true;
-		Rect bound(0, 0, 0, 0);
-		glm::vec2 cursor(0, 0);
-		for (const auto& character : text)
-		{
-			success = getGlyphInfoFromChar(character, &glyph);
+		std::fill(m_bmpPageOffsets, m_bmpPageOffsets + s_bmpPageCount, 0);
+		m_bmpGlyphs.assign(s_pageSize, s_noGlyph);
+		m_extendedCharcodes.clear();
+		m_extendedGlyphs.clear();
+		m_extendedCount = 0;
+		m_extendedHashShift = 32;
+		m_count = 0;
+	}
 
-			if (!success)
-				break;
+	void insert(unsigned long charcode, unsigned int glyphIndex)
+	{
+		if (glyphIndex == s_noGlyph)
+			return;
 
-			Rect glyphRect = glyph->getGlyphRectIncludingAdvance();
-			glyphRect.addOffset(cursor);
-			bound.append(glyphRect);
-			cursor.x += glyph->advanceInPixel;
+		if (charcode < 0x10000)
+		{
+			const unsigned int pageIndex = (unsigned int)(charcode / s_pageSize);
+			if (m_bmpPageOffsets[pageIndex] == 0)
+			{
+				m_bmpPageOffsets[pageIndex] = (unsigned int)m_bmpGlyphs.size();
+				m_bmpGlyphs.resize(m_bmpGlyphs.size() + s_pageSize, s_noGlyph);
+			}
 
+			unsigned int& entry = m_bmpGlyphs[m_bmpPageOffsets[pageIndex] + charcode % s_pageSize];
+			if (entry == s_noGlyph)
+				m_count++;
+			entry = glyphIndex;
 		}
+		else
+		{
+			// keep the table at most half full so the probe sequences stay short
+			if ((m_extendedCount + 1) * 2 > m_extendedCharcodes.size())
+				growExtended();
 
-		return bound;
+			if (insertExtended(charcode, glyphIndex))
+			{
+				m_extendedCount++;
+				m_count++;
+			}
+		}
 	}
 
-	glm::vec2 getCursorPos(const std::string& text, unsigned int cursorIdx)
+	bool find(unsigned long charcode, unsigned int& outGlyphIndex) const
 	{
-		const Glyph* glyph = nullptr;
-		bool success = true;
-		glm::vec2 cursor(0, 0);
-		for (int i = 0; i < cursorIdx; i++)
+		if (charcode < 0x10000)
 		{
-			const auto& character = text[i];
-			success = getGlyphInfoFromChar(character, &glyph);
+			outGlyphIndex = m_bmpGlyphs[m_bmpPageOffsets[charcode / s_pageSize] + charcode % s_pageSize];
+			return outGlyphIndex != s_noGlyph;
+		}
 
-			if (!success)
-				break;
+		if (m_extendedCount == 0)
+			return false;
 
-			cursor.x += glyph->advanceInPixel;
+		const size_t mask = m_extendedCharcodes.size() - 1;
+		for (size_t slot = hashCharcode(charcode); m_extendedCharcodes[slot] != s_emptyCharcode; slot = (slot + 1) & mask)
+		{
+			if (m_extendedCharcodes[slot] == charcode)
+			{
+				outGlyphIndex = m_extendedGlyphs[slot];
+				return true;
+			}
 		}
+		return false;
+	}
 
-		return cursor;
+	unsigned int size() const
+	{
+		return m_count;
 	}
-	unsigned int getCursorIdx(const std::string& text, const glm::vec2& cursorPos)
+
+	// call function(charcode, glyphIndex) for each entry, the BMP charcodes first and in order
+	template<typename Function>
+	void forEach(Function function) const
 	{
-		const Glyph* glyph = nullptr;
-		bool success = true;
-		float currentPos = 0;
-		for (int i = 0; i < text.size(); i++)
+		for (unsigned int pageIndex = 0; pageIndex < s_bmpPageCount; ++pageIndex)
 		{
-			const auto& character = text[i];
-			success = getGlyphInfoFromChar(character, &glyph);
-
-			if (!success)
-				break;
-
-			currentPos += glyph->advanceInPixel;
+			if (m_bmpPageOffsets[pageIndex] == 0)
+				continue;
 
-			if (currentPos - glyph->advanceInPixel * 0.5f > cursorPos.x)
-				return i;
+			for (unsigned int i = 0; i < s_pageSize; ++i)
+			{
+				const unsigned int glyphIndex = m_bmpGlyphs[m_bmpPageOffsets[pageIndex] + i];
+				if (glyphIndex != s_noGlyph)
+					function((unsigned long)(pageIndex * s_pageSize + i), glyphIndex);
+			}
+		}
+		for (size_t slot = 0; slot < m_extendedCharcodes.size(); ++slot)
+		{
+			if (m_extendedCharcodes[slot] != s_emptyCharcode)
+				function(m_extendedCharcodes[slot], m_extendedGlyphs[slot]);
 		}
-
-		return text.size();
 	}
-	glm::vec2 getMaxGlyphSize() const
+
+private:
+	size_t hashCharcode(unsigned long charcode) const
 	{
-		return glm::vec2(m_atlas.m_glyphWidth, m_atlas.m_glyphHeight);
+		// fibonacci hashing : the high bits of the product index the table, the consecutive charcodes of a script are spread over it
+		return (size_t)(((unsigned int)charcode * 2654435769u) >> m_extendedHashShift);
 	}
 
-	void create(FT_Face& face)
+	// return true if the charcode wasn't already in the table
+	bool insertExtended(unsigned long charcode, unsigned int glyphIndex)
 	{
-		unsigned int glyphCountPerRow = std::sqrt(face->num_glyphs);
-		unsigned int rowCount = glyphCountPerRow + (std::ceil(glyphCountPerRow) - glyphCountPerRow);
-
-		unsigned int maxGlyphWidth = 0;
-		unsigned int maxGlyphHeight = 0;
-		for (int i = 0; i < face->num_glyphs; i++)
+		const size_t mask = m_extendedCharcodes.size() - 1;
+		size_t slot = hashCharcode(charcode);
+		while (m_extendedCharcodes[slot] != s_emptyCharcode && m_extendedCharcodes[slot] != charcode)
 		{
-			if (FT_Load_Char(face, i, FT_LOAD_RENDER))
-				std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-
-			unsigned int glyphWidth = face->glyph->bitmap.width;
-			unsigned int glyphHeight = face->glyph->bitmap.rows;
-
-			if (glyphWidth > maxGlyphWidth)
-				maxGlyphWidth = glyphWidth;
-			if (glyphHeight > maxGlyphHeight)
-				maxGlyphHeight = glyphHeight;
+			slot = (slot + 1) & mask;
 		}
 
-		m_atlas.m_glyphCount = face->num_glyphs;
-		m_atlas.m_glyphWidth = maxGlyphWidth;
-		m_atlas.m_glyphHeight = maxGlyphHeight;
-		m_atlas.m_colCount = glyphCountPerRow;
-		m_atlas.m_rowCount = rowCount;
-		m_glyphInfos.resize(m_atlas.m_glyphCount);
-
-		unsigned int texWidth = m_atlas.m_glyphWidth * glyphCountPerRow;
-		unsigned int texHeight = m_atlas.m_glyphHeight * rowCount;
-		unsigned int texPixelCount = texWidth * texHeight;
-		unsigned char* textureDatas = new unsigned char[texPixelCount];
-
-		// populate m_charToIndex
-		FT_UInt index;
-		FT_ULong character = FT_Get_First_Char(face, &index);
-		while (true) {
-
-			m_charToIndex[character] = index;
+		const bool isNew = m_extendedCharcodes[slot] == s_emptyCharcode;
+		m_extendedCharcodes[slot] = charcode;
+		m_extendedGlyphs[slot] = glyphIndex;
+		return isNew;
+	}
 
-			character = FT_Get_Next_Char(face, character, &index);
-			if (!index) break;
+	void growExtended()
+	{
+		std::vector<unsigned long> oldCharcodes;
+		std::vector<unsigned int> oldGlyphs;
+		oldCharcodes.swap(m_extendedCharcodes);
+		oldGlyphs.swap(m_extendedGlyphs);
+
+		// the capacity stays a power of two for the probe mask
+		const size_t capacity = std::max<size_t>(16, oldCharcodes.size() * 2);
+		m_extendedCharcodes.assign(capacity, s_emptyCharcode);
+		m_extendedGlyphs.assign(capacity, s_noGlyph);
+		m_extendedHashShift = 32;
+		for (size_t i = capacity; i > 1; i >>= 1)
+		{
+			m_extendedHashShift--;
 		}
-		//////////////////////
 
-		unsigned int pixelCursor = 0;
-		for (unsigned int glyphIdx = 0, rowIdx = 0; rowIdx < rowCount; rowIdx++)
+		for (size_t slot = 0; slot < oldCharcodes.size(); ++slot)
 		{
-			for (unsigned int colIdx = 0; colIdx < glyphCountPerRow; colIdx++, glyphIdx++)
-			{
-				if (FT_Load_Glyph(face, glyphIdx, FT_LOAD_RENDER))
-					std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+			if (oldCharcodes[slot] != s_emptyCharcode)
+				insertExtended(oldCharcodes[slot], oldGlyphs[slot]);
+		}
+	}
+};
 
-				unsigned int glyphWidth = face->glyph->bitmap.width;
-				unsigned int glyphHeight = face->glyph->bitmap.rows;
+// glyph rasterized by a worker, before being packed in the atlas
+struct RasterizedGlyph
+{
+	unsigned int glyphIndex;
+	Glyph glyph;
+	std::vector<unsigned char> pixels; // size.x * size.y bytes, one row after the other
 
-				m_glyphInfos[glyphIdx] = Glyph(
-					glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-					glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-					face->glyph->advance.x
-				);
+	RasterizedGlyph()
+		: glyphIndex(0)
+	{}
+};
 
-				for (unsigned int j = 0; j < maxGlyphHeight; j++)
-				{
-					for (unsigned int i = 0; i < maxGlyphWidth; i++)
-					{
-						int posX = colIdx * maxGlyphWidth + i;
-						int posY = rowIdx * maxGlyphHeight + j;
-
-						if (i < glyphWidth && j < glyphHeight)
-						{
-							//int invJ = (glyphHeight-1) - j;
-							textureDatas[posX + posY * texWidth] = face->glyph->bitmap.buffer[i + j * glyphWidth];
-						}
-						else
-						{
-							textureDatas[posX + posY * texWidth] = 0;
-						}
-					}
-				}
-			}
+// bounds checked reads inside a mapped file
+class BinaryReader
+{
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_offset;
+
+public:
+	BinaryReader(const unsigned char* data, size_t size)
+		: m_data(data)
+		, m_size(size)
+		, m_offset(0)
+	{}
+
+	bool readBytes(void* outData, size_t size)
+	{
+		if (size > m_size - m_offset)
+			return false;
+
+		if (size > 0)
+			std::memcpy(outData, m_data + m_offset, size);
+		m_offset += size;
+		return true;
+	}
+	template<typename T>
+	bool read(T& outValue)
+	{
+		return readBytes(&outValue, sizeof(T));
+	}
+};
+
+template<typename T>
+void writeBinary(std::ostream& stream, const T& value)
+{
+	stream.write((const char*)&value, sizeof(T));
+}
+
+class Font
+{
+private:
+	enum : unsigned int
+	{
+		// atlas cache header, the version changes with the layout of the file
+		s_atlasCacheMagic = 0x43464752, // "RGFC"
+		s_atlasCacheVersion = 2,
+		s_atlasCacheMaxPageSize = 16384,
+		// the glyph indices of the TrueType and OpenType fonts are on 16 bits
+		s_atlasCacheMaxGlyphCount = 0x10000,
+	};
+
+	enum : int
+	{
+		// empty pixels around each glyph, so the linear filtering doesn't sample the neighbours
+		s_glyphPadding = 1,
+
+		// glyph slot values, for the glyphs which aren't in m_glyphInfos
+		s_glyphNotLoaded = -1,
+		s_glyphLoadFailed = -2,
+	};
+
+	FontAtlas m_atlas;
+
+	float m_fontSize;
+	std::string m_fontName;
+
+	// kept open to rasterize the glyphs when they are used for the first time
+	FT_Face m_face;
+
+	// the face is opened from the file when the font comes from the atlas cache and a new glyph is needed
+	FT_Library m_library;
+	std::string m_fileName;
+	// the font file in memory, owned by someone else (an asset archive), used instead of m_fileName
+	const unsigned char* m_fileData;
+	size_t m_fileDataSize;
+	unsigned long long m_fileHash;
+	unsigned int m_savedGlyphCount; // glyphs already in the atlas cache
+
+	GlyphLookupTable m_charToIndex; // charcode -> glyph index 
+	std::vector<int> m_glyphSlots; // glyph index -> position in m_glyphInfos
+	std::deque<Glyph> m_glyphInfos; // glyphinfos, only for the loaded glyphs
+
+public:
+	Font()
+		: m_fontSize(0)
+		, m_face(nullptr)
+		, m_library(nullptr)
+		, m_fileData(nullptr)
+		, m_fileDataSize(0)
+		, m_fileHash(0)
+		, m_savedGlyphCount(0)
+	{}
+	~Font()
+	{
+		releaseFace();
+	}
+	// the font owns its face
+	Font(const Font& other) = delete;
+	Font& operator=(const Font& other) = delete;
+
+	// take the ownership of the face
+	void load(FT_Face face, const std::string& fontName, unsigned int fontSize)
+	{
+		releaseFace();
+
+		m_fontSize = fontSize;
+		m_fontName = fontName;
+		m_face = face;
+
+		FT_Set_Pixel_Sizes(face, 0, m_fontSize);
+
+		create(face);
+	}
+	// no glyph can be loaded after that, the loaded ones can still be used
+	void releaseFace()
+	{
+		if (m_face != nullptr)
+		{
+			FT_Done_Face(m_face);
+			m_face = nullptr;
 		}
+		m_library = nullptr;
+	}
+	// fileData is the font file in memory, it must outlive the font. Null to open fileName
+	void setFontFile(FT_Library library, const std::string& fileName, unsigned long long fileHash, const unsigned char* fileData = nullptr, size_t fileDataSize = 0)
+	{
+		m_library = library;
+		m_fileName = fileName;
+		m_fileData = fileData;
+		m_fileDataSize = fileDataSize;
+		m_fileHash = fileHash;
+	}
+	unsigned long long getFileHash() const
+	{
+		return m_fileHash;
+	}
+	unsigned int getFontSize() const
+	{
+		return (unsigned int)m_fontSize;
+	}
+	const FontAtlas& getAtlas() const
+	{
+		return m_atlas;
+	}
+	Rect computeTextBounds(const std::string& text)
+	{
+		const Glyph* glyph = nullptr;
+		bool success = true;
+		Rect bound(0, 0, 0, 0);
+		glm::vec2 cursor(0, 0);
+		for (const auto& character : text)
+		{
+			success = getGlyphInfoFromChar((unsigned char)character, &glyph);
 
-		m_atlas.m_fontTexture = Texture::create_FontAtlasTex(texWidth, texHeight, textureDatas);
+			if (!success)
+				break;
 
-		// debug
-		debugPrintChatToIndex();
+			Rect glyphRect = glyph->getGlyphRectIncludingAdvance();
+			glyphRect.addOffset(cursor);
+			bound.append(glyphRect);
+			cursor.x += glyph->advanceInPixel;
+
+		}
+
+		return bound;
 	}
 
-	glm::vec4 getGlyphSourceRect(unsigned int glyphIndex) const
+	glm::vec2 getCursorPos(const std::string& text, unsigned int cursorIdx)
 	{
-		unsigned int colIdx = glyphIndex % m_atlas.m_colCount;
-		unsigned int rowIdx = glyphIndex / m_atlas.m_colCount;
+		const Glyph* glyph = nullptr;
+		bool success = true;
+		glm::vec2 cursor(0, 0);
+		for (int i = 0; i < cursorIdx; i++)
+		{
+			const auto& character = text[i];
+			success = getGlyphInfoFromChar((unsigned char)character, &glyph);
 
-		const Glyph& glyphInfo = m_glyphInfos[glyphIndex];
+			if (!success)
+				break;
 
-		glm::vec4 outRect(colIdx * m_atlas.m_glyphWidth, rowIdx * m_atlas.m_glyphHeight, glyphInfo.size.x, glyphInfo.size.y);
+			cursor.x += glyph->advanceInPixel;
+		}
 
-		const float texWidth = m_atlas.m_fontTexture->GetTexWidth();
-		const float texHeight = m_atlas.m_fontTexture->GetTexHeight();
-		return (outRect / glm::vec4(texWidth, texHeight, texWidth, texHeight));
+		return cursor;
 	}
-	bool getGlyphDestRect(unsigned int glyphIndex, const glm::vec2& destLocation, glm::vec2& outNextDestLocation, glm::vec4& outGlyphDestRect) const
+	unsigned int getCursorIdx(const std::string& text, const glm::vec2& cursorPos)
 	{
-		if (glyphIndex < 0 || glyphIndex >= m_glyphInfos.size())
-			return false;
+		const Glyph* glyph = nullptr;
+		bool success = true;
+		float currentPos = 0;
+		for (int i = 0; i < text.size(); i++)
+		{
+			const auto& character = text[i];
+			success = getGlyphInfoFromChar((unsigned char)character, &glyph);
 
-		const Glyph& glyphInfo = m_glyphInfos[glyphIndex];
+			if (!success)
+				break;
+
+			currentPos += glyph->advanceInPixel;
+
+			if (currentPos - glyph->advanceInPixel * 0.5f > cursorPos.x)
+				return i;
+		}
+
+		return text.size();
+	}
+	glm::vec2 getMaxGlyphSize() const
+	{
+		return glm::vec2(m_atlas.m_glyphWidth, m_atlas.m_glyphHeight);
+	}
+	float getLineHeight() const
+	{
+		return m_atlas.m_glyphHeight;
+	}
+	float getAscender() const
+	{
+		return m_atlas.m_ascender;
+	}
+
+	void create(FT_Face& face)
+	{
+		// the max glyph size comes from the face metrics, the glyphs are only loaded when used
+		m_atlas.m_glyphWidth = (float)(face->size->metrics.max_advance >> 6);
+		m_atlas.m_glyphHeight = (float)((face->size->metrics.ascender - face->size->metrics.descender) >> 6);
+		m_atlas.m_ascender = (float)(face->size->metrics.ascender >> 6);
+		m_atlas.m_pages.clear();
+
+		m_glyphInfos.clear();
+		m_glyphSlots.assign(face->num_glyphs, s_glyphNotLoaded);
+
+		// populate m_charToIndex
+		m_charToIndex.clear();
+		FT_UInt index;
+		FT_ULong character = FT_Get_First_Char(face, &index);
+		while (true) {
+
+			m_charToIndex.insert(character, index);
+
+			character = FT_Get_Next_Char(face, character, &index);
+			if (!index) break;
+		}
+		//////////////////////
+	}
+
+	// upload the glyphs packed since the last call, only the modified part of each page is sent
+	void uploadDirtyPages()
+	{
+		for (auto& page : m_atlas.m_pages)
+		{
+			page->upload(GL_RED, GL_RED);
+		}
+	}
+
+	glm::vec4 getGlyphSourceRect(const Glyph& glyphInfo) const
+	{
+		if (glyphInfo.atlasPage < 0)
+			return glm::vec4(0, 0, 0, 0);
+
+		const float pageSize = (float)m_atlas.m_pages[glyphInfo.atlasPage]->getSize();
+		glm::vec4 outRect(glyphInfo.atlasPos.x, glyphInfo.atlasPos.y, glyphInfo.size.x, glyphInfo.size.y);
+		return outRect / pageSize;
+	}
+	// atlas page of the glyph, the same texture for all the glyphs of a page so they are batched together
+	Texture* getGlyphTexture(const Glyph& glyphInfo) const
+	{
+		if (glyphInfo.atlasPage < 0)
+			return nullptr;
 
+		return m_atlas.m_pages[glyphInfo.atlasPage]->m_texture.get();
+	}
+	void getGlyphDestRect(const Glyph& glyphInfo, const glm::vec2& destLocation, glm::vec2& outNextDestLocation, glm::vec4& outGlyphDestRect) const
+	{
 		outGlyphDestRect = glm::vec4(destLocation + glm::vec2(glyphInfo.bearing.x, -glyphInfo.bearing.y), glm::vec2(glyphInfo.size.x, glyphInfo.size.y));
 		outNextDestLocation = destLocation + glm::vec2(glyphInfo.advanceInPixel, 0);
+	}
+	bool getGlyphDisplayInfos(unsigned long charcode, const glm::vec2& destLocation, glm::vec2& outNextDestLocation, glm::vec4& outGlyphDestRect, glm::vec4& outGlyphSourceRect, Texture*& outTexture)
+	{
+		const Glyph* glyphInfo = nullptr;
+		if (!getGlyphInfoFromChar(charcode, &glyphInfo))
+			return false;
 
+		outGlyphSourceRect = getGlyphSourceRect(*glyphInfo);
+		outTexture = getGlyphTexture(*glyphInfo);
+		getGlyphDestRect(*glyphInfo, destLocation, outNextDestLocation, outGlyphDestRect);
 		return true;
 	}
-	bool getGlyphDisplayInfos(unsigned long charcode, const glm::vec2& destLocation, glm::vec2& outNextDestLocation, glm::vec4& outGlyphDestRect, glm::vec4& outGlyphSourceRect) const
+
+	bool getGlyphInfoFromChar(unsigned long charcode, Glyph const ** outGlyph)
 	{
 		unsigned int glyphIndex;
 		bool lookupSuccess = getGlyphIndex(charcode, glyphIndex);
 		if (!lookupSuccess)
 			return false;
 
-		outGlyphSourceRect = getGlyphSourceRect(glyphIndex);
-		return  getGlyphDestRect(glyphIndex, destLocation, outNextDestLocation, outGlyphDestRect);
+		return getGlyphInfo(glyphIndex, outGlyph);
 	}
-
-	bool getGlyphInfoFromChar(unsigned long charcode, Glyph const ** outGlyph) const
+	// the glyph is rasterized and packed in the atlas the first time
+	bool getGlyphInfo(unsigned int glyphIndex, Glyph const ** outGlyph)
 	{
-		unsigned int glyphIndex;
-		bool lookupSuccess = getGlyphIndex(charcode, glyphIndex);
-		if (!lookupSuccess)
+		if (glyphIndex >= m_glyphSlots.size())
+			return false;
+
+		if (m_glyphSlots[glyphIndex] == s_glyphNotLoaded)
+			m_glyphSlots[glyphIndex] = loadGlyph(glyphIndex);
+
+		if (m_glyphSlots[glyphIndex] < 0)
 			return false;
 
-		*outGlyph = &m_glyphInfos[glyphIndex];
+		*outGlyph = &m_glyphInfos[m_glyphSlots[glyphIndex]];
 		return true;
 	}
-	bool getGlyphIndex(unsigned char charcode, unsigned int& outGlyphIndex) const
+	bool getGlyphIndex(unsigned long charcode, unsigned int& outGlyphIndex) const
 	{
-		auto& found = m_charToIndex.find(charcode);
-		if (found != m_charToIndex.end())
+		return m_charToIndex.find(charcode, outGlyphIndex);
+	}
+	unsigned int getLoadedGlyphCount() const
+	{
+		return (unsigned int)m_glyphInfos.size();
+	}
+
+	// glyph indices of the charcodes, without the glyphs already loaded, sorted and without duplicates
+	void getMissingGlyphIndices(const std::vector<unsigned long>& charcodes, std::vector<unsigned int>& outGlyphIndices) const
+	{
+		outGlyphIndices.clear();
+		for (unsigned long charcode : charcodes)
 		{
-			outGlyphIndex = found->second;
-			return true;
+			unsigned int glyphIndex;
+			if (getGlyphIndex(charcode, glyphIndex) && glyphIndex < m_glyphSlots.size() && m_glyphSlots[glyphIndex] == s_glyphNotLoaded)
+				outGlyphIndices.push_back(glyphIndex);
 		}
-		else
+		std::sort(outGlyphIndices.begin(), outGlyphIndices.end());
+		outGlyphIndices.erase(std::unique(outGlyphIndices.begin(), outGlyphIndices.end()), outGlyphIndices.end());
+	}
+	// pack glyphs rasterized outside of the font, by glyph index order so the atlas doesn't depend on who rasterized them
+	void addRasterizedGlyphs(std::vector<RasterizedGlyph>& glyphs)
+	{
+		std::sort(glyphs.begin(), glyphs.end(), [](const RasterizedGlyph& a, const RasterizedGlyph& b) { return a.glyphIndex < b.glyphIndex; });
+		for (const auto& glyph : glyphs)
+		{
+			if (glyph.glyphIndex < m_glyphSlots.size() && m_glyphSlots[glyph.glyphIndex] == s_glyphNotLoaded)
+				m_glyphSlots[glyph.glyphIndex] = insertGlyph(glyph);
+		}
+	}
+	// can be called from any thread, as long as the face is only used by this thread
+	static bool rasterizeGlyph(FT_Face face, unsigned int glyphIndex, RasterizedGlyph& outGlyph)
+	{
+		if (face == nullptr || FT_Load_Glyph(face, glyphIndex, FT_LOAD_RENDER))
 			return false;
+
+		const FT_Bitmap& bitmap = face->glyph->bitmap;
+		outGlyph.glyphIndex = glyphIndex;
+		outGlyph.glyph = Glyph(
+			glm::ivec2(bitmap.width, bitmap.rows),
+			glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
+			face->glyph->advance.x
+		);
+
+		// the pitch can be negative or larger than the width
+		outGlyph.pixels.resize(bitmap.width * bitmap.rows);
+		for (unsigned int j = 0; j < bitmap.rows; j++)
+		{
+			const unsigned char* srcRow = bitmap.buffer + (int)j * bitmap.pitch;
+			std::copy(srcRow, srcRow + bitmap.width, &outGlyph.pixels[j * bitmap.width]);
+		}
+		return true;
 	}
 
-	void bindTexture() const
+	/////////////////// atlas cache ///////////////////
+
+	bool hasUnsavedGlyphs() const
 	{
-		m_atlas.m_fontTexture->bind();
+		return (!m_fileName.empty() || m_fileData != nullptr) && m_savedGlyphCount != m_glyphInfos.size();
 	}
-	void unbindTexture() const
+
+	// save the charmap, the loaded glyphs and the atlas pages, so the next run doesn't need freetype
+	bool saveAtlasCache(const std::string& cacheFileName)
 	{
-		glBindTexture(GL_TEXTURE_2D, 0);
+		// written aside then renamed, a reader never sees a partial file
+		const std::string tempFileName = cacheFileName + ".tmp";
+		{
+			std::ofstream stream(tempFileName, std::ios::binary | std::ios::trunc);
+			if (!stream)
+				return false;
+
+			writeBinary(stream, (unsigned int)s_atlasCacheMagic);
+			writeBinary(stream, (unsigned int)s_atlasCacheVersion);
+			writeBinary(stream, m_fileHash);
+			writeBinary(stream, (unsigned int)m_fontSize);
+			writeBinary(stream, (unsigned int)m_glyphSlots.size());
+			writeBinary(stream, m_atlas.m_glyphWidth);
+			writeBinary(stream, m_atlas.m_glyphHeight);
+			writeBinary(stream, m_atlas.m_ascender);
+			writeBinary(stream, (int)m_atlas.m_pageSize);
+
+			writeBinary(stream, (unsigned int)m_charToIndex.size());
+			m_charToIndex.forEach([&stream](unsigned long charcode, unsigned int glyphIndex)
+			{
+				writeBinary(stream, (unsigned int)charcode);
+				writeBinary(stream, glyphIndex);
+			});
+
+			writeBinary(stream, (unsigned int)m_glyphInfos.size());
+			for (unsigned int glyphIndex = 0; glyphIndex < m_glyphSlots.size(); ++glyphIndex)
+			{
+				if (m_glyphSlots[glyphIndex] < 0)
+					continue;
+
+				const Glyph& glyph = m_glyphInfos[m_glyphSlots[glyphIndex]];
+				writeBinary(stream, glyphIndex);
+				writeBinary(stream, glyph.size);
+				writeBinary(stream, glyph.bearing);
+				writeBinary(stream, (unsigned int)glyph.advance);
+				writeBinary(stream, glyph.atlasPage);
+				writeBinary(stream, glyph.atlasPos);
+			}
+
+			writeBinary(stream, (unsigned int)m_atlas.m_pages.size());
+			std::vector<glm::ivec3> skyline;
+			for (const auto& page : m_atlas.m_pages)
+			{
+				page->m_packer.getSkyline(skyline);
+				writeBinary(stream, page->getSize());
+				writeBinary(stream, page->m_packer.getUsedArea());
+				writeBinary(stream, (unsigned int)skyline.size());
+				stream.write((const char*)skyline.data(), skyline.size() * sizeof(glm::ivec3));
+				stream.write((const char*)page->m_pixels.data(), page->m_pixels.size());
+			}
+
+			if (!stream)
+				return false;
+		}
+
+		std::remove(cacheFileName.c_str());
+		if (std::rename(tempFileName.c_str(), cacheFileName.c_str()) != 0)
+			return false;
+
+		m_savedGlyphCount = (unsigned int)m_glyphInfos.size();
+		return true;
 	}
 
+	// load the font from a mapped atlas cache, return false if the cache is invalid or made for another font file
+	bool loadAtlasCache(const unsigned char* data, size_t size, unsigned long long fileHash, const std::string& fontName, unsigned int fontSize)
+	{
+		BinaryReader reader(data, size);
+
+		unsigned int magic = 0;
+		unsigned int version = 0;
+		unsigned long long cachedFileHash = 0;
+		unsigned int cachedFontSize = 0;
+		unsigned int glyphCount = 0;
+		if (!reader.read(magic) || !reader.read(version) || !reader.read(cachedFileHash) || !reader.read(cachedFontSize) || !reader.read(glyphCount)
+			|| magic != s_atlasCacheMagic || version != s_atlasCacheVersion || cachedFileHash != fileHash || cachedFontSize != fontSize
+			|| glyphCount > s_atlasCacheMaxGlyphCount)
+			return false;
+
+		releaseFace();
+		m_fontSize = fontSize;
+		m_fontName = fontName;
+		m_atlas.m_pages.clear();
+		m_glyphInfos.clear();
+		m_glyphSlots.assign(glyphCount, s_glyphNotLoaded);
+		m_charToIndex.clear();
+
+		// the new pages double the page size until the glyph fits
+		if (!reader.read(m_atlas.m_glyphWidth) || !reader.read(m_atlas.m_glyphHeight) || !reader.read(m_atlas.m_ascender) || !reader.read(m_atlas.m_pageSize)
+			|| !isValidAtlasPageSize(m_atlas.m_pageSize))
+			return false;
+
+		unsigned int charmapCount = 0;
+		if (!reader.read(charmapCount))
+			return false;
+		for (unsigned int i = 0; i < charmapCount; ++i)
+		{
+			unsigned int charcode = 0;
+			unsigned int glyphIndex = 0;
+			if (!reader.read(charcode) || !reader.read(glyphIndex))
+				return false;
+
+			m_charToIndex.insert(charcode, glyphIndex);
+		}
+
+		unsigned int loadedGlyphCount = 0;
+		if (!reader.read(loadedGlyphCount))
+			return false;
+		for (unsigned int i = 0; i < loadedGlyphCount; ++i)
+		{
+			unsigned int glyphIndex = 0;
+			unsigned int advance = 0;
+			Glyph glyph;
+			if (!reader.read(glyphIndex) || !reader.read(glyph.size) || !reader.read(glyph.bearing) || !reader.read(advance)
+				|| !reader.read(glyph.atlasPage) || !reader.read(glyph.atlasPos) || glyphIndex >= glyphCount)
+				return false;
+
+			glyph.advance = advance;
+			glyph.advanceInPixel = (advance >> 6);
+			m_glyphInfos.push_back(glyph);
+			m_glyphSlots[glyphIndex] = (int)m_glyphInfos.size() - 1;
+		}
+
+		unsigned int pageCount = 0;
+		if (!reader.read(pageCount))
+			return false;
+		std::vector<glm::ivec3> skyline;
+		for (unsigned int i = 0; i < pageCount; ++i)
+		{
+			int pageSize = 0;
+			int usedArea = 0;
+			unsigned int nodeCount = 0;
+			if (!reader.read(pageSize) || !reader.read(usedArea) || !reader.read(nodeCount)
+				|| !isValidAtlasPageSize(pageSize) || nodeCount > (unsigned int)pageSize)
+				return false;
+
+			skyline.resize(nodeCount);
+			std::unique_ptr<AtlasPage> page = std::make_unique<AtlasPage>(pageSize);
+			if (!reader.readBytes(skyline.data(), nodeCount * sizeof(glm::ivec3)) || !reader.readBytes(page->m_pixels.data(), page->m_pixels.size())
+				|| !page->m_packer.restore(pageSize, pageSize, usedArea, skyline))
+				return false;
+
+			page->addDirtyRect(glm::ivec2(0, 0), glm::ivec2(pageSize, pageSize));
+			m_atlas.m_pages.push_back(std::move(page));
+		}
+
+		// a glyph outside of its page would read out of the pixels
+		for (const auto& glyph : m_glyphInfos)
+		{
+			if (glyph.atlasPage < 0)
+				continue;
+
+			if (glyph.atlasPage >= (int)m_atlas.m_pages.size() || glyph.atlasPos.x < 0 || glyph.atlasPos.y < 0 || glyph.size.x < 0 || glyph.size.y < 0)
+				return false;
+
+			const int pageSize = m_atlas.m_pages[glyph.atlasPage]->getSize();
+			if (glyph.atlasPos.x > pageSize - glyph.size.x || glyph.atlasPos.y > pageSize - glyph.size.y)
+				return false;
+		}
+
+		m_savedGlyphCount = (unsigned int)m_glyphInfos.size();
+		return true;
+	}
+
+	// the whole charmap, one line per character : only to debug a font, tens of thousands of lines for the CJK fonts
 	void debugPrintChatToIndex() const
 	{
 		std::cout << "chat to glyph index : " << std::endl;
-		for (const auto& pair : m_charToIndex)
+		m_charToIndex.forEach([](unsigned long charcode, unsigned int glyphIndex)
+		{
+			std::cout << (char)charcode << " : " << glyphIndex << std::endl;
+		});
+	}
+
+private:
+	static bool isValidAtlasPageSize(int pageSize)
+	{
+		return pageSize > 0 && pageSize <= (int)s_atlasCacheMaxPageSize && (pageSize & (pageSize - 1)) == 0;
+	}
+
+	// the font loaded from the atlas cache opens its face only when a glyph is missing from the cache
+	bool openFace()
+	{
+		if (m_face != nullptr)
+			return true;
+		if (m_library == nullptr)
+			return false;
+
+		const FT_Error error = m_fileData != nullptr
+			? FT_New_Memory_Face(m_library, m_fileData, (FT_Long)m_fileDataSize, 0, &m_face)
+			: FT_New_Face(m_library, m_fileName.c_str(), 0, &m_face);
+		if (error)
+		{
+			std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+			m_face = nullptr;
+			m_library = nullptr;
+			return false;
+		}
+		FT_Set_Pixel_Sizes(m_face, 0, m_fontSize);
+		return true;
+	}
+
+	// return the slot of the loaded glyph, or s_glyphLoadFailed
+	int loadGlyph(unsigned int glyphIndex)
+	{
+		RasterizedGlyph rasterizedGlyph;
+		if (!openFace() || !rasterizeGlyph(m_face, glyphIndex, rasterizedGlyph))
+		{
+			std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+			return s_glyphLoadFailed;
+		}
+
+		return insertGlyph(rasterizedGlyph);
+	}
+
+	// pack the glyph bitmap in the atlas, return its slot or s_glyphLoadFailed
+	int insertGlyph(const RasterizedGlyph& rasterizedGlyph)
+	{
+		Glyph glyph = rasterizedGlyph.glyph;
+
+		// the spaces don't have any bitmap
+		if (glyph.size.x > 0 && glyph.size.y > 0)
 		{
-			std::cout << (char)pair.first << " : " << pair.second << std::endl;
+			if (!packGlyph(glyph.size, glyph.atlasPage, glyph.atlasPos))
+			{
+				std::cout << "ERROR::FREETYTPE: Failed to pack Glyph" << std::endl;
+				return s_glyphLoadFailed;
+			}
+
+			AtlasPage& page = *m_atlas.m_pages[glyph.atlasPage];
+			for (int j = 0; j < glyph.size.y; j++)
+			{
+				const unsigned char* srcRow = &rasterizedGlyph.pixels[j * glyph.size.x];
+				std::copy(srcRow, srcRow + glyph.size.x, page.getPixel(glyph.atlasPos + glm::ivec2(0, j)));
+			}
+			page.addDirtyRect(glyph.atlasPos, glyph.size);
 		}
+
+		m_glyphInfos.push_back(glyph);
+		return (int)m_glyphInfos.size() - 1;
+	}
+
+	bool packGlyph(const glm::ivec2& size, int& outPage, glm::ivec2& outPos)
+	{
+		const glm::ivec2 paddedSize = size + glm::ivec2(s_glyphPadding, s_glyphPadding);
+
+		// the last pages are the less filled
+		for (int i = (int)m_atlas.m_pages.size() - 1; i >= 0; --i)
+		{
+			if (m_atlas.m_pages[i]->m_packer.pack(paddedSize.x, paddedSize.y, outPos))
+			{
+				outPage = i;
+				return true;
+			}
+		}
+
+		// all the pages are full, a bigger page is used for the glyphs which don't fit in a default one
+		int pageSize = m_atlas.m_pageSize;
+		while (pageSize < paddedSize.x || pageSize < paddedSize.y)
+		{
+			pageSize *= 2;
+		}
+		m_atlas.m_pages.push_back(std::make_unique<AtlasPage>(pageSize));
+
+		outPage = (int)m_atlas.m_pages.size() - 1;
+		return m_atlas.m_pages.back()->m_packer.pack(paddedSize.x, paddedSize.y, outPos);
 	}
-	
 };
 
 struct FontKey
@@ -603,13 +1570,78 @@ struct FontKey
 	{}
 };
 
+// a font file to load, with the characters rasterized during the loading
+struct FontLoadRequest
+{
+	std::string fileName;
+	std::string fontName;
+	unsigned int fontSize;
+	std::vector<unsigned long> preloadCharcodes; // printable ascii characters if empty
+	// the font file already in memory (ex : a mapped asset archive), used instead of fileName. It must outlive the font
+	const unsigned char* fileData;
+	size_t fileDataSize;
+	// an atlas cache in memory, used instead of the atlas cache directory if not null
+	const unsigned char* atlasCacheData;
+	size_t atlasCacheDataSize;
+
+	FontLoadRequest(const std::string& _fileName, const std::string& _fontName, unsigned int _fontSize)
+		: fileName(_fileName)
+		, fontName(_fontName)
+		, fontSize(_fontSize)
+		, fileData(nullptr)
+		, fileDataSize(0)
+		, atlasCacheData(nullptr)
+		, atlasCacheDataSize(0)
+	{}
+	FontLoadRequest(const unsigned char* _fileData, size_t _fileDataSize, const std::string& _fontName, unsigned int _fontSize)
+		: fontName(_fontName)
+		, fontSize(_fontSize)
+		, fileData(_fileData)
+		, fileDataSize(_fileDataSize)
+		, atlasCacheData(nullptr)
+		, atlasCacheDataSize(0)
+	{}
+};
+
 class FontFactory
 {
 private:
+	enum : unsigned int
+	{
+		// glyphs rasterized by a worker task
+		s_rasterizeChunkSize = 32,
+	};
+
+	// freetype objects of a worker thread, destroyed with the thread.
+	// A face can't be used by several threads at the same time, so each worker opens its own faces.
+	struct WorkerFreeType
+	{
+		FT_Library library;
+		std::map<const unsigned char*, FT_Face> faces; // font file data -> face
+
+		WorkerFreeType()
+			: library(nullptr)
+		{
+			if (FT_Init_FreeType(&library))
+				library = nullptr;
+		}
+		~WorkerFreeType()
+		{
+			for (auto& face : faces)
+			{
+				if (face.second != nullptr)
+					FT_Done_Face(face.second);
+			}
+			if (library != nullptr)
+				FT_Done_FreeType(library);
+		}
+	};
+
 	FT_Library m_ft;
 	std::map<std::string, std::map<unsigned int, std::shared_ptr<Font>>> m_fonts;
 	std::string m_defaultFontName;
 	unsigned int m_defaultFontSize;
+	std::string m_atlasCacheDirectory;
 
 public:
 	FontFactory()
@@ -622,26 +1654,185 @@ public:
 	}
 	~FontFactory()
 	{
+		// keep the glyphs loaded during this run for the next one
+		saveAtlasCaches();
+
+		// the faces are destroyed with the library, the fonts still in use can't load new glyphs
+		for (auto& fontBySize : m_fonts)
+		{
+			for (auto& font : fontBySize.second)
+			{
+				font.second->releaseFace();
+			}
+		}
 		FT_Done_FreeType(m_ft);
 	}
 
+	// the atlas caches are read from and written to this directory, no cache if empty
+	void setAtlasCacheDirectory(const std::string& directory)
+	{
+		m_atlasCacheDirectory = directory;
+	}
+
 	bool loadFont(const std::string& fileName, const std::string& fontName, unsigned int fontSize)
 	{
-		if (hasFont(fontName, fontSize))
-			return false;
+		return loadFonts({ FontLoadRequest(fileName, fontName, fontSize) }) == 1;
+	}
 
-		FT_Face face;
-		if (FT_New_Face(m_ft, fileName.c_str(), 0, &face))
-			std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+	// load several fonts at once, return the number of fonts loaded.
+	// The font files are hashed, the atlas caches read and the glyphs rasterized by a worker pool.
+	// A font found in the atlas cache doesn't use freetype until a glyph which isn't in the cache is needed.
+	unsigned int loadFonts(const std::vector<FontLoadRequest>& requests)
+	{
+		// skip the fonts already loaded
+		std::vector<const FontLoadRequest*> pendingRequests;
+		for (const auto& request : requests)
+		{
+			auto sameFont = [&request](const FontLoadRequest* other) { return other->fontName == request.fontName && other->fontSize == request.fontSize; };
+			if (!hasFont(request.fontName, request.fontSize) && std::find_if(pendingRequests.begin(), pendingRequests.end(), sameFont) == pendingRequests.end())
+				pendingRequests.push_back(&request);
+		}
+		const size_t requestCount = pendingRequests.size();
+
+		// the font files stay mapped until the workers are done with them. The fonts given in memory aren't mapped
+		std::vector<std::unique_ptr<FileMapping>> fontFiles(requestCount);
+		std::vector<const unsigned char*> fontData(requestCount, nullptr);
+		std::vector<size_t> fontDataSizes(requestCount, 0);
+		std::vector<unsigned long long> fileHashes(requestCount, 0);
+		std::vector<std::shared_ptr<Font>> fonts(requestCount);
+		std::vector<bool> isCached(requestCount, false);
+		{
+			ThreadPool workers;
 
-		std::shared_ptr<Font> newFont = std::make_shared<Font>();
-		newFont->load(face, fontName, fontSize);
-		// insert font in container
-		m_fonts[fontName][fontSize] = newFont;
+			// hash the font files and read the atlas caches
+			std::vector<std::future<void>> cacheTasks;
+			for (size_t i = 0; i < requestCount; ++i)
+			{
+				cacheTasks.push_back(workers.submit([this, i, &pendingRequests, &fontFiles, &fontData, &fontDataSizes, &fileHashes, &fonts]()
+				{
+					const FontLoadRequest& request = *pendingRequests[i];
+					if (request.fileData != nullptr)
+					{
+						fontData[i] = request.fileData;
+						fontDataSizes[i] = request.fileDataSize;
+					}
+					else
+					{
+						fontFiles[i] = std::make_unique<FileMapping>();
+						if (!fontFiles[i]->open(request.fileName))
+							return;
+						fontData[i] = fontFiles[i]->getData();
+						fontDataSizes[i] = fontFiles[i]->getSize();
+					}
 
-		FT_Done_Face(face);
+					fileHashes[i] = hashBytes(fontData[i], fontDataSizes[i]);
+					fonts[i] = readAtlasCache(request, fileHashes[i]);
+				}));
+			}
+			for (auto& task : cacheTasks)
+			{
+				task.get();
+			}
 
-		return true;
+			// the other fonts are opened here, each font keeps its face to load the glyphs used later
+			std::vector<std::vector<unsigned int>> preloadGlyphIndices(requestCount);
+			for (size_t i = 0; i < requestCount; ++i)
+			{
+				const FontLoadRequest& request = *pendingRequests[i];
+				if (fonts[i] != nullptr)
+				{
+					isCached[i] = true;
+					continue;
+				}
+
+				// the mapped files are closed after the loading, the face of a font file is opened again from the file
+				FT_Face face;
+				const bool isOpen = request.fileData != nullptr
+					? FT_New_Memory_Face(m_ft, request.fileData, (FT_Long)request.fileDataSize, 0, &face) == 0
+					: fontFiles[i] != nullptr && fontFiles[i]->isOpen() && FT_New_Face(m_ft, request.fileName.c_str(), 0, &face) == 0;
+				if (!isOpen)
+				{
+					std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+					continue;
+				}
+
+				fonts[i] = std::make_shared<Font>();
+				fonts[i]->load(face, request.fontName, request.fontSize);
+				fonts[i]->getMissingGlyphIndices(request.preloadCharcodes.empty() ? getPrintableAsciiCharcodes() : request.preloadCharcodes, preloadGlyphIndices[i]);
+			}
+
+			// rasterize the preloaded glyphs by chunks
+			std::vector<std::pair<size_t, std::future<std::vector<RasterizedGlyph>>>> rasterizeTasks;
+			for (size_t i = 0; i < requestCount; ++i)
+			{
+				for (size_t first = 0; first < preloadGlyphIndices[i].size(); first += s_rasterizeChunkSize)
+				{
+					const size_t last = std::min(first + s_rasterizeChunkSize, preloadGlyphIndices[i].size());
+					const unsigned char* fileData = fontData[i];
+					const size_t fileDataSize = fontDataSizes[i];
+					const unsigned int fontSize = pendingRequests[i]->fontSize;
+					const std::vector<unsigned int>* glyphIndices = &preloadGlyphIndices[i];
+					rasterizeTasks.push_back(std::make_pair(i, workers.submit([fileData, fileDataSize, fontSize, glyphIndices, first, last]()
+					{
+						return rasterizeGlyphs(fileData, fileDataSize, fontSize, *glyphIndices, first, last);
+					})));
+				}
+			}
+
+			// the chunks are packed in submission order, so the atlas is the same whatever the scheduling.
+			// A glyph a worker failed to rasterize is loaded again by the font the first time it is used.
+			for (auto& task : rasterizeTasks)
+			{
+				std::vector<RasterizedGlyph> glyphs = task.second.get();
+				fonts[task.first]->addRasterizedGlyphs(glyphs);
+			}
+		}
+
+		unsigned int loadedCount = 0;
+		for (size_t i = 0; i < requestCount; ++i)
+		{
+			if (fonts[i] == nullptr)
+				continue;
+
+			const FontLoadRequest& request = *pendingRequests[i];
+			fonts[i]->setFontFile(m_ft, request.fileName, fileHashes[i], request.fileData, request.fileDataSize);
+			if (!isCached[i] && !m_atlasCacheDirectory.empty())
+				fonts[i]->saveAtlasCache(getAtlasCacheFileName(fileHashes[i], request.fontSize));
+
+			// insert font in container
+			m_fonts[request.fontName][request.fontSize] = fonts[i];
+			loadedCount++;
+		}
+
+		return loadedCount;
+	}
+
+	// write the atlas caches of the fonts which have loaded glyphs since their cache was read or written
+	void saveAtlasCaches()
+	{
+		if (m_atlasCacheDirectory.empty())
+			return;
+
+		for (auto& fontBySize : m_fonts)
+		{
+			for (auto& font : fontBySize.second)
+			{
+				if (font.second->hasUnsavedGlyphs())
+					font.second->saveAtlasCache(getAtlasCacheFileName(font.second->getFileHash(), font.second->getFontSize()));
+			}
+		}
+	}
+
+	// send the glyphs loaded since the last call to the gpu
+	void uploadDirtyAtlases()
+	{
+		for (auto& fontBySize : m_fonts)
+		{
+			for (auto& font : fontBySize.second)
+			{
+				font.second->uploadDirtyPages();
+			}
+		}
 	}
 
 	std::shared_ptr<Font> getFont(const std::string& fontName)
@@ -714,6 +1905,94 @@ public:
 		m_defaultFontName = fontName;
 		m_defaultFontSize = fontSize;
 	}
+
+private:
+	// <directory>/<font file hash>_<font size>.fontcache
+	std::string getAtlasCacheFileName(unsigned long long fileHash, unsigned int fontSize) const
+	{
+		std::ostringstream fileName;
+		fileName << m_atlasCacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << fileHash << std::dec << "_" << fontSize << ".fontcache";
+		return fileName.str();
+	}
+
+	// called by the workers
+	std::shared_ptr<Font> readAtlasCache(const FontLoadRequest& request, unsigned long long fileHash) const
+	{
+		if (request.atlasCacheData != nullptr)
+		{
+			std::shared_ptr<Font> font = std::make_shared<Font>();
+			if (!font->loadAtlasCache(request.atlasCacheData, request.atlasCacheDataSize, fileHash, request.fontName, request.fontSize))
+			{
+				std::cout << "WARNING::FONT: Invalid atlas cache, the font is loaded again" << std::endl;
+				return nullptr;
+			}
+			return font;
+		}
+		if (m_atlasCacheDirectory.empty())
+			return nullptr;
+
+		// the cache is mapped, the pages are copied directly from it
+		FileMapping cacheFile;
+		if (!cacheFile.open(getAtlasCacheFileName(fileHash, request.fontSize)))
+			return nullptr;
+
+		std::shared_ptr<Font> font = std::make_shared<Font>();
+		if (!font->loadAtlasCache(cacheFile.getData(), cacheFile.getSize(), fileHash, request.fontName, request.fontSize))
+		{
+			std::cout << "WARNING::FONT: Invalid atlas cache, the font is loaded again" << std::endl;
+			return nullptr;
+		}
+		return font;
+	}
+
+	static std::vector<RasterizedGlyph> rasterizeGlyphs(const unsigned char* fileData, size_t fileDataSize, unsigned int fontSize, const std::vector<unsigned int>& glyphIndices, size_t first, size_t last)
+	{
+		std::vector<RasterizedGlyph> glyphs;
+		FT_Face face = getWorkerFace(fileData, fileDataSize);
+		if (face == nullptr)
+			return glyphs;
+
+		FT_Set_Pixel_Sizes(face, 0, fontSize);
+		for (size_t i = first; i < last; ++i)
+		{
+			RasterizedGlyph glyph;
+			if (Font::rasterizeGlyph(face, glyphIndices[i], glyph))
+				glyphs.push_back(std::move(glyph));
+		}
+		return glyphs;
+	}
+
+	// face of the font file for the calling worker, opened from the mapped file or the memory the first time
+	static FT_Face getWorkerFace(const unsigned char* fileData, size_t fileDataSize)
+	{
+		thread_local WorkerFreeType workerFreeType;
+		if (workerFreeType.library == nullptr)
+			return nullptr;
+
+		auto found = workerFreeType.faces.find(fileData);
+		if (found != workerFreeType.faces.end())
+			return found->second;
+
+		FT_Face face = nullptr;
+		if (FT_New_Memory_Face(workerFreeType.library, fileData, (FT_Long)fileDataSize, 0, &face))
+			face = nullptr;
+
+		workerFreeType.faces[fileData] = face;
+		return face;
+	}
+
+	static const std::vector<unsigned long>& getPrintableAsciiCharcodes()
+	{
+		static std::vector<unsigned long> charcodes;
+		if (charcodes.empty())
+		{
+			for (unsigned long charcode = 32; charcode < 127; ++charcode)
+			{
+				charcodes.push_back(charcode);
+			}
+		}
+		return charcodes;
+	}
 };
 
 static std::vector<Vertex> vertices = {
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+
+// Skyline bottom-left rectangle packer, used to place glyphs or images inside an atlas page.
+// The skyline is the top border of the rects already packed. A new rect is placed on the skyline where its top ends the lowest,
+// so the free space under the skyline is never reused, but packing is fast and the waste stays low for rects of similar heights.
+class SkylinePacker
+{
+private:
+	struct SkylineNode
+	{
+		int x;
+		int y;
+		int width;
+
+		SkylineNode(int _x = 0, int _y = 0, int _width = 0)
+			: x(_x)
+			, y(_y)
+			, width(_width)
+		{}
+	};
+
+	int m_width;
+	int m_height;
+	std::vector<SkylineNode> m_skyline;
+	int m_usedArea;
+
+public:
+	SkylinePacker(int width = 0, int height = 0)
+	{
+		reset(width, height);
+	}
+
+	void reset(int width, int height)
+	{
+		m_width = width;
+		m_height = height;
+		m_usedArea = 0;
+		m_skyline.clear();
+		m_skyline.push_back(SkylineNode(0, 0, width));
+	}
+
+	// find a place for a width x height rect, return false if there is no room left
+	bool pack(int width, int height, glm::ivec2& outPos)
+	{
+		if (width <= 0 || height <= 0 || width > m_width || height > m_height)
+			return false;
+
+		int bestIndex = -1;
+		int bestTop = m_height + 1;
+		int bestNodeWidth = m_width + 1;
+		int bestY = 0;
+		for (int i = 0; i < (int)m_skyline.size(); ++i)
+		{
+			int y = 0;
+			if (!fitAt(i, width, height, y))
+				continue;
+
+			// the lowest top, then the narrowest node to keep the wide ones for the wide rects
+			if (y + height < bestTop || (y + height == bestTop && m_skyline[i].width < bestNodeWidth))
+			{
+				bestIndex = i;
+				bestTop = y + height;
+				bestNodeWidth = m_skyline[i].width;
+				bestY = y;
+			}
+		}
+
+		if (bestIndex < 0)
+			return false;
+
+		outPos = glm::ivec2(m_skyline[bestIndex].x, bestY);
+		addSkylineLevel(bestIndex, outPos, width, height);
+		m_usedArea += width * height;
+
+		return true;
+	}
+
+	int getWidth() const
+	{
+		return m_width;
+	}
+	int getHeight() const
+	{
+		return m_height;
+	}
+	// ratio of the area used by the packed rects
+	float getOccupancy() const
+	{
+		return m_width * m_height > 0 ? (float)m_usedArea / (float)(m_width * m_height) : 0.0f;
+	}
+
+	// save and restore the packer state, the skyline nodes are stored as (x, y, width)
+	int getUsedArea() const
+	{
+		return m_usedArea;
+	}
+	void getSkyline(std::vector<glm::ivec3>& outNodes) const
+	{
+		outNodes.clear();
+		for (const auto& node : m_skyline)
+		{
+			outNodes.push_back(glm::ivec3(node.x, node.y, node.width));
+		}
+	}
+	// Return false and leave the packer empty if the nodes don't cover the width from left to right, inside the height :
+	// the placement searches walk the nodes until the rect width is covered.
+	bool restore(int width, int height, int usedArea, const std::vector<glm::ivec3>& nodes)
+	{
+		reset(width, height);
+		if (width <= 0 || height <= 0 || usedArea < 0 || (long long)usedArea > (long long)width * height)
+			return false;
+
+		int nodeEnd = 0;
+		for (const auto& node : nodes)
+		{
+			if (node.x != nodeEnd || node.z <= 0 || node.z > width - nodeEnd || node.y < 0 || node.y > height)
+				return false;
+			nodeEnd += node.z;
+		}
+		if (nodeEnd != width)
+			return false;
+
+		m_usedArea = usedArea;
+		m_skyline.clear();
+		for (const auto& node : nodes)
+		{
+			m_skyline.push_back(SkylineNode(node.x, node.y, node.z));
+		}
+		return true;
+	}
+
+private:
+	// y of a rect placed with its left side on the node, false if it goes out of the packer
+	bool fitAt(int nodeIndex, int width, int height, int& outY) const
+	{
+		if (m_skyline[nodeIndex].x + width > m_width)
+			return false;
+
+		// the rect lies on the highest node under it
+		int y = m_skyline[nodeIndex].y;
+		int widthLeft = width;
+		for (int i = nodeIndex; widthLeft > 0; ++i)
+		{
+			y = std::max(y, m_skyline[i].y);
+			if (y + height > m_height)
+				return false;
+
+			widthLeft -= m_skyline[i].width;
+		}
+
+		outY = y;
+		return true;
+	}
+
+	void addSkylineLevel(int nodeIndex, const glm::ivec2& pos, int width, int height)
+	{
+		m_skyline.insert(m_skyline.begin() + nodeIndex, SkylineNode(pos.x, pos.y + height, width));
+
+		// shrink or remove the nodes now under the new one
+		for (int i = nodeIndex + 1; i < (int)m_skyline.size(); ++i)
+		{
+			const SkylineNode& previous = m_skyline[i - 1];
+			SkylineNode& node = m_skyline[i];
+			if (node.x >= previous.x + previous.width)
+				break;
+
+			const int shrink = previous.x + previous.width - node.x;
+			node.x += shrink;
+			node.width -= shrink;
+			if (node.width > 0)
+				break;
+
+			m_skyline.erase(m_skyline.begin() + i);
+			--i;
+		}
+
+		// merge the neighbours at the same height
+		for (int i = 0; i + 1 < (int)m_skyline.size(); ++i)
+		{
+			if (m_skyline[i].y == m_skyline[i + 1].y)
+			{
+				m_skyline[i].width += m_skyline[i + 1].width;
+				m_skyline.erase(m_skyline.begin() + i + 1);
+				--i;
+			}
+		}
+	}
+};
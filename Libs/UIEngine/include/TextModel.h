@@ -0,0 +1,526 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+// Text of the editable widgets, with the advance of each character indexed.
+// The characters are the nodes of an implicit treap (ordered by position, balanced by random priorities).
+// Each node keeps the sums of its subtree : character count, advance, newlines, and the widths of its first, last and widest lines.
+// Insertion, deletion, cursor position and hit tests are O(log n), the text is only flattened when it is read as a whole.
+class TextModel
+{
+public:
+	// advance of a character in pixels, for the current font
+	typedef std::function<int(char)> AdvanceFunction;
+
+private:
+	// widths of the lines of a part of the text, the first and last lines may continue outside of it
+	struct LineMetrics
+	{
+		int advance; // whole part
+		int newlineCount;
+		int firstLineAdvance; // before the first newline
+		int lastLineAdvance; // after the last newline
+		int maxInnerLineAdvance; // widest line between two newlines of the part
+
+		LineMetrics()
+			: advance(0)
+			, newlineCount(0)
+			, firstLineAdvance(0)
+			, lastLineAdvance(0)
+			, maxInnerLineAdvance(0)
+		{}
+
+		static LineMetrics fromCharacter(char character, int characterAdvance)
+		{
+			LineMetrics metrics;
+			if (character == '\n')
+			{
+				metrics.newlineCount = 1;
+			}
+			else
+			{
+				metrics.advance = characterAdvance;
+				metrics.firstLineAdvance = characterAdvance;
+				metrics.lastLineAdvance = characterAdvance;
+			}
+			return metrics;
+		}
+
+		// metrics of the text a followed by b
+		static LineMetrics concat(const LineMetrics& a, const LineMetrics& b)
+		{
+			LineMetrics metrics;
+			metrics.advance = a.advance + b.advance;
+			metrics.newlineCount = a.newlineCount + b.newlineCount;
+			metrics.firstLineAdvance = a.newlineCount > 0 ? a.firstLineAdvance : a.advance + b.firstLineAdvance;
+			metrics.lastLineAdvance = b.newlineCount > 0 ? b.lastLineAdvance : a.lastLineAdvance + b.advance;
+			metrics.maxInnerLineAdvance = std::max(a.maxInnerLineAdvance, b.maxInnerLineAdvance);
+			// the line across the junction is only complete if both parts have a newline
+			if (a.newlineCount > 0 && b.newlineCount > 0)
+				metrics.maxInnerLineAdvance = std::max(metrics.maxInnerLineAdvance, a.lastLineAdvance + b.firstLineAdvance);
+			return metrics;
+		}
+	};
+
+	struct Node
+	{
+		char character;
+		int characterAdvance;
+		unsigned int priority;
+		int left;
+		int right;
+		// subtree sums
+		int size;
+		LineMetrics metrics;
+	};
+
+	static const int s_nullNode = -1;
+
+	// the nodes are stored in a pool, the removed ones are reused
+	std::vector<Node> m_nodes;
+	std::vector<int> m_freeNodes;
+	int m_root;
+	unsigned int m_seed;
+
+	AdvanceFunction m_advanceFunction;
+
+	// flattened text, rebuilt when read after a modification
+	mutable std::string m_text;
+	mutable bool m_isTextDirty;
+
+public:
+	TextModel()
+		: m_root(s_nullNode)
+		, m_seed(0x9E3779B9u)
+		, m_isTextDirty(false)
+	{}
+
+	// the advances are computed again, O(n)
+	void setAdvanceFunction(const AdvanceFunction& advanceFunction)
+	{
+		m_advanceFunction = advanceFunction;
+		for (auto& node : m_nodes)
+		{
+			node.characterAdvance = computeAdvance(node.character);
+		}
+		updateSubtree(m_root);
+	}
+
+	void setText(const std::string& text)
+	{
+		clear();
+		insert(0, text);
+	}
+	void clear()
+	{
+		m_nodes.clear();
+		m_freeNodes.clear();
+		m_root = s_nullNode;
+		m_text.clear();
+		m_isTextDirty = false;
+	}
+	const std::string& getText() const
+	{
+		if (m_isTextDirty)
+		{
+			m_text.clear();
+			m_text.reserve(size());
+			forEachCharacter([this](char character) { m_text.push_back(character); });
+			m_isTextDirty = false;
+		}
+		return m_text;
+	}
+	size_t size() const
+	{
+		return (size_t)getSize(m_root);
+	}
+	bool empty() const
+	{
+		return m_root == s_nullNode;
+	}
+
+	// count characters from index, O(log n + count)
+	std::string getSubstring(size_t index, size_t count) const
+	{
+		std::string substring;
+		substring.reserve(std::min(count, size() - std::min(index, size())));
+
+		// descend to the first character, keeping the nodes which come after it
+		std::vector<int> stack;
+		int node = m_root;
+		int position = (int)index;
+		while (node != s_nullNode)
+		{
+			const int leftSize = getSize(m_nodes[node].left);
+			if (position <= leftSize)
+			{
+				stack.push_back(node);
+				if (position == leftSize)
+					break;
+				node = m_nodes[node].left;
+			}
+			else
+			{
+				position -= leftSize + 1;
+				node = m_nodes[node].right;
+			}
+		}
+
+		while (!stack.empty() && substring.size() < count)
+		{
+			node = stack.back();
+			stack.pop_back();
+			substring.push_back(m_nodes[node].character);
+			for (node = m_nodes[node].right; node != s_nullNode; node = m_nodes[node].left)
+			{
+				stack.push_back(node);
+			}
+		}
+		return substring;
+	}
+
+	// in order traversal, without recursion
+	void forEachCharacter(const std::function<void(char)>& function) const
+	{
+		std::vector<int> stack;
+		int node = m_root;
+		while (node != s_nullNode || !stack.empty())
+		{
+			while (node != s_nullNode)
+			{
+				stack.push_back(node);
+				node = m_nodes[node].left;
+			}
+			node = stack.back();
+			stack.pop_back();
+			function(m_nodes[node].character);
+			node = m_nodes[node].right;
+		}
+	}
+
+	// edition
+	void insert(size_t index, char character)
+	{
+		insert(index, std::string(1, character));
+	}
+	void insert(size_t index, const std::string& text)
+	{
+		if (text.empty())
+			return;
+
+		// the inserted characters are merged one after the other, then the whole part is merged once
+		int insertedRoot = s_nullNode;
+		for (char character : text)
+		{
+			insertedRoot = merge(insertedRoot, createNode(character));
+		}
+
+		int left = s_nullNode;
+		int right = s_nullNode;
+		split(m_root, (int)std::min(index, size()), left, right);
+		m_root = merge(merge(left, insertedRoot), right);
+		m_isTextDirty = true;
+	}
+	void erase(size_t index, size_t count = 1)
+	{
+		const size_t textSize = size();
+		if (index >= textSize || count == 0)
+			return;
+
+		int left = s_nullNode;
+		int middle = s_nullNode;
+		int right = s_nullNode;
+		split(m_root, (int)index, left, middle);
+		split(middle, (int)std::min(count, textSize - index), middle, right);
+		releaseSubtree(middle);
+		m_root = merge(left, right);
+		m_isTextDirty = true;
+	}
+	char getCharacter(size_t index) const
+	{
+		int node = m_root;
+		int position = (int)index;
+		while (node != s_nullNode)
+		{
+			const int leftSize = getSize(m_nodes[node].left);
+			if (position < leftSize)
+			{
+				node = m_nodes[node].left;
+			}
+			else if (position == leftSize)
+			{
+				return m_nodes[node].character;
+			}
+			else
+			{
+				position -= leftSize + 1;
+				node = m_nodes[node].right;
+			}
+		}
+		return '\0';
+	}
+
+	// lines
+	int getLineCount() const
+	{
+		return getMetrics(m_root).newlineCount + 1;
+	}
+	// width of the widest line
+	int getMaxLineAdvance() const
+	{
+		const LineMetrics& metrics = getMetrics(m_root);
+		return std::max(std::max(metrics.firstLineAdvance, metrics.lastLineAdvance), metrics.maxInnerLineAdvance);
+	}
+	// line of the character at index
+	int getLineIndex(size_t index) const
+	{
+		return getPrefixMetrics(index).newlineCount;
+	}
+	// index of the first character of the line
+	size_t getLineStart(int lineIndex) const
+	{
+		if (lineIndex <= 0)
+			return 0;
+		if (lineIndex >= getLineCount())
+			return size();
+
+		return getNewlineIndex(lineIndex - 1) + 1;
+	}
+	// index of the newline ending the line, or the text size for the last line
+	size_t getLineEnd(int lineIndex) const
+	{
+		if (lineIndex < 0)
+			return 0;
+		if (lineIndex >= getLineCount() - 1)
+			return size();
+
+		return getNewlineIndex(lineIndex);
+	}
+
+	// cursor placed before the character at index : x is the advance from the line start, y the line index
+	void getCursorPosition(size_t index, int& outAdvance, int& outLineIndex) const
+	{
+		const LineMetrics prefix = getPrefixMetrics(index);
+		outLineIndex = prefix.newlineCount;
+		outAdvance = prefix.lastLineAdvance;
+	}
+	// index of the cursor position the closest to the advance on the line
+	size_t getCursorIndex(int lineIndex, float advance) const
+	{
+		lineIndex = std::max(0, std::min(lineIndex, getLineCount() - 1));
+		const size_t lineStart = getLineStart(lineIndex);
+		const size_t lineEnd = getLineEnd(lineIndex);
+
+		// the first character whose middle is after the target, the advances being cumulated from the text start
+		const float target = (float)getPrefixMetrics(lineStart).advance + advance;
+		int node = m_root;
+		int position = 0;
+		int accumulatedAdvance = 0;
+		size_t found = size();
+		while (node != s_nullNode)
+		{
+			const Node& current = m_nodes[node];
+			const int leftAdvance = getMetrics(current.left).advance;
+			const float middle = accumulatedAdvance + leftAdvance + getCharacterAdvance(node) * 0.5f;
+			if (target < middle)
+			{
+				found = position + getSize(current.left);
+				node = current.left;
+			}
+			else
+			{
+				accumulatedAdvance += leftAdvance + getCharacterAdvance(node);
+				position += getSize(current.left) + 1;
+				node = current.right;
+			}
+		}
+
+		return std::max(lineStart, std::min(found, lineEnd));
+	}
+
+private:
+	int computeAdvance(char character) const
+	{
+		if (character == '\n' || !m_advanceFunction)
+			return 0;
+		return m_advanceFunction(character);
+	}
+	int getCharacterAdvance(int node) const
+	{
+		return m_nodes[node].character == '\n' ? 0 : m_nodes[node].characterAdvance;
+	}
+
+	unsigned int nextPriority()
+	{
+		// xorshift, the priorities only need to be spread
+		m_seed ^= m_seed << 13;
+		m_seed ^= m_seed >> 17;
+		m_seed ^= m_seed << 5;
+		return m_seed;
+	}
+
+	int createNode(char character)
+	{
+		Node node;
+		node.character = character;
+		node.characterAdvance = computeAdvance(character);
+		node.priority = nextPriority();
+		node.left = s_nullNode;
+		node.right = s_nullNode;
+		node.size = 1;
+		node.metrics = LineMetrics::fromCharacter(character, node.characterAdvance);
+
+		if (!m_freeNodes.empty())
+		{
+			const int index = m_freeNodes.back();
+			m_freeNodes.pop_back();
+			m_nodes[index] = node;
+			return index;
+		}
+		m_nodes.push_back(node);
+		return (int)m_nodes.size() - 1;
+	}
+	void releaseSubtree(int node)
+	{
+		if (node == s_nullNode)
+			return;
+
+		std::vector<int> stack(1, node);
+		while (!stack.empty())
+		{
+			const int current = stack.back();
+			stack.pop_back();
+			if (m_nodes[current].left != s_nullNode)
+				stack.push_back(m_nodes[current].left);
+			if (m_nodes[current].right != s_nullNode)
+				stack.push_back(m_nodes[current].right);
+			m_freeNodes.push_back(current);
+		}
+	}
+
+	int getSize(int node) const
+	{
+		return node != s_nullNode ? m_nodes[node].size : 0;
+	}
+	const LineMetrics& getMetrics(int node) const
+	{
+		static const LineMetrics emptyMetrics;
+		return node != s_nullNode ? m_nodes[node].metrics : emptyMetrics;
+	}
+	void update(int node)
+	{
+		Node& current = m_nodes[node];
+		current.size = getSize(current.left) + 1 + getSize(current.right);
+		current.metrics = LineMetrics::concat(LineMetrics::concat(getMetrics(current.left), LineMetrics::fromCharacter(current.character, current.characterAdvance)), getMetrics(current.right));
+	}
+	// after a change of all the advances, children before parents
+	void updateSubtree(int node)
+	{
+		if (node == s_nullNode)
+			return;
+
+		updateSubtree(m_nodes[node].left);
+		updateSubtree(m_nodes[node].right);
+		update(node);
+	}
+
+	// the first count characters go to left, the others to right
+	void split(int node, int count, int& outLeft, int& outRight)
+	{
+		if (node == s_nullNode)
+		{
+			outLeft = s_nullNode;
+			outRight = s_nullNode;
+			return;
+		}
+
+		const int leftSize = getSize(m_nodes[node].left);
+		if (count <= leftSize)
+		{
+			split(m_nodes[node].left, count, outLeft, m_nodes[node].left);
+			outRight = node;
+		}
+		else
+		{
+			split(m_nodes[node].right, count - leftSize - 1, m_nodes[node].right, outRight);
+			outLeft = node;
+		}
+		update(node);
+	}
+	// all the characters of left are before the ones of right
+	int merge(int left, int right)
+	{
+		if (left == s_nullNode)
+			return right;
+		if (right == s_nullNode)
+			return left;
+
+		if (m_nodes[left].priority > m_nodes[right].priority)
+		{
+			m_nodes[left].right = merge(m_nodes[left].right, right);
+			update(left);
+			return left;
+		}
+		else
+		{
+			m_nodes[right].left = merge(left, m_nodes[right].left);
+			update(right);
+			return right;
+		}
+	}
+
+	// metrics of the characters before index
+	LineMetrics getPrefixMetrics(size_t index) const
+	{
+		LineMetrics prefix;
+		int node = m_root;
+		int position = (int)index;
+		while (node != s_nullNode && position > 0)
+		{
+			const Node& current = m_nodes[node];
+			const int leftSize = getSize(current.left);
+			if (position <= leftSize)
+			{
+				node = current.left;
+			}
+			else
+			{
+				prefix = LineMetrics::concat(LineMetrics::concat(prefix, getMetrics(current.left)), LineMetrics::fromCharacter(current.character, current.characterAdvance));
+				position -= leftSize + 1;
+				node = current.right;
+			}
+		}
+		return prefix;
+	}
+	// index of the newline number newlineRank (from 0)
+	size_t getNewlineIndex(int newlineRank) const
+	{
+		int node = m_root;
+		int position = 0;
+		while (node != s_nullNode)
+		{
+			const Node& current = m_nodes[node];
+			const int leftNewlines = getMetrics(current.left).newlineCount;
+			if (newlineRank < leftNewlines)
+			{
+				node = current.left;
+				continue;
+			}
+
+			position += getSize(current.left);
+			newlineRank -= leftNewlines;
+			if (current.character == '\n')
+			{
+				if (newlineRank == 0)
+					return position;
+				newlineRank--;
+			}
+			position++;
+			node = current.right;
+		}
+		return size();
+	}
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include "OpenglUtils.h"
+
+// glyph quad of a laid out text, relative to the text origin (the left of the baseline)
+struct TextRunGlyph
+{
+	Texture* texture; // atlas page of the glyph
+	glm::vec4 box;
+	glm::vec4 uvRect;
+
+	TextRunGlyph(Texture* _texture, const glm::vec4& _box, const glm::vec4& _uvRect)
+		: texture(_texture)
+		, box(_box)
+		, uvRect(_uvRect)
+	{}
+};
+
+// A text laid out once with a font : drawing it only offsets its quads by the text origin.
+// The glyphs never move inside the font atlas, so a run stays valid as long as its font.
+struct TextRun
+{
+	std::vector<TextRunGlyph> glyphs; // only the glyphs with a bitmap, the spaces only move the next ones
+	Rect bounds; // same as Font::computeTextBounds
+	float advance;
+
+	TextRun()
+		: bounds(0, 0, 0, 0)
+		, advance(0)
+	{}
+
+	// the characters without glyph in the font are skipped
+	static std::shared_ptr<TextRun> layout(Font& font, const std::string& text)
+	{
+		auto run = std::make_shared<TextRun>();
+		run->glyphs.reserve(text.size());
+
+		glm::vec2 cursor(0, 0);
+		glm::vec2 nextCursor(0, 0);
+		glm::vec4 glyphDstRect;
+		const Glyph* glyph = nullptr;
+		for (const auto& character : text)
+		{
+			if (!font.getGlyphInfoFromChar((unsigned char)character, &glyph))
+				continue;
+
+			Rect glyphRect = glyph->getGlyphRectIncludingAdvance();
+			glyphRect.addOffset(cursor);
+			run->bounds.append(glyphRect);
+
+			Texture* texture = font.getGlyphTexture(*glyph);
+			font.getGlyphDestRect(*glyph, cursor, nextCursor, glyphDstRect);
+			if (texture != nullptr)
+				run->glyphs.push_back(TextRunGlyph(texture, glyphDstRect, font.getGlyphSourceRect(*glyph)));
+
+			cursor = nextCursor;
+		}
+		run->advance = cursor.x;
+
+		return run;
+	}
+};
+
+// LRU bounded cache of the text runs, shared by the widgets displaying the same strings (table cells, labels,...).
+// The runs are shared pointers, a widget keeps its run even if the cache evicts it.
+// The fonts are identified by their address, the FontFactory keeps them until the end.
+class TextRunCache
+{
+private:
+	struct TextRunKey
+	{
+		const Font* font;
+		std::string text;
+
+		TextRunKey(const Font* _font, const std::string& _text)
+			: font(_font)
+			, text(_text)
+		{}
+
+		bool operator==(const TextRunKey& other) const
+		{
+			return font == other.font && text == other.text;
+		}
+	};
+
+	struct TextRunKeyHash
+	{
+		size_t operator()(const TextRunKey& key) const
+		{
+			return std::hash<std::string>()(key.text) ^ (std::hash<const Font*>()(key.font) * 31);
+		}
+	};
+
+	typedef std::pair<TextRunKey, std::shared_ptr<const TextRun>> Entry;
+
+	size_t m_capacity;
+	// most recently used first
+	std::list<Entry> m_entries;
+	std::unordered_map<TextRunKey, std::list<Entry>::iterator, TextRunKeyHash> m_index;
+
+	unsigned int m_hitCount;
+	unsigned int m_missCount;
+
+public:
+	TextRunCache(size_t capacity = 1024)
+		: m_capacity(capacity)
+		, m_hitCount(0)
+		, m_missCount(0)
+	{}
+
+	std::shared_ptr<const TextRun> getRun(Font& font, const std::string& text)
+	{
+		const TextRunKey key(&font, text);
+		auto found = m_index.find(key);
+		if (found != m_index.end())
+		{
+			m_hitCount++;
+			m_entries.splice(m_entries.begin(), m_entries, found->second);
+			return found->second->second;
+		}
+
+		m_missCount++;
+		std::shared_ptr<const TextRun> run = TextRun::layout(font, text);
+		m_entries.push_front(Entry(key, run));
+		m_index[key] = m_entries.begin();
+		evict();
+
+		return run;
+	}
+
+	void clear()
+	{
+		m_entries.clear();
+		m_index.clear();
+	}
+	void setCapacity(size_t capacity)
+	{
+		m_capacity = capacity;
+		evict();
+	}
+	size_t getCapacity() const
+	{
+		return m_capacity;
+	}
+	size_t getSize() const
+	{
+		return m_entries.size();
+	}
+	unsigned int getHitCount() const
+	{
+		return m_hitCount;
+	}
+	unsigned int getMissCount() const
+	{
+		return m_missCount;
+	}
+
+private:
+	void evict()
+	{
+		while (m_entries.size() > m_capacity)
+		{
+			m_index.erase(m_entries.back().first);
+			m_entries.pop_back();
+		}
+	}
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "OpenglUtils.h"
+
+// a part of a texture, used by the widgets which display an image from an atlas
+struct TextureRegion
+{
+	std::shared_ptr<Texture> texture;
+	glm::vec4 uvRect; // x, y, width, height inside the texture, in [0, 1]
+	glm::ivec2 size; // in pixels
+
+	TextureRegion()
+		: uvRect(0, 0, 1, 1)
+		, size(0, 0)
+	{}
+	TextureRegion(std::shared_ptr<Texture> _texture, const glm::vec4& _uvRect, const glm::ivec2& _size)
+		: texture(_texture)
+		, uvRect(_uvRect)
+		, size(_size)
+	{}
+
+	bool isValid() const
+	{
+		return texture != nullptr;
+	}
+};
+
+// Small RGBA images (icons) packed together into shared pages, so a grid of icons is drawn with one texture binding.
+// The images bigger than the max image size keep their own texture, they wouldn't leave much room on a page anyway.
+// An image is packed with a border of its edge pixels copied around it, the linear filtering never reaches its neighbours.
+class TextureAtlas
+{
+private:
+	enum : int
+	{
+		s_imagePadding = 1,
+		s_channelCount = 4,
+	};
+
+	std::vector<std::unique_ptr<AtlasPage>> m_pages;
+	int m_pageSize;
+	int m_maxImageSize;
+	// the textures are never pushed to the GPU, see setCPUOnly
+	bool m_isCPUOnly;
+
+	// an image loaded twice shares its region
+	std::map<std::string, TextureRegion> m_regions;
+
+public:
+	TextureAtlas(int pageSize = 1024, int maxImageSize = 256)
+		: m_pageSize(pageSize)
+		, m_maxImageSize(maxImageSize)
+		, m_isCPUOnly(false)
+	{}
+	TextureAtlas(const TextureAtlas& other) = delete;
+	TextureAtlas& operator=(const TextureAtlas& other) = delete;
+
+	// the next pages and standalone textures only keep their pixels on the CPU, for an engine without opengl drawer
+	void setCPUOnly(bool isCPUOnly)
+	{
+		m_isCPUOnly = isCPUOnly;
+	}
+
+	// load the image file into the atlas, return an invalid region if the file can't be loaded
+	TextureRegion load(const std::string& fileName)
+	{
+		auto found = m_regions.find(fileName);
+		if (found != m_regions.end())
+			return found->second;
+
+		int width = 0;
+		int height = 0;
+		int channelCountInFile = 0;
+		unsigned char* pixels = loadImage(fileName, &width, &height, &channelCountInFile, s_channelCount);
+		if (pixels == nullptr)
+		{
+			std::cout << "ERROR::TEXTURE_ATLAS: Failed to load " << fileName << std::endl;
+			return TextureRegion();
+		}
+
+		TextureRegion region = add(fileName, width, height, pixels);
+		stbi_image_free(pixels);
+		return region;
+	}
+
+	// copy RGBA pixels into the atlas, the region can be found again with getRegion(name)
+	TextureRegion add(const std::string& name, int width, int height, const unsigned char* pixels)
+	{
+		if (width <= 0 || height <= 0 || pixels == nullptr)
+			return TextureRegion();
+
+		TextureRegion region = width > m_maxImageSize || height > m_maxImageSize ? createStandaloneTexture(width, height, pixels) : packImage(width, height, pixels);
+		if (region.isValid())
+			m_regions[name] = region;
+
+		return region;
+	}
+
+	TextureRegion getRegion(const std::string& name) const
+	{
+		auto found = m_regions.find(name);
+		return found != m_regions.end() ? found->second : TextureRegion();
+	}
+	bool hasRegion(const std::string& name) const
+	{
+		return m_regions.find(name) != m_regions.end();
+	}
+
+	// send the images added since the last call, on the GL thread
+	void uploadDirtyPages()
+	{
+		for (auto& page : m_pages)
+		{
+			page->upload(GL_RGBA, GL_RGBA);
+		}
+	}
+
+	unsigned int getPageCount() const
+	{
+		return (unsigned int)m_pages.size();
+	}
+	const AtlasPage& getPage(unsigned int pageIndex) const
+	{
+		return *m_pages[pageIndex];
+	}
+
+private:
+	TextureRegion packImage(int width, int height, const unsigned char* pixels)
+	{
+		const glm::ivec2 paddedSize(width + 2 * s_imagePadding, height + 2 * s_imagePadding);
+
+		// the last pages are the less filled
+		glm::ivec2 paddedPos(0, 0);
+		int pageIndex = (int)m_pages.size() - 1;
+		while (pageIndex >= 0 && !m_pages[pageIndex]->m_packer.pack(paddedSize.x, paddedSize.y, paddedPos))
+		{
+			--pageIndex;
+		}
+		if (pageIndex < 0)
+		{
+			m_pages.push_back(std::make_unique<AtlasPage>(m_pageSize, s_channelCount));
+			m_pages.back()->m_texture->setCPUOnly(m_isCPUOnly);
+			pageIndex = (int)m_pages.size() - 1;
+			if (!m_pages.back()->m_packer.pack(paddedSize.x, paddedSize.y, paddedPos))
+				return TextureRegion();
+		}
+
+		AtlasPage& page = *m_pages[pageIndex];
+		const glm::ivec2 pos = paddedPos + glm::ivec2(s_imagePadding, s_imagePadding);
+
+		// each padded pixel takes the value of the closest image pixel
+		for (int y = 0; y < paddedSize.y; ++y)
+		{
+			const int srcY = glm::clamp(y - s_imagePadding, 0, height - 1);
+			for (int x = 0; x < paddedSize.x; ++x)
+			{
+				const int srcX = glm::clamp(x - s_imagePadding, 0, width - 1);
+				std::copy_n(&pixels[(srcY * width + srcX) * s_channelCount], s_channelCount, page.getPixel(paddedPos + glm::ivec2(x, y)));
+			}
+		}
+		page.addDirtyRect(paddedPos, paddedSize);
+
+		const glm::vec4 uvRect = glm::vec4(pos.x, pos.y, width, height) / (float)page.getSize();
+		return TextureRegion(page.m_texture, uvRect, glm::ivec2(width, height));
+	}
+
+	TextureRegion createStandaloneTexture(int width, int height, const unsigned char* pixels)
+	{
+		// the texture owns a malloc copy of the pixels
+		const size_t byteSize = (size_t)width * (size_t)height * s_channelCount;
+		unsigned char* datas = (unsigned char*)std::malloc(byteSize);
+		std::copy_n(pixels, byteSize, datas);
+
+		auto texture = std::make_shared<Texture>();
+		texture->setCPUOnly(m_isCPUOnly);
+		texture->create(width, height, datas, { { GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE },{ GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE },{ GL_TEXTURE_MIN_FILTER, GL_LINEAR },{ GL_TEXTURE_MAG_FILTER, GL_LINEAR } }, GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE);
+		return TextureRegion(texture, glm::vec4(0, 0, 1, 1), glm::ivec2(width, height));
+	}
+};
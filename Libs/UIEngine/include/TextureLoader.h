@@ -0,0 +1,412 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "OpenglUtils.h"
+#include "ThreadPool.h"
+
+// state shared by a TextureHandle and the TextureLoader
+struct TextureLoadState
+{
+	enum Status : int
+	{
+		LOADING,
+		READY,
+		FAILED
+	};
+
+	std::atomic<int> status;
+	std::shared_ptr<Texture> texture; // written on the GL thread, before the status becomes READY
+	std::string fileName;
+
+	TextureLoadState(const std::string& _fileName)
+		: status(LOADING)
+		, fileName(_fileName)
+	{}
+};
+
+// Future like handle on a texture loaded by the TextureLoader.
+// The texture is uploaded on the GL thread when the loader processes its uploads, so there is no blocking wait :
+// the owner polls the handle once per frame and uses a placeholder until the texture is ready.
+class TextureHandle
+{
+private:
+	std::shared_ptr<TextureLoadState> m_state;
+
+public:
+	TextureHandle()
+	{}
+	explicit TextureHandle(std::shared_ptr<TextureLoadState> state)
+		: m_state(state)
+	{}
+
+	// handle on a texture which is already loaded
+	static TextureHandle fromTexture(std::shared_ptr<Texture> texture)
+	{
+		auto state = std::make_shared<TextureLoadState>("");
+		state->texture = texture;
+		state->status = texture != nullptr ? TextureLoadState::READY : TextureLoadState::FAILED;
+		return TextureHandle(state);
+	}
+
+	bool isValid() const
+	{
+		return m_state != nullptr;
+	}
+	bool isPending() const
+	{
+		return m_state != nullptr && m_state->status == TextureLoadState::LOADING;
+	}
+	bool isReady() const
+	{
+		return m_state != nullptr && m_state->status == TextureLoadState::READY;
+	}
+	bool hasFailed() const
+	{
+		return m_state != nullptr && m_state->status == TextureLoadState::FAILED;
+	}
+	// nullptr until the texture is ready
+	std::shared_ptr<Texture> getTexture() const
+	{
+		return isReady() ? m_state->texture : nullptr;
+	}
+	const std::string& getFileName() const
+	{
+		static const std::string noFileName;
+		return m_state != nullptr ? m_state->fileName : noFileName;
+	}
+};
+
+struct TextureLoaderStats
+{
+	unsigned int decodedCount;
+	unsigned int uploadedCount;
+	unsigned int failedCount;
+	unsigned long long decodedBytes;
+	unsigned long long uploadedBytes;
+	double decodeSeconds; // summed over the workers
+	double lastUploadMilliseconds; // spent in the last processUploads
+	double maxUploadMilliseconds;
+
+	TextureLoaderStats()
+		: decodedCount(0)
+		, uploadedCount(0)
+		, failedCount(0)
+		, decodedBytes(0)
+		, uploadedBytes(0)
+		, decodeSeconds(0)
+		, lastUploadMilliseconds(0)
+		, maxUploadMilliseconds(0)
+	{}
+};
+
+// Textures decoded by a worker pool and uploaded on the GL thread.
+// The decoded images wait in a bounded queue : the workers stop decoding when the GL thread is late.
+// Each frame only uploads up to a byte budget, so a folder of images doesn't stall the UI.
+class TextureLoader
+{
+public:
+	// gl format of a texture, the same as the Texture::load parameters
+	struct TextureFormat
+	{
+		int channelCount;
+		std::vector<std::pair<GLenum, GLint>> params;
+		GLint internalFormat;
+		GLenum format;
+		GLenum type;
+
+		TextureFormat()
+			: channelCount(0)
+			, internalFormat(0)
+			, format(0)
+			, type(0)
+		{}
+		TextureFormat(int _channelCount, const std::vector<std::pair<GLenum, GLint>>& _params, GLint _internalFormat, GLenum _format, GLenum _type)
+			: channelCount(_channelCount)
+			, params(_params)
+			, internalFormat(_internalFormat)
+			, format(_format)
+			, type(_type)
+		{}
+	};
+
+	// pixels decoded by a worker, waiting for their upload
+	struct DecodedImage
+	{
+		std::shared_ptr<TextureLoadState> state;
+		TextureFormat textureFormat;
+		int width;
+		int height;
+		// channels of the pixels : the channels of the file if the texture format asks for 0
+		int channelCount;
+		unsigned char* pixels; // allocated by stbi_load
+
+		DecodedImage()
+			: width(0)
+			, height(0)
+			, channelCount(0)
+			, pixels(nullptr)
+		{}
+		DecodedImage(std::shared_ptr<TextureLoadState> _state, const TextureFormat& _textureFormat)
+			: state(_state)
+			, textureFormat(_textureFormat)
+			, width(0)
+			, height(0)
+			, channelCount(0)
+			, pixels(nullptr)
+		{}
+		~DecodedImage()
+		{
+			if (pixels != nullptr)
+				stbi_image_free(pixels);
+		}
+		DecodedImage(DecodedImage&& other)
+			: state(std::move(other.state))
+			, textureFormat(std::move(other.textureFormat))
+			, width(other.width)
+			, height(other.height)
+			, channelCount(other.channelCount)
+			, pixels(other.releasePixels())
+		{}
+		DecodedImage& operator=(DecodedImage&& other)
+		{
+			if (pixels != nullptr)
+				stbi_image_free(pixels);
+
+			state = std::move(other.state);
+			textureFormat = std::move(other.textureFormat);
+			width = other.width;
+			height = other.height;
+			channelCount = other.channelCount;
+			pixels = other.releasePixels();
+			return *this;
+		}
+		DecodedImage(const DecodedImage& other) = delete;
+		DecodedImage& operator=(const DecodedImage& other) = delete;
+
+		// give the pixels to their new owner
+		unsigned char* releasePixels()
+		{
+			unsigned char* releasedPixels = pixels;
+			pixels = nullptr;
+			return releasedPixels;
+		}
+		size_t getByteSize() const
+		{
+			return (size_t)width * (size_t)height * (size_t)channelCount;
+		}
+	};
+
+	// create the texture from the decoded image, called on the GL thread
+	typedef std::function<std::shared_ptr<Texture>(DecodedImage&)> UploadFunction;
+
+private:
+	UploadFunction m_uploadFunction;
+	size_t m_uploadBudget; // bytes per frame
+	size_t m_maxQueuedBytes;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_queueHasRoom;
+	std::deque<DecodedImage> m_decodedImages;
+	size_t m_queuedBytes;
+	std::atomic<bool> m_stopping;
+	std::atomic<unsigned int> m_pendingCount; // requested, not uploaded or failed yet
+	TextureLoaderStats m_stats;
+
+	// declared last, so the workers are joined before the queue is destroyed
+	ThreadPool m_workers;
+
+public:
+	// 8MB per frame : a few 1024x1024 RGBA images, or hundreds of thumbnails
+	TextureLoader(size_t uploadBudget = 8 * 1024 * 1024, size_t maxQueuedBytes = 64 * 1024 * 1024, unsigned int workerCount = getDefaultWorkerCount())
+		: m_uploadFunction(&TextureLoader::uploadToGPU)
+		, m_uploadBudget(uploadBudget)
+		, m_maxQueuedBytes(maxQueuedBytes)
+		, m_queuedBytes(0)
+		, m_stopping(false)
+		, m_pendingCount(0)
+		, m_workers(workerCount)
+	{}
+	~TextureLoader()
+	{
+		// release the workers waiting for room in the queue, the remaining requests fail
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_queueHasRoom.notify_all();
+	}
+	TextureLoader(const TextureLoader& other) = delete;
+	TextureLoader& operator=(const TextureLoader& other) = delete;
+
+	// the same parameters as Texture::load
+	TextureHandle loadAsync(const std::string& fileName, int desiredChannelCount, const std::vector<std::pair<GLenum, GLint>>& params, GLint internalFormat, GLenum format, GLenum type)
+	{
+		auto state = std::make_shared<TextureLoadState>(fileName);
+		const TextureFormat textureFormat(desiredChannelCount, params, internalFormat, format, type);
+
+		m_pendingCount++;
+		m_workers.submit([this, state, textureFormat]() { decode(state, textureFormat); });
+
+		return TextureHandle(state);
+	}
+	// the same parameters as Texture::load_RGB_image
+	TextureHandle loadRGBAsync(const std::string& fileName)
+	{
+		return loadAsync(fileName, 3, { { GL_TEXTURE_WRAP_S, GL_REPEAT },{ GL_TEXTURE_WRAP_T, GL_REPEAT },{ GL_TEXTURE_MIN_FILTER, GL_LINEAR },{ GL_TEXTURE_MAG_FILTER, GL_LINEAR } }, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE);
+	}
+
+	// called once per frame on the GL thread, return the number of textures uploaded.
+	// At least one image is uploaded per call, even if it is bigger than the budget.
+	unsigned int processUploads()
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		unsigned int uploadedCount = 0;
+		size_t uploadedBytes = 0;
+		while (true)
+		{
+			DecodedImage image;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_decodedImages.empty() || (uploadedCount > 0 && uploadedBytes + m_decodedImages.front().getByteSize() > m_uploadBudget))
+					break;
+
+				image = std::move(m_decodedImages.front());
+				m_decodedImages.pop_front();
+				m_queuedBytes -= image.getByteSize();
+			}
+			m_queueHasRoom.notify_all();
+
+			const size_t byteSize = image.getByteSize();
+			std::shared_ptr<Texture> texture = m_uploadFunction(image);
+			image.state->texture = texture;
+			image.state->status = texture != nullptr ? TextureLoadState::READY : TextureLoadState::FAILED;
+			m_pendingCount--;
+
+			uploadedCount++;
+			uploadedBytes += byteSize;
+		}
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.uploadedCount += uploadedCount;
+			m_stats.uploadedBytes += uploadedBytes;
+			m_stats.lastUploadMilliseconds = milliseconds;
+			m_stats.maxUploadMilliseconds = std::max(m_stats.maxUploadMilliseconds, milliseconds);
+		}
+
+		return uploadedCount;
+	}
+
+	// true while some textures are decoded or waiting for their upload
+	bool hasPendingLoads() const
+	{
+		return m_pendingCount > 0;
+	}
+	void setUploadBudget(size_t uploadBudget)
+	{
+		m_uploadBudget = uploadBudget;
+	}
+	size_t getUploadBudget() const
+	{
+		return m_uploadBudget;
+	}
+	// replace the gpu upload (ex : to measure the loading without any gl context)
+	void setUploadFunction(const UploadFunction& uploadFunction)
+	{
+		m_uploadFunction = uploadFunction;
+	}
+	// the next loaded textures only keep their pixels on the CPU, for an engine without opengl drawer
+	void setCPUOnly(bool isCPUOnly)
+	{
+		m_uploadFunction = isCPUOnly ? &TextureLoader::createOnCPU : &TextureLoader::uploadToGPU;
+	}
+	TextureLoaderStats getStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	// the GL thread has its own work, one worker less than the hardware threads
+	static unsigned int getDefaultWorkerCount()
+	{
+		const unsigned int hardwareThreadCount = std::thread::hardware_concurrency();
+		return hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 1;
+	}
+
+	static std::shared_ptr<Texture> uploadToGPU(DecodedImage& image)
+	{
+		const TextureFormat& textureFormat = image.textureFormat;
+		auto texture = std::make_shared<Texture>();
+		texture->create(image.width, image.height, image.releasePixels(), textureFormat.params, textureFormat.internalFormat, textureFormat.format, textureFormat.type);
+		return texture;
+	}
+	static std::shared_ptr<Texture> createOnCPU(DecodedImage& image)
+	{
+		const TextureFormat& textureFormat = image.textureFormat;
+		auto texture = std::make_shared<Texture>();
+		texture->setCPUOnly(true);
+		texture->create(image.width, image.height, image.releasePixels(), textureFormat.params, textureFormat.internalFormat, textureFormat.format, textureFormat.type);
+		return texture;
+	}
+
+private:
+	// called by the workers
+	void decode(std::shared_ptr<TextureLoadState> state, const TextureFormat& textureFormat)
+	{
+		if (m_stopping)
+		{
+			failLoad(*state);
+			return;
+		}
+
+		const auto start = std::chrono::high_resolution_clock::now();
+
+		DecodedImage image(state, textureFormat);
+		int channelCountInFile = 0;
+		image.pixels = loadImage(state->fileName, &image.width, &image.height, &channelCountInFile, textureFormat.channelCount);
+		image.channelCount = textureFormat.channelCount > 0 ? textureFormat.channelCount : channelCountInFile;
+
+		const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (image.pixels == nullptr)
+		{
+			std::cout << "ERROR::TEXTURE: Failed to load " << state->fileName << std::endl;
+			failLoad(*state);
+			return;
+		}
+
+		const size_t byteSize = image.getByteSize();
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stats.decodedCount++;
+		m_stats.decodedBytes += byteSize;
+		m_stats.decodeSeconds += seconds;
+
+		// an image bigger than the whole queue is still accepted when the queue is empty
+		m_queueHasRoom.wait(lock, [this, byteSize]() { return m_stopping || m_decodedImages.empty() || m_queuedBytes + byteSize <= m_maxQueuedBytes; });
+		if (m_stopping)
+		{
+			lock.unlock();
+			failLoad(*state);
+			return;
+		}
+
+		m_queuedBytes += byteSize;
+		m_decodedImages.push_back(std::move(image));
+	}
+
+	void failLoad(TextureLoadState& state)
+	{
+		state.status = TextureLoadState::FAILED;
+		m_pendingCount--;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.failedCount++;
+	}
+};
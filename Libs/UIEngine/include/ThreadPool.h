@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <algorithm>
+
+// Fixed set of worker threads consuming a shared queue of tasks.
+// The tasks are started in submission order, the results are given back through futures.
+class ThreadPool
+{
+private:
+	std::vector<std::thread> m_workers;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskAvailable;
+	bool m_stopping;
+
+public:
+	// one worker per hardware thread if workerCount is 0
+	explicit ThreadPool(unsigned int workerCount = 0)
+		: m_stopping(false)
+	{
+		if (workerCount == 0)
+			workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned int i = 0; i < workerCount; ++i)
+		{
+			m_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+	// the queued tasks are still executed
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_taskAvailable.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+	template<typename Function>
+	std::future<typename std::result_of<Function()>::type> submit(Function function)
+	{
+		typedef typename std::result_of<Function()>::type ResultType;
+
+		// std::function needs a copyable callable
+		auto task = std::make_shared<std::packaged_task<ResultType()>>(std::move(function));
+		std::future<ResultType> result = task->get_future();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back([task]() { (*task)(); });
+		}
+		m_taskAvailable.notify_one();
+
+		return result;
+	}
+
+	unsigned int getWorkerCount() const
+	{
+		return (unsigned int)m_workers.size();
+	}
+
+private:
+	void workerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_taskAvailable.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+				if (m_tasks.empty())
+					return;
+
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "UIDrawer.h"
+#include "UIItem.h"
+
+// Retained list of the quads submitted by the widgets.
+// Consecutive quads which use the same program and texture are merged into one batch, drawn with one instanced draw call.
+// The list is only recorded again when items are added, removed, shown or hidden. When the quads of an item change,
+// the item is damaged : its quads are recorded again in place, and only the union of their old and new boxes is redrawn.
+// A frame without any damage doesn't record, upload or draw anything.
+class UIBatchRenderer
+{
+private:
+	// quads submitted by an item, inside the retained instances
+	struct ItemRange
+	{
+		unsigned int firstInstance;
+		unsigned int instanceCount;
+
+		ItemRange(unsigned int _firstInstance = 0, unsigned int _instanceCount = 0)
+			: firstInstance(_firstInstance)
+			, instanceCount(_instanceCount)
+		{}
+	};
+
+	// state of a retained quad, a damaged item can only be recorded in place if its quads keep the same states
+	struct InstanceState
+	{
+		ShaderProgram* program;
+		Texture* texture;
+
+		InstanceState(ShaderProgram* _program = nullptr, Texture* _texture = nullptr)
+			: program(_program)
+			, texture(_texture)
+		{}
+	};
+
+	glm::vec2 m_viewportSize;
+
+	// retained draw list
+	std::vector<UIQuadInstance> m_instances;
+	std::vector<InstanceState> m_instanceStates;
+	std::vector<UIDrawBatch> m_batches;
+	std::unordered_map<const UIItem*, ItemRange> m_itemRanges;
+	unsigned int m_recordCount;
+
+	// damage since the last frame
+	bool m_needRecord;
+	std::vector<const UIItem*> m_damagedItems;
+	bool m_hasDamage;
+	Rect m_damageBounds;
+
+	// instances modified since the last upload
+	bool m_needUpload;
+	unsigned int m_dirtyFirstInstance;
+	unsigned int m_dirtyEndInstance;
+
+	// in place recording of a damaged item
+	bool m_isPatching;
+	bool m_patchFailed;
+	unsigned int m_patchInstance;
+	unsigned int m_patchEndInstance;
+
+public:
+	UIBatchRenderer()
+		: m_viewportSize(0, 0)
+		, m_recordCount(0)
+		, m_needRecord(true)
+		, m_hasDamage(false)
+		, m_needUpload(true)
+		, m_dirtyFirstInstance(0)
+		, m_dirtyEndInstance(0)
+		, m_isPatching(false)
+		, m_patchFailed(false)
+		, m_patchInstance(0)
+		, m_patchEndInstance(0)
+	{}
+
+	// damage
+	// items have been added, removed, shown or hidden : the whole list is recorded and drawn again
+	void invalidateDrawList()
+	{
+		m_needRecord = true;
+	}
+	// the quads of the item have changed
+	void damageItem(const UIItem* item)
+	{
+		m_damagedItems.push_back(item);
+	}
+	// the item is destroyed, we must not draw it again
+	void forgetItem(const UIItem* item)
+	{
+		m_damagedItems.erase(std::remove(m_damagedItems.begin(), m_damagedItems.end(), item), m_damagedItems.end());
+		m_itemRanges.erase(item);
+	}
+	bool hasPendingChanges() const
+	{
+		return m_needRecord || !m_damagedItems.empty();
+	}
+
+	// called by the items during the recording, to find their quads back when they are damaged
+	void recordItem(const UIItem& item)
+	{
+		const unsigned int firstInstance = (unsigned int)m_instances.size();
+		item.drawSelf(*this);
+		UIENGINE_PROFILE_COUNT(UIProfileCounter::DRAW_NODES, 1);
+		m_itemRanges[&item] = ItemRange(firstInstance, (unsigned int)m_instances.size() - firstInstance);
+	}
+
+	void submitQuad(ShaderProgram* program, Texture* texture, const UIQuadInstance& instance)
+	{
+		if (m_isPatching)
+		{
+			patchQuad(program, texture, instance);
+			return;
+		}
+
+		// start a new batch only if the state changes
+		if (m_batches.empty() || m_batches.back().program != program || m_batches.back().texture != texture)
+		{
+			m_batches.push_back(UIDrawBatch(program, texture, (unsigned int)m_instances.size(), 0));
+		}
+
+		m_instances.push_back(instance);
+		m_instanceStates.push_back(InstanceState(program, texture));
+		m_batches.back().instanceCount++;
+	}
+
+	// update the retained list from the damages
+	void update(const UIItem& root, const glm::vec2& viewportSize)
+	{
+		if (viewportSize != m_viewportSize)
+		{
+			m_viewportSize = viewportSize;
+			m_needRecord = true;
+		}
+
+		if (m_needRecord)
+		{
+			record(root);
+			addDamage(glm::vec4(0, 0, m_viewportSize));
+		}
+		else if (!m_damagedItems.empty())
+		{
+			updateDamagedItems(root);
+		}
+		m_damagedItems.clear();
+	}
+
+	// redraw the damaged part of the drawer surface and present it
+	void draw(IUIDrawer* drawer)
+	{
+		// keep the damages until we have something to draw them with
+		if (drawer == nullptr)
+			return;
+
+		// upload only the instances which have changed
+		if (m_needUpload)
+		{
+			drawer->uploadInstances(m_instances.data(), (unsigned int)m_instances.size());
+		}
+		else if (m_dirtyFirstInstance < m_dirtyEndInstance)
+		{
+			drawer->updateInstances(m_dirtyFirstInstance, m_instances.data() + m_dirtyFirstInstance, m_dirtyEndInstance - m_dirtyFirstInstance);
+		}
+		m_needUpload = false;
+		m_dirtyFirstInstance = 0;
+		m_dirtyEndInstance = 0;
+
+		if (m_hasDamage)
+		{
+			Rect scissorRect = getDamageScissor();
+			const bool fullRedraw = scissorRect.pos == glm::vec2(0, 0) && scissorRect.extent == m_viewportSize;
+
+			// the batches outside of the scissor are discarded before rasterization
+			drawer->beginFrame(m_viewportSize, fullRedraw ? nullptr : &scissorRect);
+			for (const auto& batch : m_batches)
+			{
+				drawer->drawBatch(batch);
+			}
+			drawer->endFrame();
+
+			m_hasDamage = false;
+		}
+
+		drawer->present();
+	}
+
+	const glm::vec2& getViewportSize() const
+	{
+		return m_viewportSize;
+	}
+	unsigned int getInstanceCount() const
+	{
+		return (unsigned int)m_instances.size();
+	}
+	unsigned int getBatchCount() const
+	{
+		return (unsigned int)m_batches.size();
+	}
+	// number of times the whole list has been recorded
+	unsigned int getRecordCount() const
+	{
+		return m_recordCount;
+	}
+
+private:
+	void record(const UIItem& root)
+	{
+		// keep the capacity of the previous recording
+		m_instances.clear();
+		m_instanceStates.clear();
+		m_batches.clear();
+		m_itemRanges.clear();
+
+		root.draw(*this);
+
+		m_needRecord = false;
+		m_needUpload = true;
+		m_recordCount++;
+	}
+
+	void updateDamagedItems(const UIItem& root)
+	{
+		// an item can be damaged several times between two frames
+		std::sort(m_damagedItems.begin(), m_damagedItems.end());
+		m_damagedItems.erase(std::unique(m_damagedItems.begin(), m_damagedItems.end()), m_damagedItems.end());
+
+		for (const UIItem* item : m_damagedItems)
+		{
+			if (!patchItem(*item))
+			{
+				// the quad count or state of the item has changed, the batches have to be built again.
+				// The other quads are only moved inside the list, so we still only redraw the damaged items.
+				addItemDamage(m_damagedItems);
+				record(root);
+				addItemDamage(m_damagedItems);
+				return;
+			}
+		}
+	}
+
+	bool patchItem(const UIItem& item)
+	{
+		auto found = m_itemRanges.find(&item);
+		// the item isn't drawn
+		if (found == m_itemRanges.end())
+			return true;
+
+		const ItemRange range = found->second;
+		m_isPatching = true;
+		m_patchFailed = false;
+		m_patchInstance = range.firstInstance;
+		m_patchEndInstance = range.firstInstance + range.instanceCount;
+
+		item.drawSelf(*this);
+		UIENGINE_PROFILE_COUNT(UIProfileCounter::DRAW_NODES, 1);
+
+		m_isPatching = false;
+		if (m_patchFailed || m_patchInstance != m_patchEndInstance)
+			return false;
+
+		if (range.instanceCount > 0)
+		{
+			if (m_dirtyFirstInstance == m_dirtyEndInstance)
+			{
+				m_dirtyFirstInstance = range.firstInstance;
+				m_dirtyEndInstance = m_patchEndInstance;
+			}
+			else
+			{
+				m_dirtyFirstInstance = std::min(m_dirtyFirstInstance, range.firstInstance);
+				m_dirtyEndInstance = std::max(m_dirtyEndInstance, m_patchEndInstance);
+			}
+		}
+		return true;
+	}
+
+	void patchQuad(ShaderProgram* program, Texture* texture, const UIQuadInstance& instance)
+	{
+		if (m_patchFailed || m_patchInstance >= m_patchEndInstance
+			|| m_instanceStates[m_patchInstance].program != program || m_instanceStates[m_patchInstance].texture != texture)
+		{
+			m_patchFailed = true;
+			return;
+		}
+
+		// redraw where the quad was and where it is now
+		addDamage(m_instances[m_patchInstance].box);
+		addDamage(instance.box);
+
+		m_instances[m_patchInstance] = instance;
+		m_patchInstance++;
+	}
+
+	void addItemDamage(const std::vector<const UIItem*>& items)
+	{
+		for (const UIItem* item : items)
+		{
+			auto found = m_itemRanges.find(item);
+			if (found == m_itemRanges.end())
+				continue;
+
+			for (unsigned int i = 0; i < found->second.instanceCount; ++i)
+			{
+				addDamage(m_instances[found->second.firstInstance + i].box);
+			}
+		}
+	}
+
+	void addDamage(const glm::vec4& box)
+	{
+		if (box.z <= 0 || box.w <= 0)
+			return;
+
+		if (!m_hasDamage)
+		{
+			m_damageBounds = Rect(box.x, box.y, box.z, box.w);
+			m_hasDamage = true;
+		}
+		else
+		{
+			m_damageBounds.append(Rect(box.x, box.y, box.z, box.w));
+		}
+	}
+
+	// damage bounds in whole pixels, with a margin for the antialiased edges, clipped to the viewport
+	Rect getDamageScissor() const
+	{
+		const glm::vec2 min = glm::max(glm::floor(m_damageBounds.pos) - glm::vec2(1, 1), glm::vec2(0, 0));
+		const glm::vec2 max = glm::min(glm::ceil(m_damageBounds.pos + m_damageBounds.extent) + glm::vec2(1, 1), m_viewportSize);
+		return Rect(min, glm::max(max - min, glm::vec2(0, 0)));
+	}
+};
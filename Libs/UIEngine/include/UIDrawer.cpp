@@ -0,0 +1,576 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include "UIDrawer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UIDRAWER_USE_SSE2
+#endif
+
+// unit quad, the instance box is applied in the vertex shader
+static const float s_unitQuadCorners[] = {
+	0.0f, 0.0f,
+	1.0f, 0.0f,
+	1.0f, 1.0f,
+	0.0f, 1.0f
+};
+
+static const GLuint s_unitQuadIndices[] = {
+	0, 1, 2,
+	2, 3, 0
+};
+
+// instance attributes locations, must match UIBatch.vert
+static const GLuint s_instanceBoxLocation = 2;
+static const GLuint s_instanceTintLocation = 3;
+static const GLuint s_instanceUVRectLocation = 4;
+static const GLuint s_instanceParamsLocation = 5;
+
+GLUIDrawer::GLUIDrawer()
+	: m_vao(0)
+	, m_quadVbo(0)
+	, m_quadIbo(0)
+	, m_instanceVbo(0)
+	, m_instanceCapacity(0)
+	, m_surfaceFramebuffer(0)
+	, m_surfaceTexture(0)
+	, m_surfaceSize(0, 0)
+	, m_presentVao(0)
+	, m_previousFramebuffer(0)
+	, m_viewportSize(0, 0)
+	, m_boundProgram(nullptr)
+	, m_boundTexture(nullptr)
+{
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_quadVbo);
+	glGenBuffers(1, &m_quadIbo);
+	glGenBuffers(1, &m_instanceVbo);
+
+	glBindVertexArray(m_vao);
+
+	// quad corners
+	glBindBuffer(GL_ARRAY_BUFFER, m_quadVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(s_unitQuadCorners), s_unitQuadCorners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+
+	// indices
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_quadIbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(s_unitQuadIndices), s_unitQuadIndices, GL_STATIC_DRAW);
+
+	// per instance attributes
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+	glEnableVertexAttribArray(s_instanceBoxLocation);
+	glEnableVertexAttribArray(s_instanceTintLocation);
+	glEnableVertexAttribArray(s_instanceUVRectLocation);
+	glEnableVertexAttribArray(s_instanceParamsLocation);
+	glVertexAttribDivisor(s_instanceBoxLocation, 1);
+	glVertexAttribDivisor(s_instanceTintLocation, 1);
+	glVertexAttribDivisor(s_instanceUVRectLocation, 1);
+	glVertexAttribDivisor(s_instanceParamsLocation, 1);
+	setInstanceAttributesOffset(0);
+
+	//unbind
+	glBindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the present pass draws a fullscreen triangle generated in the vertex shader, but a vao must be bound
+	glGenVertexArrays(1, &m_presentVao);
+	m_presentProgram = std::make_unique<ShaderProgram>();
+	m_presentProgram->load("resources/shaders/UIPresent.vert", "resources/shaders/UIPresent.frag");
+}
+
+GLUIDrawer::~GLUIDrawer()
+{
+	if (m_surfaceFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_surfaceFramebuffer);
+		glDeleteTextures(1, &m_surfaceTexture);
+	}
+	glDeleteVertexArrays(1, &m_presentVao);
+	glDeleteBuffers(1, &m_instanceVbo);
+	glDeleteBuffers(1, &m_quadIbo);
+	glDeleteBuffers(1, &m_quadVbo);
+	glDeleteVertexArrays(1, &m_vao);
+}
+
+void GLUIDrawer::beginFrame(const glm::vec2& viewportSize, const Rect* scissorRect)
+{
+	m_viewportSize = viewportSize;
+	m_boundProgram = nullptr;
+	m_boundTexture = nullptr;
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, m_previousClearColor);
+
+	resizeSurface(glm::ivec2(viewportSize));
+	glBindFramebuffer(GL_FRAMEBUFFER, m_surfaceFramebuffer);
+	glViewport(0, 0, m_surfaceSize.x, m_surfaceSize.y);
+
+	// the clear is limited by the scissor too, the rest of the surface keeps the previous frames
+	if (scissorRect != nullptr)
+	{
+		// the scissor origin is the bottom left corner
+		glEnable(GL_SCISSOR_TEST);
+		glScissor((GLint)scissorRect->pos.x, (GLint)(m_surfaceSize.y - scissorRect->pos.y - scissorRect->extent.y), (GLsizei)scissorRect->extent.x, (GLsizei)scissorRect->extent.y);
+	}
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// the alpha is accumulated separately so the surface contains premultiplied colors
+	glEnable(GL_BLEND);
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	glBindVertexArray(m_vao);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void GLUIDrawer::uploadInstances(const UIQuadInstance* instances, unsigned int instanceCount)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+
+	// grow the buffer geometrically to avoid reallocating it each time a widget is added
+	if (instanceCount > m_instanceCapacity)
+		m_instanceCapacity = std::max(instanceCount, m_instanceCapacity * 2);
+
+	// orphan the previous storage so we don't wait for the previous frame draws
+	glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity * sizeof(UIQuadInstance), nullptr, GL_STREAM_DRAW);
+
+	if(instanceCount > 0)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(UIQuadInstance), instances);
+}
+
+void GLUIDrawer::updateInstances(unsigned int firstInstance, const UIQuadInstance* instances, unsigned int instanceCount)
+{
+	if (instanceCount == 0)
+		return;
+
+	// no orphaning here, the other instances are still valid
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+	glBufferSubData(GL_ARRAY_BUFFER, firstInstance * sizeof(UIQuadInstance), instanceCount * sizeof(UIQuadInstance), instances);
+}
+
+void GLUIDrawer::drawBatch(const UIDrawBatch& batch)
+{
+	if (batch.instanceCount == 0 || batch.program == nullptr)
+		return;
+
+	// we bind the program only if it is not already in use
+	if (batch.program != m_boundProgram)
+	{
+		batch.program->use();
+		// only uploaded when the viewport size changes, thanks to the shadowed value
+		batch.program->setUniform(batch.program->getViewportSizeHandle(), m_viewportSize);
+		m_boundProgram = batch.program;
+	}
+
+	// same thing for the texture
+	if (batch.texture != m_boundTexture)
+	{
+		if (batch.texture != nullptr)
+			batch.texture->bind();
+		else
+			glBindTexture(GL_TEXTURE_2D, 0);
+		m_boundTexture = batch.texture;
+	}
+
+	setInstanceAttributesOffset(batch.firstInstance);
+	glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, batch.instanceCount);
+	UIENGINE_PROFILE_COUNT(UIProfileCounter::DRAW_CALLS, 1);
+}
+
+void GLUIDrawer::endFrame()
+{
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+
+	m_boundProgram = nullptr;
+	m_boundTexture = nullptr;
+
+	glDisable(GL_BLEND);
+	glDisable(GL_SCISSOR_TEST);
+
+	// back to the application framebuffer
+	glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+	glViewport(m_previousViewport[0], m_previousViewport[1], m_previousViewport[2], m_previousViewport[3]);
+	glClearColor(m_previousClearColor[0], m_previousClearColor[1], m_previousClearColor[2], m_previousClearColor[3]);
+}
+
+void GLUIDrawer::present()
+{
+	// nothing has been drawn yet
+	if (m_surfaceFramebuffer == 0)
+		return;
+
+	// the surface colors are already multiplied by their alpha
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+	m_presentProgram->use();
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_surfaceTexture);
+	glBindVertexArray(m_presentVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	UIENGINE_PROFILE_COUNT(UIProfileCounter::DRAW_CALLS, 1);
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+	glDisable(GL_BLEND);
+}
+
+void GLUIDrawer::resizeSurface(const glm::ivec2& size)
+{
+	if (m_surfaceFramebuffer != 0 && size == m_surfaceSize)
+		return;
+
+	if (m_surfaceFramebuffer == 0)
+	{
+		glGenFramebuffers(1, &m_surfaceFramebuffer);
+		glGenTextures(1, &m_surfaceTexture);
+	}
+	m_surfaceSize = glm::max(size, glm::ivec2(1, 1));
+
+	glBindTexture(GL_TEXTURE_2D, m_surfaceTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_surfaceSize.x, m_surfaceSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_surfaceFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_surfaceTexture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_previousFramebuffer);
+}
+
+void GLUIDrawer::setInstanceAttributesOffset(unsigned int firstInstance)
+{
+	// point the instance attributes to the first instance of the batch (no base instance in gl 3.3)
+	const size_t baseOffset = firstInstance * sizeof(UIQuadInstance);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+	glVertexAttribPointer(s_instanceBoxLocation, 4, GL_FLOAT, GL_FALSE, sizeof(UIQuadInstance), (void*)(baseOffset + offsetof(UIQuadInstance, box)));
+	glVertexAttribPointer(s_instanceTintLocation, 4, GL_FLOAT, GL_FALSE, sizeof(UIQuadInstance), (void*)(baseOffset + offsetof(UIQuadInstance, tint)));
+	glVertexAttribPointer(s_instanceUVRectLocation, 4, GL_FLOAT, GL_FALSE, sizeof(UIQuadInstance), (void*)(baseOffset + offsetof(UIQuadInstance, uvRect)));
+	glVertexAttribPointer(s_instanceParamsLocation, 4, GL_FLOAT, GL_FALSE, sizeof(UIQuadInstance), (void*)(baseOffset + offsetof(UIQuadInstance, params)));
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////// SoftwareUIDrawer
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// color in [0, 255], multiplied by its alpha
+struct PremultipliedColor
+{
+	unsigned int r;
+	unsigned int g;
+	unsigned int b;
+	unsigned int a;
+};
+
+static PremultipliedColor premultiply(const glm::vec4& color)
+{
+	const glm::vec4 clamped = glm::clamp(color, 0.0f, 1.0f);
+	PremultipliedColor premultiplied;
+	premultiplied.r = (unsigned int)(clamped.r * clamped.a * 255.0f + 0.5f);
+	premultiplied.g = (unsigned int)(clamped.g * clamped.a * 255.0f + 0.5f);
+	premultiplied.b = (unsigned int)(clamped.b * clamped.a * 255.0f + 0.5f);
+	premultiplied.a = (unsigned int)(clamped.a * 255.0f + 0.5f);
+	return premultiplied;
+}
+
+// x / 255 rounded, exact for x in [0, 255 * 255]
+static inline unsigned int divideBy255(unsigned int x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+// like the blending of GLUIDrawer : src + dst * (1 - src.a), on the colors and the alpha
+static inline void blendPixel(unsigned char* pixel, const PremultipliedColor& color)
+{
+	const unsigned int inverseAlpha = 255 - color.a;
+	pixel[0] = (unsigned char)(color.r + divideBy255(pixel[0] * inverseAlpha));
+	pixel[1] = (unsigned char)(color.g + divideBy255(pixel[1] * inverseAlpha));
+	pixel[2] = (unsigned char)(color.b + divideBy255(pixel[2] * inverseAlpha));
+	pixel[3] = (unsigned char)(color.a + divideBy255(pixel[3] * inverseAlpha));
+}
+
+// blend the same color on count consecutive pixels
+static void blendSpan(unsigned char* pixels, int count, const PremultipliedColor& color)
+{
+	int pixelIndex = 0;
+	if (color.a == 255)
+	{
+		const unsigned char opaque[4] = { (unsigned char)color.r, (unsigned char)color.g, (unsigned char)color.b, 255 };
+		for (; pixelIndex < count; ++pixelIndex)
+		{
+			std::memcpy(pixels + pixelIndex * 4, opaque, 4);
+		}
+		return;
+	}
+
+#ifdef UIDRAWER_USE_SSE2
+	// 4 pixels per iteration, the channels widened to 16 bits
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i source = _mm_setr_epi16((short)color.r, (short)color.g, (short)color.b, (short)color.a, (short)color.r, (short)color.g, (short)color.b, (short)color.a);
+	const __m128i inverseAlpha = _mm_set1_epi16((short)(255 - color.a));
+	const __m128i rounding = _mm_set1_epi16(128);
+	for (; pixelIndex + 4 <= count; pixelIndex += 4)
+	{
+		const __m128i destination = _mm_loadu_si128((const __m128i*)(pixels + pixelIndex * 4));
+		__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(destination, zero), inverseAlpha), rounding);
+		__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(destination, zero), inverseAlpha), rounding);
+		// divideBy255
+		low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+		high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+		low = _mm_add_epi16(low, source);
+		high = _mm_add_epi16(high, source);
+		_mm_storeu_si128((__m128i*)(pixels + pixelIndex * 4), _mm_packus_epi16(low, high));
+	}
+#endif
+
+	for (; pixelIndex < count; ++pixelIndex)
+	{
+		blendPixel(pixels + pixelIndex * 4, color);
+	}
+}
+
+// same as the shaders : coverage of a rounded box, the radius is given relatively to the smallest side of the box
+static float roundedBoxCoverage(const glm::vec2& pos, const glm::vec2& extent, float radius)
+{
+	const float radiusInPixel = radius * std::min(extent.x, extent.y);
+	const glm::vec2 halfExtent = extent * 0.5f;
+	const glm::vec2 q = glm::abs(pos - halfExtent) - (halfExtent - glm::vec2(radiusInPixel));
+	const float dist = glm::length(glm::max(q, 0.0f)) + std::min(std::max(q.x, q.y), 0.0f) - radiusInPixel;
+	return glm::clamp(0.5f - dist, 0.0f, 1.0f);
+}
+
+// bilinear filtering, clamped to the edges. The missing channels are read like opengl does : (r, 0, 0, 1)
+static glm::vec4 sampleTexture(const Texture& texture, const glm::vec2& uv)
+{
+	const int width = texture.GetTexWidth();
+	const int height = texture.GetTexHeight();
+	const int channelCount = texture.getChannelCount();
+	const unsigned char* pixels = texture.getPixels();
+
+	auto fetch = [&](int x, int y)
+	{
+		x = glm::clamp(x, 0, width - 1);
+		y = glm::clamp(y, 0, height - 1);
+		const unsigned char* texel = pixels + ((size_t)y * width + x) * channelCount;
+		glm::vec4 color(texel[0], 0, 0, 255);
+		for (int channel = 1; channel < channelCount; ++channel)
+		{
+			color[channel] = texel[channel];
+		}
+		return color / 255.0f;
+	};
+
+	const glm::vec2 texelPos = uv * glm::vec2(width, height) - 0.5f;
+	const glm::vec2 floorPos = glm::floor(texelPos);
+	const glm::vec2 weight = texelPos - floorPos;
+	const int x = (int)floorPos.x;
+	const int y = (int)floorPos.y;
+	const glm::vec4 top = glm::mix(fetch(x, y), fetch(x + 1, y), weight.x);
+	const glm::vec4 bottom = glm::mix(fetch(x, y + 1), fetch(x + 1, y + 1), weight.x);
+	return glm::mix(top, bottom, weight.y);
+}
+
+SoftwareUIDrawer::SoftwareUIDrawer()
+	: m_surfaceSize(0, 0)
+	, m_clipMin(0, 0)
+	, m_clipMax(0, 0)
+	, m_frameCount(0)
+	, m_drawCallCount(0)
+	, m_blendedPixelCount(0)
+{}
+
+void SoftwareUIDrawer::beginFrame(const glm::vec2& viewportSize, const Rect* scissorRect)
+{
+	resizeSurface(glm::ivec2(viewportSize));
+
+	// same rounding as glScissor
+	m_clipMin = glm::ivec2(0, 0);
+	m_clipMax = m_surfaceSize;
+	if (scissorRect != nullptr)
+	{
+		m_clipMin = glm::clamp(glm::ivec2(scissorRect->pos), glm::ivec2(0, 0), m_surfaceSize);
+		m_clipMax = glm::clamp(glm::ivec2(scissorRect->pos) + glm::ivec2(scissorRect->extent), m_clipMin, m_surfaceSize);
+	}
+
+	// the rest of the surface keeps the previous frames
+	for (int y = m_clipMin.y; y < m_clipMax.y; ++y)
+	{
+		unsigned char* row = &m_surface[((size_t)y * m_surfaceSize.x + m_clipMin.x) * 4];
+		std::fill(row, row + (m_clipMax.x - m_clipMin.x) * 4, (unsigned char)0);
+	}
+}
+
+void SoftwareUIDrawer::uploadInstances(const UIQuadInstance* instances, unsigned int instanceCount)
+{
+	m_instances.assign(instances, instances + instanceCount);
+}
+
+void SoftwareUIDrawer::updateInstances(unsigned int firstInstance, const UIQuadInstance* instances, unsigned int instanceCount)
+{
+	std::copy(instances, instances + instanceCount, m_instances.begin() + firstInstance);
+}
+
+void SoftwareUIDrawer::drawBatch(const UIDrawBatch& batch)
+{
+	for (unsigned int instanceIndex = batch.firstInstance; instanceIndex < batch.firstInstance + batch.instanceCount; ++instanceIndex)
+	{
+		drawQuad(m_instances[instanceIndex], batch.texture);
+	}
+	m_drawCallCount++;
+	UIENGINE_PROFILE_COUNT(UIProfileCounter::DRAW_CALLS, 1);
+}
+
+void SoftwareUIDrawer::endFrame()
+{
+	m_frameCount++;
+}
+
+void SoftwareUIDrawer::resizeSurface(const glm::ivec2& size)
+{
+	const glm::ivec2 surfaceSize = glm::max(size, glm::ivec2(1, 1));
+	if (surfaceSize == m_surfaceSize)
+		return;
+
+	m_surfaceSize = surfaceSize;
+	m_surface.assign((size_t)m_surfaceSize.x * m_surfaceSize.y * 4, 0);
+}
+
+void SoftwareUIDrawer::drawQuad(const UIQuadInstance& instance, const Texture* texture)
+{
+	const glm::vec2 boxPos(instance.box.x, instance.box.y);
+	const glm::vec2 boxExtent(instance.box.z, instance.box.w);
+	const UIQuadKind kind = (UIQuadKind)(int)instance.params.y;
+	if (boxExtent.x <= 0 || boxExtent.y <= 0 || instance.tint.a <= 0)
+		return;
+	if (kind != QUAD_SOLID && (texture == nullptr || texture->getPixels() == nullptr))
+		return;
+
+	// like the GPU, the pixels whose center is inside the box
+	const glm::ivec2 pixelMin = glm::max(glm::ivec2(glm::ceil(boxPos - 0.5f)), m_clipMin);
+	const glm::ivec2 pixelMax = glm::min(glm::ivec2(glm::ceil(boxPos + boxExtent - 0.5f)), m_clipMax);
+	if (pixelMin.x >= pixelMax.x || pixelMin.y >= pixelMax.y)
+		return;
+
+	// the glyphs aren't rounded
+	const float cornerRadius = kind == QUAD_GLYPH ? 0.0f : instance.params.x;
+	const glm::vec2 uvOrigin(instance.uvRect.x, instance.uvRect.y);
+	const glm::vec2 uvExtent(instance.uvRect.z, instance.uvRect.w);
+	const PremultipliedColor solidColor = premultiply(instance.tint);
+
+	for (int y = pixelMin.y; y < pixelMax.y; ++y)
+	{
+		unsigned char* row = &m_surface[(size_t)y * m_surfaceSize.x * 4];
+		const float localY = y + 0.5f - boxPos.y;
+		auto getCoverage = [&](int x) { return roundedBoxCoverage(glm::vec2(x + 0.5f - boxPos.x, localY), boxExtent, cornerRadius); };
+
+		if (kind == QUAD_SOLID)
+		{
+			// the coverage only grows towards the middle of the row : the partially covered pixels are at both ends
+			int spanBegin = pixelMin.x;
+			int spanEnd = pixelMax.x;
+			for (float coverage = 0; spanBegin < spanEnd && (coverage = getCoverage(spanBegin)) < 1.0f; ++spanBegin)
+			{
+				if (coverage > 0)
+					blendPixel(row + spanBegin * 4, premultiply(glm::vec4(glm::vec3(instance.tint), instance.tint.a * coverage)));
+			}
+			for (float coverage = 0; spanEnd > spanBegin && (coverage = getCoverage(spanEnd - 1)) < 1.0f; --spanEnd)
+			{
+				if (coverage > 0)
+					blendPixel(row + (spanEnd - 1) * 4, premultiply(glm::vec4(glm::vec3(instance.tint), instance.tint.a * coverage)));
+			}
+			blendSpan(row + spanBegin * 4, spanEnd - spanBegin, solidColor);
+		}
+		else
+		{
+			const float v = uvOrigin.y + (localY / boxExtent.y) * uvExtent.y;
+			for (int x = pixelMin.x; x < pixelMax.x; ++x)
+			{
+				const float localX = x + 0.5f - boxPos.x;
+				const glm::vec4 texel = sampleTexture(*texture, glm::vec2(uvOrigin.x + (localX / boxExtent.x) * uvExtent.x, v));
+
+				glm::vec4 color;
+				if (kind == QUAD_GLYPH)
+				{
+					// single channel atlas
+					color = glm::vec4(glm::vec3(instance.tint), instance.tint.a * texel.r);
+				}
+				else
+				{
+					color = texel * instance.tint;
+					color.a *= getCoverage(x);
+				}
+				if (color.a > 0)
+					blendPixel(row + x * 4, premultiply(color));
+			}
+		}
+	}
+	m_blendedPixelCount += (size_t)(pixelMax.x - pixelMin.x) * (pixelMax.y - pixelMin.y);
+}
+
+bool SoftwareUIDrawer::saveSurface(const std::string& fileName) const
+{
+	std::ofstream stream(fileName, std::ios::binary);
+	if (!stream)
+		return false;
+
+	stream << "P7\nWIDTH " << m_surfaceSize.x << "\nHEIGHT " << m_surfaceSize.y << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+	stream.write((const char*)m_surface.data(), m_surface.size());
+	return (bool)stream;
+}
+
+int SoftwareUIDrawer::compareSurface(const std::string& fileName, int tolerance) const
+{
+	std::ifstream stream(fileName, std::ios::binary);
+	std::string line;
+	if (!std::getline(stream, line) || line != "P7")
+		return -1;
+
+	glm::ivec2 size(0, 0);
+	int depth = 0;
+	while (std::getline(stream, line) && line != "ENDHDR")
+	{
+		const size_t separator = line.find(' ');
+		const std::string key = line.substr(0, separator);
+		const int value = separator == std::string::npos ? 0 : std::atoi(line.c_str() + separator + 1);
+		if (key == "WIDTH")
+			size.x = value;
+		else if (key == "HEIGHT")
+			size.y = value;
+		else if (key == "DEPTH")
+			depth = value;
+	}
+	if (size != m_surfaceSize || depth != 4)
+		return -1;
+
+	std::vector<unsigned char> golden(m_surface.size());
+	if (!stream.read((char*)golden.data(), golden.size()))
+		return -1;
+
+	int differentPixelCount = 0;
+	for (size_t pixelIndex = 0; pixelIndex < golden.size(); pixelIndex += 4)
+	{
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			if (std::abs((int)golden[pixelIndex + channel] - (int)m_surface[pixelIndex + channel]) > tolerance)
+			{
+				differentPixelCount++;
+				break;
+			}
+		}
+	}
+	return differentPixelCount;
+}
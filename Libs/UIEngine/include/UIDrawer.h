@@ -0,0 +1,342 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "glm/glm.hpp"
+#include "OpenglUtils.h"
+
+// the kind of a quad, for drawers which doesn't rely on the shader programs
+enum UIQuadKind
+{
+	QUAD_SOLID = 0,
+	QUAD_IMAGE = 1,
+	QUAD_GLYPH = 2,
+};
+
+// per instance datas of a batched quad
+struct UIQuadInstance
+{
+	glm::vec4 box;		// position and extent, in pixels
+	glm::vec4 tint;
+	glm::vec4 uvRect;	// normalized source rect inside the bound texture
+	glm::vec4 params;	// x : corner radius, y : quad kind
+
+	UIQuadInstance()
+		: box(0, 0, 0, 0)
+		, tint(1, 1, 1, 1)
+		, uvRect(0, 0, 1, 1)
+		, params(0, QUAD_SOLID, 0, 0)
+	{}
+
+	UIQuadInstance(const glm::vec4& _box, const glm::vec4& _tint, const glm::vec4& _uvRect, float cornerRadius, UIQuadKind kind)
+		: box(_box)
+		, tint(_tint)
+		, uvRect(_uvRect)
+		, params(cornerRadius, (float)kind, 0, 0)
+	{}
+};
+
+// a run of consecutive instances sharing the same program and texture, drawn with a single instanced draw call
+struct UIDrawBatch
+{
+	ShaderProgram* program;
+	Texture* texture;
+	unsigned int firstInstance;
+	unsigned int instanceCount;
+
+	UIDrawBatch(ShaderProgram* _program = nullptr, Texture* _texture = nullptr, unsigned int _firstInstance = 0, unsigned int _instanceCount = 0)
+		: program(_program)
+		, texture(_texture)
+		, firstInstance(_firstInstance)
+		, instanceCount(_instanceCount)
+	{}
+};
+
+// Backend used by the UIEngine to submit the batched quads.
+// The instances are uploaded once, then only the modified ones are updated. Each batch is drawn from this upload.
+// The batches are drawn into a surface retained between frames, which is presented on the current framebuffer.
+class IUIDrawer
+{
+public:
+	virtual ~IUIDrawer()
+	{}
+
+	// only the scissor rect of the retained surface is cleared and drawn again, or all of it if scissorRect is null
+	virtual void beginFrame(const glm::vec2& viewportSize, const Rect* scissorRect) = 0;
+	virtual void uploadInstances(const UIQuadInstance* instances, unsigned int instanceCount) = 0;
+	// replace a part of the uploaded instances, the instance count doesn't change
+	virtual void updateInstances(unsigned int firstInstance, const UIQuadInstance* instances, unsigned int instanceCount) = 0;
+	virtual void drawBatch(const UIDrawBatch& batch) = 0;
+	virtual void endFrame() = 0;
+	// draw the retained surface on the current framebuffer, even if nothing has been drawn since the last frame
+	virtual void present() = 0;
+	// false if the drawer samples the pixels of the textures on the CPU, the engine then never pushes its textures to the GPU
+	virtual bool usesGPUTextures() const
+	{
+		return true;
+	}
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Draw the batches with instanced draw calls on a unit quad.
+// The batches are drawn into an offscreen surface, because the default framebuffer content is lost after each swap.
+// The surface stores premultiplied colors and is blended over the application frame by present().
+class GLUIDrawer final : public IUIDrawer
+{
+private:
+	GLuint m_vao;
+	GLuint m_quadVbo;
+	GLuint m_quadIbo;
+	GLuint m_instanceVbo;
+	unsigned int m_instanceCapacity;
+
+	// retained surface
+	GLuint m_surfaceFramebuffer;
+	GLuint m_surfaceTexture;
+	glm::ivec2 m_surfaceSize;
+	GLuint m_presentVao;
+	std::unique_ptr<ShaderProgram> m_presentProgram;
+
+	// application state, restored at the end of the frame
+	GLint m_previousFramebuffer;
+	GLint m_previousViewport[4];
+	GLfloat m_previousClearColor[4];
+
+	glm::vec2 m_viewportSize;
+	ShaderProgram* m_boundProgram;
+	Texture* m_boundTexture;
+
+public:
+	GLUIDrawer();
+	virtual ~GLUIDrawer();
+
+	virtual void beginFrame(const glm::vec2& viewportSize, const Rect* scissorRect) override;
+	virtual void uploadInstances(const UIQuadInstance* instances, unsigned int instanceCount) override;
+	virtual void updateInstances(unsigned int firstInstance, const UIQuadInstance* instances, unsigned int instanceCount) override;
+	virtual void drawBatch(const UIDrawBatch& batch) override;
+	virtual void endFrame() override;
+	virtual void present() override;
+
+private:
+	void setInstanceAttributesOffset(unsigned int firstInstance);
+	void resizeSurface(const glm::ivec2& size);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Rasterize the batches on the CPU into a retained RGBA surface, for the tests and the machines without GPU.
+// The quads are drawn like the shaders of GLUIDrawer : rounded boxes, images and glyphs, blended as premultiplied colors.
+// The kind of a quad is read from its instance, the programs of the batches are ignored.
+// Each row of a quad is blended as a span : the antialiased ends one pixel at a time, the fully covered middle 4 pixels at a time with SSE2.
+class SoftwareUIDrawer final : public IUIDrawer
+{
+private:
+	// premultiplied RGBA, rows from the top
+	std::vector<unsigned char> m_surface;
+	glm::ivec2 m_surfaceSize;
+	std::vector<UIQuadInstance> m_instances;
+	// pixels drawn by the current frame, [min, max)
+	glm::ivec2 m_clipMin;
+	glm::ivec2 m_clipMax;
+
+	unsigned int m_frameCount;
+	unsigned int m_drawCallCount;
+	size_t m_blendedPixelCount;
+
+public:
+	SoftwareUIDrawer();
+
+	virtual void beginFrame(const glm::vec2& viewportSize, const Rect* scissorRect) override;
+	virtual void uploadInstances(const UIQuadInstance* instances, unsigned int instanceCount) override;
+	virtual void updateInstances(unsigned int firstInstance, const UIQuadInstance* instances, unsigned int instanceCount) override;
+	virtual void drawBatch(const UIDrawBatch& batch) override;
+	virtual void endFrame() override;
+	// the surface is the result, there is nothing to present
+	virtual void present() override
+	{}
+	virtual bool usesGPUTextures() const override
+	{
+		return false;
+	}
+
+	const std::vector<unsigned char>& getSurface() const
+	{
+		return m_surface;
+	}
+	const glm::ivec2& getSurfaceSize() const
+	{
+		return m_surfaceSize;
+	}
+
+	// golden images, stored as drawn (premultiplied) in the PAM format
+	bool saveSurface(const std::string& fileName) const;
+	// number of pixels with a channel further than tolerance from the image, -1 if it can't be read or hasn't the size of the surface
+	int compareSurface(const std::string& fileName, int tolerance) const;
+
+	// counters, accumulated since the last reset
+	unsigned int getFrameCount() const
+	{
+		return m_frameCount;
+	}
+	unsigned int getDrawCallCount() const
+	{
+		return m_drawCallCount;
+	}
+	size_t getBlendedPixelCount() const
+	{
+		return m_blendedPixelCount;
+	}
+	void resetCounters()
+	{
+		m_frameCount = 0;
+		m_drawCallCount = 0;
+		m_blendedPixelCount = 0;
+	}
+
+private:
+	void resizeSurface(const glm::ivec2& size);
+	void drawQuad(const UIQuadInstance& instance, const Texture* texture);
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Doesn't draw anything, only record the submitted batches and count the draw calls.
+// Used to check the batching without any opengl context.
+class RecordingUIDrawer final : public IUIDrawer
+{
+private:
+	std::vector<UIDrawBatch> m_recordedBatches;
+	std::vector<UIQuadInstance> m_recordedInstances;
+
+	unsigned int m_frameCount;
+	unsigned int m_drawCallCount;
+	unsigned int m_programBindCount;
+	unsigned int m_textureBindCount;
+	unsigned int m_uploadCount;
+	unsigned int m_partialUploadCount;
+	unsigned int m_presentCount;
+	bool m_lastFrameScissored;
+	Rect m_lastScissorRect;
+
+	ShaderProgram* m_boundProgram;
+	Texture* m_boundTexture;
+
+public:
+	RecordingUIDrawer()
+		: m_frameCount(0)
+		, m_drawCallCount(0)
+		, m_programBindCount(0)
+		, m_textureBindCount(0)
+		, m_uploadCount(0)
+		, m_partialUploadCount(0)
+		, m_presentCount(0)
+		, m_lastFrameScissored(false)
+		, m_boundProgram(nullptr)
+		, m_boundTexture(nullptr)
+	{}
+
+	virtual void beginFrame(const glm::vec2& viewportSize, const Rect* scissorRect) override
+	{
+		// the instances are kept, like the uploaded buffer
+		m_recordedBatches.clear();
+		m_boundProgram = nullptr;
+		m_boundTexture = nullptr;
+
+		m_lastFrameScissored = scissorRect != nullptr;
+		m_lastScissorRect = scissorRect != nullptr ? *scissorRect : Rect(glm::vec2(0, 0), viewportSize);
+	}
+	virtual void uploadInstances(const UIQuadInstance* instances, unsigned int instanceCount) override
+	{
+		m_recordedInstances.assign(instances, instances + instanceCount);
+		m_uploadCount++;
+	}
+	virtual void updateInstances(unsigned int firstInstance, const UIQuadInstance* instances, unsigned int instanceCount) override
+	{
+		std::copy(instances, instances + instanceCount, m_recordedInstances.begin() + firstInstance);
+		m_partialUploadCount++;
+	}
+	virtual void drawBatch(const UIDrawBatch& batch) override
+	{
+		if (batch.program != m_boundProgram)
+		{
+			m_boundProgram = batch.program;
+			m_programBindCount++;
+		}
+		if (batch.texture != m_boundTexture)
+		{
+			m_boundTexture = batch.texture;
+			m_textureBindCount++;
+		}
+
+		m_recordedBatches.push_back(batch);
+		m_drawCallCount++;
+	}
+	virtual void endFrame() override
+	{
+		m_frameCount++;
+	}
+	virtual void present() override
+	{
+		m_presentCount++;
+	}
+
+	// last drawn frame
+	const std::vector<UIDrawBatch>& getRecordedBatches() const
+	{
+		return m_recordedBatches;
+	}
+	const std::vector<UIQuadInstance>& getRecordedInstances() const
+	{
+		return m_recordedInstances;
+	}
+	bool isLastFrameScissored() const
+	{
+		return m_lastFrameScissored;
+	}
+	const Rect& getLastScissorRect() const
+	{
+		return m_lastScissorRect;
+	}
+
+	// counters, accumulated since the last reset
+	unsigned int getFrameCount() const
+	{
+		return m_frameCount;
+	}
+	unsigned int getDrawCallCount() const
+	{
+		return m_drawCallCount;
+	}
+	unsigned int getProgramBindCount() const
+	{
+		return m_programBindCount;
+	}
+	unsigned int getTextureBindCount() const
+	{
+		return m_textureBindCount;
+	}
+	unsigned int getUploadCount() const
+	{
+		return m_uploadCount;
+	}
+	unsigned int getPartialUploadCount() const
+	{
+		return m_partialUploadCount;
+	}
+	// a frame without damage is presented without being drawn
+	unsigned int getPresentCount() const
+	{
+		return m_presentCount;
+	}
+	void resetCounters()
+	{
+		m_frameCount = 0;
+		m_drawCallCount = 0;
+		m_programBindCount = 0;
+		m_textureBindCount = 0;
+		m_uploadCount = 0;
+		m_partialUploadCount = 0;
+		m_presentCount = 0;
+	}
+};
@@ -1,10 +1,20 @@
 #pragma once
 
 #include <map>
+#include <cstdlib>
+#include <atomic>
 
 #include "Widget.h"
 #include "WidgetLayer.h"
 #include "EmptyWidget.h"
+#include "UIDrawer.h"
+#include "UIBatchRenderer.h"
+#include "UIHitTestGrid.h"
+#include "ObjectPool.h"
+#include "UILayoutNodes.h"
+#include "UIParallelLayout.h"
+#include "UIInputQueue.h"
+#include "UIProfiler.h"
 
 class UIEngine
 {
@@ -14,52 +24,110 @@ private:
 	std::shared_ptr<ShaderProgram> m_UIWidgetProgram;
 	std::shared_ptr<ShaderProgram> m_UIWidgetImageProgram;
 	std::shared_ptr<ShaderProgram> m_UIWidgetTextProgram;
+	// Items allocation, the factories allocate the widgets and layers from the pools
+	std::shared_ptr<ObjectPools> m_objectPools;
 	// Factories
 	std::map<std::string, std::function<std::shared_ptr<UIItem>()>> m_itemFactory;
 	std::map<std::string, std::function<std::shared_ptr<Widget>()>> m_widgetFactory;
 	std::map<std::string, std::function<std::shared_ptr<BaseWidgetLayer>()>> m_layerFactory;
 	// Fonts
 	FontFactory m_fontFactory;
+	// Textures
+	TextureLoader m_textureLoader;
+	std::shared_ptr<Texture> m_placeholderTexture;
+	std::vector<ImageWidget*> m_pendingTextureWidgets;
+	TextureAtlas m_iconAtlas;
+	// Text
+	TextRunCache m_textRunCache;
+	// Rendering
+	std::unique_ptr<IUIDrawer> m_drawer;
+	UIBatchRenderer m_batchRenderer;
+
+	// Hit tests, declared before the widgets so it outlives them
+	UIHitTestGrid m_hitTestGrid;
+	// Layout state of the widgets, declared before the widgets too
+	UILayoutNodes m_layoutNodes;
 
 	// Current displayed items
 	//std::multimap<int, std::shared_ptr<BaseWidgetLayer>> m_layers;
 	std::unique_ptr<ViewportWidget> m_rootViewportWidget;
+	// Layout, requested from the layout threads too
+	std::atomic<bool> m_layoutRequested;
+	UIParallelLayout m_parallelLayout;
+	UILayoutRecord m_layoutRecord;
+
+	// Inputs, pushed by the window callbacks and processed once per frame
+	UIInputQueue m_inputQueue;
+
+	// Timings and counters of the last frames
+	UIProfiler m_profiler;
 
 	// Special item handling
+	// the focused item, it receives the keys first
 	UIItem* m_selectedItem;
+	// receives the mouse events without hit test until the buttons are released
+	UIItem* m_pointerCaptureItem;
 	std::vector<UIItem*> m_pressedItems;
+	std::vector<UIItem*> m_hoveredItems;
 	UIItem* m_draggedItem;
 
 	glm::vec2 m_lastMousePressedPos;
 	glm::vec2 m_mousePos;
 
 public:
-	UIEngine()
+	// Without drawer, the engine draws with opengl and needs a current context.
+	// With a drawer which doesn't use opengl (SoftwareUIDrawer), the engine doesn't make any opengl call :
+	// its textures only keep their pixels on the CPU, see Texture::setCPUOnly.
+	// The fonts are shared by the engines, they follow Texture::setGPUEnabled
+	explicit UIEngine(std::unique_ptr<IUIDrawer> drawer = nullptr)
 	{
+		m_layoutRequested = true;
+		m_objectPools = std::make_shared<ObjectPools>();
+		m_selectedItem = nullptr;
+		m_pointerCaptureItem = nullptr;
+		m_draggedItem = nullptr;
 		m_rootViewportWidget = std::make_unique<ViewportWidget>(this);
 
 		// init resources
-		m_rectShape = std::make_shared<VAO>();
-		m_rectShape->setDatas(vertices, indices);
+		// the programs only identify the quad kinds of the batches for the other drawers
 		m_UIWidgetProgram = std::make_shared<ShaderProgram>();
-		m_UIWidgetProgram->load("resources/shaders/UIWidget.vert", "resources/shaders/UIWidget.frag");
 		m_UIWidgetImageProgram = std::make_shared<ShaderProgram>();
-		m_UIWidgetImageProgram->load("resources/shaders/UIImageWidget.vert", "resources/shaders/UIImageWidget.frag");
 		m_UIWidgetTextProgram = std::make_shared<ShaderProgram>();
-		m_UIWidgetTextProgram->load("resources/shaders/UITextWidget.vert", "resources/shaders/UITextWidget.frag");
+		if (drawer == nullptr)
+		{
+			m_rectShape = std::make_shared<VAO>();
+			m_rectShape->setDatas(vertices, indices);
+			// all the widget programs share the instanced vertex shader
+			m_UIWidgetProgram->load("resources/shaders/UIBatch.vert", "resources/shaders/UIWidgetBatch.frag");
+			m_UIWidgetImageProgram->load("resources/shaders/UIBatch.vert", "resources/shaders/UIImageWidgetBatch.frag");
+			m_UIWidgetTextProgram->load("resources/shaders/UIBatch.vert", "resources/shaders/UITextWidgetBatch.frag");
+			m_drawer = std::make_unique<GLUIDrawer>();
+		}
+		else
+		{
+			m_drawer = std::move(drawer);
+		}
+		updateTexturesCPUOnly();
+		// a grey pixel, drawn by the image widgets until their texture is loaded
+		unsigned char* placeholderPixels = (unsigned char*)std::malloc(3);
+		std::fill(placeholderPixels, placeholderPixels + 3, (unsigned char)128);
+		m_placeholderTexture = std::make_shared<Texture>();
+		m_placeholderTexture->setCPUOnly(!m_drawer->usesGPUTextures());
+		m_placeholderTexture->create(1, 1, placeholderPixels, { { GL_TEXTURE_MIN_FILTER, GL_NEAREST },{ GL_TEXTURE_MAG_FILTER, GL_NEAREST } }, GL_RGB, GL_RGB, GL_UNSIGNED_BYTE);
 
 		// init factories
-		m_widgetFactory["EmptyWidget"] = [this]() { return std::make_shared<EmptyWidget>(this, this->getRectShape(), this->getUIWidgetProgram()); };
-		m_widgetFactory["ImageWidget"] = [this]() { return std::make_shared<ImageWidget>(this, this->getRectShape(), this->getUIWidgetImageProgram()); };
-		m_widgetFactory["TextWidget"] = [this]() { return std::make_shared<TextWidget>(this, this->getRectShape(), this->getUIWidgetTextProgram()); };
-		m_widgetFactory["TextInputWidget"] = [this]() { return std::make_shared<TextInputWidget>(this, this->getRectShape(), this->getUIWidgetTextProgram(), this->getUIWidgetProgram()); };
-		m_widgetFactory["ButtonWidget"] = [this]() { return std::make_shared<ButtonWidget>(this, this->getRectShape(), this->getUIWidgetProgram()); };
-		m_widgetFactory["DropDownWidget"] = [this]() { return std::make_shared<DropDownWidget>(this, this->getRectShape(), this->getUIWidgetProgram()); };
-
-		m_layerFactory["Raw"] = [this]() { return std::make_shared<RawLayer>(this); };
-		m_layerFactory["Canvas"] = [this]() { return std::make_shared<CanvasLayer>(this); };
-		m_layerFactory["HorizontalList"] = [this]() { return std::make_shared<HorizontalListLayer>(this); };
-		m_layerFactory["VerticalList"] = [this]() { return std::make_shared<VerticalListLayer>(this); };
+		m_widgetFactory["EmptyWidget"] = [this]() { return std::allocate_shared<EmptyWidget>(this->getObjectAllocator(), this, this->getRectShape(), this->getUIWidgetProgram()); };
+		m_widgetFactory["ImageWidget"] = [this]() { return std::allocate_shared<ImageWidget>(this->getObjectAllocator(), this, this->getRectShape(), this->getUIWidgetImageProgram()); };
+		m_widgetFactory["TextWidget"] = [this]() { return std::allocate_shared<TextWidget>(this->getObjectAllocator(), this, this->getRectShape(), this->getUIWidgetTextProgram()); };
+		m_widgetFactory["TextInputWidget"] = [this]() { return std::allocate_shared<TextInputWidget>(this->getObjectAllocator(), this, this->getRectShape(), this->getUIWidgetTextProgram(), this->getUIWidgetProgram()); };
+		m_widgetFactory["ButtonWidget"] = [this]() { return std::allocate_shared<ButtonWidget>(this->getObjectAllocator(), this, this->getRectShape(), this->getUIWidgetProgram()); };
+		m_widgetFactory["DropDownWidget"] = [this]() { return std::allocate_shared<DropDownWidget>(this->getObjectAllocator(), this, this->getRectShape(), this->getUIWidgetProgram()); };
+
+		m_layerFactory["Raw"] = [this]() { return std::allocate_shared<RawLayer>(this->getObjectAllocator(), this); };
+		m_layerFactory["Canvas"] = [this]() { return std::allocate_shared<CanvasLayer>(this->getObjectAllocator(), this); };
+		m_layerFactory["HorizontalList"] = [this]() { return std::allocate_shared<HorizontalListLayer>(this->getObjectAllocator(), this); };
+		m_layerFactory["VerticalList"] = [this]() { return std::allocate_shared<VerticalListLayer>(this->getObjectAllocator(), this); };
+		m_layerFactory["VirtualList"] = [this]() { return std::allocate_shared<VirtualListLayer>(this->getObjectAllocator(), this); };
 	}
 
 	ViewportWidget* getRootViewportWidget()
@@ -67,6 +135,30 @@ public:
 		return m_rootViewportWidget.get();
 	}
 
+	// items allocation
+	// allocator of the widgets, slots and layers, to use with std::allocate_shared
+	PoolAllocator<char> getObjectAllocator() const
+	{
+		return PoolAllocator<char>(m_objectPools);
+	}
+	// only the next items are affected, the disabled pools stay alive until their last item is destroyed
+	void setObjectPoolingEnabled(bool isEnabled)
+	{
+		if (isEnabled && m_objectPools == nullptr)
+			m_objectPools = std::make_shared<ObjectPools>();
+		else if (!isEnabled)
+			m_objectPools = nullptr;
+	}
+	bool isObjectPoolingEnabled() const
+	{
+		return m_objectPools != nullptr;
+	}
+	// null if the pooling is disabled
+	const ObjectPools* getObjectPools() const
+	{
+		return m_objectPools.get();
+	}
+
 	// factories instantiation
 	std::shared_ptr<UIItem> instantiateUIItem(const std::string& itemTypeName)
 	{
@@ -139,20 +231,225 @@ public:
 	{
 		return m_fontFactory;
 	}
+	TextureLoader& getTextureLoader()
+	{
+		return m_textureLoader;
+	}
+	Texture* getPlaceholderTexture() const
+	{
+		return m_placeholderTexture.get();
+	}
+	// the small images shared by many widgets (toolbar icons,...) should be loaded here
+	TextureAtlas& getIconAtlas()
+	{
+		return m_iconAtlas;
+	}
+	TextRunCache& getTextRunCache()
+	{
+		return m_textRunCache;
+	}
+
+	// textures
+	// the widget is polled each frame until its texture is ready
+	void watchPendingTexture(ImageWidget* widget)
+	{
+		if (std::find(m_pendingTextureWidgets.begin(), m_pendingTextureWidgets.end(), widget) == m_pendingTextureWidgets.end())
+			m_pendingTextureWidgets.push_back(widget);
+	}
+	// upload the textures decoded since the last frame, within the loader budget, and give them to their widgets
+	void updatePendingTextures()
+	{
+		m_textureLoader.processUploads();
+
+		// the failed loadings are done too, they don't need any upload
+		auto isDone = [](ImageWidget* widget) { return widget->updatePendingTexture(); };
+		m_pendingTextureWidgets.erase(std::remove_if(m_pendingTextureWidgets.begin(), m_pendingTextureWidgets.end(), isDone), m_pendingTextureWidgets.end());
+	}
+
+	// drawer
+	// replace the backend used to submit the batches (ex : a RecordingUIDrawer to count the draw calls)
+	// the textures already pushed to the GPU stay there, the next ones follow the new drawer
+	void setDrawer(std::unique_ptr<IUIDrawer> drawer)
+	{
+		m_drawer = std::move(drawer);
+		updateTexturesCPUOnly();
+		// the new drawer doesn't have the instances and the surface of the previous one
+		m_batchRenderer.invalidateDrawList();
+	}
+	IUIDrawer* getDrawer() const
+	{
+		return m_drawer.get();
+	}
+private:
+	// the textures of the engine are only pushed to the GPU if its drawer samples them there
+	void updateTexturesCPUOnly()
+	{
+		const bool isCPUOnly = !m_drawer->usesGPUTextures();
+		m_textureLoader.setCPUOnly(isCPUOnly);
+		m_iconAtlas.setCPUOnly(isCPUOnly);
+	}
+public:
+	const UIBatchRenderer& getBatchRenderer() const
+	{
+		return m_batchRenderer;
+	}
 	
-	// render all items
-	void renderUI(const glm::vec2& viewportSize)
+	// hit tests
+	UIHitTestGrid& getHitTestGrid()
+	{
+		return m_hitTestGrid;
+	}
+	const UIHitTestGrid& getHitTestGrid() const
+	{
+		return m_hitTestGrid;
+	}
+	UILayoutNodes& getLayoutNodes()
+	{
+		return m_layoutNodes;
+	}
+	const UILayoutNodes& getLayoutNodes() const
+	{
+		return m_layoutNodes;
+	}
+
+	// layout
+	// the widgets modifications only mark them as dirty and request a layout
+	void requestLayout()
+	{
+		m_layoutRequested = true;
+	}
+	bool isLayoutRequested() const
+	{
+		return m_layoutRequested;
+	}
+	// the big independent subtrees are laid out on threadCount threads, see UIParallelLayout.
+	// One thread per hardware thread if threadCount is 0, sequential layout with 1 (the default)
+	void setParallelLayoutThreadCount(unsigned int threadCount)
+	{
+		m_parallelLayout.setThreadCount(threadCount);
+	}
+	unsigned int getParallelLayoutThreadCount() const
+	{
+		return m_parallelLayout.getThreadCount();
+	}
+	UIParallelLayout& getParallelLayout()
+	{
+		return m_parallelLayout;
+	}
+	// during a parallel pass, keep the layers which can't be arranged on a layout thread for the end of the pass
+	bool deferLayerLayout(BaseWidgetLayer* layer)
+	{
+		UILayoutRecord* record = UIParallelLayout::getCurrentRecord();
+		if (record == nullptr || layer->canArrangeInParallel())
+			return false;
+
+		record->deferredLayers.push_back(layer);
+		return true;
+	}
+	// one layout pass for all the modifications since the last one, only the dirty widgets are visited
+	void updateLayout()
+	{
+		if (!m_layoutRequested)
+			return;
+
+		{
+			UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::LAYOUT);
+			if (m_parallelLayout.isEnabled())
+				updateLayoutInParallel();
+			else
+				m_rootViewportWidget->updateLayout();
+		}
+
+		// the subtrees of the moved widgets are placed in one sweep, in tree order
+		UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::POSITIONS);
+		if (m_layoutNodes.isOrderDirty())
+			m_layoutNodes.sortNodes<WidgetBase>(m_rootViewportWidget.get());
+		m_layoutNodes.updatePositions();
+		for (int layoutHandle : m_layoutNodes.getChangedHandles())
+		{
+			WidgetBase* widget = m_layoutNodes.getOwner(layoutHandle);
+
+			// the root isn't hit tested, only the widgets inside it
+			if (widget->getOwningLayer() != nullptr)
+				m_hitTestGrid.updateItem(widget, widget->getComputedBounds());
+
+			// the quads are built from the bounds
+			widget->invalidateDraw();
+		}
+
+		// the widgets moved by the pass request a layout too, they are already up to date
+		m_layoutRequested = false;
+	}
+
+	// damage
+	// the widgets modifications only mark the widgets whose quads have changed, see UIBatchRenderer
+	void damageItem(const UIItem* item)
+	{
+		if (UILayoutRecord* record = UIParallelLayout::getCurrentRecord())
+			record->damagedItems.push_back(item);
+		else
+			m_batchRenderer.damageItem(item);
+	}
+	void invalidateDrawList()
+	{
+		m_batchRenderer.invalidateDrawList();
+	}
+	// slots have been added or removed : the layout nodes are sorted again, and the draw list recorded again
+	void invalidateHierarchy()
+	{
+		m_layoutNodes.invalidateOrder();
+		m_batchRenderer.invalidateDrawList();
+	}
+	// false if the last rendered frame is still up to date, the application can wait for the next event
+	bool needsRedraw()
 	{
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		// the inputs and the layout pass can damage the widgets
+		processInputEvents();
+		updateLayout();
 
-		ShaderProgram* currentBoundProgram = nullptr;
+		// keep rendering while the textures are loading, each frame uploads a part of them
+		return m_batchRenderer.hasPendingChanges() || m_textureLoader.hasPendingLoads();
+	}
 
-		m_rootViewportWidget->draw(&currentBoundProgram, viewportSize);
+	// render all items
+	// the widgets only submit quads, which are merged into one instanced draw per (program, texture) run.
+	// The quads are retained between frames, only the damaged part of the UI is recorded and drawn again.
+	void renderUI(const glm::vec2& viewportSize)
+	{
+		{
+			UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::FRAME);
+			processInputEvents();
+			{
+				// the widgets whose texture is ready are damaged
+				UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::TEXTURE_UPLOAD);
+				updatePendingTextures();
+			}
+			updateLayout();
 
-		currentBoundProgram = nullptr;
+			{
+				UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::RECORD);
+				m_batchRenderer.update(*m_rootViewportWidget, viewportSize);
+			}
+			{
+				// the glyphs used for the first time have been packed during the layout or the recording
+				UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::TEXTURE_UPLOAD);
+				m_fontFactory.uploadDirtyAtlases();
+				m_iconAtlas.uploadDirtyPages();
+			}
+			{
+				UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::SUBMIT);
+				m_batchRenderer.draw(m_drawer.get());
+			}
+		}
+		// the work done by needsRedraw since the last frame is counted in this one
+		UIENGINE_PROFILE_END_FRAME(m_profiler);
+	}
 
-		glDisable(GL_BLEND);
+	// profiling
+	// the stats of the last frames, and the trace capture. Empty if UIENGINE_PROFILING is 0
+	UIProfiler& getProfiler()
+	{
+		return m_profiler;
 	}
 
 	// item handling
@@ -162,8 +459,45 @@ public:
 	//}
 
 	// input handling
+	// the window callbacks push their events here, instead of calling the handle functions below
+	UIInputQueue& getInputQueue()
+	{
+		return m_inputQueue;
+	}
+	// dispatch the events pushed since the last frame, called before the layout pass by needsRedraw and renderUI
+	void processInputEvents()
+	{
+		UIENGINE_PROFILE_SCOPE(m_profiler, UIProfilePhase::INPUT);
+		for (const UIInputEvent& event : m_inputQueue.takeEvents())
+		{
+			switch (event.type)
+			{
+			case UIInputEventType::MOUSE_MOVE:
+				handleMouseMove(event.mousePos);
+				break;
+			case UIInputEventType::MOUSE_BUTTON_PRESSED:
+				handleMouseButtonPressed((int)event.code, event.mousePos);
+				break;
+			case UIInputEventType::MOUSE_BUTTON_RELEASED:
+				handleMouseButtonReleased((int)event.code, event.mousePos);
+				break;
+			case UIInputEventType::KEY_PRESSED:
+				handleKeyPressed((int)event.code);
+				break;
+			case UIInputEventType::KEY_RELEASED:
+				handleKeyReleased((int)event.code);
+				break;
+			case UIInputEventType::CHARACTER:
+				handleCharacter(event.code);
+				break;
+			}
+		}
+	}
 	void handleMouseMove(const glm::vec2 mousePos)
 	{
+		// hit tests need up to date bounds
+		updateLayout();
+
 		m_mousePos = mousePos;
 
 		// detect the drag
@@ -181,20 +515,31 @@ public:
 		else
 		{
 			m_draggedItem->onDrag(m_mousePos);
+			// the drop targets are still hit tested
 			m_rootViewportWidget->handleDragOver(m_mousePos);
 		}
 
 		// handle mouse movements
-		m_rootViewportWidget->handleMouseMove(mousePos);
+		if (m_pointerCaptureItem != nullptr)
+			m_pointerCaptureItem->onMouseMove(mousePos);
+		else
+			m_rootViewportWidget->handleMouseMove(mousePos);
 	}
 	void handleMouseButtonPressed(int button, const glm::vec2 mousePos)
 	{
+		updateLayout();
+
 		m_lastMousePressedPos = mousePos;
 
-		m_rootViewportWidget->handleMouseButtonPressed(button, mousePos);
+		if (m_pointerCaptureItem != nullptr)
+			m_pointerCaptureItem->onMouseButtonPressed(button, mousePos);
+		else
+			m_rootViewportWidget->handleMouseButtonPressed(button, mousePos);
 	}
 	void handleMouseButtonReleased(int button, const glm::vec2 mousePos)
 	{
+		updateLayout();
+
 		// detect drag end
 		if (isDraggingItem())
 		{
@@ -203,22 +548,63 @@ public:
 		}
 
 		// handle mouse button released
-		m_rootViewportWidget->handleMouseButtonReleased(button, mousePos);
+		if (m_pointerCaptureItem != nullptr)
+			m_pointerCaptureItem->onMouseButtonReleased(button, mousePos);
+		else
+			m_rootViewportWidget->handleMouseButtonReleased(button, mousePos);
 		// clear after we have handle the release event
 		clearPressedItems();
+		releasePointerCapture();
 	}
 
+	// the keys only visit the focus chain, not the whole tree
 	void handleKeyPressed(int key)
 	{
-		m_rootViewportWidget->handleKeyPressed(key);
+		dispatchToFocusChain([key](UIItem* item) { return item->onKeyPressed(key); });
 	}
 	void handleKeyReleased(int key)
 	{
-		m_rootViewportWidget->handleKeyReleased(key);
+		dispatchToFocusChain([key](UIItem* item) { return item->onKeyReleased(key); });
 	}
 	void handleCharacter(unsigned int codepoint)
 	{
-		m_rootViewportWidget->handleCharacter(codepoint);
+		dispatchToFocusChain([codepoint](UIItem* item) { return item->onCharacter(codepoint); });
+	}
+	// the selected item, then its parents up to the root viewport, until one of them handles the event.
+	// Without selected item, only the root viewport gets the event
+	template<typename Function>
+	bool dispatchToFocusChain(Function function)
+	{
+		UIItem* focusedItem = m_selectedItem != nullptr ? m_selectedItem : m_rootViewportWidget.get();
+
+		// like the broadcast did, an item under a hidden parent doesn't receive the keys
+		for (UIItem* item = focusedItem; item != nullptr; item = item->getParentItem())
+		{
+			if (!item->isInputEnabled())
+				return false;
+		}
+		for (UIItem* item = focusedItem; item != nullptr; item = item->getParentItem())
+		{
+			if (item->isSelfInputEnabled() && function(item))
+				return true;
+		}
+		return false;
+	}
+
+	// pointer capture
+	// an item which follows the mouse once pressed (a slider, a scroll bar) captures it from its onMouseButtonPressed :
+	// the mouse events go to it without hit test, until the buttons are released
+	void capturePointer(UIItem* item)
+	{
+		m_pointerCaptureItem = item;
+	}
+	void releasePointerCapture()
+	{
+		m_pointerCaptureItem = nullptr;
+	}
+	UIItem* getPointerCaptureItem() const
+	{
+		return m_pointerCaptureItem;
 	}
 
 	// selection
@@ -262,6 +648,16 @@ public:
 		m_pressedItems.push_back(item);
 	}
 
+	// items under the cursor after the last mouse move
+	const std::vector<UIItem*>& getHoveredItems() const
+	{
+		return m_hoveredItems;
+	}
+	std::vector<UIItem*>& getHoveredItemsForWrite()
+	{
+		return m_hoveredItems;
+	}
+
 	bool isDraggingItem() const
 	{
 		return m_draggedItem != nullptr;
@@ -281,6 +677,7 @@ public:
 	{
 		if (m_draggedItem != nullptr)
 			m_draggedItem->onDragEnd(m_mousePos);
+		m_draggedItem = nullptr;
 	}
 	UIItem* getDraggedItem() const
 	{
@@ -291,10 +688,56 @@ public:
 	{
 		if (destroyedItem == m_selectedItem)
 			deselectItem();
-		auto& found = std::find(m_pressedItems.begin(), m_pressedItems.end(), destroyedItem);
+		if (destroyedItem == m_pointerCaptureItem)
+			releasePointerCapture();
+		if (destroyedItem == m_draggedItem)
+			m_draggedItem = nullptr;
+		auto found = std::find(m_pressedItems.begin(), m_pressedItems.end(), destroyedItem);
 		if (found != m_pressedItems.end())
 		{
 			m_pressedItems.erase(found);
 		}
+		auto foundHovered = std::find(m_hoveredItems.begin(), m_hoveredItems.end(), destroyedItem);
+		if (foundHovered != m_hoveredItems.end())
+		{
+			m_hoveredItems.erase(foundHovered);
+		}
+		m_batchRenderer.forgetItem(destroyedItem);
+		auto foundPendingTexture = std::find_if(m_pendingTextureWidgets.begin(), m_pendingTextureWidgets.end(), [destroyedItem](ImageWidget* widget) { return static_cast<UIItem*>(widget) == destroyedItem; });
+		if (foundPendingTexture != m_pendingTextureWidgets.end())
+		{
+			m_pendingTextureWidgets.erase(foundPendingTexture);
+		}
+	}
+
+private:
+	// the layout threads only record what they change outside of their subtree, applied here in slot order
+	void updateLayoutInParallel()
+	{
+		m_layoutRecord.clear();
+		UIParallelLayout::getCurrentRecord() = &m_layoutRecord;
+		m_rootViewportWidget->updateLayout();
+		UIParallelLayout::getCurrentRecord() = nullptr;
+		UIENGINE_PROFILE_COUNT(UIProfileCounter::LAYOUT_NODES, m_layoutRecord.layoutNodeCount);
+
+		for (int layoutHandle : m_layoutRecord.movedHandles)
+		{
+			m_layoutNodes.markMoved(layoutHandle);
+		}
+		for (WidgetBase* widget : m_layoutRecord.resizedWidgets)
+		{
+			if (widget->getOwningLayer() != nullptr)
+				m_hitTestGrid.updateItem(widget, widget->getComputedBounds());
+		}
+		for (const UIItem* item : m_layoutRecord.damagedItems)
+		{
+			m_batchRenderer.damageItem(item);
+		}
+		// their subtrees are laid out in sequence
+		for (BaseWidgetLayer* layer : m_layoutRecord.deferredLayers)
+		{
+			layer->arrangeSlots();
+			layer->updateSlotsRecur();
+		}
 	}
 };
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include "glm/glm.hpp"
+#include "Utils.h"
+
+class UIItem;
+
+// Uniform grid over the viewport, used to find the items under the cursor without visiting the whole widget tree.
+// Each item is referenced by all the cells overlapped by its bounds. The items outside the viewport are clamped to the border cells.
+// The grid only knows the bounds, the visibility rules are applied by the caller on the returned candidates.
+class UIHitTestGrid
+{
+private:
+	struct CellRange
+	{
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+
+		CellRange(int _minX = 0, int _minY = 0, int _maxX = -1, int _maxY = -1)
+			: minX(_minX)
+			, minY(_minY)
+			, maxX(_maxX)
+			, maxY(_maxY)
+		{}
+	};
+
+	struct CellEntry
+	{
+		UIItem* item;
+		Rect bounds;
+
+		CellEntry(UIItem* _item, const Rect& _bounds)
+			: item(_item)
+			, bounds(_bounds)
+		{}
+	};
+
+	float m_cellSize;
+	Rect m_bounds;
+	int m_cellCountX;
+	int m_cellCountY;
+	std::vector<std::vector<CellEntry>> m_cells;
+
+	// the cells used by each item, to remove it without searching all the cells
+	std::unordered_map<const UIItem*, CellRange> m_itemCells;
+
+public:
+	UIHitTestGrid(float cellSize = 64.0f)
+		: m_cellSize(cellSize)
+		, m_bounds(0, 0, 0, 0)
+		, m_cellCountX(1)
+		, m_cellCountY(1)
+		, m_cells(1)
+	{}
+
+	// area covered by the cells, all the items are dispatched again if it changes
+	void setBounds(const Rect& bounds)
+	{
+		if (bounds.pos == m_bounds.pos && bounds.extent == m_bounds.extent)
+			return;
+
+		// keep the items with their bounds
+		std::vector<CellEntry> entries;
+		entries.reserve(m_itemCells.size());
+		for (const auto& itemCells : m_itemCells)
+		{
+			const auto& cell = m_cells[itemCells.second.minY * m_cellCountX + itemCells.second.minX];
+			auto found = std::find_if(cell.begin(), cell.end(), [&itemCells](const CellEntry& entry) { return entry.item == itemCells.first; });
+			entries.push_back(*found);
+		}
+
+		m_bounds = bounds;
+		m_cellCountX = std::max(1, (int)std::ceil(bounds.extent.x / m_cellSize));
+		m_cellCountY = std::max(1, (int)std::ceil(bounds.extent.y / m_cellSize));
+		m_cells.clear();
+		m_cells.resize(m_cellCountX * m_cellCountY);
+		m_itemCells.clear();
+
+		for (const auto& entry : entries)
+		{
+			insertItem(entry.item, entry.bounds);
+		}
+	}
+
+	// insert the item, or move it if it is already in the grid
+	void updateItem(UIItem* item, const Rect& bounds)
+	{
+		removeItem(item);
+		insertItem(item, bounds);
+	}
+
+	void removeItem(const UIItem* item)
+	{
+		auto found = m_itemCells.find(item);
+		if (found == m_itemCells.end())
+			return;
+
+		const CellRange& range = found->second;
+		for (int y = range.minY; y <= range.maxY; ++y)
+		{
+			for (int x = range.minX; x <= range.maxX; ++x)
+			{
+				// the order inside a cell doesn't matter
+				auto& cell = m_cells[y * m_cellCountX + x];
+				auto foundEntry = std::find_if(cell.begin(), cell.end(), [item](const CellEntry& entry) { return entry.item == item; });
+				if (foundEntry != cell.end())
+				{
+					*foundEntry = cell.back();
+					cell.pop_back();
+				}
+			}
+		}
+
+		m_itemCells.erase(found);
+	}
+
+	// items whose bounds contain the point, in no particular order
+	void query(const glm::vec2& point, std::vector<UIItem*>& outItems) const
+	{
+		outItems.clear();
+
+		const auto& cell = m_cells[getCellY(point.y) * m_cellCountX + getCellX(point.x)];
+		for (const auto& entry : cell)
+		{
+			if (entry.bounds.isPointInside(point))
+				outItems.push_back(entry.item);
+		}
+	}
+
+	bool containsItem(const UIItem* item) const
+	{
+		return m_itemCells.find(item) != m_itemCells.end();
+	}
+	int getItemCount() const
+	{
+		return (int)m_itemCells.size();
+	}
+	float getCellSize() const
+	{
+		return m_cellSize;
+	}
+
+private:
+	void insertItem(UIItem* item, const Rect& bounds)
+	{
+		CellRange range(getCellX(bounds.pos.x), getCellY(bounds.pos.y), getCellX(bounds.pos.x + bounds.extent.x), getCellY(bounds.pos.y + bounds.extent.y));
+		for (int y = range.minY; y <= range.maxY; ++y)
+		{
+			for (int x = range.minX; x <= range.maxX; ++x)
+			{
+				m_cells[y * m_cellCountX + x].push_back(CellEntry(item, bounds));
+			}
+		}
+
+		m_itemCells[item] = range;
+	}
+
+	int getCellX(float x) const
+	{
+		return glm::clamp((int)std::floor((x - m_bounds.pos.x) / m_cellSize), 0, m_cellCountX - 1);
+	}
+	int getCellY(float y) const
+	{
+		return glm::clamp((int)std::floor((y - m_bounds.pos.y) / m_cellSize), 0, m_cellCountY - 1);
+	}
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include "glm/glm.hpp"
+
+enum class UIInputEventType
+{
+	MOUSE_MOVE,
+	MOUSE_BUTTON_PRESSED,
+	MOUSE_BUTTON_RELEASED,
+	KEY_PRESSED,
+	KEY_RELEASED,
+	CHARACTER,
+};
+
+struct UIInputEvent
+{
+	UIInputEventType type;
+	// mouse events only
+	glm::vec2 mousePos;
+	// the button, the key or the codepoint, depending on the type
+	unsigned int code;
+};
+
+// Input events pushed by the window callbacks, processed once per frame by UIEngine::processInputEvents.
+// The consecutive mouse moves are merged into the last one : a mouse polled faster than the frame rate costs one tree walk per frame.
+// A move is never merged across a button or a key event, the order of the events is kept.
+// The events can be pushed from another thread than the one processing them.
+class UIInputQueue
+{
+private:
+	std::mutex m_mutex;
+	std::vector<UIInputEvent> m_events;
+	// events being processed, swapped with m_events to keep both allocations
+	std::vector<UIInputEvent> m_takenEvents;
+	size_t m_mergedMoveCount;
+
+public:
+	UIInputQueue()
+		: m_mergedMoveCount(0)
+	{}
+	UIInputQueue(const UIInputQueue& other) = delete;
+	UIInputQueue& operator=(const UIInputQueue& other) = delete;
+
+	void pushMouseMove(const glm::vec2& mousePos)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_events.empty() && m_events.back().type == UIInputEventType::MOUSE_MOVE)
+		{
+			m_events.back().mousePos = mousePos;
+			m_mergedMoveCount++;
+		}
+		else
+		{
+			m_events.push_back(UIInputEvent{ UIInputEventType::MOUSE_MOVE, mousePos, 0 });
+		}
+	}
+	void pushMouseButtonPressed(int button, const glm::vec2& mousePos)
+	{
+		push(UIInputEvent{ UIInputEventType::MOUSE_BUTTON_PRESSED, mousePos, (unsigned int)button });
+	}
+	void pushMouseButtonReleased(int button, const glm::vec2& mousePos)
+	{
+		push(UIInputEvent{ UIInputEventType::MOUSE_BUTTON_RELEASED, mousePos, (unsigned int)button });
+	}
+	void pushKeyPressed(int key)
+	{
+		push(UIInputEvent{ UIInputEventType::KEY_PRESSED, glm::vec2(0, 0), (unsigned int)key });
+	}
+	void pushKeyReleased(int key)
+	{
+		push(UIInputEvent{ UIInputEventType::KEY_RELEASED, glm::vec2(0, 0), (unsigned int)key });
+	}
+	void pushCharacter(unsigned int codepoint)
+	{
+		push(UIInputEvent{ UIInputEventType::CHARACTER, glm::vec2(0, 0), codepoint });
+	}
+
+	// the events pushed since the last call, in order. Valid until the next call
+	const std::vector<UIInputEvent>& takeEvents()
+	{
+		m_takenEvents.clear();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_takenEvents.swap(m_events);
+		return m_takenEvents;
+	}
+	bool isEmpty()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_events.empty();
+	}
+	// mouse moves merged into a previous one since the creation of the queue
+	size_t getMergedMoveCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_mergedMoveCount;
+	}
+
+private:
+	void push(const UIInputEvent& event)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_events.push_back(event);
+	}
+};
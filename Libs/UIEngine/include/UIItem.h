@@ -5,6 +5,7 @@
 #include "OpenglUtils.h"
 
 class UIEngine;
+class UIBatchRenderer;
 
 class UIItem
 {
@@ -46,7 +47,11 @@ public:
 	//virtual const glm::vec2& getPosition() const = 0;
 	//virtual const glm::vec2& getSize() const = 0;
 
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const = 0;
+	// record the item and its children into the renderer
+	virtual void draw(UIBatchRenderer& renderer) const = 0;
+	// submit the quads of the item only, recorded again alone when the item is damaged
+	virtual void drawSelf(UIBatchRenderer& renderer) const
+	{}
 
 	virtual bool isMouseHovering(const glm::vec2& cursor) const = 0;
 	bool getIsHovered() const
@@ -61,6 +66,21 @@ public:
 	{
 		return false;
 	}
+	// the keys go to the selected item then bubble up to its parents, see UIEngine::dispatchToFocusChain
+	virtual UIItem* getParentItem() const
+	{
+		return nullptr;
+	}
+	// false if the item and its children ignore the inputs
+	virtual bool isInputEnabled() const
+	{
+		return true;
+	}
+	// false if the item ignores the inputs, but not its children
+	virtual bool isSelfInputEnabled() const
+	{
+		return true;
+	}
 	bool getIsSelected() const
 	{
 		return m_selected;
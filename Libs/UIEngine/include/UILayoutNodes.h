@@ -0,0 +1,318 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+
+class WidgetBase;
+
+// Layout state of the widgets, stored in parallel arrays instead of inside each widget.
+// A widget keeps a handle to its node. The nodes are sorted in tree order (parents before children, a subtree is a contiguous range)
+// when the hierarchy changes, so the positions in viewport are computed by a linear sweep over the moved subtrees,
+// without visiting the widgets.
+class UILayoutNodes
+{
+public:
+	enum : int
+	{
+		s_noNode = -1,
+	};
+
+private:
+	// per handle
+	std::vector<int> m_handleNodes;
+	std::vector<WidgetBase*> m_owners;
+	std::vector<int> m_freeHandles;
+
+	// per node
+	std::vector<int> m_handles; // s_noNode if released
+	std::vector<int> m_parents; // s_noNode for the root and the widgets outside of the tree
+	std::vector<int> m_subtreeEnds; // the subtree of a node is [node, subtreeEnd)
+	std::vector<glm::vec2> m_relativePositions; // set by the parent layer
+	std::vector<glm::vec2> m_contentOffsets; // from the position of the node to the origin of its layer (the padding of its slot)
+	std::vector<glm::vec2> m_positions; // in viewport
+	std::vector<glm::vec2> m_sizes;
+	std::vector<glm::vec2> m_preferredSizes;
+
+	// the nodes after the tree are outside of it, their position isn't computed
+	int m_treeEnd;
+	bool m_isOrderDirty;
+
+	// handles of the widgets whose relative position has changed since the last sweep
+	std::vector<int> m_movedHandles;
+	// handles of the widgets whose position has changed during the last sweep
+	std::vector<int> m_changedHandles;
+
+	// kept to reuse the allocations
+	std::vector<int> m_sortedHandles;
+	std::vector<int> m_sortedParents;
+	std::vector<int> m_sweepRoots;
+
+public:
+	UILayoutNodes()
+		: m_treeEnd(0)
+		, m_isOrderDirty(true)
+	{}
+	UILayoutNodes(const UILayoutNodes& other) = delete;
+	UILayoutNodes& operator=(const UILayoutNodes& other) = delete;
+
+	// nodes
+	int createNode(WidgetBase* owner)
+	{
+		int handle = 0;
+		if (!m_freeHandles.empty())
+		{
+			handle = m_freeHandles.back();
+			m_freeHandles.pop_back();
+		}
+		else
+		{
+			handle = (int)m_handleNodes.size();
+			m_handleNodes.push_back(s_noNode);
+			m_owners.push_back(nullptr);
+		}
+
+		// outside of the tree until the next sort
+		const int node = (int)m_handles.size();
+		m_handleNodes[handle] = node;
+		m_owners[handle] = owner;
+		m_handles.push_back(handle);
+		m_parents.push_back(s_noNode);
+		m_subtreeEnds.push_back(node + 1);
+		m_relativePositions.push_back(glm::vec2(0, 0));
+		m_contentOffsets.push_back(glm::vec2(0, 0));
+		m_positions.push_back(glm::vec2(0, 0));
+		m_sizes.push_back(glm::vec2(0, 0));
+		m_preferredSizes.push_back(glm::vec2(0, 0));
+		m_isOrderDirty = true;
+
+		return handle;
+	}
+	// the node stays in the arrays until the next sort
+	void releaseNode(int handle)
+	{
+		const int node = m_handleNodes[handle];
+		m_handles[node] = s_noNode;
+		m_handleNodes[handle] = s_noNode;
+		m_owners[handle] = nullptr;
+		m_freeHandles.push_back(handle);
+
+		m_movedHandles.erase(std::remove(m_movedHandles.begin(), m_movedHandles.end(), handle), m_movedHandles.end());
+		m_isOrderDirty = true;
+	}
+	WidgetBase* getOwner(int handle) const
+	{
+		return m_owners[handle];
+	}
+
+	// per node state
+	const glm::vec2& getRelativePosition(int handle) const
+	{
+		return m_relativePositions[m_handleNodes[handle]];
+	}
+	void setRelativePosition(int handle, const glm::vec2& relativePosition)
+	{
+		m_relativePositions[m_handleNodes[handle]] = relativePosition;
+	}
+	const glm::vec2& getContentOffset(int handle) const
+	{
+		return m_contentOffsets[m_handleNodes[handle]];
+	}
+	void setContentOffset(int handle, const glm::vec2& contentOffset)
+	{
+		m_contentOffsets[m_handleNodes[handle]] = contentOffset;
+	}
+	const glm::vec2& getPosition(int handle) const
+	{
+		return m_positions[m_handleNodes[handle]];
+	}
+	const glm::vec2& getSize(int handle) const
+	{
+		return m_sizes[m_handleNodes[handle]];
+	}
+	void setSize(int handle, const glm::vec2& size)
+	{
+		m_sizes[m_handleNodes[handle]] = size;
+	}
+	const glm::vec2& getPreferredSize(int handle) const
+	{
+		return m_preferredSizes[m_handleNodes[handle]];
+	}
+	void setPreferredSize(int handle, const glm::vec2& preferredSize)
+	{
+		m_preferredSizes[m_handleNodes[handle]] = preferredSize;
+	}
+
+	// order
+	// widgets have been added to or removed from the tree
+	void invalidateOrder()
+	{
+		m_isOrderDirty = true;
+	}
+	bool isOrderDirty() const
+	{
+		return m_isOrderDirty;
+	}
+	// give the nodes of the tree under root their tree order, then put the other live nodes after them.
+	// Node must give its layout handle and append its children in their traversal order.
+	template<typename Node>
+	void sortNodes(const Node* root)
+	{
+		// depth first, parents first
+		m_sortedHandles.clear();
+		m_sortedParents.clear();
+		std::vector<std::pair<const Node*, int>> stack(1, std::make_pair(root, (int)s_noNode));
+		std::vector<const Node*> children;
+		while (!stack.empty())
+		{
+			const Node* current = stack.back().first;
+			const int parent = stack.back().second;
+			stack.pop_back();
+
+			const int sortedIndex = (int)m_sortedHandles.size();
+			m_sortedHandles.push_back(current->getLayoutHandle());
+			m_sortedParents.push_back(parent);
+
+			children.clear();
+			current->appendLayoutChildren(children);
+			for (auto child = children.rbegin(); child != children.rend(); ++child)
+			{
+				stack.push_back(std::make_pair(*child, sortedIndex));
+			}
+		}
+
+		applyOrder();
+	}
+
+	// positions
+	// the relative position of the widget or its content offset has changed, its subtree is placed again by the next sweep
+	void markMoved(int handle)
+	{
+		m_movedHandles.push_back(handle);
+	}
+	// compute the positions of the moved subtrees, from their parent position
+	void updatePositions()
+	{
+		m_changedHandles.clear();
+
+		m_sweepRoots.clear();
+		for (int handle : m_movedHandles)
+		{
+			const int node = m_handleNodes[handle];
+			if (node < m_treeEnd)
+				m_sweepRoots.push_back(node);
+		}
+		m_movedHandles.clear();
+
+		// a subtree inside an already swept one is skipped
+		std::sort(m_sweepRoots.begin(), m_sweepRoots.end());
+		int sweptEnd = 0;
+		for (int sweepRoot : m_sweepRoots)
+		{
+			if (sweepRoot < sweptEnd)
+				continue;
+
+			m_changedHandles.push_back(m_handles[sweepRoot]);
+			m_positions[sweepRoot] = getParentOrigin(sweepRoot) + m_relativePositions[sweepRoot];
+
+			sweptEnd = m_subtreeEnds[sweepRoot];
+			for (int node = sweepRoot + 1; node < sweptEnd; ++node)
+			{
+				const int parent = m_parents[node];
+				const glm::vec2 position = m_positions[parent] + m_contentOffsets[parent] + m_relativePositions[node];
+				if (position != m_positions[node])
+				{
+					m_positions[node] = position;
+					m_changedHandles.push_back(m_handles[node]);
+				}
+			}
+		}
+	}
+	// widgets placed by the last sweep
+	const std::vector<int>& getChangedHandles() const
+	{
+		return m_changedHandles;
+	}
+
+	int getNodeCount() const
+	{
+		return (int)m_handles.size();
+	}
+	int getTreeNodeCount() const
+	{
+		return m_treeEnd;
+	}
+	// size of the subtree of the widget at the last sort, 1 for a widget added after it
+	int getSubtreeNodeCount(int handle) const
+	{
+		const int node = m_handleNodes[handle];
+		return m_subtreeEnds[node] - node;
+	}
+
+private:
+	glm::vec2 getParentOrigin(int node) const
+	{
+		const int parent = m_parents[node];
+		return parent == s_noNode ? glm::vec2(0, 0) : m_positions[parent] + m_contentOffsets[parent];
+	}
+
+	template<typename T>
+	static void permute(std::vector<T>& values, const std::vector<int>& newToOldNodes)
+	{
+		std::vector<T> permuted;
+		permuted.reserve(newToOldNodes.size());
+		for (int oldNode : newToOldNodes)
+		{
+			permuted.push_back(values[oldNode]);
+		}
+		values.swap(permuted);
+	}
+
+	void applyOrder()
+	{
+		// the tree nodes, then the live nodes outside of the tree, the released nodes are dropped
+		std::vector<int> newToOldNodes;
+		newToOldNodes.reserve(m_handles.size());
+		std::vector<bool> isInTree(m_handles.size(), false);
+		for (int handle : m_sortedHandles)
+		{
+			const int node = m_handleNodes[handle];
+			newToOldNodes.push_back(node);
+			isInTree[node] = true;
+		}
+		m_treeEnd = (int)newToOldNodes.size();
+		for (int node = 0; node < (int)m_handles.size(); ++node)
+		{
+			if (!isInTree[node] && m_handles[node] != s_noNode)
+				newToOldNodes.push_back(node);
+		}
+
+		permute(m_handles, newToOldNodes);
+		permute(m_relativePositions, newToOldNodes);
+		permute(m_contentOffsets, newToOldNodes);
+		permute(m_positions, newToOldNodes);
+		permute(m_sizes, newToOldNodes);
+		permute(m_preferredSizes, newToOldNodes);
+
+		const int nodeCount = (int)newToOldNodes.size();
+		m_parents.assign(nodeCount, s_noNode);
+		std::copy(m_sortedParents.begin(), m_sortedParents.end(), m_parents.begin());
+
+		// the children are after their parent, the ends are propagated from the last node
+		m_subtreeEnds.resize(nodeCount);
+		for (int node = 0; node < nodeCount; ++node)
+		{
+			m_subtreeEnds[node] = node + 1;
+		}
+		for (int node = m_treeEnd - 1; node > 0; --node)
+		{
+			m_subtreeEnds[m_parents[node]] = std::max(m_subtreeEnds[m_parents[node]], m_subtreeEnds[node]);
+		}
+
+		for (int node = 0; node < nodeCount; ++node)
+		{
+			m_handleNodes[m_handles[node]] = node;
+		}
+		m_isOrderDirty = false;
+	}
+};
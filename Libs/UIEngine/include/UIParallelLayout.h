@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "WorkStealingPool.h"
+
+class UIItem;
+class WidgetBase;
+class BaseWidgetLayer;
+
+// What a subtree laid out on a layout thread changes outside of it, applied by the UI thread after the pass.
+// The records of the sibling subtrees are appended in slot order, whatever the thread which laid them out.
+struct UILayoutRecord
+{
+	// the layout requests aren't propagated above it, its parents are updated by other threads
+	const WidgetBase* rootWidget;
+	std::vector<int> movedHandles;
+	// their hit test bounds have changed
+	std::vector<WidgetBase*> resizedWidgets;
+	std::vector<const UIItem*> damagedItems;
+	// layers which create widgets when arranged, arranged by the UI thread
+	std::vector<BaseWidgetLayer*> deferredLayers;
+	// widgets visited, for the profiler
+	unsigned int layoutNodeCount;
+
+	UILayoutRecord()
+		: rootWidget(nullptr)
+		, layoutNodeCount(0)
+	{}
+
+	void append(const UILayoutRecord& other)
+	{
+		movedHandles.insert(movedHandles.end(), other.movedHandles.begin(), other.movedHandles.end());
+		resizedWidgets.insert(resizedWidgets.end(), other.resizedWidgets.begin(), other.resizedWidgets.end());
+		damagedItems.insert(damagedItems.end(), other.damagedItems.begin(), other.damagedItems.end());
+		deferredLayers.insert(deferredLayers.end(), other.deferredLayers.begin(), other.deferredLayers.end());
+		layoutNodeCount += other.layoutNodeCount;
+	}
+	void clear()
+	{
+		rootWidget = nullptr;
+		movedHandles.clear();
+		resizedWidgets.clear();
+		damagedItems.clear();
+		deferredLayers.clear();
+		layoutNodeCount = 0;
+	}
+};
+
+// Parallel mode of the layout pass.
+// Once a layer is arranged, the size of each slot widget is fixed and its subtree is laid out independently of its siblings :
+// the big subtrees are laid out on a work stealing pool, see BaseWidgetLayer::updateSlotsInParallel.
+// During the pass, each thread records its side effects in the record of its subtree instead of applying them.
+class UIParallelLayout
+{
+public:
+	enum : int
+	{
+		// smaller subtrees are laid out by the thread of their parent, a task costs more than placing them
+		s_minTaskNodeCount = 256,
+	};
+
+private:
+	// null in sequential mode
+	std::unique_ptr<WorkStealingPool> m_pool;
+
+public:
+	UIParallelLayout()
+	{}
+	UIParallelLayout(const UIParallelLayout& other) = delete;
+	UIParallelLayout& operator=(const UIParallelLayout& other) = delete;
+
+	// the UI thread takes part in the pass, threadCount - 1 workers are created.
+	// One thread per hardware thread if threadCount is 0, sequential layout with 1.
+	void setThreadCount(unsigned int threadCount)
+	{
+		if (threadCount == 0)
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+		m_pool.reset();
+		if (threadCount > 1)
+			m_pool = std::make_unique<WorkStealingPool>(threadCount - 1);
+	}
+	unsigned int getThreadCount() const
+	{
+		return m_pool == nullptr ? 1 : m_pool->getWorkerCount() + 1;
+	}
+	bool isEnabled() const
+	{
+		return m_pool != nullptr;
+	}
+	WorkStealingPool& getPool()
+	{
+		return *m_pool;
+	}
+
+	// record of the subtree laid out by the current thread, null outside of a parallel pass
+	static UILayoutRecord*& getCurrentRecord()
+	{
+		thread_local UILayoutRecord* currentRecord = nullptr;
+		return currentRecord;
+	}
+};
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <cstdint>
+#include <algorithm>
+
+// Define UIENGINE_PROFILING to 0 to compile the scopes and the counters out, the queries then return empty frames.
+#ifndef UIENGINE_PROFILING
+#define UIENGINE_PROFILING 1
+#endif
+
+// the parts of a frame, timed by a UIProfileScope
+enum class UIProfilePhase
+{
+	FRAME,			// the whole renderUI call, the other phases are inside it or in needsRedraw
+	INPUT,			// dispatch of the queued input events
+	LAYOUT,			// measure and arrangement of the dirty widgets (the updateSlotsRecur pass)
+	POSITIONS,		// sweep placing the moved subtrees in the viewport
+	RECORD,			// draw traversal, recording or patching the quads of the damaged widgets
+	TEXTURE_UPLOAD,	// textures and glyph atlases uploaded to the GPU
+	SUBMIT,			// instance upload and draw calls, CPU side of the GL submission
+	COUNT,
+};
+
+// what a frame has done, counted by UIENGINE_PROFILE_COUNT
+enum class UIProfileCounter
+{
+	LAYOUT_NODES,		// widgets visited by the layout pass
+	DRAW_NODES,			// items recorded or patched by the draw traversal
+	DRAW_CALLS,
+	UNIFORM_UPLOADS,	// uniforms actually uploaded, the shadowed values are skipped
+	GLYPHS,				// glyph quads submitted
+	TEXTURE_BINDS,
+	COUNT,
+};
+
+struct UIFrameStats
+{
+	enum : int
+	{
+		s_phaseCount = (int)UIProfilePhase::COUNT,
+		s_counterCount = (int)UIProfileCounter::COUNT,
+	};
+
+	uint64_t frameIndex;
+	// in microseconds since the creation of the profiler
+	double beginTime;
+	double endTime;
+	// a phase can run several times in a frame : total duration, begin of its first run and end of its last one
+	double phaseDurations[s_phaseCount];
+	double phaseBeginTimes[s_phaseCount];
+	double phaseEndTimes[s_phaseCount];
+	unsigned int counters[s_counterCount];
+
+	UIFrameStats()
+	{
+		reset(0, 0);
+	}
+
+	void reset(uint64_t _frameIndex, double _beginTime)
+	{
+		frameIndex = _frameIndex;
+		beginTime = _beginTime;
+		endTime = _beginTime;
+		std::fill(phaseDurations, phaseDurations + s_phaseCount, 0.0);
+		std::fill(phaseBeginTimes, phaseBeginTimes + s_phaseCount, -1.0);
+		std::fill(phaseEndTimes, phaseEndTimes + s_phaseCount, -1.0);
+		std::fill(counters, counters + s_counterCount, 0u);
+	}
+
+	double getPhaseDuration(UIProfilePhase phase) const
+	{
+		return phaseDurations[(int)phase];
+	}
+	unsigned int getCounter(UIProfileCounter counter) const
+	{
+		return counters[(int)counter];
+	}
+};
+
+// Per frame timings and counters of the UIEngine, kept in a ring buffer of the last frames.
+// The phases are timed by scopes. While a scope is open on a thread, the counters incremented on this thread go to its profiler,
+// so the code without access to the engine (the drawers, the shader programs) can count too. The counts outside of any scope are dropped.
+// The timed scopes can also be captured as a Chrome trace (chrome://tracing, Perfetto).
+class UIProfiler
+{
+public:
+	enum : int
+	{
+		s_defaultFrameCapacity = 240,
+	};
+
+private:
+	struct TraceEvent
+	{
+		UIProfilePhase phase;
+		uint64_t frameIndex;
+		double beginTime;
+		double duration;
+	};
+
+	std::chrono::steady_clock::time_point m_origin;
+
+	// ring buffer of the finished frames
+	std::vector<UIFrameStats> m_frames;
+	size_t m_nextFrame;
+	size_t m_storedFrameCount;
+	UIFrameStats m_currentFrame;
+	uint64_t m_frameIndex;
+
+	bool m_traceCaptureEnabled;
+	std::vector<TraceEvent> m_traceEvents;
+	// counters of the captured frames, written as counter tracks
+	std::vector<UIFrameStats> m_traceFrames;
+
+public:
+	explicit UIProfiler(size_t frameCapacity = s_defaultFrameCapacity)
+		: m_origin(std::chrono::steady_clock::now())
+		, m_frames(std::max(frameCapacity, (size_t)1))
+		, m_nextFrame(0)
+		, m_storedFrameCount(0)
+		, m_frameIndex(0)
+		, m_traceCaptureEnabled(false)
+	{}
+	UIProfiler(const UIProfiler& other) = delete;
+	UIProfiler& operator=(const UIProfiler& other) = delete;
+
+	// microseconds since the creation of the profiler
+	double getTime() const
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_origin).count();
+	}
+
+	// recording, see UIProfileScope and UIENGINE_PROFILE_COUNT
+	void addPhase(UIProfilePhase phase, double beginTime, double endTime)
+	{
+		const int phaseIndex = (int)phase;
+		m_currentFrame.phaseDurations[phaseIndex] += endTime - beginTime;
+		if (m_currentFrame.phaseBeginTimes[phaseIndex] < 0)
+			m_currentFrame.phaseBeginTimes[phaseIndex] = beginTime;
+		m_currentFrame.phaseEndTimes[phaseIndex] = endTime;
+
+		if (m_traceCaptureEnabled)
+			m_traceEvents.push_back(TraceEvent{ phase, m_frameIndex, beginTime, endTime - beginTime });
+	}
+	void addCount(UIProfileCounter counter, unsigned int count = 1)
+	{
+		m_currentFrame.counters[(int)counter] += count;
+	}
+	// store the current frame in the ring buffer and start the next one
+	void endFrame()
+	{
+		const double time = getTime();
+		m_currentFrame.endTime = time;
+		if (m_traceCaptureEnabled)
+			m_traceFrames.push_back(m_currentFrame);
+
+		m_frames[m_nextFrame] = m_currentFrame;
+		m_nextFrame = (m_nextFrame + 1) % m_frames.size();
+		m_storedFrameCount = std::min(m_storedFrameCount + 1, m_frames.size());
+
+		m_frameIndex++;
+		m_currentFrame.reset(m_frameIndex, time);
+	}
+
+	// queries
+	size_t getFrameCapacity() const
+	{
+		return m_frames.size();
+	}
+	size_t getStoredFrameCount() const
+	{
+		return m_storedFrameCount;
+	}
+	// 0 is the last finished frame, 1 the one before... framesAgo must be lower than getStoredFrameCount()
+	const UIFrameStats& getFrame(size_t framesAgo) const
+	{
+		return m_frames[(m_nextFrame + m_frames.size() - 1 - framesAgo) % m_frames.size()];
+	}
+	// mean of the durations and the counters (rounded down) of the last frameCount frames
+	UIFrameStats getAverage(size_t frameCount) const
+	{
+		frameCount = std::min(frameCount, m_storedFrameCount);
+		UIFrameStats average;
+		if (frameCount == 0)
+			return average;
+
+		double counterSums[UIFrameStats::s_counterCount] = {};
+		for (size_t framesAgo = 0; framesAgo < frameCount; ++framesAgo)
+		{
+			const UIFrameStats& frame = getFrame(framesAgo);
+			for (int phaseIndex = 0; phaseIndex < UIFrameStats::s_phaseCount; ++phaseIndex)
+			{
+				average.phaseDurations[phaseIndex] += frame.phaseDurations[phaseIndex] / frameCount;
+			}
+			for (int counterIndex = 0; counterIndex < UIFrameStats::s_counterCount; ++counterIndex)
+			{
+				counterSums[counterIndex] += frame.counters[counterIndex];
+			}
+		}
+		for (int counterIndex = 0; counterIndex < UIFrameStats::s_counterCount; ++counterIndex)
+		{
+			average.counters[counterIndex] = (unsigned int)(counterSums[counterIndex] / frameCount);
+		}
+		average.frameIndex = getFrame(0).frameIndex;
+		average.beginTime = getFrame(frameCount - 1).beginTime;
+		average.endTime = getFrame(0).endTime;
+		return average;
+	}
+	void clearFrames()
+	{
+		m_nextFrame = 0;
+		m_storedFrameCount = 0;
+	}
+
+	// trace capture, the events are kept until clearTrace
+	void setTraceCaptureEnabled(bool enabled)
+	{
+		m_traceCaptureEnabled = enabled;
+	}
+	bool isTraceCaptureEnabled() const
+	{
+		return m_traceCaptureEnabled;
+	}
+	void clearTrace()
+	{
+		m_traceEvents.clear();
+		m_traceFrames.clear();
+	}
+	// one complete event per timed scope and one counter event per frame, in the Chrome trace event JSON format
+	bool writeChromeTrace(const std::string& fileName) const
+	{
+		std::ofstream stream(fileName);
+		if (!stream)
+			return false;
+
+		// microseconds, the default precision would round the timestamps after a second of uptime
+		stream << std::fixed << std::setprecision(3);
+		stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool isFirst = true;
+		for (const TraceEvent& event : m_traceEvents)
+		{
+			stream << (isFirst ? "\n" : ",\n") << "{\"name\":\"" << getPhaseName(event.phase) << "\",\"cat\":\"UIEngine\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+				<< event.beginTime << ",\"dur\":" << event.duration << ",\"args\":{\"frame\":" << event.frameIndex << "}}";
+			isFirst = false;
+		}
+		for (const UIFrameStats& frame : m_traceFrames)
+		{
+			stream << (isFirst ? "\n" : ",\n") << "{\"name\":\"counters\",\"cat\":\"UIEngine\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << frame.endTime << ",\"args\":{";
+			for (int counterIndex = 0; counterIndex < UIFrameStats::s_counterCount; ++counterIndex)
+			{
+				stream << (counterIndex == 0 ? "" : ",") << "\"" << getCounterName((UIProfileCounter)counterIndex) << "\":" << frame.counters[counterIndex];
+			}
+			stream << "}}";
+			isFirst = false;
+		}
+		stream << "\n]}\n";
+		return (bool)stream;
+	}
+
+	static const char* getPhaseName(UIProfilePhase phase)
+	{
+		static const char* const names[] = { "frame", "input", "layout", "positions", "record", "texture upload", "submit" };
+		static_assert(sizeof(names) / sizeof(names[0]) == (size_t)UIProfilePhase::COUNT, "a phase has no name");
+		return names[(int)phase];
+	}
+	static const char* getCounterName(UIProfileCounter counter)
+	{
+		static const char* const names[] = { "layout nodes", "draw nodes", "draw calls", "uniform uploads", "glyphs", "texture binds" };
+		static_assert(sizeof(names) / sizeof(names[0]) == (size_t)UIProfileCounter::COUNT, "a counter has no name");
+		return names[(int)counter];
+	}
+
+	// profiler of the innermost scope open on this thread, null outside of any scope
+	static UIProfiler*& getCurrent()
+	{
+		thread_local UIProfiler* currentProfiler = nullptr;
+		return currentProfiler;
+	}
+};
+
+// Time a phase from its construction to its destruction, and make its profiler the current one meanwhile.
+class UIProfileScope
+{
+private:
+	UIProfiler& m_profiler;
+	UIProfiler* m_previousProfiler;
+	UIProfilePhase m_phase;
+	double m_beginTime;
+
+public:
+	UIProfileScope(UIProfiler& profiler, UIProfilePhase phase)
+		: m_profiler(profiler)
+		, m_previousProfiler(UIProfiler::getCurrent())
+		, m_phase(phase)
+		, m_beginTime(profiler.getTime())
+	{
+		UIProfiler::getCurrent() = &m_profiler;
+	}
+	~UIProfileScope()
+	{
+		m_profiler.addPhase(m_phase, m_beginTime, m_profiler.getTime());
+		UIProfiler::getCurrent() = m_previousProfiler;
+	}
+	UIProfileScope(const UIProfileScope& other) = delete;
+	UIProfileScope& operator=(const UIProfileScope& other) = delete;
+};
+
+#if UIENGINE_PROFILING
+#define UIENGINE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define UIENGINE_PROFILE_CONCAT(a, b) UIENGINE_PROFILE_CONCAT_IMPL(a, b)
+// time the rest of the enclosing block
+#define UIENGINE_PROFILE_SCOPE(profiler, phase) UIProfileScope UIENGINE_PROFILE_CONCAT(uiProfileScope, __LINE__)((profiler), (phase))
+// add to a counter of the current profiler, if any
+#define UIENGINE_PROFILE_COUNT(counter, count) do { if (UIProfiler* currentProfiler = UIProfiler::getCurrent()) currentProfiler->addCount((counter), (unsigned int)(count)); } while (0)
+#define UIENGINE_PROFILE_END_FRAME(profiler) (profiler).endFrame()
+#else
+#define UIENGINE_PROFILE_SCOPE(profiler, phase) ((void)0)
+#define UIENGINE_PROFILE_COUNT(counter, count) ((void)0)
+#define UIENGINE_PROFILE_END_FRAME(profiler) ((void)0)
+#endif
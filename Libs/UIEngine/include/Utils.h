@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include "glm/glm.hpp"
 
 struct Rect
@@ -44,3 +45,14 @@ struct Rect
 		extent.y = glm::max(bottom01.y, bottom02.y) - pos.y;
 	}
 };
+
+// FNV-1a hash of a buffer, used to identify the content of a file
+inline unsigned long long hashBytes(const unsigned char* data, size_t size, unsigned long long hash = 14695981039346656037ull)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
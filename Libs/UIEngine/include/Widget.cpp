@@ -1,12 +1,164 @@
 #include "Widget.h"
 #include "WidgetLayer.h"
 #include "UIEngine.h"
+#include "UIBatchRenderer.h"
 
 
 WidgetBase::WidgetBase(UIEngine* uiengine)
 	: UIItem(uiengine)
+	, m_layoutNodes(&uiengine->getLayoutNodes())
+	, m_layoutHandle(m_layoutNodes->createNode(this))
+	, m_visibility(WidgetVisibility::VISIBLE)
+	, m_desiredSize(0, 0)
+	, m_measureDirty(true)
+	, m_layoutDirty(true)
+	, m_childLayoutDirty(false)
+	, m_positionDirty(true)
+	, m_layoutRelativePosition(0, 0)
+	, m_layoutSize(0, 0)
 {}
 
+WidgetBase::~WidgetBase()
+{
+	m_uiEngine->getHitTestGrid().removeItem(this);
+	m_layoutNodes->releaseNode(m_layoutHandle);
+}
+
+WidgetBase* WidgetBase::getParentWidget() const
+{
+	BaseWidgetLayer* owningLayer = getOwningLayer();
+	return owningLayer == nullptr ? nullptr : owningLayer->getOwningWidget();
+}
+
+bool WidgetBase::isSizedToContent() const
+{
+	WidgetSlot* owningSlot = getOwningSlot();
+	return owningSlot != nullptr && owningSlot->getSizeToContent();
+}
+
+void WidgetBase::invalidateMeasure()
+{
+	m_measureDirty = true;
+
+	// our parent places us with our desired size
+	WidgetBase* parent = getParentWidget();
+	if (parent != nullptr)
+		parent->invalidateLayout();
+}
+
+void WidgetBase::invalidateLayout()
+{
+	m_layoutDirty = true;
+
+	// if our size depends on our content, our parent has to measure us again
+	if (isSizedToContent())
+		invalidateMeasure();
+	else
+		propagateLayoutRequest();
+}
+
+void WidgetBase::invalidatePosition()
+{
+	m_positionDirty = true;
+	propagateLayoutRequest();
+}
+
+void WidgetBase::invalidateDraw()
+{
+	m_uiEngine->damageItem(this);
+}
+
+void WidgetBase::invalidateDrawList()
+{
+	m_uiEngine->invalidateDrawList();
+}
+
+void WidgetBase::propagateLayoutRequest()
+{
+	// during a parallel layout pass, the parents above the subtree of this thread are updated by other threads.
+	// They are in the middle of their update, their flags are cleared after it anyway
+	const UILayoutRecord* record = UIParallelLayout::getCurrentRecord();
+	const WidgetBase* subtreeRoot = record == nullptr ? nullptr : record->rootWidget;
+
+	// we stop as soon as a parent is already marked, its own parents are marked too
+	const WidgetBase* child = this;
+	WidgetBase* parent = getParentWidget();
+	while (child != subtreeRoot && parent != nullptr && !parent->m_childLayoutDirty)
+	{
+		parent->m_childLayoutDirty = true;
+		child = parent;
+		parent = parent->getParentWidget();
+	}
+
+	m_uiEngine->requestLayout();
+}
+
+const glm::vec2& WidgetBase::measure()
+{
+	if (m_measureDirty)
+	{
+		m_desiredSize = computeDesiredSize();
+		m_measureDirty = false;
+	}
+
+	return m_desiredSize;
+}
+
+void WidgetBase::updateLayout()
+{
+	// the relative position and the size have been set by the parent layer before this call
+	const bool moved = m_positionDirty || getComputedRelativePosition() != m_layoutRelativePosition;
+	const bool resized = getComputedSize() != m_layoutSize;
+	const bool arrange = m_layoutDirty || resized;
+
+#if UIENGINE_PROFILING
+	// the layout threads have no profiler, they count in their record
+	if (UILayoutRecord* record = UIParallelLayout::getCurrentRecord())
+		record->layoutNodeCount++;
+	else
+		UIENGINE_PROFILE_COUNT(UIProfileCounter::LAYOUT_NODES, 1);
+#endif
+
+	// nothing to do in this subtree
+	if (!moved && !arrange && !m_childLayoutDirty)
+		return;
+
+	m_positionDirty = false;
+	m_layoutDirty = false;
+	m_layoutRelativePosition = getComputedRelativePosition();
+	m_layoutSize = getComputedSize();
+
+	if (moved)
+	{
+		// the padding of our slot offsets our layer
+		WidgetSlot* owningSlot = getOwningSlot();
+		const glm::vec2 contentOffset = owningSlot == nullptr ? glm::vec2(0, 0) : glm::vec2(owningSlot->getPadding().left, owningSlot->getPadding().top);
+		m_layoutNodes->setContentOffset(m_layoutHandle, contentOffset);
+
+		// our subtree is placed after the pass, the sweep updates the hit test grid and damages the widgets which have moved
+		if (UILayoutRecord* record = UIParallelLayout::getCurrentRecord())
+			record->movedHandles.push_back(m_layoutHandle);
+		else
+			m_layoutNodes->markMoved(m_layoutHandle);
+	}
+	else if (resized)
+	{
+		// the root isn't hit tested, only the widgets inside it
+		if (UILayoutRecord* record = UIParallelLayout::getCurrentRecord())
+			record->resizedWidgets.push_back(this);
+		else if (getOwningLayer() != nullptr)
+			m_uiEngine->getHitTestGrid().updateItem(this, getComputedBounds());
+
+		// the quads are built from the bounds
+		invalidateDraw();
+	}
+
+	updateLayersLayout(arrange);
+
+	// cleared at the end, the slots arrangement may mark this widget again
+	m_childLayoutDirty = false;
+}
+
 //const glm::vec2& WidgetBase::getPosition() const
 //{
 //	return m_box.pos;
@@ -40,45 +192,31 @@ Widget::~Widget()
 
 }
 
-void Widget::draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void Widget::draw(UIBatchRenderer& renderer) const
 {
-	// self draw
-	if (m_program.expired() || m_shape.expired())
+	if (m_visibility == WidgetVisibility::INVISILE || m_visibility == WidgetVisibility::COLLAPSED)
 		return;
 
-	// we bind the program only if it is not already in use
-	auto program = m_program.lock();
-	if (program.get() != *boundProgram)
-	{
-		program->use();
-		*boundProgram = program.get();
-	}
-
-	// compute render box
-	glm::vec4 box = m_computedBounds.toVec4();
-	viewportTransform(box, viewportSize);
-	//glm::vec4 box((m_posInViewport / (viewportSize * 0.5f)), m_box.extent / (viewportSize * 0.5f));
-	//box *= glm::vec4(1, -1, 1, -1);
-	//box += glm::vec4(-1, 1, 0, 0);
-
-	// update uniforms
-	glUniform4fv(glGetUniformLocation(program->getGLId(), "box"), 1, &box[0]/*&m_box.toVec4()[0]*/);
-	glUniform4fv(glGetUniformLocation(program->getGLId(), "tint"), 1, &getTint()[0]);
-	glUniform2fv(glGetUniformLocation(program->getGLId(), "viewportSize"), 1, &viewportSize[0]);
-	glUniform1f(glGetUniformLocation(program->getGLId(), "cornerRadius"), m_cornerRadius);
-
-	// draw the widget shape
-	auto shape = m_shape.lock();
-	shape->draw();
+	// self draw, the renderer keeps the range of our quads
+	renderer.recordItem(*this);
 
 	// recursivity on layer slots
 	if (m_layer != nullptr)
-		m_layer->draw(boundProgram, viewportSize);
+		m_layer->draw(renderer);
+}
+
+void Widget::drawSelf(UIBatchRenderer& renderer) const
+{
+	if (m_program.expired())
+		return;
+
+	// the box stays in pixels, the viewport transform is done by the vertex shader
+	renderer.submitQuad(m_program.lock().get(), nullptr, UIQuadInstance(getComputedBounds().toVec4(), getTint(), glm::vec4(0, 0, 1, 1), m_cornerRadius, QUAD_SOLID));
 }
 
 bool Widget::isMouseHovering(const glm::vec2& cursor) const
 {
-	return m_computedBounds.isPointInside(cursor);
+	return getComputedBounds().isPointInside(cursor);
 }
 
 bool Widget::acceptLayer() const
@@ -101,23 +239,24 @@ BaseWidgetLayer* Widget::getOwningLayer() const
 
 void Widget::setLayer(const std::shared_ptr<BaseWidgetLayer>& layer)
 {
+	if (m_layer != nullptr)
+		m_layer->setOwningWidget(nullptr);
+
 	m_layer = layer;
 	//for (auto& child : m_childs)
 	//{
 	//	m_layer->addSlot(child.get());
 	//}
 	m_layer->setOwningWidget(this);
-
-	updateTransformFromParent();
 }
 
 void Widget::removeLayer()
 {
 	//m_layer->clearSlots();
-	m_layer.reset();
 	m_layer->setOwningWidget(nullptr);
+	m_layer.reset();
 
-	updateTransformFromParent();
+	invalidateLayout();
 }
 
 BaseWidgetLayer* Widget::getLayer() const
@@ -182,141 +321,39 @@ const std::string& Widget::getName() const
 //	setPosition(getPosition() + offset, recursiveUpdateFromParent);
 //}
 
-void Widget::computeChildrenPositionInViewport()
+void Widget::appendLayoutChildren(std::vector<const WidgetBase*>& outChildren) const
 {
-	if (m_layer)
-		m_layer->computeChildrenPositionInViewport();
-}
-
-void Widget::computePositionInViewportRecur()
-{
-	computePositionInViewport();
-
-	if (m_layer)
-		m_layer->computePositionInViewportRecur();
-}
+	if (m_layer == nullptr)
+		return;
 
-void Widget::computePositionInViewport()
-{
-	if (m_owningSlot != nullptr && m_owningSlot->getOwningLayer() != nullptr
-		&& m_owningSlot->getOwningLayer()->isAttachedToWidget())
+	for (int slotIndex = 0; slotIndex < m_layer->getSlotCount(); ++slotIndex)
 	{
-		m_computedBounds.pos = m_owningSlot->getOwningLayer()->getPosition() + getComputedRelativePosition();
+		outChildren.push_back(m_layer->getSlot(slotIndex)->getOwnedWidget());
 	}
 }
 
-void Widget::updateTransformFromParent()
+glm::vec2 Widget::computeDesiredSize()
 {
-	auto owningLayer = getOwningLayer();
-	if (owningLayer)
-	{
-		owningLayer->updateSlotsRecur();
-	}
-	else
-	{
-		updateLayer();
-	}
-}
-
-void Widget::updateLayer(bool canUpdateParent, bool ignoreSizeToContent)
-{
-	if (m_layer)
-		m_layer->updateSlotsRecur(canUpdateParent, ignoreSizeToContent);
-}
-
-bool Widget::handleMouseMove(const glm::vec2 mousePos) 
-{
-	if (m_visibility == WidgetVisibility::INVISILE
-		|| m_visibility == WidgetVisibility::COLLAPSED
-		|| m_visibility == WidgetVisibility::HIT_TEST_INVISIBLE)
-		return false;
-
-	bool handled = m_layer == nullptr ? false : m_layer->handleMouseMove(mousePos);
-	if (m_visibility == WidgetVisibility::SELF_HIT_TEST_INVISIBLE)
-		return handled;
-
-	if (isMouseHovering(mousePos))
-	{
-		handled = onMouseMove(mousePos);
+	if (m_visibility == WidgetVisibility::COLLAPSED)
+		return glm::vec2(0, 0);
 
-		if (!getIsHovered())
-		{
-			onMouseEnter();
-			if (m_uiEngine->isDraggingItem())
-				onDragEnter();
-
-			setIsHovered(true);
-		}
-	}
+	if (m_layer != nullptr && isSizedToContent())
+		return m_layer->measureContent();
 	else
-	{
-		if (getIsHovered())
-		{
-			onMouseLeave();
-			if (m_uiEngine->isDraggingItem())
-				onDragLeave();
-
-			setIsHovered(false);
-		}
-
-		// mouse is not in any child so we don't bubble this event on childs
-		handled = true;
-	}
-
-	return handled;
+		return getPreferredSize();
 }
 
-bool Widget::handleMouseButtonPressed(int button, const glm::vec2& mousePos)
+void Widget::updateLayersLayout(bool arrange)
 {
-	if (m_visibility == WidgetVisibility::INVISILE
-		|| m_visibility == WidgetVisibility::COLLAPSED
-		|| m_visibility == WidgetVisibility::HIT_TEST_INVISIBLE)
-		return false;
-
-	if (isMouseHovering(mousePos))
-	{
-		if (m_layer == nullptr)
-			m_uiEngine->selectItem(this);
-
-		m_uiEngine->addPressedItem(this);
+	if (m_layer == nullptr)
+		return;
 
-		// we propagate event on childs only if the mouse is inside the parent
-		bool handled = (m_layer == nullptr) ? false : m_layer->handleMouseButtonPressed(button, mousePos);
+	if (arrange && m_uiEngine->deferLayerLayout(m_layer.get()))
+		return;
 
-		if (handled)
-			return true;
-		else if(m_visibility != WidgetVisibility::SELF_HIT_TEST_INVISIBLE)
-		{
-			handled = onMouseButtonPressed(button, mousePos);
-		}
-	}
-	else
-	{
-		m_selected = false;
-		return false;
-	}
-}
-
-bool Widget::handleMouseButtonReleased(int button, const glm::vec2& mousePos) 
-{
-	if (m_visibility == WidgetVisibility::INVISILE
-		|| m_visibility == WidgetVisibility::COLLAPSED
-		|| m_visibility == WidgetVisibility::HIT_TEST_INVISIBLE)
-		return false;
-
-	if (isMouseHovering(mousePos))
-	{
-		// we propagate event on childs only if the mouse is inside the parent
-		bool handled = (m_layer == nullptr) ? false : m_layer->handleMouseButtonReleased(button, mousePos);
-		if (handled)
-			return true;
-		else if(m_visibility != WidgetVisibility::SELF_HIT_TEST_INVISIBLE)
-		{
-			handled = onMouseButtonReleased(button, mousePos);
-		}
-	}
-	else
-		return false;
+	if (arrange)
+		m_layer->arrangeSlots();
+	m_layer->updateSlotsRecur();
 }
 
 bool Widget::handleKeyPressed(int key)
@@ -370,50 +407,6 @@ bool Widget::handleCharacter(unsigned int codepoint)
 	return handled;
 }
 
-bool Widget::handleDragOver(const glm::vec2& mousePos)
-{
-	if (m_visibility == WidgetVisibility::INVISILE
-		|| m_visibility == WidgetVisibility::COLLAPSED
-		|| m_visibility == WidgetVisibility::HIT_TEST_INVISIBLE)
-		return false;
-
-	if (isMouseHovering(mousePos))
-	{
-		// we propagate event on childs only if the mouse is inside the parent
-		bool handled = (m_layer == nullptr) ? false : m_layer->handleDragOver(mousePos);
-		if (handled)
-			return true;
-		else if (m_visibility != WidgetVisibility::SELF_HIT_TEST_INVISIBLE)
-		{
-			handled = onDragOver(mousePos);
-		}
-	}
-	else
-		return false;
-}
-
-bool Widget::handleDrop(const glm::vec2& mousePos)
-{
-	if (m_visibility == WidgetVisibility::INVISILE
-		|| m_visibility == WidgetVisibility::COLLAPSED
-		|| m_visibility == WidgetVisibility::HIT_TEST_INVISIBLE)
-		return false;
-
-	if (isMouseHovering(mousePos))
-	{
-		// we propagate event on childs only if the mouse is inside the parent
-		bool handled = (m_layer == nullptr) ? false : m_layer->handleDrop(mousePos);
-		if (handled)
-			return true;
-		else if (m_visibility != WidgetVisibility::SELF_HIT_TEST_INVISIBLE)
-		{
-			handled = onDrop(mousePos);
-		}
-	}
-	else
-		return false;
-}
-
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 ////// WidgetSlot
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -423,8 +416,19 @@ WidgetSlot::WidgetSlot(BaseWidgetLayer* owningLayer, std::shared_ptr<Widget> own
 	, m_owningLayer(owningLayer)
 	, m_sizeToContent(false)
 	, m_padding(0, 0, 0, 0)
+	, m_indexInLayer(0)
 {
 	ownedWidget->m_owningSlot = this;
+
+	// new parent, the widget has to be measured and placed again
+	ownedWidget->invalidatePosition();
+	ownedWidget->invalidateMeasure();
+}
+
+WidgetSlot::~WidgetSlot()
+{
+	if (m_ownedWidget != nullptr && m_ownedWidget->m_owningSlot == this)
+		m_ownedWidget->m_owningSlot = nullptr;
 }
 
 Widget* WidgetSlot::getOwnedWidget() const
@@ -448,6 +452,14 @@ const WidgetPadding& WidgetSlot::getPadding() const
 {
 	return m_padding;
 }
+int WidgetSlot::getIndexInLayer() const
+{
+	return m_indexInLayer;
+}
+void WidgetSlot::setIndexInLayer(int index)
+{
+	m_indexInLayer = index;
+}
 
 void WidgetSlot::setSizeToContent(bool sizeToContent)
 {
@@ -455,8 +467,9 @@ void WidgetSlot::setSizeToContent(bool sizeToContent)
 	{
 		m_sizeToContent = sizeToContent;
 
-		if (m_owningLayer != nullptr)
-			m_owningLayer->updateSlotsRecur();
+		// the desired size of the widget and the way its layer is arranged both depend on it
+		m_ownedWidget->invalidateLayout();
+		m_ownedWidget->invalidateMeasure();
 	}
 }
 void WidgetSlot::setPadding(const WidgetPadding& padding)
@@ -465,8 +478,9 @@ void WidgetSlot::setPadding(const WidgetPadding& padding)
 	{
 		m_padding = padding;
 
-		if (m_owningLayer != nullptr)
-			m_owningLayer->updateSlotsRecur();
+		// the padding moves and resizes the layer of the widget
+		m_ownedWidget->invalidateLayout();
+		m_ownedWidget->invalidatePosition();
 	}
 }
 
@@ -476,6 +490,8 @@ void WidgetSlot::setPadding(const WidgetPadding& padding)
 
 RawSlot::RawSlot(BaseWidgetLayer* _owningLayer, std::shared_ptr<Widget> _ownedWidget)
 	: WidgetSlot(_owningLayer, _ownedWidget)
+	, m_size(0, 0)
+	, m_position(0, 0)
 {}
 RawSlot::~RawSlot()
 {}
@@ -492,8 +508,13 @@ const glm::vec2& RawSlot::getSize() const
 
 void RawSlot::setPosition(const glm::vec2& position)
 {
+	if (m_position == position)
+		return;
+
 	m_position = position;
-	m_ownedWidget->setComputedRelativePosition(m_position);
+
+	if (m_owningLayer != nullptr)
+		m_owningLayer->invalidateLayout();
 }
 const glm::vec2 RawSlot::getPosition() const
 {
@@ -524,17 +545,23 @@ bool ListSlot::getFillY() const
 
 void ListSlot::setFillX(bool fillX)
 {
+	if (m_fillX == fillX)
+		return;
+
 	m_fillX = fillX;
 
 	if (m_owningLayer != nullptr)
-		m_owningLayer->updateSlotsRecur();
+		m_owningLayer->invalidateLayout();
 }
 void ListSlot::setFillY(bool fillY)
 {
+	if (m_fillY == fillY)
+		return;
+
 	m_fillY = fillY;
 
 	if (m_owningLayer != nullptr)
-		m_owningLayer->updateSlotsRecur();
+		m_owningLayer->invalidateLayout();
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -568,17 +595,17 @@ WidgetAnchor& CanvasSlot::getAnchor()
 ////// ViewportWidget
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ViewportWidget::draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void ViewportWidget::draw(UIBatchRenderer& renderer) const
 {
 	for (const auto& layer : m_layers)
 	{
-		layer.second->draw(boundProgram, m_computedBounds.extent);
+		layer.second->draw(renderer);
 	}
 }
 
 bool ViewportWidget::isMouseHovering(const glm::vec2& cursor) const
 {
-	return m_computedBounds.isPointInside(cursor);
+	return getComputedBounds().isPointInside(cursor);
 }
 
 bool ViewportWidget::acceptLayer() const
@@ -592,10 +619,7 @@ void ViewportWidget::setViewport(const glm::vec2& pos, const glm::vec2& extent)
 	setComputedSize(extent);
 	setPreferredSize(extent);
 
-	for (auto& layer : m_layers)
-	{
-		layer.second->updateSlotsRecur();
-	}
+	m_uiEngine->getHitTestGrid().setBounds(Rect(pos, extent));
 }
 
 //void ViewportWidget::setSize(const glm::vec2& size, bool updateChilds)
@@ -611,25 +635,34 @@ void ViewportWidget::setViewport(const glm::vec2& pos, const glm::vec2& extent)
 //	}
 //}
 
-void ViewportWidget::computePositionInViewportRecur()
+void ViewportWidget::appendLayoutChildren(std::vector<const WidgetBase*>& outChildren) const
 {
-	for (auto& layer : m_layers)
+	// the root, its relative position is its position in viewport
+	for (const auto& layer : m_layers)
 	{
-		layer.second->computePositionInViewportRecur();
+		for (int slotIndex = 0; slotIndex < layer.second->getSlotCount(); ++slotIndex)
+		{
+			outChildren.push_back(layer.second->getSlot(slotIndex)->getOwnedWidget());
+		}
 	}
 }
 
-void ViewportWidget::computeChildrenPositionInViewport()
+glm::vec2 ViewportWidget::computeDesiredSize()
 {
-	for (auto& layer : m_layers)
-	{
-		layer.second->computeChildrenPositionInViewport();
-	}
+	return getPreferredSize();
 }
 
-void ViewportWidget::computePositionInViewport()
+void ViewportWidget::updateLayersLayout(bool arrange)
 {
-	// nothing to do here
+	for (auto& layer : m_layers)
+	{
+		if (arrange && m_uiEngine->deferLayerLayout(layer.second.get()))
+			continue;
+
+		if (arrange)
+			layer.second->arrangeSlots();
+		layer.second->updateSlotsRecur();
+	}
 }
 
 // layer handling
@@ -637,8 +670,6 @@ void ViewportWidget::addLayer(std::shared_ptr<BaseWidgetLayer> layer, int zorder
 {
 	m_layers.insert(std::pair<int, std::shared_ptr<BaseWidgetLayer>>(zorder, layer));
 	layer->setOwningWidget(this);
-
-	layer->updateSlotsRecur();
 }
 
 void ViewportWidget::removeLayer(std::shared_ptr<BaseWidgetLayer> layer)
@@ -647,24 +678,57 @@ void ViewportWidget::removeLayer(std::shared_ptr<BaseWidgetLayer> layer)
 	if (found != m_layers.end())
 	{
 		m_layers.erase(found);
+		// its widgets aren't reachable by the hit tests anymore
+		layer->setOwningWidget(nullptr);
 	}
 }
 
 bool ViewportWidget::handleMouseMove(const glm::vec2 mousePos) 
 {
-	bool handled = false;
+	// the widgets are hovered even if their parents aren't
 	if (isMouseHovering(mousePos))
+		collectHitWidgets(mousePos, false);
+	else
+		m_hitWidgets.clear();
+
+	// a self hit test invisible widget is never hovered
+	m_hitWidgets.erase(std::remove_if(m_hitWidgets.begin(), m_hitWidgets.end(), [](const HitWidget& hit) { return hit.widget->getVisibility() == WidgetVisibility::SELF_HIT_TEST_INVISIBLE; }), m_hitWidgets.end());
+
+	std::vector<UIItem*>& hoveredItems = m_uiEngine->getHoveredItemsForWrite();
+
+	// leave the widgets which aren't under the cursor anymore
+	for (UIItem* hoveredItem : hoveredItems)
 	{
-		for (auto& layer : m_layers)
+		auto found = std::find_if(m_hitWidgets.begin(), m_hitWidgets.end(), [hoveredItem](const HitWidget& hit) { return hit.widget == hoveredItem; });
+		if (found == m_hitWidgets.end())
 		{
-			bool handledByChild = layer.second->handleMouseMove(mousePos);
-			handled = handled || handledByChild;
+			hoveredItem->onMouseLeave();
+			if (m_uiEngine->isDraggingItem())
+				hoveredItem->onDragLeave();
+
+			hoveredItem->setIsHovered(false);
 		}
 	}
-	else
+	hoveredItems.clear();
+
+	// then move and enter, children first
+	bool handled = false;
+	for (auto it = m_hitWidgets.rbegin(); it != m_hitWidgets.rend(); ++it)
 	{
-		// mouse is not in any child so we don't bubble this event on childs
-		handled = true;
+		Widget* widget = it->widget;
+		bool handledByWidget = widget->onMouseMove(mousePos);
+		handled = handled || handledByWidget;
+
+		if (!widget->getIsHovered())
+		{
+			widget->onMouseEnter();
+			if (m_uiEngine->isDraggingItem())
+				widget->onDragEnter();
+
+			widget->setIsHovered(true);
+		}
+
+		hoveredItems.push_back(widget);
 	}
 
 	return handled;
@@ -672,42 +736,62 @@ bool ViewportWidget::handleMouseMove(const glm::vec2 mousePos)
 
 bool ViewportWidget::handleMouseButtonPressed(int button, const glm::vec2& mousePos)
 {
-	bool handled = false;
-	if (isMouseHovering(mousePos))
+	if (!isMouseHovering(mousePos))
 	{
-		for (auto& layer : m_layers)
-		{
-			bool handledByChild = layer.second->handleMouseButtonPressed(button, mousePos);
-			handled = handled || handledByChild;
-		}
+		// mouse is not in any child so we don't bubble this event on childs
+		return true;
 	}
-	else
+
+	collectHitWidgets(mousePos, true);
+
+	// clicking outside of the selected item unselects it
+	UIItem* selectedItem = m_uiEngine->getSelectedItem();
+	if (selectedItem != nullptr && !selectedItem->isMouseHovering(mousePos))
+		m_uiEngine->deselectItem();
+
+	// parents first, the deepest widget without layer ends selected
+	for (auto& hit : m_hitWidgets)
 	{
-		// mouse is not in any child so we don't bubble this event on childs
-		handled = true;
+		if (hit.widget->getLayer() == nullptr)
+			m_uiEngine->selectItem(hit.widget);
+
+		m_uiEngine->addPressedItem(hit.widget);
 	}
 
-	return handled;
+	return dispatchToHitWidgets([button, &mousePos](Widget* widget) { return widget->onMouseButtonPressed(button, mousePos); });
 }
 
 bool ViewportWidget::handleMouseButtonReleased(int button, const glm::vec2& mousePos)
 {
-	bool handled = false;
-	if (isMouseHovering(mousePos))
-	{
-		for (auto& layer : m_layers)
-		{
-			bool handledByChild = layer.second->handleMouseButtonReleased(button, mousePos);
-			handled = handled || handledByChild;
-		}
-	}
-	else
+	if (!isMouseHovering(mousePos))
 	{
 		// mouse is not in any child so we don't bubble this event on childs
-		handled = true;
+		return true;
 	}
 
-	return handled;
+	collectHitWidgets(mousePos, true);
+
+	return dispatchToHitWidgets([button, &mousePos](Widget* widget) { return widget->onMouseButtonReleased(button, mousePos); });
+}
+
+bool ViewportWidget::handleDragOver(const glm::vec2& mousePos)
+{
+	if (!isMouseHovering(mousePos))
+		return false;
+
+	collectHitWidgets(mousePos, true);
+
+	return dispatchToHitWidgets([&mousePos](Widget* widget) { return widget->onDragOver(mousePos); });
+}
+
+bool ViewportWidget::handleDrop(const glm::vec2& mousePos)
+{
+	if (!isMouseHovering(mousePos))
+		return false;
+
+	collectHitWidgets(mousePos, true);
+
+	return dispatchToHitWidgets([&mousePos](Widget* widget) { return widget->onDrop(mousePos); });
 }
 
 bool ViewportWidget::handleKeyPressed(int key)
@@ -749,10 +833,132 @@ bool ViewportWidget::handleCharacter(unsigned int codepoint)
 	return handled;
 }
 
+int ViewportWidget::getLayerOrder(const BaseWidgetLayer* layer) const
+{
+	int order = 0;
+	for (const auto& item : m_layers)
+	{
+		if (item.second.get() == layer)
+			return order;
+		order++;
+	}
+	return -1;
+}
+
+bool ViewportWidget::isReachableByHitTest(const Widget* widget, const glm::vec2& mousePos, bool parentsMustContainCursor) const
+{
+	auto isHiddenFromHitTests = [](const WidgetBase* item)
+	{
+		return item->getVisibility() == WidgetVisibility::INVISILE
+			|| item->getVisibility() == WidgetVisibility::COLLAPSED
+			|| item->getVisibility() == WidgetVisibility::HIT_TEST_INVISIBLE;
+	};
+
+	if (isHiddenFromHitTests(widget))
+		return false;
+
+	// same rules as a recursive traversal from the root
+	const WidgetBase* parent = widget->getParentWidget();
+	while (parent != this)
+	{
+		// not attached to this viewport
+		if (parent == nullptr)
+			return false;
+
+		if (isHiddenFromHitTests(parent) || (parentsMustContainCursor && !parent->isMouseHovering(mousePos)))
+			return false;
+
+		parent = parent->getParentWidget();
+	}
+
+	return true;
+}
+
+void ViewportWidget::collectHitWidgets(const glm::vec2& mousePos, bool parentsMustContainCursor)
+{
+	m_hitWidgets.clear();
+	m_hitPaths.clear();
+
+	// only the widgets of the cursor cell are tested
+	m_uiEngine->getHitTestGrid().query(mousePos, m_hitTestCandidates);
+	for (UIItem* candidate : m_hitTestCandidates)
+	{
+		// only widgets are inserted in the grid
+		Widget* widget = static_cast<Widget*>(candidate);
+		if (!isReachableByHitTest(widget, mousePos, parentsMustContainCursor))
+			continue;
+
+		HitWidget hit;
+		hit.widget = widget;
+		hit.pathBegin = (int)m_hitPaths.size();
+		hit.parentIndex = -1;
+		hit.handledByChild = false;
+
+		const WidgetBase* current = widget;
+		while (current != this)
+		{
+			m_hitPaths.push_back(current->getOwningSlot()->getIndexInLayer());
+			const BaseWidgetLayer* layer = current->getOwningLayer();
+			current = layer->getOwningWidget();
+			if (current == this)
+				m_hitPaths.push_back(getLayerOrder(layer));
+		}
+		hit.pathSize = (int)m_hitPaths.size() - hit.pathBegin;
+		std::reverse(m_hitPaths.begin() + hit.pathBegin, m_hitPaths.end());
+
+		m_hitWidgets.push_back(hit);
+	}
+
+	// traversal order : layers by z-order, then slots order, parents before children
+	const int* paths = m_hitPaths.data();
+	std::sort(m_hitWidgets.begin(), m_hitWidgets.end(), [paths](const HitWidget& a, const HitWidget& b)
+	{
+		return std::lexicographical_compare(paths + a.pathBegin, paths + a.pathBegin + a.pathSize, paths + b.pathBegin, paths + b.pathBegin + b.pathSize);
+	});
+
+	// the parent of a hit widget is the closest previous widget whose path is a prefix of its path
+	m_hitParentStack.clear();
+	for (int hitIndex = 0; hitIndex < (int)m_hitWidgets.size(); ++hitIndex)
+	{
+		const HitWidget& hit = m_hitWidgets[hitIndex];
+		while (!m_hitParentStack.empty())
+		{
+			const HitWidget& parentHit = m_hitWidgets[m_hitParentStack.back()];
+			if (parentHit.pathSize < hit.pathSize && std::equal(paths + parentHit.pathBegin, paths + parentHit.pathBegin + parentHit.pathSize, paths + hit.pathBegin))
+				break;
+			m_hitParentStack.pop_back();
+		}
+
+		m_hitWidgets[hitIndex].parentIndex = m_hitParentStack.empty() ? -1 : m_hitParentStack.back();
+		m_hitParentStack.push_back(hitIndex);
+	}
+}
+
+bool ViewportWidget::dispatchToHitWidgets(const std::function<bool(Widget*)>& handler)
+{
+	bool handled = false;
+	for (int hitIndex = (int)m_hitWidgets.size() - 1; hitIndex >= 0; --hitIndex)
+	{
+		HitWidget& hit = m_hitWidgets[hitIndex];
+
+		bool hitHandled = hit.handledByChild;
+		if (!hitHandled && hit.widget->getVisibility() != WidgetVisibility::SELF_HIT_TEST_INVISIBLE)
+			hitHandled = handler(hit.widget);
+
+		if (hit.parentIndex >= 0)
+			m_hitWidgets[hit.parentIndex].handledByChild = m_hitWidgets[hit.parentIndex].handledByChild || hitHandled;
+		else
+			handled = handled || hitHandled;
+	}
+
+	return handled;
+}
+
 ///////////////////////////////////////////////////////////////////////
 
 ImageWidget::ImageWidget(UIEngine* uiengine, std::weak_ptr<VAO> shape, std::weak_ptr<ShaderProgram> program)
 	: Widget(uiengine, shape, program)
+	, m_uvRect(0, 0, 1, 1)
 {
 
 }
@@ -765,60 +971,86 @@ ImageWidget::~ImageWidget()
 void ImageWidget::setTexture(std::shared_ptr<Texture> texture)
 {
 	m_texture = texture;
+	m_uvRect = glm::vec4(0, 0, 1, 1);
+	m_pendingTexture = TextureHandle();
+	invalidateDraw();
 }
 
-const Texture* ImageWidget::getTexture() const
+void ImageWidget::setTexture(const TextureRegion& textureRegion)
 {
-	return m_texture.get();
+	setTexture(textureRegion.texture);
+	m_uvRect = textureRegion.uvRect;
 }
 
-void ImageWidget::draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void ImageWidget::setTexture(const TextureHandle& textureHandle)
 {
-	// self draw
-	if (m_program.expired() || m_shape.expired() || m_visibility == WidgetVisibility::INVISILE	|| m_visibility == WidgetVisibility::COLLAPSED)
-		return;
-
-	// we bind the program only if it is not already in use
-	auto program = m_program.lock();
-	if (program.get() != *boundProgram)
+	if (!textureHandle.isPending())
 	{
-		program->use();
-		*boundProgram = program.get();
+		setTexture(textureHandle.getTexture());
+		return;
 	}
 
-	// compute render box
-	glm::vec4 box = m_computedBounds.toVec4();
-	viewportTransform(box, viewportSize);
-	//box((m_posInViewport / (viewportSize * 0.5f)), m_box.extent / (viewportSize * 0.5f));
-	//box *= glm::vec4(1, -1, 1, -1);
-	//box += glm::vec4(-1, 1, 0, 0);
+	m_texture = nullptr;
+	m_pendingTexture = textureHandle;
+	m_uiEngine->watchPendingTexture(this);
+	invalidateDraw();
+}
 
-	// activate texture unit and bind texture
-	glActiveTexture(GL_TEXTURE0);
-	m_texture->bind();
+const Texture* ImageWidget::getTexture() const
+{
+	return m_texture.get();
+}
 
-	// update uniforms
-	glUniform4fv(glGetUniformLocation(program->getGLId(), "box"), 1, &box[0]/*&m_box.toVec4()[0]*/);
-	glUniform4fv(glGetUniformLocation(program->getGLId(), "tint"), 1, &getTint()[0]);
-	glUniform2fv(glGetUniformLocation(program->getGLId(), "viewportSize"), 1, &viewportSize[0]);
-	glUniform1f(glGetUniformLocation(program->getGLId(), "cornerRadius"), m_cornerRadius);
+const glm::vec4& ImageWidget::getUVRect() const
+{
+	return m_uvRect;
+}
 
-	// draw the widget shape
-	auto shape = m_shape.lock();
-	shape->draw();
+bool ImageWidget::isTexturePending() const
+{
+	return m_pendingTexture.isPending();
+}
 
-	// unbind texture
-	m_texture->unbind();
+bool ImageWidget::updatePendingTexture()
+{
+	// the texture has been replaced since
+	if (!m_pendingTexture.isValid())
+		return true;
 
-	// recursivity on layer slots
-	if (m_layer != nullptr)
-		m_layer->draw(boundProgram, viewportSize);
+	if (m_pendingTexture.isPending())
+		return false;
+
+	// nothing is drawn if the loading has failed
+	setTexture(m_pendingTexture.getTexture());
+	return true;
+}
+
+void ImageWidget::drawSelf(UIBatchRenderer& renderer) const
+{
+	Texture* texture = m_pendingTexture.isPending() ? m_uiEngine->getPlaceholderTexture() : m_texture.get();
+	if (m_program.expired() || texture == nullptr)
+		return;
+
+	const glm::vec4 uvRect = m_pendingTexture.isPending() ? glm::vec4(0, 0, 1, 1) : m_uvRect;
+	renderer.submitQuad(m_program.lock().get(), texture, UIQuadInstance(getComputedBounds().toVec4(), getTint(), uvRect, m_cornerRadius, QUAD_IMAGE));
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////
 
 
+// the run quads are only offset by the text origin
+static void submitTextRun(UIBatchRenderer& renderer, ShaderProgram* program, const TextRun& textRun, const glm::vec2& origin, const glm::vec4& tint)
+{
+	// all the glyphs share the same program, and the glyphs of an atlas page the same texture, so they end up in few batches
+	const glm::vec4 offset(origin, 0, 0);
+	UIENGINE_PROFILE_COUNT(UIProfileCounter::GLYPHS, textRun.glyphs.size());
+	for (const auto& glyph : textRun.glyphs)
+	{
+		renderer.submitQuad(program, glyph.texture, UIQuadInstance(glyph.box + offset, tint, glyph.uvRect, 0, QUAD_GLYPH));
+	}
+}
+
 TextWidget::TextWidget(UIEngine* uiengine, std::weak_ptr<VAO> shape, std::weak_ptr<ShaderProgram> program)
 	: Widget(uiengine, shape, program)
 {
@@ -833,6 +1065,8 @@ TextWidget::~TextWidget()
 void TextWidget::setFont(std::shared_ptr<Font> font)
 {
 	m_font = font;
+	updateTextRun();
+	invalidateDraw();
 }
 
 const Font* TextWidget::getFont() const
@@ -846,8 +1080,8 @@ void TextWidget::setText(const std::string& text)
 
 	assert(m_font && "set a font before modifying the text.");
 
-	m_textBounds = m_font->computeTextBounds(m_text);
-	setPreferredSize(m_textBounds.extent);
+	updateTextRun();
+	invalidateDraw();
 }
 
 const std::string& TextWidget::getText() const
@@ -855,66 +1089,34 @@ const std::string& TextWidget::getText() const
 	return m_text;
 }
 
-void TextWidget::draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void TextWidget::updateTextRun()
 {
-	// self draw
-	if (m_program.expired() || m_shape.expired() || m_visibility == WidgetVisibility::INVISILE || m_visibility == WidgetVisibility::COLLAPSED)
+	if (m_font == nullptr)
+	{
+		m_textRun = nullptr;
 		return;
+	}
 
-	drawText(boundProgram, viewportSize);
-
-	// recursivity on layer slots
-	if (m_layer != nullptr)
-		m_layer->draw(boundProgram, viewportSize);
+	// the bounds come with the layout, the text isn't walked again
+	m_textRun = m_uiEngine->getTextRunCache().getRun(*m_font, m_text);
+	m_textBounds = m_textRun->bounds;
+	setPreferredSize(m_textBounds.extent);
 }
 
-void TextWidget::drawText(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void TextWidget::drawSelf(UIBatchRenderer& renderer) const
 {
-	glPixelStorei(GL_PACK_ALIGNMENT, 1);
-
-	// we bind the program only if it is not already in use
-	auto program = m_program.lock();
-	if (program.get() != *boundProgram)
-	{
-		program->use();
-		*boundProgram = program.get();
-	}
-
-	// activate texture unit and bind texture
-	glActiveTexture(GL_TEXTURE0);
-	m_font->bindTexture();
-
-	glm::vec2 cursor = m_computedBounds.pos + glm::vec2(0, m_textBounds.extent.y);
-	glm::vec2 nextCursor(0, 0);
-	glm::vec4 glyphSrcRect;
-	glm::vec4 glyphDstRect;
-
-	for (const auto& character : m_text)
-	{
-		m_font->getGlyphDisplayInfos(character, cursor, nextCursor, glyphDstRect, glyphSrcRect);
-
-		// compute render box
-		glyphDstRect /= glm::vec4((viewportSize), (viewportSize));
-		glyphDstRect *= glm::vec4(2, -2, 2, -2);
-		glyphDstRect += glm::vec4(-1, 1, 0, 0);
-
-		// update uniforms
-		glUniform4fv(glGetUniformLocation(program->getGLId(), "box"), 1, &glyphDstRect[0]);
-		glUniform4fv(glGetUniformLocation(program->getGLId(), "glyphSrcRect"), 1, &glyphSrcRect[0]);
-		glUniform4fv(glGetUniformLocation(program->getGLId(), "tint"), 1, &getTint()[0]);
-		glUniform2fv(glGetUniformLocation(program->getGLId(), "viewportSize"), 1, &viewportSize[0]);
-
-		// draw the widget shape
-		auto shape = m_shape.lock();
-		shape->draw();
+	if (m_program.expired() || m_font == nullptr)
+		return;
 
-		cursor = nextCursor;
-	}
+	drawText(renderer);
+}
 
-	// unbind texture
-	m_font->unbindTexture();
+void TextWidget::drawText(UIBatchRenderer& renderer) const
+{
+	if (m_textRun == nullptr)
+		return;
 
-	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	submitTextRun(renderer, m_program.lock().get(), *m_textRun, getComputedPosition() + glm::vec2(0, m_textBounds.extent.y), getTint());
 }
 
 
@@ -925,6 +1127,8 @@ void TextWidget::drawText(ShaderProgram** boundProgram, const glm::vec2& viewpor
 TextInputWidget::TextInputWidget(UIEngine* uiengine, std::weak_ptr<VAO> shape, std::weak_ptr<ShaderProgram> textProgram, std::weak_ptr<ShaderProgram> cursorProgram)
 	: Widget(uiengine, shape, textProgram)
 	, m_cursorPos(0)
+	, m_isEditing(false)
+	, m_isMultiLine(false)
 	, m_cursorProgram(cursorProgram)
 {
 
@@ -938,6 +1142,24 @@ TextInputWidget::~TextInputWidget()
 void TextInputWidget::setFont(std::shared_ptr<Font> font)
 {
 	m_font = font;
+
+	// the widget keeps the font alive as long as the model
+	Font* advanceFont = m_font.get();
+	if (advanceFont != nullptr)
+	{
+		m_textModel.setAdvanceFunction([advanceFont](char character)
+		{
+			const Glyph* glyph = nullptr;
+			return advanceFont->getGlyphInfoFromChar((unsigned char)character, &glyph) ? (int)glyph->advanceInPixel : 0;
+		});
+	}
+	else
+	{
+		m_textModel.setAdvanceFunction(nullptr);
+	}
+
+	rebuildLineRuns();
+	invalidateDraw();
 }
 
 const Font* TextInputWidget::getFont() const
@@ -947,35 +1169,61 @@ const Font* TextInputWidget::getFont() const
 
 void TextInputWidget::setText(const std::string& text)
 {
-	m_text = text;
+	m_textModel.setText(text);
+	m_cursorPos = std::min(m_cursorPos, (int)m_textModel.size());
 
-	m_textBounds = m_font->computeTextBounds(m_text);
-	setPreferredSize(m_textBounds.extent);
+	rebuildLineRuns();
+	invalidateDraw();
 }
 
 const std::string& TextInputWidget::getText() const
 {
-	return m_text;
+	return m_textModel.getText();
+}
+
+const TextModel& TextInputWidget::getTextModel() const
+{
+	return m_textModel;
+}
+
+void TextInputWidget::setMultiLine(bool isMultiLine)
+{
+	m_isMultiLine = isMultiLine;
+}
+
+bool TextInputWidget::isMultiLine() const
+{
+	return m_isMultiLine;
 }
 
 void TextInputWidget::addCharacter(char character)
 {
-	m_text.insert(m_text.begin() + m_cursorPos, character);
+	insertText(std::string(1, character));
+}
 
-	m_textBounds = m_font->computeTextBounds(m_text);
-	setPreferredSize(m_textBounds.extent);
+void TextInputWidget::insertText(const std::string& text)
+{
+	if (text.empty())
+		return;
+
+	const int firstLine = m_textModel.getLineIndex(m_cursorPos);
+	const size_t offset = m_cursorPos - m_textModel.getLineStart(firstLine);
+	const int addedLineCount = (int)std::count(text.begin(), text.end(), '\n');
+	m_textModel.insert(m_cursorPos, text);
+	if (addedLineCount == 0)
+		updateLineChunks(firstLine, offset, 0, text.size());
+	else
+		updateLineRuns(firstLine, 1, 1 + addedLineCount);
 
-	cursorNext();
+	m_cursorPos += (int)text.size();
+	invalidateDraw();
 }
 
 void TextInputWidget::removePreviousCharacter()
 {
 	if (m_cursorPos > 0)
 	{
-		m_text.erase(m_text.begin() + (m_cursorPos - 1));
-
-		m_textBounds = m_font->computeTextBounds(m_text);
-		setPreferredSize(m_textBounds.extent);
+		removeCharacters(m_cursorPos - 1, 1);
 
 		cursorPrevious();
 	}
@@ -983,115 +1231,195 @@ void TextInputWidget::removePreviousCharacter()
 
 void TextInputWidget::removeNextCharacter()
 {
-	if (m_cursorPos < m_text.size())
+	if (m_cursorPos < (int)m_textModel.size())
 	{
-		m_text.erase(m_text.begin() + m_cursorPos);
-
-		m_textBounds = m_font->computeTextBounds(m_text);
-		setPreferredSize(m_textBounds.extent);
-
-		//cursorPrevious();
+		removeCharacters(m_cursorPos, 1);
+		invalidateDraw();
 	}
 }
 
+void TextInputWidget::removeCharacters(size_t index, size_t count)
+{
+	const int firstLine = m_textModel.getLineIndex(index);
+	const size_t offset = index - m_textModel.getLineStart(firstLine);
+	const int removedLineCount = m_textModel.getLineIndex(index + count) - firstLine;
+	m_textModel.erase(index, count);
+	if (removedLineCount == 0)
+		updateLineChunks(firstLine, offset, count, 0);
+	else
+		updateLineRuns(firstLine, 1 + removedLineCount, 1);
+}
+
 void TextInputWidget::cursorNext()
 {
-	m_cursorPos = std::min(std::max(0, m_cursorPos + 1), (int)(m_text.size()));
+	m_cursorPos = std::min(std::max(0, m_cursorPos + 1), (int)(m_textModel.size()));
+	invalidateDraw();
 }
 
 void TextInputWidget::cursorPrevious()
 {
-	m_cursorPos = std::min(std::max(0, m_cursorPos - 1), (int)(m_text.size()));
+	m_cursorPos = std::min(std::max(0, m_cursorPos - 1), (int)(m_textModel.size()));
+	invalidateDraw();
 }
 
-void TextInputWidget::draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void TextInputWidget::cursorUp()
 {
-	// self draw
-	if (m_program.expired() || m_shape.expired() || m_visibility == WidgetVisibility::INVISILE || m_visibility == WidgetVisibility::COLLAPSED)
+	setCursorLine(m_textModel.getLineIndex(m_cursorPos) - 1);
+}
+
+void TextInputWidget::cursorDown()
+{
+	setCursorLine(m_textModel.getLineIndex(m_cursorPos) + 1);
+}
+
+void TextInputWidget::cursorLineStart()
+{
+	m_cursorPos = (int)m_textModel.getLineStart(m_textModel.getLineIndex(m_cursorPos));
+	invalidateDraw();
+}
+
+void TextInputWidget::cursorLineEnd()
+{
+	m_cursorPos = (int)m_textModel.getLineEnd(m_textModel.getLineIndex(m_cursorPos));
+	invalidateDraw();
+}
+
+void TextInputWidget::setCursorLine(int lineIndex)
+{
+	if (lineIndex < 0 || lineIndex >= m_textModel.getLineCount())
 		return;
 
-	drawText(boundProgram, viewportSize);
-	if(getIsSelected())
-		drawCursor(boundProgram, viewportSize);
+	// keep the horizontal position of the cursor
+	int advance = 0;
+	int currentLine = 0;
+	m_textModel.getCursorPosition(m_cursorPos, advance, currentLine);
+	m_cursorPos = (int)m_textModel.getCursorIndex(lineIndex, (float)advance);
+	invalidateDraw();
+}
 
-	// recursivity on layer slots
-	if (m_layer != nullptr)
-		m_layer->draw(boundProgram, viewportSize);
+void TextInputWidget::setCursorFromPosition(const glm::vec2& relativePos)
+{
+	const float lineHeight = m_font != nullptr ? m_font->getLineHeight() : 0.0f;
+	const int lineIndex = lineHeight > 0 ? (int)std::floor(relativePos.y / lineHeight) : 0;
+	m_cursorPos = (int)m_textModel.getCursorIndex(lineIndex, relativePos.x);
+	invalidateDraw();
 }
 
-void TextInputWidget::drawText(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void TextInputWidget::updateLineRuns(int firstLine, int oldLineCount, int newLineCount)
 {
-	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	if (m_font == nullptr)
+	{
+		m_lineChunks.clear();
+		return;
+	}
 
-	// we bind the program only if it is not already in use
-	auto program = m_program.lock();
-	if (program.get() != *boundProgram)
+	std::vector<std::vector<LineChunk>> lineChunks(newLineCount);
+	for (int lineIndex = firstLine; lineIndex < firstLine + newLineCount; ++lineIndex)
 	{
-		program->use();
-		*boundProgram = program.get();
+		const size_t lineStart = m_textModel.getLineStart(lineIndex);
+		layoutLineChunks(lineStart, m_textModel.getLineEnd(lineIndex) - lineStart, lineChunks[lineIndex - firstLine]);
 	}
 
-	// activate texture unit and bind texture
-	glActiveTexture(GL_TEXTURE0);
-	m_font->bindTexture();
+	const int lastOldLine = std::min(firstLine + oldLineCount, (int)m_lineChunks.size());
+	m_lineChunks.erase(m_lineChunks.begin() + std::min(firstLine, lastOldLine), m_lineChunks.begin() + lastOldLine);
+	m_lineChunks.insert(m_lineChunks.begin() + std::min(firstLine, (int)m_lineChunks.size()), lineChunks.begin(), lineChunks.end());
 
-	glm::vec2 cursor = m_computedBounds.pos + glm::vec2(0, m_textBounds.extent.y);
-	glm::vec2 nextCursor(0, 0);
-	glm::vec4 glyphSrcRect;
-	glm::vec4 glyphDstRect;
+	updateTextBounds();
+}
 
-	for (const auto& character : m_text)
+void TextInputWidget::updateLineChunks(int lineIndex, size_t offset, size_t removedCount, size_t insertedCount)
+{
+	if (m_font == nullptr || lineIndex >= (int)m_lineChunks.size())
 	{
-		m_font->getGlyphDisplayInfos(character, cursor, nextCursor, glyphDstRect, glyphSrcRect);
+		rebuildLineRuns();
+		return;
+	}
+
+	// the first chunk touched : the one of the first removed character, or the one the insertion is in or at the end of
+	std::vector<LineChunk>& chunks = m_lineChunks[lineIndex];
+	size_t firstChunk = 0;
+	size_t rangeStart = 0;
+	while (firstChunk + 1 < chunks.size() && rangeStart + chunks[firstChunk].characterCount + (removedCount == 0 ? 1 : 0) <= offset)
+	{
+		rangeStart += chunks[firstChunk].characterCount;
+		firstChunk++;
+	}
 
-		// compute render box
-		glyphDstRect /= glm::vec4((viewportSize), (viewportSize));
-		glyphDstRect *= glm::vec4(2, -2, 2, -2);
-		glyphDstRect += glm::vec4(-1, 1, 0, 0);
+	// up to the last removed character, and the small chunks left by the previous edits are merged with their next one
+	size_t endChunk = std::min(firstChunk + 1, chunks.size());
+	size_t rangeEnd = rangeStart + (chunks.empty() ? 0 : chunks[firstChunk].characterCount);
+	while (endChunk < chunks.size() && (rangeEnd < offset + removedCount || rangeEnd - rangeStart < s_lineChunkSize / 2))
+	{
+		rangeEnd += chunks[endChunk].characterCount;
+		endChunk++;
+	}
 
-		// update uniforms
-		glUniform4fv(glGetUniformLocation(program->getGLId(), "box"), 1, &glyphDstRect[0]);
-		glUniform4fv(glGetUniformLocation(program->getGLId(), "glyphSrcRect"), 1, &glyphSrcRect[0]);
-		glUniform4fv(glGetUniformLocation(program->getGLId(), "tint"), 1, &getTint()[0]);
-		glUniform2fv(glGetUniformLocation(program->getGLId(), "viewportSize"), 1, &viewportSize[0]);
+	std::vector<LineChunk> editedChunks;
+	layoutLineChunks(m_textModel.getLineStart(lineIndex) + rangeStart, rangeEnd - rangeStart - removedCount + insertedCount, editedChunks);
+	chunks.erase(chunks.begin() + firstChunk, chunks.begin() + endChunk);
+	chunks.insert(chunks.begin() + firstChunk, editedChunks.begin(), editedChunks.end());
 
-		// draw the widget shape
-		auto shape = m_shape.lock();
-		shape->draw();
+	updateTextBounds();
+}
 
-		cursor = nextCursor;
+void TextInputWidget::layoutLineChunks(size_t start, size_t count, std::vector<LineChunk>& chunks) const
+{
+	for (size_t chunkStart = 0; chunkStart < count; chunkStart += s_lineChunkSize)
+	{
+		const size_t characterCount = std::min((size_t)s_lineChunkSize, count - chunkStart);
+		chunks.push_back({ characterCount, TextRun::layout(*m_font, m_textModel.getSubstring(start + chunkStart, characterCount)) });
 	}
+}
 
-	// unbind texture
-	m_font->unbindTexture();
+void TextInputWidget::rebuildLineRuns()
+{
+	m_lineChunks.clear();
+	updateLineRuns(0, 0, m_textModel.getLineCount());
+}
 
-	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+void TextInputWidget::updateTextBounds()
+{
+	setPreferredSize(glm::vec2((float)m_textModel.getMaxLineAdvance(), m_textModel.getLineCount() * m_font->getLineHeight()));
 }
 
+void TextInputWidget::drawSelf(UIBatchRenderer& renderer) const
+{
+	if (m_program.expired() || m_font == nullptr)
+		return;
+
+	drawText(renderer);
+	if(getIsSelected())
+		drawCursor(renderer);
+}
 
-void TextInputWidget::drawCursor(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const
+void TextInputWidget::drawText(UIBatchRenderer& renderer) const
 {
-	// we bind the program only if it is not already in use
-	auto program = m_cursorProgram.lock();
-	if (program.get() != *boundProgram)
+	ShaderProgram* program = m_program.lock().get();
+	glm::vec2 origin = getComputedPosition() + glm::vec2(0, m_font->getAscender());
+	for (const auto& chunks : m_lineChunks)
 	{
-		program->use();
-		*boundProgram = program.get();
+		// the font has no kerning, a chunk starts at the advance of the previous ones
+		glm::vec2 chunkOrigin = origin;
+		for (const LineChunk& chunk : chunks)
+		{
+			submitTextRun(renderer, program, *chunk.run, chunkOrigin, getTint());
+			chunkOrigin.x += chunk.run->advance;
+		}
+		origin.y += m_font->getLineHeight();
 	}
+}
 
+void TextInputWidget::drawCursor(UIBatchRenderer& renderer) const
+{
+	if (m_cursorProgram.expired())
+		return;
 
-	// compute render box
-	glm::vec4 box(	m_computedBounds.pos + m_font->getCursorPos(m_text, m_cursorPos), glm::vec2(4, m_font->getMaxGlyphSize().y) );
-	viewportTransform(box, viewportSize);
-
-	// update uniforms
-	glUniform4fv(glGetUniformLocation(program->getGLId(), "box"), 1, &box[0]);
-	glUniform4fv(glGetUniformLocation(program->getGLId(), "tint"), 1, &getTint()[0]);
-	glUniform2fv(glGetUniformLocation(program->getGLId(), "viewportSize"), 1, &viewportSize[0]);
+	int advance = 0;
+	int lineIndex = 0;
+	m_textModel.getCursorPosition(m_cursorPos, advance, lineIndex);
+	glm::vec4 box(	getComputedPosition() + glm::vec2(advance, lineIndex * m_font->getLineHeight()), glm::vec2(4, m_font->getLineHeight()) );
 
-	// draw the widget shape
-	auto shape = m_shape.lock();
-	shape->draw();
+	renderer.submitQuad(m_cursorProgram.lock().get(), nullptr, UIQuadInstance(box, getTint(), glm::vec4(0, 0, 1, 1), 0, QUAD_SOLID));
 }
 
 
@@ -1136,8 +1464,8 @@ void DropDownWidget::displayDropDownList()
 {
 	m_uiEngine->getRootViewportWidget()->addLayer(m_dropDownListLayout, 10);
 
-	m_dropDownList->setComputedRelativePosition(m_selection->getComputedPosition() + glm::vec2(0, m_selection->getComputedBounds().extent.y));
-	m_dropDownList->updateLayer();
+	// the raw layer places the list at its slot position during the next layout pass
+	static_cast<RawSlot*>(m_dropDownList->getOwningSlot())->setPosition(m_selection->getComputedPosition() + glm::vec2(0, m_selection->getComputedBounds().extent.y));
 	m_dropDownList->setVisibility(WidgetVisibility::VISIBLE);
 }
 
@@ -1271,7 +1599,7 @@ WindowWidget::WindowWidget(UIEngine* uiengine, std::weak_ptr<VAO> shape, std::we
 	}
 	// content
 	{
-		auto content = std::make_shared<WindowFrameSlot>(true, m_uiEngine, m_shape, m_program);
+		auto content = std::allocate_shared<WindowFrameSlot>(m_uiEngine->getObjectAllocator(), true, m_uiEngine, m_shape, m_program);
 
 		auto contentSlot = backgroundLayout->addSlotAs<ListSlot>(content);
 		contentSlot->setFillX(true);
@@ -1489,7 +1817,7 @@ void WindowFrameSlot::splitAndAdd(int indexOffset, bool requetedAlignmentIsHoriz
 	{
 		std::shared_ptr<Widget> savedChild = getLayer()->getSlot(frameIndex)->getOwnedWidgetShared();
 		getLayer()->removeSlot(frameIndex);
-		auto newChild = std::make_shared<WindowFrameSlot>(requetedAlignmentIsHorizontal, m_uiEngine, m_shape, m_program);
+		auto newChild = std::allocate_shared<WindowFrameSlot>(m_uiEngine->getObjectAllocator(), requetedAlignmentIsHorizontal, m_uiEngine, m_shape, m_program);
 		getLayer()->insertSlot(newChild, frameIndex);
 
 		//////////////////
@@ -7,6 +7,11 @@
 #include "Utils.h"
 #include "UIItem.h"
 #include "OpenglUtils.h"
+#include "TextureLoader.h"
+#include "TextureAtlas.h"
+#include "TextRun.h"
+#include "TextModel.h"
+#include "UILayoutNodes.h"
 
 #include "GLFW/glfw3.h" //Todo : remove dependency
 
@@ -74,24 +79,44 @@ enum WidgetVisibility
 class WidgetBase : public UIItem
 {
 protected:
-	// the resulting bounding box in viewport
-	Rect m_computedBounds;
-	// the preferred size of this widget
-	glm::vec2 m_preferredSize;
-	// the computed position, relative to its parent layout
-	glm::vec2 m_computedRelativePosition;
+	// the preferred size, the computed size, the position relative to the parent layout and the position in viewport
+	// are stored by the engine layout nodes, see UILayoutNodes
+	UILayoutNodes* m_layoutNodes;
+	int m_layoutHandle;
 
 	WidgetVisibility m_visibility;
 
+	// layout state
+	// the modifications only set these flags, the layout is computed once per frame by UIEngine::updateLayout
+	glm::vec2 m_desiredSize;
+	bool m_measureDirty;		// m_desiredSize has to be computed again
+	bool m_layoutDirty;			// the layer slots have to be arranged again
+	bool m_childLayoutDirty;	// a widget under this one has to be updated
+	bool m_positionDirty;		// the position in viewport has to be computed again, even if the relative position hasn't changed
+	// the relative position and the size used by the last layout pass, to detect the changes
+	glm::vec2 m_layoutRelativePosition;
+	glm::vec2 m_layoutSize;
+
 public:
 	WidgetBase(UIEngine* uiengine);
-	virtual ~WidgetBase()
-	{}
+	virtual ~WidgetBase();
 
 	// visibility
 	void setVisibility(WidgetVisibility visibility)
 	{
+		if (m_visibility == visibility)
+			return;
+
+		// a collapsed widget doesn't take any space
+		bool collapseChanged = m_visibility == WidgetVisibility::COLLAPSED || visibility == WidgetVisibility::COLLAPSED;
+		// an hidden widget isn't recorded in the draw list
+		bool drawnChanged = isDrawnWithVisibility(m_visibility) != isDrawnWithVisibility(visibility);
 		m_visibility = visibility;
+
+		if (collapseChanged)
+			invalidateMeasure();
+		if (drawnChanged)
+			invalidateDrawList();
 	}
 	WidgetVisibility getVisibility() const
 	{
@@ -101,45 +126,75 @@ public:
 	// preferred size
 	virtual void setPreferredSize(const glm::vec2& preferredSize)
 	{
-		m_preferredSize = preferredSize;
+		m_layoutNodes->setPreferredSize(m_layoutHandle, preferredSize);
 	}
 	const glm::vec2& getPreferredSize() const
 	{
-		return m_preferredSize;
+		return m_layoutNodes->getPreferredSize(m_layoutHandle);
 	}
 
-	// computed transform
-	// compute the position of the m_computedBounds based on parents position
-	virtual void computePositionInViewport() = 0;
-	virtual void computeChildrenPositionInViewport() = 0;
-	virtual void computePositionInViewportRecur() = 0;
+	// layout
+	// the desired size changed, the parent has to place this widget again
+	void invalidateMeasure();
+	// the slots of this widget have to be arranged again
+	void invalidateLayout();
+	// the parent has changed, the position in viewport has to be computed again
+	void invalidatePosition();
+	// size wanted by this widget, computed once after each invalidation
+	const glm::vec2& measure();
+	// arrange this widget and the dirty widgets under it, the moved widgets are placed in viewport after the pass by UILayoutNodes::updatePositions
+	void updateLayout();
+	bool isSizedToContent() const;
+	bool needLayoutUpdate() const
+	{
+		return m_layoutDirty || m_childLayoutDirty || m_positionDirty;
+	}
+	// updateLayout would return immediately
+	bool isLayoutUpToDate() const
+	{
+		return !needLayoutUpdate() && getComputedRelativePosition() == m_layoutRelativePosition && getComputedSize() == m_layoutSize;
+	}
 
+	// rendering
+	// the quads of this widget have changed, only them are recorded and drawn again
+	void invalidateDraw();
+	// this widget has been shown or hidden, the whole draw list is recorded again
+	void invalidateDrawList();
+
+	// computed transform
+	// used by the layers to place the widget, the position in viewport is computed by the next layout pass
 	void setComputedRelativePosition(const glm::vec2& position)
 	{
-		m_computedRelativePosition = position;
-		m_computedBounds.pos = position;
-
-		computePositionInViewport();
+		if (getComputedRelativePosition() != position)
+		{
+			m_layoutNodes->setRelativePosition(m_layoutHandle, position);
+			propagateLayoutRequest();
+		}
 	}
 	void setComputedSize(const glm::vec2& size)
 	{
-		m_computedBounds.extent = size;
+		if (getComputedSize() != size)
+		{
+			m_layoutNodes->setSize(m_layoutHandle, size);
+			propagateLayoutRequest();
+		}
 	}
 	const glm::vec2& getComputedRelativePosition() const
 	{
-		return m_computedRelativePosition;
+		return m_layoutNodes->getRelativePosition(m_layoutHandle);
 	}
 	const glm::vec2& getComputedSize() const
 	{
-		return m_computedBounds.extent;
+		return m_layoutNodes->getSize(m_layoutHandle);
 	}
 	const glm::vec2& getComputedPosition() const
 	{
-		return m_computedBounds.pos;
+		return m_layoutNodes->getPosition(m_layoutHandle);
 	}
-	const Rect& getComputedBounds() const
+	// the resulting bounding box in viewport
+	Rect getComputedBounds() const
 	{
-		return m_computedBounds;
+		return Rect(getComputedPosition(), getComputedSize());
 	}
 	void scaleComputedSizeBy(const glm::vec2& scaleFactor)
 	{
@@ -153,6 +208,39 @@ public:
 	// hierarchy
 	virtual WidgetSlot* getOwningSlot() const = 0;
 	virtual BaseWidgetLayer* getOwningLayer() const = 0;
+	WidgetBase* getParentWidget() const;
+	UIItem* getParentItem() const override
+	{
+		return getParentWidget();
+	}
+	bool isInputEnabled() const override
+	{
+		return m_visibility != WidgetVisibility::INVISILE && m_visibility != WidgetVisibility::COLLAPSED && m_visibility != WidgetVisibility::HIT_TEST_INVISIBLE;
+	}
+	bool isSelfInputEnabled() const override
+	{
+		return m_visibility != WidgetVisibility::SELF_HIT_TEST_INVISIBLE;
+	}
+	// used by UILayoutNodes to sort the nodes in tree order
+	int getLayoutHandle() const
+	{
+		return m_layoutHandle;
+	}
+	virtual void appendLayoutChildren(std::vector<const WidgetBase*>& outChildren) const = 0;
+
+protected:
+	// desired size, without cache
+	virtual glm::vec2 computeDesiredSize() = 0;
+	// arrange the layers slots if needed, then update the slots which need it
+	virtual void updateLayersLayout(bool arrange) = 0;
+
+private:
+	// mark the parents so the next layout pass reaches this widget
+	void propagateLayoutRequest();
+	static bool isDrawnWithVisibility(WidgetVisibility visibility)
+	{
+		return visibility != WidgetVisibility::INVISILE && visibility != WidgetVisibility::COLLAPSED;
+	}
 };
 
 class Widget : public WidgetBase
@@ -196,43 +284,42 @@ public:
 	// preferred size
 	virtual void setPreferredSize(const glm::vec2& preferredSize)
 	{
+		if (preferredSize == getPreferredSize())
+			return;
+
 		WidgetBase::setPreferredSize(preferredSize);
-		// first we assume that the computed size is the same as the preferred size
-		setComputedSize(preferredSize);
-		// then we recompute the size from parent to obtain the real computed size
-		updateTransformFromParent();
+		// the real computed size is given by the parent during the next layout pass
+		invalidateMeasure();
 	}
 	//virtual void setSize(const glm::vec2& size, bool recursiveUpdateFromParent = false) override;
 	//void setPosition(const glm::vec2& pos, bool recursiveUpdateFromParent = false);
 	//void scaleBy(const glm::vec2& scaleFactor, bool recursiveUpdateFromParent = false);
 	//void addOffset(const glm::vec2& offset, bool recursiveUpdateFromParent = false);
 
-	virtual void computePositionInViewportRecur() override;
-	virtual void computeChildrenPositionInViewport() override;
-	virtual void computePositionInViewport() override;
-
-	void updateTransformFromParent();
-	void updateLayer(bool canUpdateParent = true, bool ignoreSizeToContent = false);
+	virtual void appendLayoutChildren(std::vector<const WidgetBase*>& outChildren) const override;
 
 	// rendering
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const override;
+	// draw self then the layer slots, skipped if the widget is invisible or collapsed
+	virtual void draw(UIBatchRenderer& renderer) const override;
+	// submit the quads of this widget only
+	virtual void drawSelf(UIBatchRenderer& renderer) const override;
 
 	// events
+	// the mouse events are dispatched by the ViewportWidget to the widgets under the cursor
 	virtual bool isMouseHovering(const glm::vec2& cursor) const override;
 
-	virtual bool handleMouseMove(const glm::vec2 mousePos) override;
-	virtual bool handleMouseButtonPressed(int button, const glm::vec2& mousePos) override;
-	virtual bool handleMouseButtonReleased(int button, const glm::vec2& mousePos) override;
 	virtual bool handleKeyPressed(int key) override;
 	virtual bool handleKeyReleased(int key) override;
 	virtual bool handleCharacter(unsigned int codepoint) override;
-	virtual bool handleDragOver(const glm::vec2& mousePos) override;
-	virtual bool handleDrop(const glm::vec2& mousePos) override;
 
 	// properties
 	void setTint(const glm::vec4& tint)
 	{
+		if (m_tint == tint)
+			return;
+
 		m_tint = tint;
+		invalidateDraw();
 	}
 	const glm::vec4& getTint() const
 	{
@@ -240,12 +327,20 @@ public:
 	}
 	void setCornerRadius(float cornerRadius)
 	{
+		if (m_cornerRadius == cornerRadius)
+			return;
+
 		m_cornerRadius = cornerRadius;
+		invalidateDraw();
 	}
 	float getCornerRadius() const
 	{
 		return m_cornerRadius;
 	}
+
+protected:
+	virtual glm::vec2 computeDesiredSize() override;
+	virtual void updateLayersLayout(bool arrange) override;
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -258,11 +353,12 @@ protected:
 
 	bool m_sizeToContent;
 	WidgetPadding m_padding;
+	// position in the owning layer, kept up to date by the layer
+	int m_indexInLayer;
 
 public:
 	WidgetSlot(BaseWidgetLayer* owningLayer, std::shared_ptr<Widget> ownedWidget);
-	virtual ~WidgetSlot()
-	{}
+	virtual ~WidgetSlot();
 
 	Widget* getOwnedWidget() const;
 	std::shared_ptr<Widget> getOwnedWidgetShared() const;
@@ -270,6 +366,8 @@ public:
 
 	bool getSizeToContent() const;
 	const WidgetPadding& getPadding() const;
+	int getIndexInLayer() const;
+	void setIndexInLayer(int index);
 
 	void setSizeToContent(bool sizeToContent);
 	void setPadding(const WidgetPadding& padding);
@@ -330,15 +428,33 @@ public:
 class ViewportWidget final : public WidgetBase
 {
 private:
+	// a widget under the cursor
+	struct HitWidget
+	{
+		Widget* widget;
+		// range in m_hitPaths : layer order then slot indices from the root, to sort the hit widgets like the recursive traversal
+		int pathBegin;
+		int pathSize;
+		// closest parent in the hit widgets, -1 if none
+		int parentIndex;
+		bool handledByChild;
+	};
+
 	// Current displayed items
 	std::multimap<int, std::shared_ptr<BaseWidgetLayer>> m_layers;
+	// widgets under the cursor for the current event, kept to reuse the allocations
+	std::vector<HitWidget> m_hitWidgets;
+	// the paths of all the hit widgets, one after the other
+	std::vector<int> m_hitPaths;
+	std::vector<int> m_hitParentStack;
+	std::vector<UIItem*> m_hitTestCandidates;
 
 public:
 	ViewportWidget(UIEngine* uiengine)
 		: WidgetBase(uiengine)
 	{}
 
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const override;
+	virtual void draw(UIBatchRenderer& renderer) const override;
 	virtual bool isMouseHovering(const glm::vec2& cursor) const override;
 	virtual bool acceptLayer() const override;
 	// has no owning slot
@@ -348,9 +464,7 @@ public:
 
 	void setViewport(const glm::vec2& pos, const glm::vec2& extent);
 	//void setSize(const glm::vec2& size, bool updateChilds = true) override;
-	void computePositionInViewportRecur() override;
-	virtual void computeChildrenPositionInViewport() override;
-	void computePositionInViewport() override;
+	virtual void appendLayoutChildren(std::vector<const WidgetBase*>& outChildren) const override;
 
 	// layer handling
 	void addLayer(std::shared_ptr<BaseWidgetLayer> layer, int zorder);
@@ -363,6 +477,21 @@ public:
 	virtual bool handleKeyPressed(int key) override;
 	virtual bool handleKeyReleased(int key) override;
 	virtual bool handleCharacter(unsigned int codepoint) override;
+	virtual bool handleDragOver(const glm::vec2& mousePos) override;
+	virtual bool handleDrop(const glm::vec2& mousePos) override;
+
+protected:
+	virtual glm::vec2 computeDesiredSize() override;
+	virtual void updateLayersLayout(bool arrange) override;
+
+private:
+	// hit tests
+	int getLayerOrder(const BaseWidgetLayer* layer) const;
+	bool isReachableByHitTest(const Widget* widget, const glm::vec2& mousePos, bool parentsMustContainCursor) const;
+	// fill m_hitWidgets with the widgets under the cursor, parents first
+	void collectHitWidgets(const glm::vec2& mousePos, bool parentsMustContainCursor);
+	// children first, a widget receives the event only if none of its children has handled it
+	bool dispatchToHitWidgets(const std::function<bool(Widget*)>& handler);
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -371,15 +500,27 @@ class ImageWidget : public Widget
 {
 private:
 	std::shared_ptr<Texture> m_texture;
+	// part of m_texture displayed, the whole texture except for the atlas regions
+	glm::vec4 m_uvRect;
+	// texture still loading, the engine placeholder is drawn meanwhile
+	TextureHandle m_pendingTexture;
 
 public:
 	ImageWidget(UIEngine* uiengine, std::weak_ptr<VAO> shape, std::weak_ptr<ShaderProgram> program);
 	virtual ~ImageWidget();
 
 	void setTexture(std::shared_ptr<Texture> texture);
+	// the texture is displayed once the TextureLoader has uploaded it
+	void setTexture(const TextureHandle& textureHandle);
+	// the widgets displaying regions of the same atlas page are drawn together
+	void setTexture(const TextureRegion& textureRegion);
 	const Texture* getTexture() const;
+	const glm::vec4& getUVRect() const;
+	bool isTexturePending() const;
+	// called by the engine each frame while the texture is pending, return true once it is ready or has failed
+	bool updatePendingTexture();
 
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const override;
+	virtual void drawSelf(UIBatchRenderer& renderer) const override;
 };
 
 class TextWidget : public Widget
@@ -388,6 +529,8 @@ private:
 	std::shared_ptr<Font> m_font;
 	std::string m_text;
 	Rect m_textBounds;
+	// laid out again only when the text or the font changes, shared with the widgets displaying the same text
+	std::shared_ptr<const TextRun> m_textRun;
 
 public:
 	TextWidget(UIEngine* uiengine, std::weak_ptr<VAO> shape, std::weak_ptr<ShaderProgram> program);
@@ -398,8 +541,11 @@ public:
 	void setText(const std::string& text);
 	const std::string& getText() const;
 
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const override;
-	void drawText(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const;
+	virtual void drawSelf(UIBatchRenderer& renderer) const override;
+	void drawText(UIBatchRenderer& renderer) const;
+
+private:
+	void updateTextRun();
 };
 
 class TextInputWidget : public Widget
@@ -408,11 +554,28 @@ public:
 	std::function<void()> onTextCommit;
 
 private:
+	// consecutive characters of a line, laid out together
+	struct LineChunk
+	{
+		size_t characterCount;
+		std::shared_ptr<const TextRun> run;
+	};
+
+	enum : size_t
+	{
+		s_lineChunkSize = 64,
+	};
+
 	std::shared_ptr<Font> m_font;
-	std::string m_text;
-	Rect m_textBounds;
+	// an edit only updates the model and lays out the lines it touches, the rest of the text isn't read
+	TextModel m_textModel;
+	// the runs of each line, in chunks of s_lineChunkSize characters at most : typing lays out the chunk of the cursor again,
+	// the next chunks of the line are only drawn further. Not shared : the edited texts are rarely displayed elsewhere
+	std::vector<std::vector<LineChunk>> m_lineChunks;
 	int m_cursorPos;
 	bool m_isEditing;
+	// enter inserts a new line instead of committing the text
+	bool m_isMultiLine;
 	std::weak_ptr<ShaderProgram> m_cursorProgram;
 
 public:
@@ -423,15 +586,37 @@ public:
 	const Font* getFont() const;
 	void setText(const std::string& text);
 	const std::string& getText() const;
+	const TextModel& getTextModel() const;
+	void setMultiLine(bool isMultiLine);
+	bool isMultiLine() const;
 	void addCharacter(char character);
+	void insertText(const std::string& text);
 	void removePreviousCharacter();
 	void removeNextCharacter();
 	void cursorNext();
 	void cursorPrevious();
+	void cursorUp();
+	void cursorDown();
+	void cursorLineStart();
+	void cursorLineEnd();
+	void setCursorFromPosition(const glm::vec2& relativePos);
+
+	virtual void drawSelf(UIBatchRenderer& renderer) const override;
+	void drawText(UIBatchRenderer& renderer) const;
+	void drawCursor(UIBatchRenderer& renderer) const;
 
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const override;
-	void drawText(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const;
-	void drawCursor(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const;
+private:
+	void removeCharacters(size_t index, size_t count);
+	// replace the runs of the lines [firstLine, firstLine + oldLineCount) by the runs of the lines [firstLine, firstLine + newLineCount)
+	void updateLineRuns(int firstLine, int oldLineCount, int newLineCount);
+	// the characters [offset, offset + removedCount) of the line have been replaced by insertedCount characters, without any line break
+	void updateLineChunks(int lineIndex, size_t offset, size_t removedCount, size_t insertedCount);
+	void layoutLineChunks(size_t start, size_t count, std::vector<LineChunk>& chunks) const;
+	void rebuildLineRuns();
+	void updateTextBounds();
+	void setCursorLine(int lineIndex);
+
+public:
 
 	virtual bool onKeyPressed(int key) override
 	{
@@ -449,6 +634,29 @@ public:
 			{
 				cursorPrevious();
 			}
+			else if (key == GLFW_KEY_UP)
+			{
+				cursorUp();
+			}
+			else if (key == GLFW_KEY_DOWN)
+			{
+				cursorDown();
+			}
+			else if (key == GLFW_KEY_HOME)
+			{
+				cursorLineStart();
+			}
+			else if (key == GLFW_KEY_END)
+			{
+				cursorLineEnd();
+			}
+			else if (key == GLFW_KEY_ENTER || key == GLFW_KEY_KP_ENTER)
+			{
+				if (m_isMultiLine)
+					addCharacter('\n');
+				else if (onTextCommit)
+					onTextCommit();
+			}
 
 			return true;
 		}
@@ -466,11 +674,19 @@ public:
 	}
 	virtual bool onMouseButtonPressed(int button, const glm::vec2& mousePos) override
 	{
-		glm::vec2 relativePos = mousePos - m_computedBounds.pos;
-		m_cursorPos = m_font->getCursorIdx(m_text, relativePos);
+		setCursorFromPosition(mousePos - getComputedPosition());
 
 		return true;
 	}
+	// the cursor is only drawn while selected
+	virtual void onItemSelected() override
+	{
+		invalidateDraw();
+	}
+	virtual void onItemUnselected() override
+	{
+		invalidateDraw();
+	}
 };
 
 struct ButtonStyle
@@ -1,11 +1,329 @@
 #include "WidgetLayer.h"
+#include "UIEngine.h"
 
 void BaseWidgetLayer::setOwningWidget(WidgetBase* owningWidget)
 {
 	m_owningWidget = owningWidget;
+
+	// the slots have to be placed again inside their new owner
+	for (int i = 0; i < getSlotCount(); ++i)
+	{
+		getSlot(i)->getOwnedWidget()->invalidatePosition();
+	}
+	invalidateSlots();
+}
+
+PoolAllocator<char> BaseWidgetLayer::getObjectAllocator() const
+{
+	return m_uiengine->getObjectAllocator();
 }
 
 bool BaseWidgetLayer::isAttachedToWidget() const
 {
 	return m_owningWidget != nullptr;
-}
\ No newline at end of file
+}
+
+bool BaseWidgetLayer::updateSlotsInParallel()
+{
+	UILayoutRecord* record = UIParallelLayout::getCurrentRecord();
+	if (record == nullptr)
+		return false;
+
+	// once arranged, a slot widget is laid out independently of its siblings, the big subtrees are given to the other threads.
+	// A widget sized to its content invalidates its parent when it changes, it stays on the thread of its parent
+	const UILayoutNodes& layoutNodes = m_uiengine->getLayoutNodes();
+	std::vector<WidgetBase*> taskWidgets;
+	for (int slotIndex = 0; slotIndex < getSlotCount(); ++slotIndex)
+	{
+		WidgetSlot* slot = getSlot(slotIndex);
+		WidgetBase* widget = slot->getOwnedWidget();
+		if (!slot->getSizeToContent() && !widget->isLayoutUpToDate() && layoutNodes.getSubtreeNodeCount(widget->getLayoutHandle()) >= UIParallelLayout::s_minTaskNodeCount)
+			taskWidgets.push_back(widget);
+	}
+	if (taskWidgets.empty())
+		return false;
+
+	// one record per task, appended in slot order once they are done
+	std::vector<UILayoutRecord> taskRecords(taskWidgets.size());
+	WorkStealingPool& pool = m_uiengine->getParallelLayout().getPool();
+	WorkStealingPool::TaskGroup tasks;
+	for (size_t taskIndex = 0; taskIndex < taskWidgets.size(); ++taskIndex)
+	{
+		WidgetBase* widget = taskWidgets[taskIndex];
+		UILayoutRecord* taskRecord = &taskRecords[taskIndex];
+		taskRecord->rootWidget = widget;
+		pool.run(tasks, [widget, taskRecord]()
+		{
+			// the thread may be waiting for its own tasks, its record is restored after this one
+			UILayoutRecord*& currentRecord = UIParallelLayout::getCurrentRecord();
+			UILayoutRecord* waitingRecord = currentRecord;
+			currentRecord = taskRecord;
+			widget->updateLayout();
+			currentRecord = waitingRecord;
+		});
+	}
+
+	// the small subtrees are laid out meanwhile, in the record of this thread
+	size_t nextTask = 0;
+	for (int slotIndex = 0; slotIndex < getSlotCount(); ++slotIndex)
+	{
+		WidgetBase* widget = getSlot(slotIndex)->getOwnedWidget();
+		if (nextTask < taskWidgets.size() && taskWidgets[nextTask] == widget)
+			nextTask++;
+		else
+			widget->updateLayout();
+	}
+	pool.wait(tasks);
+
+	for (const UILayoutRecord& taskRecord : taskRecords)
+	{
+		record->append(taskRecord);
+	}
+	return true;
+}
+
+void BaseWidgetLayer::invalidateLayout()
+{
+	if (m_owningWidget != nullptr)
+		m_owningWidget->invalidateLayout();
+}
+
+void BaseWidgetLayer::invalidateSlots()
+{
+	invalidateLayout();
+	m_uiengine->invalidateHierarchy();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////
+
+void VirtualListLayer::setItemWidgetFunction(const ItemWidgetFunction& itemWidgetFunction)
+{
+	m_itemWidgetFunction = itemWidgetFunction;
+	refreshItems();
+}
+
+void VirtualListLayer::setItemCount(int itemCount)
+{
+	m_itemCount = std::max(0, itemCount);
+	if (m_isItemExtentEstimated)
+		rebuildExtentTree();
+
+	m_scrollOffset = glm::clamp(m_scrollOffset, 0.0, getMaxScrollOffset());
+	refreshItems();
+}
+
+void VirtualListLayer::setItemExtent(float itemExtent, bool isEstimated)
+{
+	m_itemExtent = std::max(itemExtent, 1.0f);
+	m_isItemExtentEstimated = isEstimated;
+	if (m_isItemExtentEstimated)
+	{
+		rebuildExtentTree();
+	}
+	else
+	{
+		m_itemExtents.clear();
+		m_extentTree.clear();
+	}
+
+	invalidateLayout();
+}
+
+void VirtualListLayer::refreshItems()
+{
+	// the pool gives the widgets back to the item callback, which fills them again
+	for (auto& slot : m_slots)
+	{
+		recycleRow(slot);
+	}
+	m_slots.clear();
+	invalidateSlots();
+}
+
+void VirtualListLayer::setScrollOffset(double scrollOffset)
+{
+	scrollOffset = glm::clamp(scrollOffset, 0.0, getMaxScrollOffset());
+	if (scrollOffset == m_scrollOffset)
+		return;
+
+	m_scrollOffset = scrollOffset;
+	invalidateLayout();
+}
+
+double VirtualListLayer::getItemPosition(int itemIndex) const
+{
+	itemIndex = glm::clamp(itemIndex, 0, m_itemCount);
+	if (!m_isItemExtentEstimated)
+		return (double)itemIndex * m_itemExtent;
+
+	double position = 0;
+	for (int treeIndex = itemIndex; treeIndex > 0; treeIndex -= treeIndex & -treeIndex)
+	{
+		position += m_extentTree[treeIndex];
+	}
+	return position;
+}
+
+int VirtualListLayer::getItemAt(double position) const
+{
+	if (m_itemCount == 0)
+		return 0;
+
+	if (!m_isItemExtentEstimated)
+		return glm::clamp((int)std::floor(position / m_itemExtent), 0, m_itemCount - 1);
+
+	// descend the Fenwick tree, counting the items which end before the position
+	int itemIndex = 0;
+	int step = 1;
+	while (step * 2 <= m_itemCount)
+	{
+		step *= 2;
+	}
+	for (; step > 0; step /= 2)
+	{
+		const int next = itemIndex + step;
+		if (next <= m_itemCount && m_extentTree[next] <= position)
+		{
+			itemIndex = next;
+			position -= m_extentTree[next];
+		}
+	}
+	return std::min(itemIndex, m_itemCount - 1);
+}
+
+void VirtualListLayer::arrangeSlots()
+{
+	const glm::vec2 size = getSize();
+	m_scrollOffset = glm::clamp(m_scrollOffset, 0.0, getMaxScrollOffset());
+
+	// the measured extents of the new rows move the next ones, the visible range is stable after a few passes
+	for (int pass = 0; pass < 4; ++pass)
+	{
+		const int firstItem = getItemAt(m_scrollOffset);
+		const int endItem = m_itemCount > 0 && size.y > 0 && m_itemWidgetFunction ? getItemAt(m_scrollOffset + size.y) + 1 : firstItem;
+		const bool rowsChanged = updateVisibleRows(firstItem, endItem);
+
+		bool extentsChanged = false;
+		if (m_isItemExtentEstimated)
+		{
+			for (int slotIndex = 0; slotIndex < (int)m_slots.size(); ++slotIndex)
+			{
+				const float measuredExtent = m_slots[slotIndex]->getOwnedWidget()->measure().y;
+				extentsChanged = setEstimatedExtent(m_firstVisibleItem + slotIndex, measuredExtent) || extentsChanged;
+			}
+			m_scrollOffset = glm::clamp(m_scrollOffset, 0.0, getMaxScrollOffset());
+		}
+
+		if (!rowsChanged && !extentsChanged)
+			break;
+	}
+
+	for (int slotIndex = 0; slotIndex < (int)m_slots.size(); ++slotIndex)
+	{
+		const int itemIndex = m_firstVisibleItem + slotIndex;
+		ListSlot& slot = *m_slots[slotIndex];
+		Widget* widget = slot.getOwnedWidget();
+
+		const float width = slot.getFillX() ? size.x : widget->measure().x;
+		const float extent = m_isItemExtentEstimated ? m_itemExtents[itemIndex] : m_itemExtent;
+		widget->setComputedSize(glm::vec2(width, extent));
+		widget->setComputedRelativePosition(glm::vec2(0, (float)(getItemPosition(itemIndex) - m_scrollOffset)));
+	}
+}
+
+glm::vec2 VirtualListLayer::measureContent()
+{
+	// the width of the rows which aren't displayed is unknown
+	float contentWidth = 0;
+	for (auto& slot : m_slots)
+	{
+		contentWidth = std::max(contentWidth, slot->getOwnedWidget()->measure().x);
+	}
+	return glm::vec2(contentWidth, (float)getContentExtent());
+}
+
+bool VirtualListLayer::updateVisibleRows(int firstItem, int endItem)
+{
+	const int previousFirstItem = m_firstVisibleItem;
+	const int previousEndItem = m_firstVisibleItem + (int)m_slots.size();
+	if (firstItem == previousFirstItem && endItem == previousEndItem)
+		return false;
+
+	for (int itemIndex = previousFirstItem; itemIndex < previousEndItem; ++itemIndex)
+	{
+		if (itemIndex < firstItem || itemIndex >= endItem)
+			recycleRow(m_slots[itemIndex - previousFirstItem]);
+	}
+
+	std::vector<std::shared_ptr<ListSlot>> rows;
+	rows.reserve(endItem - firstItem);
+	for (int itemIndex = firstItem; itemIndex < endItem; ++itemIndex)
+	{
+		// the rows still visible keep their widget
+		if (itemIndex >= previousFirstItem && itemIndex < previousEndItem)
+		{
+			rows.push_back(m_slots[itemIndex - previousFirstItem]);
+			continue;
+		}
+
+		std::shared_ptr<Widget> recycledWidget;
+		if (!m_recycledWidgets.empty())
+		{
+			recycledWidget = m_recycledWidgets.back();
+			m_recycledWidgets.pop_back();
+		}
+
+		std::shared_ptr<Widget> widget = m_itemWidgetFunction(itemIndex, recycledWidget);
+		assert(widget != nullptr && widget.get() != m_owningWidget);
+
+		auto row = std::allocate_shared<ListSlot>(getObjectAllocator(), this, widget);
+		row->setFillX(true);
+		rows.push_back(row);
+		widget->onWidgetAddedToLayer();
+	}
+
+	m_slots = std::move(rows);
+	m_firstVisibleItem = firstItem;
+	updateSlotIndices(0);
+	m_uiengine->invalidateHierarchy();
+
+	return true;
+}
+
+void VirtualListLayer::recycleRow(const std::shared_ptr<ListSlot>& slot)
+{
+	// the row isn't displayed anymore, it must not be hit until it is used again
+	std::shared_ptr<Widget> widget = slot->getOwnedWidgetShared();
+	m_uiengine->getHitTestGrid().removeItem(widget.get());
+	m_recycledWidgets.push_back(widget);
+}
+
+void VirtualListLayer::rebuildExtentTree()
+{
+	m_itemExtents.assign(m_itemCount, m_itemExtent);
+
+	// built in O(n), each node gives its sum to its parent
+	m_extentTree.assign(m_itemCount + 1, 0.0);
+	for (int treeIndex = 1; treeIndex <= m_itemCount; ++treeIndex)
+	{
+		m_extentTree[treeIndex] += m_itemExtent;
+		const int parentIndex = treeIndex + (treeIndex & -treeIndex);
+		if (parentIndex <= m_itemCount)
+			m_extentTree[parentIndex] += m_extentTree[treeIndex];
+	}
+}
+
+bool VirtualListLayer::setEstimatedExtent(int itemIndex, float extent)
+{
+	extent = std::max(extent, 1.0f);
+	const double delta = (double)extent - m_itemExtents[itemIndex];
+	if (delta == 0)
+		return false;
+
+	m_itemExtents[itemIndex] = extent;
+	for (int treeIndex = itemIndex + 1; treeIndex <= m_itemCount; treeIndex += treeIndex & -treeIndex)
+	{
+		m_extentTree[treeIndex] += delta;
+	}
+	return true;
+}
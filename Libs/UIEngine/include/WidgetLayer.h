@@ -2,6 +2,7 @@
 
 #include "UIItem.h"
 #include "Widget.h"
+#include "ObjectPool.h"
 
 class BaseWidgetLayer// : public UIItem
 {
@@ -33,7 +34,7 @@ public:
 	}
 
 	// transform
-	const glm::vec2& getPosition() const
+	glm::vec2 getPosition() const
 	{
 		// We take the padding into account to place the layer into its owning widget
 		auto owningSlot = getOwningWidgetSlot();
@@ -46,7 +47,7 @@ public:
 			return glm::vec2(0, 0);
 	}
 
-	const glm::vec2& getRelativePosition() const
+	glm::vec2 getRelativePosition() const
 	{
 		// We take the padding into account to place the layer into its owning widget
 		auto owningSlot = getOwningWidgetSlot();
@@ -59,7 +60,7 @@ public:
 			return glm::vec2(0, 0);
 	}
 
-	const glm::vec2& getSize() const
+	glm::vec2 getSize() const
 	{
 		// We take the padding into account to place the layer into its owning widget
 		auto owningSlot = getOwningWidgetSlot();
@@ -72,8 +73,31 @@ public:
 			return glm::vec2(0, 0);
 	}
 
-	virtual void computePositionInViewportRecur() = 0;
-	virtual void computeChildrenPositionInViewport() = 0;
+	// allocator of the slots, from the engine pools
+	PoolAllocator<char> getObjectAllocator() const;
+
+	// layout
+	// the slots will be arranged again during the next layout pass
+	void invalidateLayout();
+	// slots have been added or removed : the layout and the draw list have to be built again
+	void invalidateSlots();
+	// set the size and the relative position of each slot widget, from their desired size
+	virtual void arrangeSlots() = 0;
+	// size needed by the slots, used when the owning widget is sized to its content
+	virtual glm::vec2 measureContent() = 0;
+	// update the slot widgets which have been modified
+	virtual void updateSlotsRecur() = 0;
+	// false if arranging the slots creates widgets : during a parallel layout pass, the layer is arranged by the UI thread after the pass
+	virtual bool canArrangeInParallel() const
+	{
+		return true;
+	}
+
+protected:
+	// during a parallel layout pass, lay the big slot subtrees out on the layout threads. False if the slots have to be updated in sequence
+	bool updateSlotsInParallel();
+
+public:
 
 	// slots handling
 	virtual WidgetSlot* addSlot(std::shared_ptr<Widget> widget) = 0;
@@ -85,8 +109,6 @@ public:
 	virtual void removeSlot(int slotIndex) = 0;
 	virtual void removeSlot(const UIItem* ownedItem) = 0;
 	virtual void clearSlots() = 0;
-	virtual void updateSlotsRecur(bool canUpdateParent = true, bool ignoreSizeToContent = false) = 0;
-	virtual void updateSlotsRects(bool canUpdateParent = true, bool ignoreSizeToContent = false) = 0;
 	virtual std::shared_ptr<WidgetSlot> getSlotShared(int slotIndex) const = 0;
 	virtual WidgetSlot* getSlot(int slotIndex) const = 0;
 	virtual int getSlotCount() const = 0;
@@ -98,18 +120,14 @@ public:
 	}
 
 	// rendering
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const = 0;
+	virtual void draw(UIBatchRenderer& renderer) const = 0;
 
 	// inputs
+	// the mouse events are dispatched through the hit test grid, see ViewportWidget
 	virtual bool isMouseHovering(const glm::vec2& cursor) const = 0;
-	virtual bool handleMouseMove(const glm::vec2 mousePos) = 0;
-	virtual bool handleMouseButtonPressed(int button, const glm::vec2& mousePos) = 0;
-	virtual bool handleMouseButtonReleased(int button, const glm::vec2& mousePos) = 0;
 	virtual bool handleKeyPressed(int key) = 0;
 	virtual bool handleKeyReleased(int key) = 0;
 	virtual bool handleCharacter(unsigned int codepoint) = 0;
-	virtual bool handleDragOver(const glm::vec2& mousePos) = 0;
-	virtual bool handleDrop(const glm::vec2& mousePos) = 0;
 	virtual bool handleDrag(const glm::vec2& mousePos) = 0;
 };
 
@@ -131,9 +149,10 @@ public:
 		// The child widget MUST be different than the owning widget !
 		assert(widget.get() != m_owningWidget);
 
-		auto newSlot = std::make_shared<SlotClass>(this, widget);
+		auto newSlot = std::allocate_shared<SlotClass>(getObjectAllocator(), this, widget);
+		newSlot->setIndexInLayer((int)m_slots.size());
 		m_slots.push_back(newSlot);
-		updateSlotsRecur();
+		invalidateSlots();
 		widget->onWidgetAddedToLayer();
 
 		return newSlot.get();
@@ -141,21 +160,24 @@ public:
 	void removeSlot(int slotIndex) override
 	{
 		m_slots.erase(m_slots.begin() + slotIndex);
-		updateSlotsRecur();
+		updateSlotIndices(slotIndex);
+		invalidateSlots();
 	}
 	void removeSlot(const UIItem* ownedItem) override
 	{
 		auto& found = std::find_if(m_slots.begin(), m_slots.end(), [ownedItem](const std::shared_ptr<SlotClass>& item) { return item->getOwnedWidget() == ownedItem; });
 		if (found != m_slots.end())
 		{
+			int slotIndex = (int)std::distance(m_slots.begin(), found);
 			m_slots.erase(found);
+			updateSlotIndices(slotIndex);
 		}
-		updateSlotsRecur();
+		invalidateSlots();
 	}
 	void clearSlots() override
 	{
 		m_slots.clear();
-		updateSlotsRecur();
+		invalidateSlots();
 	}
 	std::shared_ptr<WidgetSlot> getSlotShared(int slotIndex) const override
 	{
@@ -177,61 +199,33 @@ public:
 	}
 	WidgetSlot* insertSlot(std::shared_ptr<Widget> widget, int index) override
 	{
-		auto newSlot = std::make_shared<SlotClass>(this, widget);
+		auto newSlot = std::allocate_shared<SlotClass>(getObjectAllocator(), this, widget);
 		m_slots.insert(m_slots.begin() + index, newSlot);
+		updateSlotIndices(index);
 
-		updateSlotsRecur();
+		invalidateSlots();
 		widget->onWidgetAddedToLayer();
 
-		return newSlot;
-	}
-	
-	void updateSlotsRecur(bool canUpdateParent = true, bool ignoreSizeToContent = false) override
-	{
-		// first update child recursivly
-		for (auto& slot : m_slots)
-		{
-			slot->getOwnedWidget()->updateLayer(false, ignoreSizeToContent);
-		}
-
-		// then update self
-		if(m_owningWidget != nullptr && getOwningWidgetSlot() != nullptr)
-			updateSlotsRects(canUpdateParent, ignoreSizeToContent);
-
-		// make sur all position relative to viewport are up to date
-		for (auto& slot : m_slots)
-		{
-			slot->getOwnedWidget()->computeChildrenPositionInViewport();
-		}
-		//computePositionInViewportRecur();
+		return newSlot.get();
 	}
 
-	virtual void computePositionInViewportRecur() override
+	void updateSlotsRecur() override
 	{
-		for (auto& slot : m_slots)
-		{
-			slot->getOwnedWidget()->computePositionInViewportRecur();
-		}
-	}
+		if (updateSlotsInParallel())
+			return;
 
-	virtual void computeChildrenPositionInViewport() override
-	{
+		// each slot widget returns immediately if it has nothing to update
 		for (auto& slot : m_slots)
 		{
-			slot->getOwnedWidget()->computePositionInViewport();
+			slot->getOwnedWidget()->updateLayout();
 		}
 	}
 
-	//virtual void computePositionInViewport() override
-	//{
-	//	// nothing to do here
-	//}
-
-	virtual void draw(ShaderProgram** boundProgram, const glm::vec2& viewportSize) const override
+	virtual void draw(UIBatchRenderer& renderer) const override
 	{
 		for (const auto& slot : m_slots)
 		{
-			slot->getOwnedWidget()->draw(boundProgram, viewportSize);
+			slot->getOwnedWidget()->draw(renderer);
 		}
 	}
 	virtual bool isMouseHovering(const glm::vec2& cursor) const override
@@ -239,39 +233,6 @@ public:
 		return m_owningWidget->isMouseHovering(cursor);
 	}
 
-	virtual bool handleMouseMove(const glm::vec2 mousePos) override
-	{
-		bool handled = false;
-		for (auto& slot : m_slots)
-		{
-			bool childHandled = slot->getOwnedWidget()->handleMouseMove(mousePos);
-			handled = handled || childHandled;
-		}
-
-		return handled;
-	}
-	virtual bool handleMouseButtonPressed(int button, const glm::vec2& mousePos) override
-	{
-		bool handled = false;
-		for (auto& slot : m_slots)
-		{
-			bool childHandled = slot->getOwnedWidget()->handleMouseButtonPressed(button, mousePos);
-			handled = handled || childHandled;
-		}
-
-		return handled;
-	}
-	virtual bool handleMouseButtonReleased(int button, const glm::vec2& mousePos) override
-	{
-		bool handled = false;
-		for(auto& slot : m_slots)
-		{
-			bool childHandled = slot->getOwnedWidget()->handleMouseButtonReleased(button, mousePos);
-			handled = handled || childHandled;
-		}
-
-		return handled;
-	}
 	virtual bool handleKeyPressed(int key) override
 	{
 		bool handled = false;
@@ -305,38 +266,26 @@ public:
 
 		return handled;
 	}
-	virtual bool handleDragOver(const glm::vec2& mousePos) override
+	virtual bool handleDrag(const glm::vec2& mousePos) override
 	{
 		bool handled = false;
 		for (auto& slot : m_slots)
 		{
-			bool childHandled = slot->getOwnedWidget()->handleDragOver(mousePos);
+			bool childHandled = slot->getOwnedWidget()->handleDrag(mousePos);
 			handled = handled || childHandled;
 		}
 
 		return handled;
 	}
-	virtual bool handleDrop(const glm::vec2& mousePos) override
-	{
-		bool handled = false;
-		for (auto& slot : m_slots)
-		{
-			bool childHandled = slot->getOwnedWidget()->handleDrop(mousePos);
-			handled = handled || childHandled;
-		}
 
-		return handled;
-	}
-	virtual bool handleDrag(const glm::vec2& mousePos) override
+protected:
+	// the slots after an insertion or a removal have moved in the layer
+	void updateSlotIndices(int firstSlotIndex)
 	{
-		bool handled = false;
-		for (auto& slot : m_slots)
+		for (int slotIndex = firstSlotIndex; slotIndex < (int)m_slots.size(); ++slotIndex)
 		{
-			bool childHandled = slot->getOwnedWidget()->handleDrag(mousePos);
-			handled = handled || childHandled;
+			m_slots[slotIndex]->setIndexInLayer(slotIndex);
 		}
-
-		return handled;
 	}
 };
 
@@ -351,15 +300,25 @@ public:
 	virtual ~RawLayer()
 	{}
 
-	void updateSlotsRects(bool canUpdateParent, bool ignoreSizeToContent = false) override
+	void arrangeSlots() override
 	{
 		for (auto& slot : m_slots)
 		{
-			glm::vec2 slotInitialSize = slot->getOwnedWidget()->getVisibility() == WidgetVisibility::COLLAPSED ? glm::vec2(0, 0) : slot->getOwnedWidget()->getPreferredSize();
-			slot->getOwnedWidget()->setComputedSize(slotInitialSize);
+			slot->getOwnedWidget()->setComputedSize(slot->getOwnedWidget()->measure());
 			slot->getOwnedWidget()->setComputedRelativePosition(slot->getPosition());
 		}
 	}
+
+	glm::vec2 measureContent() override
+	{
+		// the slots are placed from the layer origin
+		glm::vec2 contentSize(0, 0);
+		for (auto& slot : m_slots)
+		{
+			contentSize = glm::max(contentSize, slot->getPosition() + slot->getOwnedWidget()->measure());
+		}
+		return contentSize;
+	}
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -373,73 +332,70 @@ public:
 	virtual ~CanvasLayer()
 	{}
 
-	void updateSlotsRects(bool canUpdateParent, bool ignoreSizeToContent = false) override
+	void arrangeSlots() override
 	{
 		// parent size (with padding)
+		glm::vec2 parentSize = getSize();
+		for (auto& slot : m_slots)
+		{
+			Rect slotRect = computeSlotRect(*slot, parentSize);
+			slot->getOwnedWidget()->setComputedSize(slotRect.extent);
+			slot->getOwnedWidget()->setComputedRelativePosition(slotRect.pos);
+		}
+	}
+
+	glm::vec2 measureContent() override
+	{
 		glm::vec2 parentSize = getSize();
 		Rect contentBounds;
 		int slotIndex = 0;
 		for (auto& slot : m_slots)
 		{
-			// reset the size to the preferred size before computation
-			glm::vec2 slotInitialSize = slot->getOwnedWidget()->getVisibility() == WidgetVisibility::COLLAPSED ? glm::vec2(0, 0) : slot->getOwnedWidget()->getPreferredSize();
-			slot->getOwnedWidget()->setComputedSize(slotInitialSize);
-
-			// self size
-			glm::vec2 selfSlotSize = slot->getAnchor().selfSize;
-			if (slot->getSizeToContent())
-			{
-				slot->getOwnedWidget()->updateLayer(false);
-
-				selfSlotSize = slot->getOwnedWidget()->getComputedSize();
-			}
-			else if (slot->getAnchor().hasProportionalScale)
-			{
-				selfSlotSize *= parentSize;
-			}
-			slot->getOwnedWidget()->setComputedSize(selfSlotSize);
-
-			// anchor to container position
-			glm::vec2 anchorPosition = slot->getAnchor().anchorPosition;
-			if (slot->getAnchor().hasProportionalAnchorPosition)
-			{
-				anchorPosition *= parentSize;
-			}
-
-			// self anchor position
-			glm::vec2 positionRelativeToAnchor = slot->getAnchor().positionRelativeToAnchor;
-			if (slot->getAnchor().hasProportionalPositionRelativeToAnchor)
-			{
-				positionRelativeToAnchor *= parentSize;
-			}
-
-			// pivot
-			glm::vec2 pivotValue = -slot->getAnchor().pivot * selfSlotSize;
-			slot->getOwnedWidget()->setComputedRelativePosition(anchorPosition + positionRelativeToAnchor);
-			slot->getOwnedWidget()->addOffsetToComputedPosition(pivotValue);
-
-			// update childs
-			if(!slot->getSizeToContent())
-				slot->getOwnedWidget()->updateLayer(false);
-
-			// compute content bounds
 			if (slotIndex == 0)
-				contentBounds = slot->getOwnedWidget()->getComputedBounds();
+				contentBounds = computeSlotRect(*slot, parentSize);
 			else
-				contentBounds.append(slot->getOwnedWidget()->getComputedBounds());
+				contentBounds.append(computeSlotRect(*slot, parentSize));
 
 			slotIndex++;
 		}
+		return contentBounds.extent;
+	}
+
+private:
+	// rect of the slot widget, relative to the layer
+	Rect computeSlotRect(CanvasSlot& slot, const glm::vec2& parentSize)
+	{
+		const WidgetAnchor& anchor = slot.getAnchor();
+
+		// self size
+		glm::vec2 selfSlotSize = anchor.selfSize;
+		if (slot.getSizeToContent())
+		{
+			selfSlotSize = slot.getOwnedWidget()->measure();
+		}
+		else if (anchor.hasProportionalScale)
+		{
+			selfSlotSize *= parentSize;
+		}
 
-		// if we are inside a widget which is setup to resize to its content, then we modify its size if the content size has changed, and we update its parent
-		if (!ignoreSizeToContent && getOwningWidgetSlot() != nullptr && getOwningWidgetSlot()->getOwningLayer() != nullptr
-			&& getOwningWidgetSlot()->getSizeToContent() && contentBounds.extent != getOwningWidget()->getComputedSize())
+		// anchor to container position
+		glm::vec2 anchorPosition = anchor.anchorPosition;
+		if (anchor.hasProportionalAnchorPosition)
 		{
-			m_owningWidget->setComputedSize(contentBounds.extent);
+			anchorPosition *= parentSize;
+		}
 
-			if(canUpdateParent)
-				m_owningWidget->getOwningLayer()->updateSlotsRects(false);
+		// self anchor position
+		glm::vec2 positionRelativeToAnchor = anchor.positionRelativeToAnchor;
+		if (anchor.hasProportionalPositionRelativeToAnchor)
+		{
+			positionRelativeToAnchor *= parentSize;
 		}
+
+		// pivot
+		glm::vec2 pivotValue = -anchor.pivot * selfSlotSize;
+
+		return Rect(anchorPosition + positionRelativeToAnchor + pivotValue, selfSlotSize);
 	}
 };
 
@@ -452,14 +408,17 @@ public:
 		: WidgetLayer<ListSlot>(uiengine)
 	{}
 
-	void updateSlotsRects(bool canUpdateParent, bool ignoreSizeToContent = false) override
+	void arrangeSlots() override
 	{
-		// We can't compute rect if we are not attached to a slot
-		if (getOwningWidgetSlot() == nullptr)
-			return;
+		// start from the desired sizes
+		for (auto& slot : m_slots)
+		{
+			slot->getOwnedWidget()->setComputedSize(slot->getOwnedWidget()->measure());
+		}
 
 		// We resize the childs only if the parent widget is not set as a sizeToContent widget
-		if (!getOwningWidgetSlot()->getSizeToContent())
+		WidgetSlot* owningWidgetSlot = getOwningWidgetSlot();
+		if (owningWidgetSlot == nullptr || !owningWidgetSlot->getSizeToContent())
 		{
 			// compute the availlable space for slots which fill on X and for slot which keep their preferred size
 			glm::vec2 availlableSize = getSize();
@@ -470,17 +429,8 @@ public:
 
 			for (auto& slot : m_slots)
 			{
-				// reset the size to the preferred size before computation
-				glm::vec2 slotInitialSize = slot->getOwnedWidget()->getVisibility() == WidgetVisibility::COLLAPSED ? glm::vec2(0, 0) : slot->getOwnedWidget()->getPreferredSize();
-				slot->getOwnedWidget()->setComputedSize(slotInitialSize);
-
-				bool fillX = slot->getFillX();
-				bool isSizedToContent = slot->getSizeToContent();
-				if (!fillX || isSizedToContent)
+				if (!slot->getFillX() || slot->getSizeToContent())
 				{
-					// update child to get its computed size
-					slot->getOwnedWidget()->updateLayer(false);
-
 					availlableSizeForFilledX -= slot->getOwnedWidget()->getComputedSize().x;
 					slotPreferedSizeXCount++;
 				}
@@ -497,11 +447,7 @@ public:
 				for (auto& slot : m_slots)
 				{
 					if (!slot->getFillX())
-					{
 						slot->getOwnedWidget()->scaleComputedSizeBy(glm::vec2(forceScale, 1.0f));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false, true);
-					}
 				}
 
 				availlableSizeForFilledX = 0;
@@ -513,65 +459,36 @@ public:
 				float availlableSizeForOneFilled = availlableSizeForFilledX / slotFilledSizeXCount;
 				for (auto& slot : m_slots)
 				{
+					glm::vec2 slotSize = slot->getOwnedWidget()->getComputedSize();
 					if (slot->getFillX() && slot->getFillY())
-					{
 						slot->getOwnedWidget()->setComputedSize(glm::vec2(availlableSizeForOneFilled, availlableSizeForFilledY));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false);
-					}
 					else if (slot->getFillX() && !slot->getFillY())
-					{
-						glm::vec2 slotSize = slot->getOwnedWidget()->getComputedSize();
 						slot->getOwnedWidget()->setComputedSize(glm::vec2(availlableSizeForOneFilled, slotSize.y));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false);
-					}
 					else if (!slot->getFillX() && slot->getFillY())
-					{
-						glm::vec2 slotSize = slot->getOwnedWidget()->getComputedSize();
 						slot->getOwnedWidget()->setComputedSize(glm::vec2(slotSize.x, availlableSizeForFilledY));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false);
-					}
 				}
 			}
-
-			// Once we have modified the size of childs, we need to update them
-			//for (auto& slot : m_slots)
-			//{
-			//	if(!slot->getSizeToContent())
-			//		slot->getOwnedWidget()->updateLayer();
-			//}
 		}
 
 		// update slots position
 		glm::vec2 cursor(0, 0);
-		float contentSizeX = 0;
-		float contentSizeY = 0;
 		for (auto& slot : m_slots)
 		{
 			slot->getOwnedWidget()->setComputedRelativePosition(cursor);
 			cursor.x += slot->getOwnedWidget()->getComputedSize().x;
-			contentSizeY = std::max(contentSizeY, slot->getOwnedWidget()->getComputedSize().y);
 		}
-		contentSizeX = cursor.x;
+	}
 
-		// If the current widget is a sizeToContent widget, we update its size based on the content
-		if (!ignoreSizeToContent && getOwningWidgetSlot()->getSizeToContent())
+	glm::vec2 measureContent() override
+	{
+		glm::vec2 contentSize(0, 0);
+		for (auto& slot : m_slots)
 		{
-			// We update only if the size has changed to avoid circulary calls
-			const glm::vec2& computedSize = m_owningWidget->getComputedSize();
-			if (computedSize != glm::vec2(contentSizeX, contentSizeY))
-			{
-				m_owningWidget->setComputedSize(glm::vec2(contentSizeX, contentSizeY));
-
-				if (canUpdateParent)
-				{
-					// this time we update the parent
-					m_owningWidget->getOwningSlot()->getOwningLayer()->updateSlotsRects(false);
-				}
-			}
+			const glm::vec2& slotSize = slot->getOwnedWidget()->measure();
+			contentSize.x += slotSize.x;
+			contentSize.y = std::max(contentSize.y, slotSize.y);
 		}
+		return contentSize;
 	}
 };
 
@@ -583,16 +500,19 @@ public:
 		: WidgetLayer<ListSlot>(uiengine)
 	{}
 
-	void updateSlotsRects(bool canUpdateParent, bool ignoreSizeToContent = false) override
+	void arrangeSlots() override
 	{
-		// We can't compute rect if we are not attached to a slot
-		if (getOwningWidgetSlot() == nullptr)
-			return;
+		// start from the desired sizes
+		for (auto& slot : m_slots)
+		{
+			slot->getOwnedWidget()->setComputedSize(slot->getOwnedWidget()->measure());
+		}
 
 		// We resize the childs only if the parent widget is not set as a sizeToContent widget
-		if (!getOwningWidgetSlot()->getSizeToContent())
+		WidgetSlot* owningWidgetSlot = getOwningWidgetSlot();
+		if (owningWidgetSlot == nullptr || !owningWidgetSlot->getSizeToContent())
 		{
-			// compute the availlable space for slots which fill on X and for slot which keep their preferred size
+			// compute the availlable space for slots which fill on Y and for slot which keep their preferred size
 			glm::vec2 availlableSize = getSize();
 			float availlableSizeForFilledX = availlableSize.x;
 			float availlableSizeForFilledY = availlableSize.y;
@@ -601,17 +521,8 @@ public:
 
 			for (auto& slot : m_slots)
 			{
-				// reset the size to the preferred size before computation
-				glm::vec2 slotInitialSize = slot->getOwnedWidget()->getVisibility() == WidgetVisibility::COLLAPSED ? glm::vec2(0, 0) : slot->getOwnedWidget()->getPreferredSize();
-				slot->getOwnedWidget()->setComputedSize(slotInitialSize);
-
-				bool fillY = slot->getFillY();
-				bool isSizedToContent = slot->getSizeToContent();
-				if (!fillY || isSizedToContent)
+				if (!slot->getFillY() || slot->getSizeToContent())
 				{
-					// update child to get its computed size
-					slot->getOwnedWidget()->updateLayer(false);
-
 					availlableSizeForFilledY -= slot->getOwnedWidget()->getComputedSize().y;
 					slotPreferedSizeYCount++;
 				}
@@ -628,11 +539,7 @@ public:
 				for (auto& slot : m_slots)
 				{
 					if (!slot->getFillY())
-					{
-						slot->getOwnedWidget()->scaleComputedSizeBy(glm::vec2(forceScale, 1.0f));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false, true);
-					}
+						slot->getOwnedWidget()->scaleComputedSizeBy(glm::vec2(1.0f, forceScale));
 				}
 
 				availlableSizeForFilledY = 0;
@@ -644,65 +551,164 @@ public:
 				float availlableSizeForOneFilled = availlableSizeForFilledY / slotFilledSizeYCount;
 				for (auto& slot : m_slots)
 				{
+					glm::vec2 slotSize = slot->getOwnedWidget()->getComputedSize();
 					if (slot->getFillX() && slot->getFillY())
-					{
-						slot->getOwnedWidget()->setComputedSize(glm::vec2(availlableSizeForOneFilled, availlableSizeForFilledY));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false);
-					}
-					else if (slot->getFillX() && !slot->getFillY())
-					{
-						glm::vec2 slotSize = slot->getOwnedWidget()->getComputedSize();
-						slot->getOwnedWidget()->setComputedSize(glm::vec2(availlableSizeForOneFilled, slotSize.y));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false);
-					}
-					else if (!slot->getFillX() && slot->getFillY())
-					{
-						glm::vec2 slotSize = slot->getOwnedWidget()->getComputedSize();
-						slot->getOwnedWidget()->setComputedSize(glm::vec2(slotSize.x, availlableSizeForFilledY));
-						// We update the child computed bounds
-						slot->getOwnedWidget()->updateLayer(false);
-					}
+						slot->getOwnedWidget()->setComputedSize(glm::vec2(availlableSizeForFilledX, availlableSizeForOneFilled));
+					else if (slot->getFillY() && !slot->getFillX())
+						slot->getOwnedWidget()->setComputedSize(glm::vec2(slotSize.x, availlableSizeForOneFilled));
+					else if (!slot->getFillY() && slot->getFillX())
+						slot->getOwnedWidget()->setComputedSize(glm::vec2(availlableSizeForFilledX, slotSize.y));
 				}
 			}
-
-			// Once we have modified the size of childs, we need to update them
-			//for (auto& slot : m_slots)
-			//{
-			//	if(!slot->getSizeToContent())
-			//		slot->getOwnedWidget()->updateLayer();
-			//}
 		}
 
 		// update slots position
 		glm::vec2 cursor(0, 0);
-		float contentSizeX = 0;
-		float contentSizeY = 0;
 		for (auto& slot : m_slots)
 		{
 			slot->getOwnedWidget()->setComputedRelativePosition(cursor);
 			cursor.y += slot->getOwnedWidget()->getComputedSize().y;
-			contentSizeX = std::max(contentSizeX, slot->getOwnedWidget()->getComputedSize().x);
 		}
-		contentSizeY = cursor.y;
+	}
 
-		// If the current widget is a sizeToContent widget, we update its size based on the content
-		if (!ignoreSizeToContent && getOwningWidgetSlot()->getSizeToContent())
+	glm::vec2 measureContent() override
+	{
+		glm::vec2 contentSize(0, 0);
+		for (auto& slot : m_slots)
 		{
-			// We update only if the size has changed to avoid circulary calls
-			const glm::vec2& computedSize = m_owningWidget->getComputedSize();
-			if (computedSize != glm::vec2(contentSizeX, contentSizeY))
-			{
-				m_owningWidget->setComputedSize(glm::vec2(contentSizeX, contentSizeY));
-
-				if (canUpdateParent)
-				{
-					// this time we update the parent
-					m_owningWidget->getOwningSlot()->getOwningLayer()->updateSlotsRects(false);
-				}
-			}
+			const glm::vec2& slotSize = slot->getOwnedWidget()->measure();
+			contentSize.x = std::max(contentSize.x, slotSize.x);
+			contentSize.y += slotSize.y;
 		}
+		return contentSize;
 	}
 };
 
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Vertical list of a large number of items, where only the rows inside the owning widget exist as widgets.
+// The rows leaving the view give their widget back to a pool, the rows entering it get one from the item callback,
+// so a frame only lays out, draws and hit tests the visible rows, whatever the item count.
+// The rows have a fixed extent, or an estimated one which is replaced by the measured size of the rows once displayed.
+class VirtualListLayer final : public WidgetLayer<ListSlot>
+{
+public:
+	// widget displaying the item, the recycled widget is a row which left the view (or null), to fill again instead of creating a new one
+	typedef std::function<std::shared_ptr<Widget>(int itemIndex, std::shared_ptr<Widget> recycledWidget)> ItemWidgetFunction;
+
+private:
+	ItemWidgetFunction m_itemWidgetFunction;
+	int m_itemCount;
+	float m_itemExtent;
+	bool m_isItemExtentEstimated;
+	// estimated extents only : extent of each item, and their Fenwick tree to find the position of an item and the item at a position in O(log n)
+	std::vector<float> m_itemExtents;
+	std::vector<double> m_extentTree;
+
+	// in double, the positions of a million rows are beyond the float precision
+	double m_scrollOffset;
+	// m_slots displays the items from m_firstVisibleItem, in order
+	int m_firstVisibleItem;
+	// widgets of the rows which have left the view
+	std::vector<std::shared_ptr<Widget>> m_recycledWidgets;
+
+public:
+	VirtualListLayer(UIEngine* uiengine)
+		: WidgetLayer<ListSlot>(uiengine)
+		, m_itemCount(0)
+		, m_itemExtent(20.0f)
+		, m_isItemExtentEstimated(false)
+		, m_scrollOffset(0)
+		, m_firstVisibleItem(0)
+	{}
+	virtual ~VirtualListLayer()
+	{}
+
+	// items
+	void setItemWidgetFunction(const ItemWidgetFunction& itemWidgetFunction);
+	void setItemCount(int itemCount);
+	int getItemCount() const
+	{
+		return m_itemCount;
+	}
+	// the estimated extents are corrected when the rows are displayed
+	void setItemExtent(float itemExtent, bool isEstimated = false);
+	float getItemExtent() const
+	{
+		return m_itemExtent;
+	}
+	// the items have changed, the visible rows are filled again
+	void refreshItems();
+
+	// scrolling
+	void setScrollOffset(double scrollOffset);
+	void scrollBy(double delta)
+	{
+		setScrollOffset(m_scrollOffset + delta);
+	}
+	void scrollToItem(int itemIndex)
+	{
+		setScrollOffset(getItemPosition(itemIndex));
+	}
+	double getScrollOffset() const
+	{
+		return m_scrollOffset;
+	}
+	double getContentExtent() const
+	{
+		return getItemPosition(m_itemCount);
+	}
+
+	// position of the top of the item, from the top of the list
+	double getItemPosition(int itemIndex) const;
+	// item at the position from the top of the list, clamped to the items
+	int getItemAt(double position) const;
+	int getFirstVisibleItem() const
+	{
+		return m_firstVisibleItem;
+	}
+	int getVisibleItemCount() const
+	{
+		return (int)m_slots.size();
+	}
+
+	// layout
+	void arrangeSlots() override;
+	glm::vec2 measureContent() override;
+	// the rows are created while arranging
+	bool canArrangeInParallel() const override
+	{
+		return false;
+	}
+
+	// the rows are only created by the item callback
+	WidgetSlot* addSlot(std::shared_ptr<Widget> widget) override
+	{
+		return nullptr;
+	}
+	WidgetSlot* insertSlot(std::shared_ptr<Widget> widget, int index) override
+	{
+		return nullptr;
+	}
+	void removeSlot(int slotIndex) override
+	{}
+	void removeSlot(const UIItem* ownedItem) override
+	{}
+	void clearSlots() override
+	{
+		setItemCount(0);
+	}
+
+private:
+	// give the rows outside [firstItem, endItem) back to the pool and create the missing ones, return true if a row has changed
+	bool updateVisibleRows(int firstItem, int endItem);
+	void recycleRow(const std::shared_ptr<ListSlot>& slot);
+	void rebuildExtentTree();
+	// return true if the extent has changed
+	bool setEstimatedExtent(int itemIndex, float extent);
+	double getMaxScrollOffset() const
+	{
+		return std::max(0.0, getContentExtent() - getSize().y);
+	}
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+// Worker threads with one task queue each, for tasks which spawn other tasks.
+// A thread pushes its tasks on its own queue and runs the last one first, an idle worker steals the oldest task of another queue :
+// the big subtrees, pushed first, are stolen while their owner goes deep into its last task.
+// A thread waiting for its tasks runs tasks too, so a task can wait for the tasks it spawned without blocking a worker.
+class WorkStealingPool
+{
+public:
+	// the unfinished tasks of a batch, see run and wait
+	class TaskGroup
+	{
+		friend class WorkStealingPool;
+
+	private:
+		std::atomic<int> m_pendingCount;
+
+	public:
+		TaskGroup()
+			: m_pendingCount(0)
+		{}
+		TaskGroup(const TaskGroup& other) = delete;
+		TaskGroup& operator=(const TaskGroup& other) = delete;
+	};
+
+private:
+	struct Task
+	{
+		std::function<void()> function;
+		TaskGroup* group;
+	};
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+	// the queue of the current thread, the threads outside of the pool share the last queue
+	struct ThreadQueue
+	{
+		const WorkStealingPool* pool;
+		size_t queueIndex;
+	};
+
+	std::vector<std::unique_ptr<TaskQueue>> m_queues;
+	std::vector<std::thread> m_workers;
+	std::atomic<int> m_queuedCount;
+	// the idle workers sleep until a task is queued
+	std::mutex m_sleepMutex;
+	std::condition_variable m_taskAvailable;
+	bool m_stopping;
+
+public:
+	// the threads calling wait run tasks too, a pool without worker runs every task in wait
+	explicit WorkStealingPool(unsigned int workerCount)
+		: m_queuedCount(0)
+		, m_stopping(false)
+	{
+		for (unsigned int i = 0; i < workerCount + 1; ++i)
+		{
+			m_queues.push_back(std::make_unique<TaskQueue>());
+		}
+		for (unsigned int i = 0; i < workerCount; ++i)
+		{
+			m_workers.emplace_back([this, i]() { workerLoop(i); });
+		}
+	}
+	// the queued tasks are still executed
+	~WorkStealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+			m_stopping = true;
+		}
+		m_taskAvailable.notify_all();
+
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+	WorkStealingPool(const WorkStealingPool& other) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool& other) = delete;
+
+	// the group must outlive the task, call wait before destroying it
+	void run(TaskGroup& group, std::function<void()> function)
+	{
+		group.m_pendingCount.fetch_add(1, std::memory_order_relaxed);
+
+		TaskQueue& queue = *m_queues[getThreadQueueIndex()];
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(Task{ std::move(function), &group });
+		}
+		m_queuedCount.fetch_add(1);
+
+		// taken so a worker can't miss the notification between its check and its wait
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_taskAvailable.notify_one();
+	}
+	// return once all the tasks of the group are done, the writes of the tasks are visible after it
+	void wait(TaskGroup& group)
+	{
+		while (group.m_pendingCount.load(std::memory_order_acquire) > 0)
+		{
+			// the remaining tasks of the group may be running on other threads
+			if (!runNextTask())
+				std::this_thread::yield();
+		}
+	}
+
+	unsigned int getWorkerCount() const
+	{
+		return (unsigned int)m_workers.size();
+	}
+
+private:
+	static ThreadQueue& getThreadQueue()
+	{
+		thread_local ThreadQueue threadQueue = { nullptr, 0 };
+		return threadQueue;
+	}
+	size_t getThreadQueueIndex() const
+	{
+		const ThreadQueue& threadQueue = getThreadQueue();
+		return threadQueue.pool == this ? threadQueue.queueIndex : m_queues.size() - 1;
+	}
+
+	// our newest task, or the oldest task of another queue
+	bool runNextTask()
+	{
+		const size_t ownIndex = getThreadQueueIndex();
+		Task task;
+		bool found = false;
+		{
+			TaskQueue& queue = *m_queues[ownIndex];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty())
+			{
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+				found = true;
+			}
+		}
+		for (size_t offset = 1; !found && offset < m_queues.size(); ++offset)
+		{
+			TaskQueue& queue = *m_queues[(ownIndex + offset) % m_queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.tasks.empty())
+			{
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+				found = true;
+			}
+		}
+		if (!found)
+			return false;
+
+		m_queuedCount.fetch_sub(1);
+		task.function();
+		// last access to the group, the waiting thread can destroy it right after
+		task.group->m_pendingCount.fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	void workerLoop(size_t queueIndex)
+	{
+		getThreadQueue() = ThreadQueue{ this, queueIndex };
+
+		while (true)
+		{
+			if (runNextTask())
+				continue;
+
+			std::unique_lock<std::mutex> lock(m_sleepMutex);
+			m_taskAvailable.wait(lock, [this]() { return m_stopping || m_queuedCount.load() > 0; });
+			if (m_stopping && m_queuedCount.load() == 0)
+				return;
+		}
+	}
+};
@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <map>
 #include <functional>
+#include <chrono>
+#include <thread>
 #include "glm/glm.hpp"
 
 #include "Widget.h"
@@ -15,6 +17,7 @@
 #include "EmptyWidget.h"
 #include "Application.h"
 #include "UIEngine.h"
+#include "AssetArchive.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -27,16 +30,19 @@ private:
 	ShaderProgram program;
 	/////
 
+	// the textures and the fonts created from the archive use its mapping, it is closed after the engine is destroyed
+	AssetArchive m_assets;
 	UIEngine uiengine;
 	glm::vec2 cursorPos;
 
 	// resources : 
-	std::shared_ptr<Texture> m_defaultTexture;
+	TextureHandle m_defaultTexture;
 
 public:
 	void init() override;
 	void update() override;
 	void render() override;
+	bool needsRender() override;
 
 	// input
 	void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) override;
@@ -49,15 +55,23 @@ void MyApplication::init()
 {
 	// test opengl
 	vao.setDatas(vertices, indices);
-	program.load("resources/shaders/UIWidget.vert", "resources/shaders/UIWidget.frag");
+	// the resources come from the asset archive if there is one (UIEngine --build-asset-archive), from the files otherwise
+	m_assets.open("resources/assets.uiar");
+	if (!m_assets.isOpen() || !m_assets.loadShaderProgram(program, "resources/shaders/UIWidget.vert", "resources/shaders/UIWidget.frag"))
+		program.load("resources/shaders/UIWidget.vert", "resources/shaders/UIWidget.frag");
 	//////
 
 	// initialize resources
-	m_defaultTexture = Texture::load_RGB_image("resources/images/default.jpg");
+	std::shared_ptr<Texture> archivedTexture = m_assets.isOpen() ? m_assets.createTexture("resources/images/default.jpg", { { GL_TEXTURE_WRAP_S, GL_REPEAT },{ GL_TEXTURE_WRAP_T, GL_REPEAT },{ GL_TEXTURE_MIN_FILTER, GL_LINEAR },{ GL_TEXTURE_MAG_FILTER, GL_LINEAR } }) : nullptr;
+	m_defaultTexture = archivedTexture != nullptr ? TextureHandle::fromTexture(archivedTexture) : uiengine.getTextureLoader().loadRGBAsync("resources/images/default.jpg");
 	//m_defaultFont = std::make_shared <Font>();
 	//m_defaultFont->load()
 
-	uiengine.getFontFactory().loadFont("resources/fonts/OpenSans-Regular.ttf", "default", 48);
+	uiengine.getFontFactory().setAtlasCacheDirectory("resources/fonts");
+	if (m_assets.find("resources/fonts/OpenSans-Regular.ttf") != nullptr)
+		uiengine.getFontFactory().loadFonts({ m_assets.makeFontRequest("resources/fonts/OpenSans-Regular.ttf", "", "default", 48) });
+	else
+		uiengine.getFontFactory().loadFont("resources/fonts/OpenSans-Regular.ttf", "default", 48);
 	uiengine.getFontFactory().setFontAsDefault("default", 48);
 
 	// set viewport size
@@ -126,7 +140,7 @@ void MyApplication::init()
 					buttonSlot->setSize(glm::vec2(100, 100));
 					buttonSlot->getAnchor().anchorPosition = glm::vec2(0, 0);
 					buttonImage->setTint(glm::vec4(0, 1, 0, 1));
-					buttonImage->setTexture(m_defaultTexture);
+					buttonImage->setTexture(uiengine.getIconAtlas().load("resources/images/default.jpg"));
 				}
 			}
 		}
@@ -269,27 +283,34 @@ void MyApplication::render()
 	uiengine.renderUI(glm::vec2(viewportWidth, viewportHeight));
 }
 
+bool MyApplication::needsRender()
+{
+	// nothing else is animated in this test application
+	return uiengine.needsRedraw();
+}
+
 void MyApplication::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	std::cout << "key detected : " << key << std::endl;
 
 	if (action == GLFW_PRESS)
-		uiengine.handleKeyPressed(key);
+		uiengine.getInputQueue().pushKeyPressed(key);
 	else if (action == GLFW_RELEASE)
-		uiengine.handleKeyReleased(key);
+		uiengine.getInputQueue().pushKeyReleased(key);
 }
 
 void MyApplication::characterCallback(GLFWwindow* window, unsigned int codepoint)
 {
 	std::cout << "character detected : " << (char)codepoint << std::endl;
 
-	uiengine.handleCharacter(codepoint);
+	uiengine.getInputQueue().pushCharacter(codepoint);
 }
 
 void MyApplication::cursorPositionCallback(GLFWwindow* window, double xpos, double ypos)
 {
+	// merged with the other moves of the frame
 	cursorPos = glm::vec2(xpos, ypos);
-	uiengine.handleMouseMove(cursorPos);
+	uiengine.getInputQueue().pushMouseMove(cursorPos);
 }
 
 void MyApplication::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
@@ -297,13 +318,468 @@ void MyApplication::mouseButtonCallback(GLFWwindow* window, int button, int acti
 	std::cout << "mouse button detected : " << button << ", on position : "<< cursorPos.x << "," << cursorPos.y << std::endl;
 
 	if(action == GLFW_PRESS)
-		uiengine.handleMouseButtonPressed(button, cursorPos);
+		uiengine.getInputQueue().pushMouseButtonPressed(button, cursorPos);
 	else if(action == GLFW_RELEASE)
-		uiengine.handleMouseButtonReleased(button, cursorPos);
+		uiengine.getInputQueue().pushMouseButtonReleased(button, cursorPos);
+}
+
+// Decode the images with the TextureLoader, without any window : the upload only takes the pixels.
+// Print the decode throughput, and the time spent each frame by the loader on the render thread,
+// compared to the time the render thread would have been blocked by synchronous loads.
+int benchmarkTextureLoading(const std::vector<std::string>& fileNames)
+{
+	TextureLoader loader;
+	loader.setUploadFunction([](TextureLoader::DecodedImage& image)
+	{
+		// a texture without gl id, only to complete the handle
+		std::free(image.releasePixels());
+		return std::make_shared<Texture>();
+	});
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<TextureHandle> handles;
+	for (const auto& fileName : fileNames)
+	{
+		handles.push_back(loader.loadRGBAsync(fileName));
+	}
+
+	// one upload pass per 60Hz frame
+	const std::chrono::microseconds frameDuration(16667);
+	unsigned int frameCount = 0;
+	double totalFrameMilliseconds = 0;
+	while (loader.hasPendingLoads())
+	{
+		const auto frameStart = std::chrono::high_resolution_clock::now();
+		loader.processUploads();
+		totalFrameMilliseconds += loader.getStats().lastUploadMilliseconds;
+		frameCount++;
+
+		std::this_thread::sleep_until(frameStart + frameDuration);
+	}
+	loader.processUploads();
+
+	const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	const TextureLoaderStats stats = loader.getStats();
+	const double decodedMegabytes = stats.decodedBytes / (1024.0 * 1024.0);
+
+	std::cout << "texture loading benchmark : " << fileNames.size() << " images, " << stats.decodedCount << " decoded, " << stats.failedCount << " failed" << std::endl;
+	std::cout << "  decoded " << decodedMegabytes << " MB in " << seconds << " s (" << decodedMegabytes / seconds << " MB/s, " << TextureLoader::getDefaultWorkerCount() << " workers)" << std::endl;
+	std::cout << "  synchronous loads would block the render thread " << stats.decodeSeconds * 1000.0 << " ms" << std::endl;
+	std::cout << "  render thread : " << frameCount << " frames, " << (frameCount > 0 ? totalFrameMilliseconds / frameCount : 0.0) << " ms per frame on average, " << stats.maxUploadMilliseconds << " ms max" << std::endl;
+
+	return stats.failedCount == 0 ? 0 : 1;
+}
+
+// the engine loads its shaders, it needs a context
+GLFWwindow* createBenchmarkWindow()
+{
+	if (!glfwInit())
+		return nullptr;
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(640, 480, "benchmark", NULL, NULL);
+	if (window == nullptr)
+	{
+		glfwTerminate();
+		return nullptr;
+	}
+	glfwMakeContextCurrent(window);
+	glewInit();
+	return window;
+}
+
+// Build a tree of widgets (panels of 1000 rows), lay it out and record it, dispatch keys through it then destroy it.
+// Run once with the items allocated by std::make_shared, then once with the engine pools.
+int benchmarkWidgetTree(int widgetCount)
+{
+	GLFWwindow* window = createBenchmarkWindow();
+	if (window == nullptr)
+		return 1;
+
+	typedef std::chrono::high_resolution_clock Clock;
+	auto getMilliseconds = [](Clock::time_point start) { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+	const glm::vec2 viewportSize(1920, 1080);
+	const int rowsPerPanel = 1000;
+	const int keyPressCount = 10;
+
+	std::cout << "widget tree benchmark : " << widgetCount << " widgets" << std::endl;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		const bool isPooled = pass == 1;
+		auto uiengine = std::make_unique<UIEngine>();
+		uiengine->setObjectPoolingEnabled(isPooled);
+		uiengine->getRootViewportWidget()->setViewport(glm::vec2(0, 0), viewportSize);
+
+		auto start = Clock::now();
+		auto rootLayer = uiengine->instantiateLayer("HorizontalList");
+		int createdCount = 0;
+		while (createdCount < widgetCount)
+		{
+			auto panel = uiengine->instantiateWidget("EmptyWidget");
+			auto panelLayer = uiengine->instantiateLayer("VerticalList");
+			panel->setLayer(panelLayer);
+			rootLayer->addSlot(panel);
+			createdCount++;
+
+			for (int row = 0; row < rowsPerPanel && createdCount < widgetCount; ++row, ++createdCount)
+			{
+				panelLayer->addSlot(uiengine->instantiateWidget("EmptyWidget"));
+			}
+		}
+		uiengine->getRootViewportWidget()->addLayer(rootLayer, 0);
+		rootLayer.reset();
+		const double buildMilliseconds = getMilliseconds(start);
+
+		// the items too big for the pools are on the global heap, like without pooling
+		if (isPooled)
+		{
+			const ObjectPools* pools = uiengine->getObjectPools();
+			std::cout << "  pools : " << pools->getUsedBlockCount() << " pooled blocks in " << pools->getSlabCount() << " slabs, "
+				<< pools->getHeapAllocationCount() << " items on the heap" << std::endl;
+		}
+
+		// the first frame places and records every widget
+		start = Clock::now();
+		uiengine->renderUI(viewportSize);
+		glFinish();
+		const double firstFrameMilliseconds = getMilliseconds(start);
+
+		// the engine only sends the keys to the focus chain, the broadcast through the widgets visits the whole tree
+		start = Clock::now();
+		for (int keyPress = 0; keyPress < keyPressCount; ++keyPress)
+		{
+			uiengine->getRootViewportWidget()->handleKeyPressed(GLFW_KEY_A);
+		}
+		const double traversalMilliseconds = getMilliseconds(start) / keyPressCount;
+
+		start = Clock::now();
+		uiengine.reset();
+		const double destructionMilliseconds = getMilliseconds(start);
+
+		std::cout << (isPooled ? "  pooled      : " : "  make_shared : ")
+			<< "build " << buildMilliseconds << " ms, first frame " << firstFrameMilliseconds << " ms, key traversal " << traversalMilliseconds
+			<< " ms, destruction " << destructionMilliseconds << " ms" << std::endl;
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
+
+// Editor like layout : 8 docks side by side, each one a list of rows of 4 cells, widgetCount widgets in total.
+// The viewport is resized at each pass so every widget is arranged again, with 1 layout thread, then 2, 4... up to one per hardware thread.
+int benchmarkParallelLayout(int widgetCount)
+{
+	GLFWwindow* window = createBenchmarkWindow();
+	if (window == nullptr)
+		return 1;
+
+	typedef std::chrono::high_resolution_clock Clock;
+	const int dockCount = 8;
+	const int cellsPerRow = 4;
+	const int passCount = 20;
+	const glm::vec2 viewportSizes[2] = { glm::vec2(1920, 1080), glm::vec2(1600, 900) };
+
+	auto uiengine = std::make_unique<UIEngine>();
+	auto rootLayer = uiengine->instantiateLayer("HorizontalList");
+	std::vector<Widget*> cells;
+	int createdCount = 0;
+	for (int dock = 0; dock < dockCount; ++dock)
+	{
+		auto dockWidget = uiengine->instantiateWidget("EmptyWidget");
+		auto dockLayer = uiengine->instantiateLayer("VerticalList");
+		dockWidget->setLayer(dockLayer);
+		rootLayer->addSlotAs<ListSlot>(dockWidget)->setFillY(true);
+		createdCount++;
+
+		const int dockEnd = widgetCount * (dock + 1) / dockCount;
+		while (createdCount < dockEnd)
+		{
+			auto row = uiengine->instantiateWidget("EmptyWidget");
+			auto rowLayer = uiengine->instantiateLayer("HorizontalList");
+			row->setLayer(rowLayer);
+			dockLayer->addSlotAs<ListSlot>(row)->setFillX(true);
+			createdCount++;
+
+			for (int cell = 0; cell < cellsPerRow && createdCount < dockEnd; ++cell, ++createdCount)
+			{
+				auto cellWidget = uiengine->instantiateWidget("EmptyWidget");
+				rowLayer->addSlotAs<ListSlot>(cellWidget)->setFillY(true);
+				cells.push_back(cellWidget.get());
+			}
+		}
+	}
+	uiengine->getRootViewportWidget()->addLayer(rootLayer, 0);
+	rootLayer.reset();
+
+	// the first pass sorts the layout nodes
+	uiengine->getRootViewportWidget()->setViewport(glm::vec2(0, 0), viewportSizes[0]);
+	uiengine->updateLayout();
+
+	std::cout << "parallel layout benchmark : " << createdCount << " widgets in " << dockCount << " docks" << std::endl;
+	const unsigned int maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	double sequentialMilliseconds = 0;
+	for (unsigned int threadCount = 1; threadCount <= maxThreadCount; threadCount = threadCount < maxThreadCount ? std::min(threadCount * 2, maxThreadCount) : threadCount + 1)
+	{
+		uiengine->setParallelLayoutThreadCount(threadCount);
+
+		auto start = Clock::now();
+		for (int pass = 0; pass < passCount; ++pass)
+		{
+			uiengine->getRootViewportWidget()->setViewport(glm::vec2(0, 0), viewportSizes[(pass + 1) % 2]);
+			uiengine->updateLayout();
+		}
+		const double passMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / passCount;
+		if (threadCount == 1)
+			sequentialMilliseconds = passMilliseconds;
+
+		// the same layout whatever the thread count
+		double checksum = 0;
+		for (const Widget* cell : cells)
+		{
+			checksum += cell->getComputedPosition().x + cell->getComputedPosition().y + cell->getComputedSize().x + cell->getComputedSize().y;
+		}
+
+		std::cout << "  " << threadCount << " threads : " << passMilliseconds << " ms per pass, speedup " << sequentialMilliseconds / passMilliseconds
+			<< ", checksum " << checksum << std::endl;
+	}
+
+	uiengine.reset();
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
+
+// Rasterize overlapping rounded boxes with the software drawer, without any window or GL context.
+// Each frame is recorded and rasterized again from scratch. The last frame is compared to goldenImage, or written to it if it doesn't exist yet.
+int benchmarkSoftwareRendering(int widgetCount, const std::string& goldenImage)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const glm::vec2 viewportSize(1280, 720);
+	const glm::vec2 cellSize(24, 16);
+	const glm::vec2 cellStep(20, 12);
+	const int columnCount = (int)(viewportSize.x / cellStep.x);
+	const int frameCount = 20;
+
+	auto drawer = std::make_unique<SoftwareUIDrawer>();
+	SoftwareUIDrawer* softwareDrawer = drawer.get();
+	auto uiengine = std::make_unique<UIEngine>(std::move(drawer));
+	uiengine->getRootViewportWidget()->setViewport(glm::vec2(0, 0), viewportSize);
+
+	// the boxes overlap their neighbours and wrap over the previous rows once the viewport is full
+	auto rootLayer = uiengine->instantiateLayer("Raw");
+	const int rowCount = (int)(viewportSize.y / cellStep.y) - 1;
+	for (int index = 0; index < widgetCount; ++index)
+	{
+		auto box = uiengine->instantiateWidget("EmptyWidget");
+		box->setTint(glm::vec4((index % 7) / 6.0f, (index % 11) / 10.0f, (index % 13) / 12.0f, 0.25f + (index % 4) * 0.25f));
+		box->setCornerRadius((index % 5) * 0.1f);
+		const glm::vec2 cell((float)(index % columnCount), (float)((index / columnCount) % rowCount));
+		RawSlot* slot = rootLayer->addSlotAs<RawSlot>(box);
+		slot->setPosition(cell * cellStep + glm::vec2(0.5f * (index / (columnCount * rowCount) % 2)));
+		slot->setSize(cellSize);
+	}
+	uiengine->getRootViewportWidget()->addLayer(rootLayer, 0);
+	rootLayer.reset();
+
+	// the first frame lays out the widgets
+	uiengine->renderUI(viewportSize);
+	softwareDrawer->resetCounters();
+
+	auto start = Clock::now();
+	for (int frame = 0; frame < frameCount; ++frame)
+	{
+		uiengine->invalidateDrawList();
+		uiengine->renderUI(viewportSize);
+	}
+	const double frameMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frameCount;
+	const double blendedPixelsPerFrame = (double)softwareDrawer->getBlendedPixelCount() / frameCount;
+
+	std::cout << "software rendering benchmark : " << widgetCount << " widgets, " << viewportSize.x << "x" << viewportSize.y << std::endl;
+	std::cout << "  " << frameMilliseconds << " ms per frame, " << softwareDrawer->getDrawCallCount() / frameCount << " batches per frame, "
+		<< blendedPixelsPerFrame / 1000000.0 << " Mpixels blended per frame, " << blendedPixelsPerFrame / (frameMilliseconds * 1000.0) << " Mpixels/s" << std::endl;
+
+	// split of the frames, empty if the profiling is compiled out
+	const UIFrameStats averageFrame = uiengine->getProfiler().getAverage(frameCount);
+	std::cout << "  phases (ms) :";
+	for (int phaseIndex = 0; phaseIndex < UIFrameStats::s_phaseCount; ++phaseIndex)
+	{
+		std::cout << " " << UIProfiler::getPhaseName((UIProfilePhase)phaseIndex) << " " << averageFrame.phaseDurations[phaseIndex] / 1000.0 << (phaseIndex + 1 < UIFrameStats::s_phaseCount ? "," : "");
+	}
+	std::cout << std::endl << "  counters :";
+	for (int counterIndex = 0; counterIndex < UIFrameStats::s_counterCount; ++counterIndex)
+	{
+		std::cout << " " << UIProfiler::getCounterName((UIProfileCounter)counterIndex) << " " << averageFrame.counters[counterIndex] << (counterIndex + 1 < UIFrameStats::s_counterCount ? "," : "");
+	}
+	std::cout << std::endl;
+
+	int result = 0;
+	if (!goldenImage.empty())
+	{
+		if (!std::ifstream(goldenImage))
+		{
+			result = softwareDrawer->saveSurface(goldenImage) ? 0 : 1;
+			std::cout << "  golden image written to " << goldenImage << std::endl;
+		}
+		else
+		{
+			const int differentPixelCount = softwareDrawer->compareSurface(goldenImage, 0);
+			result = differentPixelCount == 0 ? 0 : 1;
+			std::cout << "  golden image " << goldenImage << " : " << (differentPixelCount < 0 ? std::string("unreadable or of another size") : std::to_string(differentPixelCount) + " different pixels") << std::endl;
+		}
+	}
+
+	uiengine.reset();
+	return result;
 }
 
-int main()
+// Scroll a VirtualListLayer of itemCount rows, with a fixed extent then with an estimated one corrected by the measured rows.
+// Drawn by the software drawer, no window is needed. Each frame scrolls a bit, the last ones jump far in the list.
+// The list must only have the visible rows as slots at every frame, whatever the item count.
+int benchmarkVirtualList(int itemCount)
 {
+	typedef std::chrono::high_resolution_clock Clock;
+	const glm::vec2 viewportSize(1280, 720);
+	const float fixedExtent = 20.0f;
+	const float minMeasuredExtent = 14.0f;
+	const int scrollFrameCount = 300;
+	const int jumpFrameCount = 30;
+
+	std::cout << "virtual list benchmark : " << itemCount << " items, " << viewportSize.x << "x" << viewportSize.y << std::endl;
+	int result = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		const bool isEstimated = pass == 1;
+		auto uiengine = std::make_unique<UIEngine>(std::make_unique<SoftwareUIDrawer>());
+		uiengine->getRootViewportWidget()->setViewport(glm::vec2(0, 0), viewportSize);
+
+		auto rootLayer = uiengine->instantiateLayer("Raw");
+		auto listWidget = uiengine->instantiateWidget("EmptyWidget");
+		RawSlot* listSlot = rootLayer->addSlotAs<RawSlot>(listWidget);
+		listSlot->setPosition(glm::vec2(0, 0));
+		listSlot->setSize(viewportSize);
+		auto listLayer = std::static_pointer_cast<VirtualListLayer>(uiengine->instantiateLayer("VirtualList"));
+		listWidget->setLayer(listLayer);
+		uiengine->getRootViewportWidget()->addLayer(rootLayer, 0);
+		rootLayer.reset();
+
+		// the measured rows are 14 to 38 pixels, estimated at 20
+		int createdWidgetCount = 0;
+		UIEngine* engine = uiengine.get();
+		listLayer->setItemWidgetFunction([engine, isEstimated, fixedExtent, minMeasuredExtent, &createdWidgetCount](int itemIndex, std::shared_ptr<Widget> recycledWidget)
+		{
+			std::shared_ptr<Widget> row = recycledWidget;
+			if (row == nullptr)
+			{
+				row = engine->instantiateWidget("EmptyWidget");
+				createdWidgetCount++;
+			}
+			row->setTint(glm::vec4((itemIndex % 7) / 6.0f, (itemIndex % 11) / 10.0f, 0.5f, 1.0f));
+			row->setPreferredSize(glm::vec2(0, isEstimated ? minMeasuredExtent + (itemIndex % 7) * 4.0f : fixedExtent));
+			return row;
+		});
+		listLayer->setItemExtent(fixedExtent, isEstimated);
+		listLayer->setItemCount(itemCount);
+
+		// a row partially shown at each end at most
+		const int maxVisibleRowCount = (int)std::ceil(viewportSize.y / (isEstimated ? minMeasuredExtent : fixedExtent)) + 1;
+		int wrongFrameCount = 0;
+		int maxSlotCount = 0;
+		double totalMilliseconds = 0;
+		double worstMilliseconds = 0;
+		unsigned int random = 12345;
+		for (int frame = 0; frame < scrollFrameCount + jumpFrameCount; ++frame)
+		{
+			if (frame < scrollFrameCount)
+			{
+				listLayer->scrollBy(53.5);
+			}
+			else
+			{
+				random = random * 1664525u + 1013904223u;
+				listLayer->scrollToItem((int)(random % (unsigned int)std::max(itemCount, 1)));
+			}
+
+			auto start = Clock::now();
+			uiengine->renderUI(viewportSize);
+			const double frameMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			totalMilliseconds += frameMilliseconds;
+			worstMilliseconds = std::max(worstMilliseconds, frameMilliseconds);
+
+			// the rows between the top and the bottom of the list, the same computation as the layer
+			const double scrollOffset = listLayer->getScrollOffset();
+			const int visibleRowCount = itemCount > 0 ? listLayer->getItemAt(scrollOffset + viewportSize.y) - listLayer->getItemAt(scrollOffset) + 1 : 0;
+			const int slotCount = listLayer->getVisibleItemCount();
+			maxSlotCount = std::max(maxSlotCount, slotCount);
+			if (slotCount != visibleRowCount || slotCount > maxVisibleRowCount || listLayer->getFirstVisibleItem() != listLayer->getItemAt(scrollOffset))
+				wrongFrameCount++;
+		}
+
+		const int frameCount = scrollFrameCount + jumpFrameCount;
+		std::cout << (isEstimated ? "  estimated extent : " : "  fixed extent     : ")
+			<< totalMilliseconds / frameCount << " ms per frame, worst " << worstMilliseconds << " ms, "
+			<< maxSlotCount << " slots at most for " << maxVisibleRowCount << " visible rows at most, "
+			<< createdWidgetCount << " row widgets created, " << wrongFrameCount << " frames with other slots than the visible rows" << std::endl;
+		if (wrongFrameCount > 0)
+			result = 1;
+
+		// the list is destroyed with the engine
+		listLayer.reset();
+		listWidget.reset();
+		uiengine.reset();
+	}
+	return result;
+}
+
+// pack the files in an archive, each asset is named after its file name as given
+int buildAssetArchive(const std::string& archiveName, const std::vector<std::string>& fileNames)
+{
+	AssetArchiveBuilder builder;
+	for (const auto& fileName : fileNames)
+	{
+		if (!builder.addFile(fileName))
+			return 1;
+	}
+	if (!builder.write(archiveName))
+	{
+		std::cout << "error : can't write " << archiveName << std::endl;
+		return 1;
+	}
+
+	AssetArchive archive;
+	if (!archive.open(archiveName))
+		return 1;
+
+	size_t totalSize = 0;
+	for (size_t i = 0; i < archive.getEntryCount(); ++i)
+	{
+		totalSize += (size_t)archive.getEntry(i).size;
+	}
+	std::cout << archiveName << " : " << archive.getEntryCount() << " assets, " << totalSize << " bytes" << std::endl;
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	// UIEngine --benchmark-texture-loading image1.jpg image2.png ...
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-texture-loading")
+		return benchmarkTextureLoading(std::vector<std::string>(argv + 2, argv + argc));
+	// UIEngine --benchmark-widget-tree [widgetCount]
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-widget-tree")
+		return benchmarkWidgetTree(argc > 2 ? std::atoi(argv[2]) : 100000);
+	// UIEngine --benchmark-parallel-layout [widgetCount]
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-parallel-layout")
+		return benchmarkParallelLayout(argc > 2 ? std::atoi(argv[2]) : 50000);
+	// UIEngine --benchmark-software-rendering [widgetCount] [goldenImage.pam]
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-software-rendering")
+		return benchmarkSoftwareRendering(argc > 2 ? std::atoi(argv[2]) : 20000, argc > 3 ? argv[3] : "");
+	// UIEngine --benchmark-virtual-list [itemCount]
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-virtual-list")
+		return benchmarkVirtualList(argc > 2 ? std::atoi(argv[2]) : 1000000);
+	// UIEngine --build-asset-archive archive.uiar shader.vert image.png font.ttf ...
+	if (argc > 2 && std::string(argv[1]) == "--build-asset-archive")
+		return buildAssetArchive(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+
 	MyApplication app;
 	app.init();
 	app.run();
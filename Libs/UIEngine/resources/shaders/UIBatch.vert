@@ -0,0 +1,32 @@
+#version 330 core
+
+// unit quad corner, [0, 1]
+layout (location = 0) in vec2 corner;
+
+// per instance datas, see UIQuadInstance
+layout (location = 2) in vec4 instanceBox;
+layout (location = 3) in vec4 instanceTint;
+layout (location = 4) in vec4 instanceUVRect;
+layout (location = 5) in vec4 instanceParams;
+
+uniform vec2 viewportSize;
+
+out vec2 localPos;
+out vec2 uv;
+flat out vec2 boxExtent;
+flat out vec4 tint;
+flat out float cornerRadius;
+
+void main()
+{
+	// the box is in pixels with y going down, convert it to ndc
+	vec2 pixelPos = instanceBox.xy + corner * instanceBox.zw;
+	vec2 ndcPos = (pixelPos / viewportSize) * vec2(2, -2) + vec2(-1, 1);
+	gl_Position = vec4(ndcPos, 0.0, 1.0);
+
+	localPos = corner * instanceBox.zw;
+	uv = instanceUVRect.xy + corner * instanceUVRect.zw;
+	boxExtent = instanceBox.zw;
+	tint = instanceTint;
+	cornerRadius = instanceParams.x;
+}
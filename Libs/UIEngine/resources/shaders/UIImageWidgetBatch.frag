@@ -0,0 +1,27 @@
+#version 330 core
+
+in vec2 localPos;
+in vec2 uv;
+flat in vec2 boxExtent;
+flat in vec4 tint;
+flat in float cornerRadius;
+
+uniform sampler2D image;
+
+out vec4 fragColor;
+
+// coverage of a rounded box, the radius is given relatively to the smallest side of the box
+float roundedBoxCoverage(vec2 pos, vec2 extent, float radius)
+{
+	float radiusInPixel = radius * min(extent.x, extent.y);
+	vec2 halfExtent = extent * 0.5;
+	vec2 q = abs(pos - halfExtent) - (halfExtent - vec2(radiusInPixel));
+	float dist = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radiusInPixel;
+	return clamp(0.5 - dist, 0.0, 1.0);
+}
+
+void main()
+{
+	vec4 color = texture(image, uv) * tint;
+	fragColor = vec4(color.rgb, color.a * roundedBoxCoverage(localPos, boxExtent, cornerRadius));
+}
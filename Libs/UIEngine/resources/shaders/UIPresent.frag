@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 uv;
+
+// the retained UI surface, see GLUIDrawer
+uniform sampler2D surface;
+
+out vec4 fragColor;
+
+void main()
+{
+	// premultiplied color, blended with (ONE, ONE_MINUS_SRC_ALPHA)
+	fragColor = texture(surface, uv);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 localPos;
+in vec2 uv;
+flat in vec2 boxExtent;
+flat in vec4 tint;
+flat in float cornerRadius;
+
+// single channel glyph atlas
+uniform sampler2D fontAtlas;
+
+out vec4 fragColor;
+
+void main()
+{
+	fragColor = vec4(tint.rgb, tint.a * texture(fontAtlas, uv).r);
+}
@@ -0,0 +1,431 @@
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <array>
+#include <type_traits>
+#include <algorithm>
+
+#include "Metadata.hpp"
+
+namespace meta{
+
+// Growable output buffer of the binary serializer.
+// The values are appended with memcpy, the buffer grows geometrically and keeps its capacity when cleared :
+// saving the same scene again doesn't allocate.
+class BinaryArena
+{
+private:
+    std::unique_ptr<unsigned char[]> m_data;
+    size_t m_size;
+    size_t m_capacity;
+
+public:
+    BinaryArena()
+        : m_size(0)
+        , m_capacity(0)
+    {}
+
+    // room for byteCount bytes at the end of the buffer, filled by the caller
+    unsigned char* Allocate(size_t byteCount)
+    {
+        if (m_size + byteCount > m_capacity)
+            Reserve(std::max(m_size + byteCount, m_capacity * 2));
+
+        unsigned char* allocated = m_data.get() + m_size;
+        m_size += byteCount;
+        return allocated;
+    }
+
+    void Write(const void* data, size_t byteCount)
+    {
+        if (byteCount > 0)
+            std::memcpy(Allocate(byteCount), data, byteCount);
+    }
+
+    void Reserve(size_t capacity)
+    {
+        if (capacity <= m_capacity)
+            return;
+
+        // not value initialized, every byte is written before being read
+        std::unique_ptr<unsigned char[]> data(new unsigned char[capacity]);
+        if (m_size > 0)
+            std::memcpy(data.get(), m_data.get(), m_size);
+        m_data = std::move(data);
+        m_capacity = capacity;
+    }
+
+    void Clear()
+    {
+        m_size = 0;
+    }
+
+    const unsigned char* GetData() const
+    {
+        return m_data.get();
+    }
+
+    // to patch bytes already written, invalidated by the next Allocate
+    unsigned char* GetData()
+    {
+        return m_data.get();
+    }
+
+    size_t GetSize() const
+    {
+        return m_size;
+    }
+
+    size_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+};
+
+// Read cursor over serialized bytes, the reads past the end fail and leave the destination untouched.
+class BinaryReader
+{
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    size_t m_offset;
+    bool m_hasFailed;
+
+public:
+    BinaryReader(const unsigned char* data, size_t size)
+        : m_data(data)
+        , m_size(size)
+        , m_offset(0)
+        , m_hasFailed(false)
+    {}
+
+    // the next byteCount bytes, null if there aren't enough of them
+    const unsigned char* Consume(size_t byteCount)
+    {
+        if (m_hasFailed || byteCount > m_size - m_offset)
+        {
+            m_hasFailed = true;
+            return nullptr;
+        }
+
+        const unsigned char* consumed = m_data + m_offset;
+        m_offset += byteCount;
+        return consumed;
+    }
+
+    bool Read(void* data, size_t byteCount)
+    {
+        const unsigned char* consumed = Consume(byteCount);
+        if (consumed == nullptr)
+            return false;
+
+        if (byteCount > 0)
+            std::memcpy(data, consumed, byteCount);
+        return true;
+    }
+
+    size_t GetOffset() const
+    {
+        return m_offset;
+    }
+
+    bool IsAtEnd() const
+    {
+        return m_offset == m_size;
+    }
+
+    bool HasFailed() const
+    {
+        return m_hasFailed;
+    }
+};
+
+template<typename ObjectClass>
+constexpr bool IsReflected()
+{
+    return PropertyRegistry<ObjectClass>::s_propertyCount > 0;
+}
+
+template<typename ObjectClass>
+void SaveBinary(const ObjectClass& object, BinaryArena& arena);
+
+template<typename ObjectClass>
+bool LoadBinary(ObjectClass& object, BinaryReader& reader);
+
+// How a property value is written, specialize it for the types which are neither trivially copyable nor reflected.
+// The trivially copyable values are copied as they are in memory : the files are only read back by the same build on the same platform.
+template<typename Value, typename Enable = void>
+struct BinaryValueSerializer
+{
+    static_assert(std::is_trivially_copyable<Value>::value, "no binary serializer for this property type, specialize meta::BinaryValueSerializer");
+
+    static void Save(const Value& value, BinaryArena& arena)
+    {
+        arena.Write(&value, sizeof(Value));
+    }
+
+    static bool Load(Value& value, BinaryReader& reader)
+    {
+        return reader.Read(&value, sizeof(Value));
+    }
+};
+
+// the reflected classes are written property by property, recursively
+template<typename Value>
+struct BinaryValueSerializer<Value, std::enable_if_t<!std::is_trivially_copyable<Value>::value && IsReflected<Value>()>>
+{
+    static void Save(const Value& value, BinaryArena& arena)
+    {
+        SaveBinary(value, arena);
+    }
+
+    static bool Load(Value& value, BinaryReader& reader)
+    {
+        return LoadBinary(value, reader);
+    }
+};
+
+// the sizes are written on 64 bits, whatever the platform
+template<>
+struct BinaryValueSerializer<std::string>
+{
+    static void Save(const std::string& value, BinaryArena& arena)
+    {
+        const uint64_t length = value.size();
+        unsigned char* destination = arena.Allocate(sizeof(length) + value.size());
+        std::memcpy(destination, &length, sizeof(length));
+        if (length > 0)
+            std::memcpy(destination + sizeof(length), value.data(), value.size());
+    }
+
+    static bool Load(std::string& value, BinaryReader& reader)
+    {
+        uint64_t length = 0;
+        if (!reader.Read(&length, sizeof(length)))
+            return false;
+
+        const unsigned char* characters = reader.Consume((size_t)length);
+        if (characters == nullptr)
+            return false;
+
+        value.assign((const char*)characters, (size_t)length);
+        return true;
+    }
+};
+
+template<typename Element>
+struct BinaryValueSerializer<std::vector<Element>>
+{
+    static void Save(const std::vector<Element>& value, BinaryArena& arena)
+    {
+        const uint64_t count = value.size();
+        arena.Write(&count, sizeof(count));
+        if constexpr (std::is_trivially_copyable<Element>::value)
+        {
+            arena.Write(value.data(), value.size() * sizeof(Element));
+        }
+        else
+        {
+            for (const Element& element : value)
+                BinaryValueSerializer<Element>::Save(element, arena);
+        }
+    }
+
+    static bool Load(std::vector<Element>& value, BinaryReader& reader)
+    {
+        uint64_t count = 0;
+        if (!reader.Read(&count, sizeof(count)))
+            return false;
+
+        if constexpr (std::is_trivially_copyable<Element>::value)
+        {
+            // check the size before resizing, a corrupted count must not allocate
+            if (count > SIZE_MAX / sizeof(Element))
+                return false;
+            const unsigned char* elements = reader.Consume((size_t)count * sizeof(Element));
+            if (elements == nullptr)
+                return false;
+
+            value.resize((size_t)count);
+            if (count > 0)
+                std::memcpy(value.data(), elements, (size_t)count * sizeof(Element));
+            return true;
+        }
+        else
+        {
+            value.clear();
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                value.emplace_back();
+                if (!BinaryValueSerializer<Element>::Load(value.back(), reader))
+                    return false;
+            }
+            return true;
+        }
+    }
+};
+
+namespace details{
+
+// A step of the binary layout of a class : a run of trivially copyable properties adjacent in memory, copied with a single memcpy,
+// or one property written by its BinaryValueSerializer.
+struct BinaryLayoutStep
+{
+    // -1 for a run
+    int propertyIndex;
+    size_t offset;
+    size_t size;
+};
+
+template<typename ObjectClass, size_t StepCapacity>
+struct BinaryLayout
+{
+    std::array<BinaryLayoutStep, StepCapacity> steps;
+    size_t stepCount;
+    // the properties cover the whole object without padding : arrays of objects are copied with a single memcpy
+    bool isWholeObjectRun;
+};
+
+// Member pointers can't be converted to offsets in a constant expression : the offsets are measured on a default constructed object.
+template<typename ObjectClass, int... Is>
+std::array<size_t, sizeof...(Is) + 1> GetPropertyOffsets(::details::seq<Is...>)
+{
+    const auto& properties = PropertyRegistry<ObjectClass>::properties;
+    const ObjectClass object{};
+    const unsigned char* objectBytes = reinterpret_cast<const unsigned char*>(&object);
+    return { { (size_t)(reinterpret_cast<const unsigned char*>(&std::get<Is>(properties).GetValue(object)) - objectBytes)..., 0 } };
+}
+
+// Which properties can be merged in runs is known at compile time (their type), where they are needs the member offsets :
+// the layout is computed once per class, at the first use. The classes without default constructor write each property on its own.
+template<typename ObjectClass, int... Is>
+BinaryLayout<ObjectClass, sizeof...(Is) + 1> BuildBinaryLayout(::details::seq<Is...> indices)
+{
+    using TupleType = typename PropertyRegistry<ObjectClass>::TupleType;
+    constexpr bool canMerge = std::is_default_constructible<ObjectClass>::value;
+    const std::array<bool, sizeof...(Is) + 1> isTrivial = { { (canMerge && std::is_trivially_copyable<typename std::tuple_element<Is, TupleType>::type::PropertyType>::value)..., false } };
+    std::array<size_t, sizeof...(Is) + 1> offsets{};
+    if constexpr (canMerge)
+        offsets = GetPropertyOffsets<ObjectClass>(indices);
+    const std::array<size_t, sizeof...(Is) + 1> sizes = { { sizeof(typename std::tuple_element<Is, TupleType>::type::PropertyType)..., 0 } };
+
+    BinaryLayout<ObjectClass, sizeof...(Is) + 1> layout{};
+    for (size_t propertyIndex = 0; propertyIndex < sizeof...(Is); ++propertyIndex)
+    {
+        BinaryLayoutStep* previousStep = layout.stepCount > 0 ? &layout.steps[layout.stepCount - 1] : nullptr;
+        if (isTrivial[propertyIndex] && previousStep != nullptr && previousStep->propertyIndex < 0 && previousStep->offset + previousStep->size == offsets[propertyIndex])
+            previousStep->size += sizes[propertyIndex];
+        else
+            layout.steps[layout.stepCount++] = BinaryLayoutStep{ isTrivial[propertyIndex] ? -1 : (int)propertyIndex, offsets[propertyIndex], sizes[propertyIndex] };
+    }
+    layout.isWholeObjectRun = std::is_trivially_copyable<ObjectClass>::value && layout.stepCount == 1 && layout.steps[0].propertyIndex < 0
+        && layout.steps[0].offset == 0 && layout.steps[0].size == sizeof(ObjectClass);
+    return layout;
+}
+
+template<typename ObjectClass>
+const auto& GetBinaryLayout()
+{
+    static const auto layout = BuildBinaryLayout<ObjectClass>(::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>());
+    return layout;
+}
+
+template<typename ObjectClass, int Index>
+void SavePropertyAt(const ObjectClass& object, BinaryArena& arena)
+{
+    const auto& property = std::get<Index>(PropertyRegistry<ObjectClass>::properties);
+    BinaryValueSerializer<typename std::decay_t<decltype(property)>::PropertyType>::Save(property.GetValue(object), arena);
+}
+
+template<typename ObjectClass, int Index>
+bool LoadPropertyAt(ObjectClass& object, BinaryReader& reader)
+{
+    const auto& property = std::get<Index>(PropertyRegistry<ObjectClass>::properties);
+    return BinaryValueSerializer<typename std::decay_t<decltype(property)>::PropertyType>::Load(property.GetValue(object), reader);
+}
+
+template<typename ObjectClass, int... Is>
+void SaveProperty(const ObjectClass& object, int propertyIndex, BinaryArena& arena, ::details::seq<Is...>)
+{
+    using Saver = void (*)(const ObjectClass&, BinaryArena&);
+    static constexpr Saver savers[] = { &SavePropertyAt<ObjectClass, Is>..., nullptr };
+    savers[propertyIndex](object, arena);
+}
+
+template<typename ObjectClass, int... Is>
+bool LoadProperty(ObjectClass& object, int propertyIndex, BinaryReader& reader, ::details::seq<Is...>)
+{
+    using Loader = bool (*)(ObjectClass&, BinaryReader&);
+    static constexpr Loader loaders[] = { &LoadPropertyAt<ObjectClass, Is>..., nullptr };
+    return loaders[propertyIndex](object, reader);
+}
+
+} // details
+
+// write the registered properties of object, in registration order
+template<typename ObjectClass>
+void SaveBinary(const ObjectClass& object, BinaryArena& arena)
+{
+    const auto& layout = details::GetBinaryLayout<ObjectClass>();
+    const unsigned char* objectBytes = reinterpret_cast<const unsigned char*>(&object);
+    for (size_t stepIndex = 0; stepIndex < layout.stepCount; ++stepIndex)
+    {
+        const details::BinaryLayoutStep& step = layout.steps[stepIndex];
+        if (step.propertyIndex < 0)
+            arena.Write(objectBytes + step.offset, step.size);
+        else
+            details::SaveProperty(object, step.propertyIndex, arena, ::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>());
+    }
+}
+
+// read the properties written by SaveBinary, false if the data is truncated
+template<typename ObjectClass>
+bool LoadBinary(ObjectClass& object, BinaryReader& reader)
+{
+    const auto& layout = details::GetBinaryLayout<ObjectClass>();
+    unsigned char* objectBytes = reinterpret_cast<unsigned char*>(&object);
+    for (size_t stepIndex = 0; stepIndex < layout.stepCount; ++stepIndex)
+    {
+        const details::BinaryLayoutStep& step = layout.steps[stepIndex];
+        const bool isLoaded = step.propertyIndex < 0
+            ? reader.Read(objectBytes + step.offset, step.size)
+            : details::LoadProperty(object, step.propertyIndex, reader, ::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>());
+        if (!isLoaded)
+            return false;
+    }
+    return true;
+}
+
+// objects one after the other, the whole array in one memcpy if the properties cover the objects
+template<typename ObjectClass>
+void SaveBinaryArray(const ObjectClass* objects, size_t objectCount, BinaryArena& arena)
+{
+    if (details::GetBinaryLayout<ObjectClass>().isWholeObjectRun)
+    {
+        arena.Write(objects, objectCount * sizeof(ObjectClass));
+        return;
+    }
+
+    for (size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex)
+        SaveBinary(objects[objectIndex], arena);
+}
+
+template<typename ObjectClass>
+bool LoadBinaryArray(ObjectClass* objects, size_t objectCount, BinaryReader& reader)
+{
+    if (details::GetBinaryLayout<ObjectClass>().isWholeObjectRun)
+        return reader.Read(objects, objectCount * sizeof(ObjectClass));
+
+    for (size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex)
+    {
+        if (!LoadBinary(objects[objectIndex], reader))
+            return false;
+    }
+    return true;
+}
+
+} // meta
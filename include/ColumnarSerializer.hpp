@@ -0,0 +1,483 @@
+#pragma once
+
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <type_traits>
+#include <utility>
+
+#include "BinarySerializer.hpp"
+
+namespace meta{
+
+// How a column is stored, chosen per column by SaveColumns.
+enum class ColumnEncoding : uint8_t
+{
+    // the values one after the other
+    RAW = 0,
+    // (run length, value) pairs, for the values repeated by consecutive objects
+    RLE = 1,
+    // integers only : the difference with the previous value, zigzag and varint encoded
+    DELTA = 2,
+    // integers only : runs of equal differences, sequential ids are a single run
+    DELTA_RLE = 3,
+};
+
+namespace details{
+
+template<typename Value, typename Enable = void>
+struct IsEqualityComparable : std::false_type {};
+
+template<typename Value>
+struct IsEqualityComparable<Value, decltype((void)(std::declval<const Value&>() == std::declval<const Value&>()))> : std::true_type {};
+
+template<typename Value>
+constexpr bool IsDeltaEncodable()
+{
+    return std::is_integral<Value>::value && !std::is_same<Value, bool>::value;
+}
+
+inline size_t GetVarintSize(uint64_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+inline void WriteVarint(uint64_t value, BinaryArena& arena)
+{
+    unsigned char bytes[10];
+    size_t size = 0;
+    while (value >= 0x80)
+    {
+        bytes[size++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[size++] = (unsigned char)value;
+    arena.Write(bytes, size);
+}
+
+inline bool ReadVarint(uint64_t& value, BinaryReader& reader)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        const unsigned char* byte = reader.Consume(1);
+        if (byte == nullptr)
+            return false;
+
+        value |= (uint64_t)(*byte & 0x7f) << shift;
+        if ((*byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// difference of two integers of the same width, wrapping, mapped to an unsigned value small for small differences of any sign
+template<typename Value>
+uint64_t EncodeDelta(Value value, Value previousValue)
+{
+    using Unsigned = std::make_unsigned_t<Value>;
+    const int64_t delta = (std::make_signed_t<Unsigned>)(Unsigned)((Unsigned)value - (Unsigned)previousValue);
+    return ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+}
+
+template<typename Value>
+Value DecodeDelta(uint64_t encodedDelta, Value previousValue)
+{
+    using Unsigned = std::make_unsigned_t<Value>;
+    const uint64_t delta = (encodedDelta >> 1) ^ (~(encodedDelta & 1) + 1);
+    return (Value)(Unsigned)((Unsigned)previousValue + (Unsigned)delta);
+}
+
+template<typename Value>
+bool AreSameValues(const Value& first, const Value& second)
+{
+    // byte compare : a float column keeps its -0 and its NaNs
+    if constexpr (std::is_trivially_copyable<Value>::value)
+        return std::memcmp(&first, &second, sizeof(Value)) == 0;
+    else
+        return first == second;
+}
+
+// Size of the column in each encoding, measured in one pass over the values.
+// The non trivially copyable values have no known size : they are run length encoded if they repeat at least every other object.
+template<typename ObjectClass, typename Prop>
+ColumnEncoding ChooseColumnEncoding(const ObjectClass* objects, size_t objectCount, const PropertyMetadata<ObjectClass, Prop>& property)
+{
+    if (objectCount == 0)
+        return ColumnEncoding::RAW;
+
+    if constexpr (std::is_trivially_copyable<Prop>::value)
+    {
+        size_t rleSize = 0;
+        size_t deltaSize = 0;
+        size_t deltaRleSize = 0;
+        size_t runLength = 1;
+        size_t deltaRunLength = 1;
+        uint64_t previousDelta = 0;
+        if constexpr (IsDeltaEncodable<Prop>())
+        {
+            previousDelta = EncodeDelta<Prop>(property.GetValue(objects[0]), 0);
+            deltaSize = GetVarintSize(previousDelta);
+        }
+
+        for (size_t objectIndex = 1; objectIndex < objectCount; ++objectIndex)
+        {
+            const Prop& value = property.GetValue(objects[objectIndex]);
+            const Prop& previousValue = property.GetValue(objects[objectIndex - 1]);
+            if (AreSameValues(value, previousValue))
+            {
+                runLength++;
+            }
+            else
+            {
+                rleSize += GetVarintSize(runLength) + sizeof(Prop);
+                runLength = 1;
+            }
+
+            if constexpr (IsDeltaEncodable<Prop>())
+            {
+                const uint64_t delta = EncodeDelta(value, previousValue);
+                deltaSize += GetVarintSize(delta);
+                if (delta == previousDelta)
+                {
+                    deltaRunLength++;
+                }
+                else
+                {
+                    deltaRleSize += GetVarintSize(deltaRunLength) + GetVarintSize(previousDelta);
+                    deltaRunLength = 1;
+                    previousDelta = delta;
+                }
+            }
+        }
+        rleSize += GetVarintSize(runLength) + sizeof(Prop);
+
+        // on a tie the raw column wins, it is the fastest to load
+        ColumnEncoding encoding = ColumnEncoding::RAW;
+        size_t encodedSize = objectCount * sizeof(Prop);
+        if (rleSize < encodedSize)
+        {
+            encoding = ColumnEncoding::RLE;
+            encodedSize = rleSize;
+        }
+        if constexpr (IsDeltaEncodable<Prop>())
+        {
+            deltaRleSize += GetVarintSize(deltaRunLength) + GetVarintSize(previousDelta);
+            if (deltaSize < encodedSize)
+            {
+                encoding = ColumnEncoding::DELTA;
+                encodedSize = deltaSize;
+            }
+            if (deltaRleSize < encodedSize)
+                encoding = ColumnEncoding::DELTA_RLE;
+        }
+        return encoding;
+    }
+    else if constexpr (IsEqualityComparable<Prop>::value)
+    {
+        size_t runCount = 1;
+        for (size_t objectIndex = 1; objectIndex < objectCount; ++objectIndex)
+        {
+            if (!AreSameValues(property.GetValue(objects[objectIndex]), property.GetValue(objects[objectIndex - 1])))
+                runCount++;
+        }
+        return runCount * 2 <= objectCount ? ColumnEncoding::RLE : ColumnEncoding::RAW;
+    }
+    else
+    {
+        return ColumnEncoding::RAW;
+    }
+}
+
+template<typename Prop>
+void SaveColumnValue(const Prop& value, BinaryArena& arena)
+{
+    if constexpr (std::is_trivially_copyable<Prop>::value)
+        arena.Write(&value, sizeof(Prop));
+    else
+        BinaryValueSerializer<Prop>::Save(value, arena);
+}
+
+template<typename Prop>
+bool LoadColumnValue(Prop& value, BinaryReader& reader)
+{
+    if constexpr (std::is_trivially_copyable<Prop>::value)
+        return reader.Read(&value, sizeof(Prop));
+    else
+        return BinaryValueSerializer<Prop>::Load(value, reader);
+}
+
+template<typename ObjectClass, typename Prop>
+void SaveColumn(const ObjectClass* objects, size_t objectCount, const PropertyMetadata<ObjectClass, Prop>& property, ColumnEncoding encoding, BinaryArena& arena)
+{
+    if (encoding == ColumnEncoding::RAW)
+    {
+        if constexpr (std::is_trivially_copyable<Prop>::value)
+        {
+            // gathered in place, the arena grows once for the whole column
+            unsigned char* column = arena.Allocate(objectCount * sizeof(Prop));
+            for (size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex)
+                std::memcpy(column + objectIndex * sizeof(Prop), &property.GetValue(objects[objectIndex]), sizeof(Prop));
+        }
+        else
+        {
+            for (size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex)
+                BinaryValueSerializer<Prop>::Save(property.GetValue(objects[objectIndex]), arena);
+        }
+    }
+    else if (encoding == ColumnEncoding::RLE)
+    {
+        size_t runBegin = 0;
+        for (size_t objectIndex = 1; objectIndex <= objectCount; ++objectIndex)
+        {
+            if (objectIndex < objectCount && AreSameValues(property.GetValue(objects[objectIndex]), property.GetValue(objects[runBegin])))
+                continue;
+
+            WriteVarint(objectIndex - runBegin, arena);
+            SaveColumnValue(property.GetValue(objects[runBegin]), arena);
+            runBegin = objectIndex;
+        }
+    }
+    else if constexpr (IsDeltaEncodable<Prop>())
+    {
+        Prop previousValue = 0;
+        uint64_t runDelta = 0;
+        size_t runLength = 0;
+        for (size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex)
+        {
+            const Prop value = property.GetValue(objects[objectIndex]);
+            const uint64_t delta = EncodeDelta(value, previousValue);
+            previousValue = value;
+            if (encoding == ColumnEncoding::DELTA)
+            {
+                WriteVarint(delta, arena);
+            }
+            else if (runLength > 0 && delta == runDelta)
+            {
+                runLength++;
+            }
+            else
+            {
+                if (runLength > 0)
+                {
+                    WriteVarint(runLength, arena);
+                    WriteVarint(runDelta, arena);
+                }
+                runDelta = delta;
+                runLength = 1;
+            }
+        }
+        if (runLength > 0)
+        {
+            WriteVarint(runLength, arena);
+            WriteVarint(runDelta, arena);
+        }
+    }
+}
+
+template<typename ObjectClass, typename Prop>
+bool LoadColumn(ObjectClass* objects, size_t objectCount, const PropertyMetadata<ObjectClass, Prop>& property, ColumnEncoding encoding, BinaryReader& reader)
+{
+    if (encoding == ColumnEncoding::RAW)
+    {
+        if constexpr (std::is_trivially_copyable<Prop>::value)
+        {
+            if (objectCount > SIZE_MAX / sizeof(Prop))
+                return false;
+            const unsigned char* column = reader.Consume(objectCount * sizeof(Prop));
+            if (column == nullptr)
+                return false;
+
+            for (size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex)
+                std::memcpy(&property.GetValue(objects[objectIndex]), column + objectIndex * sizeof(Prop), sizeof(Prop));
+        }
+        else
+        {
+            for (size_t objectIndex = 0; objectIndex < objectCount; ++objectIndex)
+            {
+                if (!BinaryValueSerializer<Prop>::Load(property.GetValue(objects[objectIndex]), reader))
+                    return false;
+            }
+        }
+        return true;
+    }
+    else if (encoding == ColumnEncoding::RLE)
+    {
+        size_t objectIndex = 0;
+        while (objectIndex < objectCount)
+        {
+            uint64_t runLength = 0;
+            if (!ReadVarint(runLength, reader) || runLength == 0 || runLength > objectCount - objectIndex)
+                return false;
+
+            Prop& runValue = property.GetValue(objects[objectIndex]);
+            if (!LoadColumnValue(runValue, reader))
+                return false;
+            for (size_t runIndex = 1; runIndex < runLength; ++runIndex)
+                property.GetValue(objects[objectIndex + runIndex]) = runValue;
+            objectIndex += (size_t)runLength;
+        }
+        return true;
+    }
+    else if constexpr (IsDeltaEncodable<Prop>())
+    {
+        if (encoding != ColumnEncoding::DELTA && encoding != ColumnEncoding::DELTA_RLE)
+            return false;
+
+        Prop previousValue = 0;
+        size_t objectIndex = 0;
+        while (objectIndex < objectCount)
+        {
+            uint64_t runLength = 1;
+            if (encoding == ColumnEncoding::DELTA_RLE && (!ReadVarint(runLength, reader) || runLength == 0 || runLength > objectCount - objectIndex))
+                return false;
+            uint64_t delta = 0;
+            if (!ReadVarint(delta, reader))
+                return false;
+
+            for (uint64_t runIndex = 0; runIndex < runLength; ++runIndex)
+            {
+                previousValue = DecodeDelta(delta, previousValue);
+                property.GetValue(objects[objectIndex++]) = previousValue;
+            }
+        }
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+// A column : its encoding, the byte size of its data, its data.
+// The size lets a loader skip the columns it doesn't want, and bounds the reads of a corrupted column to its own bytes.
+template<typename ObjectClass, int Index>
+void SaveColumnAt(const ObjectClass* objects, size_t objectCount, bool isEncoded, BinaryArena& arena)
+{
+    const auto& property = std::get<Index>(PropertyRegistry<ObjectClass>::properties);
+    const ColumnEncoding encoding = isEncoded ? ChooseColumnEncoding(objects, objectCount, property) : ColumnEncoding::RAW;
+    arena.Write(&encoding, sizeof(encoding));
+
+    const size_t sizeOffset = arena.GetSize();
+    arena.Allocate(sizeof(uint64_t));
+    SaveColumn(objects, objectCount, property, encoding, arena);
+    const uint64_t columnSize = arena.GetSize() - sizeOffset - sizeof(uint64_t);
+    std::memcpy(arena.GetData() + sizeOffset, &columnSize, sizeof(columnSize));
+}
+
+// Whether a column of columnSize bytes can hold objectCount values, checked before the objects are allocated.
+// Only the raw columns of trivially copyable values and the delta columns (a byte per value at least) bound the count,
+// a run of any length takes a few bytes.
+template<typename ObjectClass, typename Prop>
+bool CanHoldObjects(uint64_t objectCount, const PropertyMetadata<ObjectClass, Prop>& /*property*/, ColumnEncoding encoding, uint64_t columnSize)
+{
+    switch (encoding)
+    {
+    case ColumnEncoding::RAW:
+        if constexpr (std::is_trivially_copyable<Prop>::value)
+            return objectCount <= columnSize / sizeof(Prop) && objectCount * sizeof(Prop) == columnSize;
+        else
+            return true;
+    case ColumnEncoding::RLE:
+        return true;
+    case ColumnEncoding::DELTA:
+        return IsDeltaEncodable<Prop>() && objectCount <= columnSize;
+    case ColumnEncoding::DELTA_RLE:
+        return IsDeltaEncodable<Prop>();
+    default:
+        return false;
+    }
+}
+
+template<typename ObjectClass, int Index>
+bool CheckColumnHeaderAt(uint64_t objectCount, BinaryReader& reader)
+{
+    ColumnEncoding encoding = ColumnEncoding::RAW;
+    uint64_t columnSize = 0;
+    if (!reader.Read(&encoding, sizeof(encoding)) || !reader.Read(&columnSize, sizeof(columnSize)) || columnSize > SIZE_MAX || reader.Consume((size_t)columnSize) == nullptr)
+        return false;
+
+    return CanHoldObjects(objectCount, std::get<Index>(PropertyRegistry<ObjectClass>::properties), encoding, columnSize);
+}
+
+template<typename ObjectClass, int Index>
+bool LoadColumnAt(ObjectClass* objects, size_t objectCount, BinaryReader& reader)
+{
+    ColumnEncoding encoding = ColumnEncoding::RAW;
+    uint64_t columnSize = 0;
+    if (!reader.Read(&encoding, sizeof(encoding)) || !reader.Read(&columnSize, sizeof(columnSize)) || columnSize > SIZE_MAX)
+        return false;
+
+    const unsigned char* column = reader.Consume((size_t)columnSize);
+    if (column == nullptr)
+        return false;
+
+    BinaryReader columnReader(column, (size_t)columnSize);
+    const auto& property = std::get<Index>(PropertyRegistry<ObjectClass>::properties);
+    return LoadColumn(objects, objectCount, property, encoding, columnReader) && columnReader.IsAtEnd();
+}
+
+template<typename ObjectClass, int... Is>
+void SaveColumns(const ObjectClass* objects, size_t objectCount, bool isEncoded, BinaryArena& arena, ::details::seq<Is...>)
+{
+    (SaveColumnAt<ObjectClass, Is>(objects, objectCount, isEncoded, arena), ...);
+}
+
+template<typename ObjectClass, int... Is>
+bool CheckColumnHeaders(uint64_t objectCount, BinaryReader& reader, ::details::seq<Is...>)
+{
+    return (CheckColumnHeaderAt<ObjectClass, Is>(objectCount, reader) && ...);
+}
+
+template<typename ObjectClass, int... Is>
+bool LoadColumns(ObjectClass* objects, size_t objectCount, BinaryReader& reader, ::details::seq<Is...>)
+{
+    return (LoadColumnAt<ObjectClass, Is>(objects, objectCount, reader) && ...);
+}
+
+} // details
+
+// Columnar save of objects of the same class : each registered property of all the objects is written as one contiguous column.
+// With isEncoded, each column is stored raw, run length encoded or delta encoded, whichever is the smallest for its values.
+// Meant for the object arrays of a scene : repetitive values take a few bytes whatever the object count.
+template<typename ObjectClass>
+void SaveColumns(const ObjectClass* objects, size_t objectCount, BinaryArena& arena, bool isEncoded = true)
+{
+    const uint64_t header[2] = { objectCount, (uint64_t)PropertyRegistry<ObjectClass>::s_propertyCount };
+    arena.Write(header, sizeof(header));
+    details::SaveColumns(objects, objectCount, isEncoded, arena, ::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>());
+}
+
+template<typename ObjectClass>
+void SaveColumns(const std::vector<ObjectClass>& objects, BinaryArena& arena, bool isEncoded = true)
+{
+    SaveColumns(objects.data(), objects.size(), arena, isEncoded);
+}
+
+// Replace objects by the objects written by SaveColumns, rebuilt with one pass per column.
+// Return false if the data is truncated, corrupted, or written for another property count.
+// All the column headers are checked before the objects are allocated, but the run length encoded columns can describe any count :
+// give maxObjectCount for the data which isn't trusted
+template<typename ObjectClass>
+bool LoadColumns(std::vector<ObjectClass>& objects, BinaryReader& reader, size_t maxObjectCount = SIZE_MAX)
+{
+    uint64_t header[2] = { 0, 0 };
+    if (!reader.Read(header, sizeof(header)) || header[1] != (uint64_t)PropertyRegistry<ObjectClass>::s_propertyCount || header[0] > maxObjectCount || header[0] > objects.max_size())
+        return false;
+
+    BinaryReader headerReader = reader;
+    if (!details::CheckColumnHeaders<ObjectClass>(header[0], headerReader, ::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>()))
+        return false;
+
+    objects.clear();
+    objects.resize((size_t)header[0]);
+    return details::LoadColumns(objects.data(), objects.size(), reader, ::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>());
+}
+
+} // meta
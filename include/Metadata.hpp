@@ -4,6 +4,10 @@
 #include <tuple>
 #include <iostream>
 #include <functional>
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
 
 namespace details{
 
@@ -53,70 +57,351 @@ void testForeEachTuple()
 #include <boost/preprocessor/arithmetic/sub.hpp>
 #include <boost/preprocessor/control/if.hpp>
 
+template<typename Class, typename Prop>
+class PropertyMetadata
+{
+private:
+    // the names are string literals, nothing is allocated when the properties are registered
+    std::string_view m_propertyName;
+    Prop Class::* m_propertyPtr;
+
+public:
+    using PropertyType = Prop;
+
+    constexpr PropertyMetadata(std::string_view propertyName, Prop Class::* propertyPtr)
+        : m_propertyName(propertyName)
+        , m_propertyPtr(propertyPtr)
+    {}
+
+    constexpr std::string_view GetName() const
+    {
+        return m_propertyName;
+    }
+
+    const Prop& GetValue(const Class& object) const
+    {
+        return object.*m_propertyPtr;
+    }
+
+    Prop& GetValue(Class& object) const
+    {
+        return object.*m_propertyPtr;
+    }
+
+    constexpr Prop Class::* GetPropertyPtr() const
+    {
+        return m_propertyPtr;
+    }
+};
+
 namespace meta{
 
-template<typename ObjectClass, typename TupleType>
-struct Datas
+// specialized for each reflected class, the returned tuple must be a constant expression
+template<typename ObjectClass>
+constexpr auto RegisterProperties()
 {
-    static TupleType properties;
-    std::string className;
-
-    // template<typename F>
-    // static void ForEachProperties(const ObjectClass& object, F function)
-    // {
-    //     for_each_in_tuple<decltype(registerProperties<ObjectClass>())>(properties, function);
-    // }
-};
+    return std::make_tuple();
+}
 
-template<typename ObjectClass, typename F>
-static void ForEachProperties(const ObjectClass& object, const F& function)
+namespace details{
+
+// FNV-1a
+constexpr uint32_t HashPropertyName(std::string_view name)
 {
-    for_each_in_tuple_02<decltype(RegisterProperties<ObjectClass>())>( GetDatas<ObjectClass, decltype(RegisterProperties<ObjectClass>())>().properties, function );
+    uint32_t hash = 2166136261u;
+    for (char character : name)
+    {
+        hash ^= (unsigned char)character;
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-template<typename ObjectClass, typename TupleType>
-const Datas<ObjectClass, TupleType>& GetDatas()
+constexpr size_t NextPowerOfTwo(size_t value)
 {
-    static Datas<ObjectClass, TupleType> datas;
-    return datas;
+    size_t powerOfTwo = 1;
+    while (powerOfTwo < value)
+        powerOfTwo *= 2;
+    return powerOfTwo;
 }
 
-template<typename ObjectClass>
-static auto RegisterProperties()
+constexpr size_t Log2(size_t powerOfTwo)
 {
-    return std::make_tuple();
+    size_t exponent = 0;
+    while (powerOfTwo > 1)
+    {
+        powerOfTwo /= 2;
+        exponent++;
+    }
+    return exponent;
 }
 
-} // meta
+// Perfect hash of the property names of a class, built at compile time (hash and displace).
+// The low bits of the name hash select a bucket, then the seed of the bucket mixed with the hash sends the names of the bucket to free slots.
+// A lookup is one hash, one multiply and one name compare, whatever the property count.
+// The small classes only compare the names one after the other : a few size compares are cheaper than hashing the name.
+template<size_t PropertyCount>
+struct PropertyNameTable
+{
+    enum : size_t
+    {
+        s_maxScannedCount = 8,
+        s_bucketCount = NextPowerOfTwo(PropertyCount > 0 ? PropertyCount : 1),
+        s_slotCount = 2 * s_bucketCount,
+        s_slotShift = 32 - Log2(s_slotCount),
+        // a bucket which still collides after this many seeds has two names of the same hash
+        s_maxSeed = 1 << 16,
+    };
+
+    struct Slot
+    {
+        std::string_view name;
+        // index of the property in the tuple, -1 for the empty slots
+        int index;
+    };
+
+    std::array<std::string_view, PropertyCount> m_names;
+    std::array<uint32_t, s_bucketCount> m_bucketSeeds;
+    std::array<Slot, s_slotCount> m_slots;
+    // false if two properties have the same name, or the same hash
+    bool m_isValid;
+
+    // unrolled, each compare is against a name known at compile time
+    template<int... Is>
+    constexpr int FindScanned(std::string_view propertyName, ::details::seq<Is...>) const
+    {
+        int index = -1;
+        (void)((m_names[Is] == propertyName ? (index = Is, true) : false) || ...);
+        return index;
+    }
 
+    static constexpr size_t GetSlot(uint32_t hash, uint32_t seed)
+    {
+        return (size_t)(((hash ^ seed) * 2654435761u) >> s_slotShift);
+    }
 
-template<typename ObjectClass, typename TupleType>
-TupleType meta::Datas<ObjectClass, TupleType>::properties = meta::RegisterProperties<ObjectClass>();
+    constexpr int Find(std::string_view propertyName) const
+    {
+        if constexpr (PropertyCount <= s_maxScannedCount)
+        {
+            return FindScanned(propertyName, ::details::gen_seq<PropertyCount>());
+        }
+        else
+        {
+            const uint32_t hash = HashPropertyName(propertyName);
+            const Slot& slot = m_slots[GetSlot(hash, m_bucketSeeds[hash & (s_bucketCount - 1)])];
+            return slot.name == propertyName ? slot.index : -1;
+        }
+    }
+};
 
-template<typename Class, typename Prop>
-class PropertyMetadata
+template<size_t PropertyCount>
+constexpr PropertyNameTable<PropertyCount> BuildPropertyNameTable(const std::array<std::string_view, PropertyCount>& propertyNames)
 {
-private:
-    std::string m_propertyName;
-    Prop Class::* m_propertyPtr;
+    using Table = PropertyNameTable<PropertyCount>;
+    Table table{};
+    table.m_names = propertyNames;
+    table.m_isValid = true;
+    for (size_t slot = 0; slot < Table::s_slotCount; ++slot)
+    {
+        table.m_slots[slot].name = std::string_view("", 0);
+        table.m_slots[slot].index = -1;
+    }
 
-public:
-    PropertyMetadata(const std::string& propertyName, Prop Class::* propertyPtr)
-        : m_propertyName(propertyName)
-        , m_propertyPtr(propertyPtr)
-    {}
+    for (size_t i = 0; i < PropertyCount; ++i)
+    {
+        for (size_t j = i + 1; j < PropertyCount; ++j)
+        {
+            if (propertyNames[i] == propertyNames[j])
+                table.m_isValid = false;
+        }
+    }
+    if (!table.m_isValid || PropertyCount <= Table::s_maxScannedCount)
+        return table;
 
-    const std::string& GetName() const
+    std::array<uint32_t, PropertyCount + 1> propertyHashes{};
+    std::array<size_t, Table::s_bucketCount> bucketSizes{};
+    for (size_t i = 0; i < PropertyCount; ++i)
     {
-        return m_propertyName;
+        propertyHashes[i] = HashPropertyName(propertyNames[i]);
+        bucketSizes[propertyHashes[i] & (Table::s_bucketCount - 1)]++;
     }
 
-    const Prop& GetValue(const Class& object) const
+    // the biggest buckets are placed first, while most of the slots are free
+    std::array<size_t, Table::s_bucketCount> bucketOrder{};
+    for (size_t bucket = 0; bucket < Table::s_bucketCount; ++bucket)
+        bucketOrder[bucket] = bucket;
+    for (size_t i = 0; i < Table::s_bucketCount; ++i)
     {
-        return object.*m_propertyPtr;
+        for (size_t j = i + 1; j < Table::s_bucketCount; ++j)
+        {
+            if (bucketSizes[bucketOrder[j]] > bucketSizes[bucketOrder[i]])
+            {
+                const size_t swapped = bucketOrder[i];
+                bucketOrder[i] = bucketOrder[j];
+                bucketOrder[j] = swapped;
+            }
+        }
     }
+
+    for (size_t orderIndex = 0; orderIndex < Table::s_bucketCount && bucketSizes[bucketOrder[orderIndex]] > 0; ++orderIndex)
+    {
+        const size_t bucket = bucketOrder[orderIndex];
+        bool isPlaced = false;
+        for (uint32_t seed = 0; seed < Table::s_maxSeed; ++seed)
+        {
+            // place the names of the bucket, and remove them if one of them collides
+            std::array<size_t, PropertyCount + 1> placedSlots{};
+            size_t placedCount = 0;
+            bool collides = false;
+            for (size_t i = 0; i < PropertyCount && !collides; ++i)
+            {
+                if ((propertyHashes[i] & (Table::s_bucketCount - 1)) != bucket)
+                    continue;
+
+                const size_t slot = Table::GetSlot(propertyHashes[i], seed);
+                if (table.m_slots[slot].index != -1)
+                {
+                    collides = true;
+                }
+                else
+                {
+                    table.m_slots[slot].index = (int)i;
+                    table.m_slots[slot].name = propertyNames[i];
+                    placedSlots[placedCount++] = slot;
+                }
+            }
+            if (!collides)
+            {
+                table.m_bucketSeeds[bucket] = seed;
+                isPlaced = true;
+                break;
+            }
+
+            for (size_t placedIndex = 0; placedIndex < placedCount; ++placedIndex)
+            {
+                table.m_slots[placedSlots[placedIndex]].index = -1;
+                table.m_slots[placedSlots[placedIndex]].name = std::string_view("", 0);
+            }
+        }
+        if (!isPlaced)
+        {
+            table.m_isValid = false;
+            return table;
+        }
+    }
+    return table;
+}
+
+template<typename TupleType, int... Is>
+constexpr std::array<std::string_view, sizeof...(Is)> GetPropertyNames(const TupleType& properties, ::details::seq<Is...>)
+{
+    return { { std::get<Is>(properties).GetName()... } };
+}
+
+} // details
+
+// Properties of a class and the name table of its properties, both computed at compile time.
+// Constant initialized : nothing runs and nothing is allocated at static init time.
+template<typename ObjectClass>
+struct PropertyRegistry
+{
+    using TupleType = decltype(RegisterProperties<ObjectClass>());
+
+    enum : int
+    {
+        s_propertyCount = (int)std::tuple_size<TupleType>::value,
+    };
+
+    static constexpr TupleType properties = RegisterProperties<ObjectClass>();
+    static constexpr details::PropertyNameTable<s_propertyCount> nameTable = details::BuildPropertyNameTable(details::GetPropertyNames(properties, ::details::gen_seq<s_propertyCount>()));
+
+    static_assert(nameTable.m_isValid, "two properties of the class have the same name (or the same hash)");
 };
 
+template<typename ObjectClass, typename F>
+void ForEachProperties([[maybe_unused]] const ObjectClass& object, const F& function)
+{
+    for_each_in_tuple(PropertyRegistry<ObjectClass>::properties, function);
+}
+
+// index of the property in the RegisterProperties tuple, -1 if the class has no property with this name.
+// Constant time, and usable at compile time : std::get<meta::FindPropertyIndex<Class>("name")>(...)
+template<typename ObjectClass>
+constexpr int FindPropertyIndex(std::string_view propertyName)
+{
+    return PropertyRegistry<ObjectClass>::nameTable.Find(propertyName);
+}
+
+namespace details{
+
+template<typename Prop, typename ObjectClass, int Index>
+Prop* GetPropertyValueAt(ObjectClass& object)
+{
+    const auto& property = std::get<Index>(PropertyRegistry<ObjectClass>::properties);
+    if constexpr (std::is_same<Prop, typename std::decay_t<decltype(property)>::PropertyType>::value)
+        return &property.GetValue(object);
+    else
+        return nullptr;
+}
+
+template<typename ObjectClass, typename F, int Index>
+void VisitPropertyAt(const F& function)
+{
+    function(std::get<Index>(PropertyRegistry<ObjectClass>::properties));
+}
+
+// one function per property, indexed by the property index : the name lookup selects the property without any scan
+template<typename Prop, typename ObjectClass, int... Is>
+Prop* GetPropertyValue(ObjectClass& object, int propertyIndex, ::details::seq<Is...>)
+{
+    using Getter = Prop* (*)(ObjectClass&);
+    static constexpr Getter getters[] = { &GetPropertyValueAt<Prop, ObjectClass, Is>..., nullptr };
+    return getters[propertyIndex](object);
+}
+
+template<typename ObjectClass, typename F, int... Is>
+void VisitProperty(int propertyIndex, const F& function, ::details::seq<Is...>)
+{
+    using Visitor = void (*)(const F&);
+    static constexpr Visitor visitors[] = { &VisitPropertyAt<ObjectClass, F, Is>..., nullptr };
+    visitors[propertyIndex](function);
+}
+
+} // details
+
+// the member of object named propertyName, null if there is no such property or if it isn't a Prop
+template<typename Prop, typename ObjectClass>
+Prop* GetPropertyValue(ObjectClass& object, std::string_view propertyName)
+{
+    const int propertyIndex = FindPropertyIndex<ObjectClass>(propertyName);
+    if (propertyIndex < 0)
+        return nullptr;
+
+    return details::GetPropertyValue<Prop>(object, propertyIndex, ::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>());
+}
+
+template<typename Prop, typename ObjectClass>
+const Prop* GetPropertyValue(const ObjectClass& object, std::string_view propertyName)
+{
+    return GetPropertyValue<Prop>(const_cast<ObjectClass&>(object), propertyName);
+}
+
+// call function with the PropertyMetadata named propertyName, like ForEachProperties does for each property.
+// Return false if the class has no such property
+template<typename ObjectClass, typename F>
+bool VisitProperty([[maybe_unused]] const ObjectClass& object, std::string_view propertyName, const F& function)
+{
+    const int propertyIndex = FindPropertyIndex<ObjectClass>(propertyName);
+    if (propertyIndex < 0)
+        return false;
+
+    details::VisitProperty<ObjectClass>(propertyIndex, function, ::details::gen_seq<PropertyRegistry<ObjectClass>::s_propertyCount>());
+    return true;
+}
+
+} // meta
+
 struct Test
 {
     int m_foo = 30;
@@ -127,7 +412,7 @@ struct Test
 namespace meta{
 
 template<>
-inline auto RegisterProperties<Test>()
+constexpr auto RegisterProperties<Test>()
 {
     return std::make_tuple(
         PropertyMetadata<Test, int>("foo", &Test::m_foo),
@@ -1,10 +1,29 @@
 #include <iostream>
 #include <string>
 #include <cstdlib>
+#include <cstring>
+#include <climits>
+
+#include <chrono>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <filesystem>
 
 #include "Application.hpp"
 #include "Object.hpp"
 #include "Metadata.hpp"
+#include "BinarySerializer.hpp"
+#include "ColumnarSerializer.hpp"
+#include "Utils.hpp"
+
+// print the failed checks, the process returns EXIT_FAILURE if one of them failed
+bool check(bool condition, const char* description)
+{
+    if (!condition)
+        std::cout << "FAILED : " << description << std::endl;
+    return condition;
+}
 
 void testApplication()
 {
@@ -47,12 +66,696 @@ void testMetadatas()
     //Foo<decltype(t), decltype(std::get<std::tuple_size<decltype(t)>::value - 1>(std::forward<decltype(t)>(t))), std::tuple_size<decltype(t)>::value - 1 >::Apply([](const auto& tupleMember){ std::cout<<tupleMember<<std::endl; }, std::forward<decltype(t)>(t));
 };
 
-int main()
+// GlyphLookupTable against a std::map filled with the same glyphs : BMP and extended charcodes, replaced glyphs, the ignored glyph 0.
+bool testGlyphLookupTable()
+{
+    GlyphLookupTable table;
+    std::map<unsigned long, unsigned int> charToIndex;
+    auto insert = [&](unsigned long charcode, unsigned int glyphIndex)
+    {
+        table.insert(charcode, glyphIndex);
+        if (glyphIndex != 0)
+            charToIndex[charcode] = glyphIndex;
+    };
+    for (unsigned long charcode = 0; charcode < 0x30000; charcode += 7)
+        insert(charcode, (unsigned int)(charcode % 5000));
+    for (unsigned long charcode : { 0x0ul, 0xFFul, 0x100ul, 0xFFFFul, 0x10000ul, 0x10FFFFul, 0x1F600ul })
+        insert(charcode, 4242);
+
+    bool isSame = table.size() == charToIndex.size();
+    for (unsigned long charcode = 0; charcode < 0x30000 && isSame; ++charcode)
+    {
+        unsigned int glyphIndex = 0;
+        const bool isFound = table.find(charcode, glyphIndex);
+        auto found = charToIndex.find(charcode);
+        isSame = found != charToIndex.end() ? isFound && glyphIndex == found->second : !isFound;
+    }
+    unsigned int glyphIndex = 0;
+    isSame = isSame && table.find(0x10FFFF, glyphIndex) && glyphIndex == 4242 && !table.find(0x10FFFE, glyphIndex);
+
+    unsigned int visitedCount = 0;
+    table.forEach([&](unsigned long charcode, unsigned int index)
+    {
+        auto found = charToIndex.find(charcode);
+        isSame = isSame && found != charToIndex.end() && found->second == index;
+        visitedCount++;
+    });
+    return check(isSame && visitedCount == charToIndex.size(), "glyph lookup table matches std::map");
+}
+
+// Glyph lookups per second on log and table like text, GlyphLookupTable against the previous std::map.
+// The charmap mimics a font covering latin, greek, cyrillic, some CJK and the emojis, no FreeType face is needed.
+bool testGlyphLookupBenchmark()
 {
+    GlyphLookupTable table;
+    std::map<unsigned long, unsigned int> charToIndex;
+    unsigned int glyphIndex = 1;
+    auto addRange = [&](unsigned long first, unsigned long last)
+    {
+        for (unsigned long charcode = first; charcode <= last; ++charcode, ++glyphIndex)
+        {
+            table.insert(charcode, glyphIndex);
+            charToIndex[charcode] = glyphIndex;
+        }
+    };
+    addRange(0x20, 0x7E);
+    addRange(0xA0, 0xFF);
+    addRange(0x370, 0x3FF);
+    addRange(0x400, 0x4FF);
+    addRange(0x4E00, 0x5FFF);
+    addRange(0x1F300, 0x1F6FF);
+
+    // realistic text : mostly ascii, with a few charcodes from the other ranges
+    const std::vector<std::string> lines = {
+        "[12:04:31.442] INFO  renderer: frame 18342 drawn in 3.21 ms (412 quads, 6 batches)",
+        "[12:04:31.459] WARN  assets: texture 'ui/icons/settings.png' missing, using placeholder",
+        "| id   | name              | status  | cpu %  | memory    |",
+        "| 0042 | WorkerThread#7    | running |  12.50 | 184.2 MiB |",
+        "ERROR in shader UIWidgetBatch.frag(23): undeclared identifier 'cornerRadius'",
+    };
+    std::vector<unsigned long> charcodes;
+    for (const auto& line : lines)
+    {
+        for (const auto& character : line)
+            charcodes.push_back((unsigned char)character);
+    }
+    for (unsigned long charcode : { 0xE9ul, 0x3B1ul, 0x416ul, 0x4E2Dul, 0x6587ul, 0x1F600ul, 0x1F4A1ul })
+        charcodes.push_back(charcode);
+
+    const int repeatCount = 200000;
+    const double lookupCount = (double)charcodes.size() * repeatCount;
+    unsigned long long checksum = 0;
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int repeat = 0; repeat < repeatCount; ++repeat)
+    {
+        for (unsigned long charcode : charcodes)
+        {
+            unsigned int index = 0;
+            if (table.find(charcode, index))
+                checksum += index;
+        }
+    }
+    double tableSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    begin = std::chrono::high_resolution_clock::now();
+    for (int repeat = 0; repeat < repeatCount; ++repeat)
+    {
+        for (unsigned long charcode : charcodes)
+        {
+            auto found = charToIndex.find(charcode);
+            if (found != charToIndex.end())
+                checksum -= found->second;
+        }
+    }
+    double mapSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    std::cout << "glyph lookup benchmark (" << table.size() << " glyphs, " << lookupCount << " lookups)" << std::endl;
+    std::cout << "  GlyphLookupTable : " << lookupCount / tableSeconds / 1e6 << " M lookups/s" << std::endl;
+    std::cout << "  std::map         : " << lookupCount / mapSeconds / 1e6 << " M lookups/s" << std::endl;
+    // both loops must have found the same glyphs
+    return check(checksum == 0, "glyph lookup benchmark checksum");
+}
+
+// An object of a scene as shown by the inspector : enough properties for the name table to hash the names instead of comparing them.
+struct InspectedObject
+{
+    float m_positionX = 0;
+    float m_positionY = 0;
+    float m_positionZ = 0;
+    float m_rotationX = 0;
+    float m_rotationY = 0;
+    float m_rotationZ = 0;
+    float m_scaleX = 0;
+    float m_scaleY = 0;
+    float m_scaleZ = 0;
+    float m_velocityX = 0;
+    float m_velocityY = 0;
+    float m_velocityZ = 0;
+    float m_mass = 0;
+    float m_friction = 0;
+    float m_restitution = 0;
+    float m_linearDamping = 0;
+    float m_angularDamping = 0;
+    float m_colorR = 0;
+    float m_colorG = 0;
+    float m_colorB = 0;
+    float m_colorA = 0;
+    float m_emissive = 0;
+    float m_roughness = 0;
+    float m_metallic = 0;
+    int m_layer = 0;
+    int m_renderOrder = 0;
+    float m_lodBias = 0;
+    float m_shadowBias = 0;
+    int m_health = 0;
+    int m_maxHealth = 0;
+    float m_armor = 0;
+    int m_team = 0;
+    float m_spawnDelay = 0;
+    int m_isVisible = 0;
+};
+
+namespace meta{
+
+template<>
+constexpr auto RegisterProperties<InspectedObject>()
+{
+    return std::make_tuple(
+        PropertyMetadata<InspectedObject, float>("position_x", &InspectedObject::m_positionX),
+        PropertyMetadata<InspectedObject, float>("position_y", &InspectedObject::m_positionY),
+        PropertyMetadata<InspectedObject, float>("position_z", &InspectedObject::m_positionZ),
+        PropertyMetadata<InspectedObject, float>("rotation_x", &InspectedObject::m_rotationX),
+        PropertyMetadata<InspectedObject, float>("rotation_y", &InspectedObject::m_rotationY),
+        PropertyMetadata<InspectedObject, float>("rotation_z", &InspectedObject::m_rotationZ),
+        PropertyMetadata<InspectedObject, float>("scale_x", &InspectedObject::m_scaleX),
+        PropertyMetadata<InspectedObject, float>("scale_y", &InspectedObject::m_scaleY),
+        PropertyMetadata<InspectedObject, float>("scale_z", &InspectedObject::m_scaleZ),
+        PropertyMetadata<InspectedObject, float>("velocity_x", &InspectedObject::m_velocityX),
+        PropertyMetadata<InspectedObject, float>("velocity_y", &InspectedObject::m_velocityY),
+        PropertyMetadata<InspectedObject, float>("velocity_z", &InspectedObject::m_velocityZ),
+        PropertyMetadata<InspectedObject, float>("mass", &InspectedObject::m_mass),
+        PropertyMetadata<InspectedObject, float>("friction", &InspectedObject::m_friction),
+        PropertyMetadata<InspectedObject, float>("restitution", &InspectedObject::m_restitution),
+        PropertyMetadata<InspectedObject, float>("linear_damping", &InspectedObject::m_linearDamping),
+        PropertyMetadata<InspectedObject, float>("angular_damping", &InspectedObject::m_angularDamping),
+        PropertyMetadata<InspectedObject, float>("color_r", &InspectedObject::m_colorR),
+        PropertyMetadata<InspectedObject, float>("color_g", &InspectedObject::m_colorG),
+        PropertyMetadata<InspectedObject, float>("color_b", &InspectedObject::m_colorB),
+        PropertyMetadata<InspectedObject, float>("color_a", &InspectedObject::m_colorA),
+        PropertyMetadata<InspectedObject, float>("emissive", &InspectedObject::m_emissive),
+        PropertyMetadata<InspectedObject, float>("roughness", &InspectedObject::m_roughness),
+        PropertyMetadata<InspectedObject, float>("metallic", &InspectedObject::m_metallic),
+        PropertyMetadata<InspectedObject, int>("layer", &InspectedObject::m_layer),
+        PropertyMetadata<InspectedObject, int>("render_order", &InspectedObject::m_renderOrder),
+        PropertyMetadata<InspectedObject, float>("lod_bias", &InspectedObject::m_lodBias),
+        PropertyMetadata<InspectedObject, float>("shadow_bias", &InspectedObject::m_shadowBias),
+        PropertyMetadata<InspectedObject, int>("health", &InspectedObject::m_health),
+        PropertyMetadata<InspectedObject, int>("max_health", &InspectedObject::m_maxHealth),
+        PropertyMetadata<InspectedObject, float>("armor", &InspectedObject::m_armor),
+        PropertyMetadata<InspectedObject, int>("team", &InspectedObject::m_team),
+        PropertyMetadata<InspectedObject, float>("spawn_delay", &InspectedObject::m_spawnDelay),
+        PropertyMetadata<InspectedObject, int>("is_visible", &InspectedObject::m_isVisible)
+    );
+}
+
+} // meta
+
+// Name lookups of the Test properties : indices, typed access, visit, and the names which aren't properties.
+bool testPropertyLookup()
+{
+    static_assert(meta::FindPropertyIndex<Test>("foo2") == 1, "property index usable at compile time");
+
+    bool isPassing = check(meta::FindPropertyIndex<Test>("foo") == 0 && meta::FindPropertyIndex<Test>("foo2") == 1 && meta::FindPropertyIndex<Test>("m_bar") == 2,
+        "property lookup finds the registered names");
+    isPassing = check(meta::FindPropertyIndex<Test>("missing") == -1 && meta::FindPropertyIndex<Test>("") == -1 && meta::FindPropertyIndex<Test>("fo") == -1
+        && meta::FindPropertyIndex<Test>("m_foo") == -1, "property lookup rejects the other names") && isPassing;
+
+    Test object;
+    const Test& constObject = object;
+    isPassing = check(meta::GetPropertyValue<float>(object, "foo2") == &object.m_foo2 && meta::GetPropertyValue<std::string>(constObject, "m_bar") == &object.m_bar
+        && meta::GetPropertyValue<int>(object, "foo2") == nullptr && meta::GetPropertyValue<int>(object, "missing") == nullptr, "typed property access") && isPassing;
+
+    std::string_view visitedName;
+    const bool isVisited = meta::VisitProperty(object, "m_bar", [&visitedName](const auto& property) { visitedName = property.GetName(); });
+    isPassing = check(isVisited && visitedName == "m_bar" && !meta::VisitProperty(object, "missing", [](const auto&) {}), "property visit by name") && isPassing;
+
+    // the hashed names of a big class
+    static_assert(meta::FindPropertyIndex<InspectedObject>("is_visible") == meta::PropertyRegistry<InspectedObject>::s_propertyCount - 1, "hashed property index usable at compile time");
+    bool isEveryNameFound = true;
+    int propertyIndex = 0;
+    meta::ForEachProperties(InspectedObject(), [&](const auto& property)
+    {
+        isEveryNameFound = isEveryNameFound && meta::FindPropertyIndex<InspectedObject>(property.GetName()) == propertyIndex;
+        propertyIndex++;
+    });
+    isPassing = check(isEveryNameFound && meta::FindPropertyIndex<InspectedObject>("missing") == -1 && meta::FindPropertyIndex<InspectedObject>("") == -1
+        && meta::FindPropertyIndex<InspectedObject>("position_w") == -1, "hashed property lookup") && isPassing;
+    return isPassing;
+}
+
+// Property lookups by name per second, like the inspector does for each displayed object.
+// The compile-time name table of meta::PropertyRegistry against a scan of the properties comparing their names,
+// for the 3 properties of Test (the table scans them too) and the 34 of InspectedObject (the table hashes them).
+template<typename ObjectClass>
+bool benchmarkPropertyLookup(const char* className, const std::vector<std::string>& propertyNames, size_t objectCount)
+{
+    std::vector<ObjectClass> objects(objectCount);
+    const int repeatCount = 100;
+    const double lookupCount = (double)objects.size() * propertyNames.size() * repeatCount;
+    long long checksum = 0;
+
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (int repeat = 0; repeat < repeatCount; ++repeat)
+    {
+        for (const ObjectClass& object : objects)
+        {
+            for (const std::string& propertyName : propertyNames)
+                checksum += meta::FindPropertyIndex<ObjectClass>(propertyName);
+        }
+    }
+    double tableSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    begin = std::chrono::high_resolution_clock::now();
+    for (int repeat = 0; repeat < repeatCount; ++repeat)
+    {
+        for (const ObjectClass& object : objects)
+        {
+            for (const std::string& propertyName : propertyNames)
+            {
+                int propertyIndex = 0;
+                int foundIndex = -1;
+                meta::ForEachProperties(object, [&](const auto& property)
+                {
+                    if (foundIndex < 0 && property.GetName() == propertyName)
+                        foundIndex = propertyIndex;
+                    propertyIndex++;
+                });
+                checksum -= foundIndex;
+            }
+        }
+    }
+    double scanSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    std::cout << "property lookup benchmark, " << className << " (" << meta::PropertyRegistry<ObjectClass>::s_propertyCount << " properties, " << lookupCount << " lookups)" << std::endl;
+    std::cout << "  name table : " << lookupCount / tableSeconds / 1e6 << " M lookups/s" << std::endl;
+    std::cout << "  scan       : " << lookupCount / scanSeconds / 1e6 << " M lookups/s" << std::endl;
+    return check(checksum == 0, "property lookup benchmark checksum");
+}
+
+bool testPropertyLookupBenchmark()
+{
+    std::vector<std::string> inspectedNames;
+    meta::ForEachProperties(InspectedObject(), [&inspectedNames](const auto& property) { inspectedNames.emplace_back(property.GetName()); });
+    inspectedNames.push_back("missing");
+
+    bool isPassing = benchmarkPropertyLookup<Test>("Test", { "foo", "foo2", "m_bar", "missing" }, 10000);
+    isPassing = benchmarkPropertyLookup<InspectedObject>("InspectedObject", inspectedNames, 1000) && isPassing;
+    return isPassing;
+}
+
+// Round trip of a few Test objects, and truncated data which must fail to load instead of reading past the end.
+bool testBinarySerialization()
+{
+    std::vector<Test> objects(3);
+    objects[0].m_bar = "";
+    objects[1].m_foo = -7;
+    objects[1].m_foo2 = 1.5f;
+    objects[2].m_bar = std::string(300, 'x');
+
+    meta::BinaryArena arena;
+    meta::SaveBinaryArray(objects.data(), objects.size(), arena);
+
+    std::vector<Test> loadedObjects(objects.size());
+    meta::BinaryReader reader(arena.GetData(), arena.GetSize());
+    bool isPassing = check(meta::LoadBinaryArray(loadedObjects.data(), loadedObjects.size(), reader) && reader.IsAtEnd(), "binary round trip loads");
+    for (size_t i = 0; i < objects.size(); ++i)
+        isPassing = check(loadedObjects[i].m_foo == objects[i].m_foo && loadedObjects[i].m_foo2 == objects[i].m_foo2 && loadedObjects[i].m_bar == objects[i].m_bar, "binary round trip values") && isPassing;
+
+    bool isTruncationDetected = true;
+    for (size_t size = 0; size < arena.GetSize(); ++size)
+    {
+        meta::BinaryReader truncatedReader(arena.GetData(), size);
+        isTruncationDetected = isTruncationDetected && !meta::LoadBinaryArray(loadedObjects.data(), loadedObjects.size(), truncatedReader);
+    }
+    isPassing = check(isTruncationDetected, "binary truncated data fails to load") && isPassing;
+
+    // a corrupted string length must fail, not allocate
+    meta::BinaryArena corruptedArena;
+    meta::SaveBinary(objects[0], corruptedArena);
+    const uint64_t length = UINT64_MAX;
+    std::memcpy(corruptedArena.GetData() + sizeof(int) + sizeof(float), &length, sizeof(length));
+    meta::BinaryReader corruptedReader(corruptedArena.GetData(), corruptedArena.GetSize());
+    Test corruptedObject;
+    isPassing = check(!meta::LoadBinary(corruptedObject, corruptedReader), "binary corrupted string length fails to load") && isPassing;
+    return isPassing;
+}
+
+// Binary save and load speed of 1M Test objects : the int and the float are copied as one block, the string on its own.
+// The second save reuses the arena, it doesn't allocate.
+bool testBinarySerializationBenchmark()
+{
+    const size_t objectCount = 1000000;
+    std::vector<Test> objects(objectCount);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        objects[i].m_foo = (int)i;
+        objects[i].m_foo2 = i * 0.5f;
+        objects[i].m_bar = "object_" + std::to_string(i % 1000);
+    }
+
+    meta::BinaryArena arena;
+    double saveSeconds = 0;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        arena.Clear();
+        auto begin = std::chrono::high_resolution_clock::now();
+        meta::SaveBinaryArray(objects.data(), objects.size(), arena);
+        saveSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+    }
+
+    std::vector<Test> loadedObjects(objectCount);
+    meta::BinaryReader reader(arena.GetData(), arena.GetSize());
+    auto begin = std::chrono::high_resolution_clock::now();
+    const bool isLoaded = meta::LoadBinaryArray(loadedObjects.data(), loadedObjects.size(), reader) && reader.IsAtEnd();
+    double loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    bool isSame = isLoaded;
+    for (size_t i = 0; i < objectCount && isSame; ++i)
+        isSame = loadedObjects[i].m_foo == objects[i].m_foo && loadedObjects[i].m_foo2 == objects[i].m_foo2 && loadedObjects[i].m_bar == objects[i].m_bar;
+
+    const double megabytes = arena.GetSize() / (1024.0 * 1024.0);
+    std::cout << "binary serialization benchmark (" << objectCount << " objects, " << megabytes << " MB)" << std::endl;
+    std::cout << "  save : " << megabytes / saveSeconds << " MB/s" << std::endl;
+    std::cout << "  load : " << megabytes / loadSeconds << " MB/s" << std::endl;
+    return check(isSame, "binary serialization benchmark round trip");
+}
+
+// Encoding of each column written by SaveColumns, read from the column headers
+std::vector<meta::ColumnEncoding> getColumnEncodings(const meta::BinaryArena& arena)
+{
+    std::vector<meta::ColumnEncoding> encodings;
+    size_t offset = 2 * sizeof(uint64_t);
+    while (offset < arena.GetSize())
+    {
+        uint64_t columnSize = 0;
+        encodings.push_back((meta::ColumnEncoding)arena.GetData()[offset]);
+        std::memcpy(&columnSize, arena.GetData() + offset + 1, sizeof(columnSize));
+        offset += 1 + sizeof(columnSize) + (size_t)columnSize;
+    }
+    return encodings;
+}
+
+// Round trips of the columnar format with each encoding of the int column : empty arrays, a single object, wrapping deltas.
+// Every truncation of the data and an unknown encoding must fail to load.
+bool testColumnarSerialization()
+{
+    bool isPassing = true;
+    auto testRoundTrip = [&isPassing](const std::vector<Test>& objects, bool isEncoded, meta::ColumnEncoding expectedEncoding, const char* description)
+    {
+        meta::BinaryArena arena;
+        meta::SaveColumns(objects, arena, isEncoded);
+        const std::vector<meta::ColumnEncoding> encodings = getColumnEncodings(arena);
+
+        std::vector<Test> loadedObjects(3);
+        meta::BinaryReader reader(arena.GetData(), arena.GetSize());
+        bool isSame = meta::LoadColumns(loadedObjects, reader) && reader.IsAtEnd() && loadedObjects.size() == objects.size();
+        for (size_t i = 0; i < objects.size() && isSame; ++i)
+            isSame = loadedObjects[i].m_foo == objects[i].m_foo && loadedObjects[i].m_foo2 == objects[i].m_foo2 && loadedObjects[i].m_bar == objects[i].m_bar;
+
+        bool isTruncationDetected = true;
+        for (size_t size = 0; size < arena.GetSize(); ++size)
+        {
+            meta::BinaryReader truncatedReader(arena.GetData(), size);
+            isTruncationDetected = isTruncationDetected && !meta::LoadColumns(loadedObjects, truncatedReader);
+        }
+
+        // an object count too big to be allocated, rejected by the raw and delta columns before any allocation
+        bool isCountCorruptionDetected = true;
+        if (encodings.size() == 3 && (encodings[0] == meta::ColumnEncoding::RAW || encodings[0] == meta::ColumnEncoding::DELTA))
+        {
+            const uint64_t corruptedCount = 1ull << 44;
+            std::memcpy(arena.GetData(), &corruptedCount, sizeof(corruptedCount));
+            meta::BinaryReader countReader(arena.GetData(), arena.GetSize());
+            isCountCorruptionDetected = !meta::LoadColumns(loadedObjects, countReader);
+            const uint64_t objectCount = objects.size();
+            std::memcpy(arena.GetData(), &objectCount, sizeof(objectCount));
+        }
+
+        // the encoding of the first column
+        arena.GetData()[2 * sizeof(uint64_t)] = 7;
+        meta::BinaryReader corruptedReader(arena.GetData(), arena.GetSize());
+        const bool isCorruptionDetected = !meta::LoadColumns(loadedObjects, corruptedReader);
+
+        const bool isExpectedEncoding = encodings.size() == 3 && encodings[0] == expectedEncoding;
+        isPassing = check(isSame && isTruncationDetected && isCountCorruptionDetected && isCorruptionDetected && isExpectedEncoding, description) && isPassing;
+    };
+
+    std::vector<Test> objects;
+    testRoundTrip(objects, true, meta::ColumnEncoding::RAW, "columnar empty array");
+    objects.resize(1);
+    testRoundTrip(objects, false, meta::ColumnEncoding::RAW, "columnar single object, raw");
+    objects[0].m_foo = 5;
+    testRoundTrip(objects, true, meta::ColumnEncoding::DELTA, "columnar single small value, delta");
+    objects[0].m_foo = INT_MIN;
+    testRoundTrip(objects, true, meta::ColumnEncoding::RAW, "columnar single big value, raw");
+
+    objects.resize(200);
+    unsigned int random = 12345;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        random = random * 1664525u + 1013904223u;
+        objects[i].m_foo = (int)random;
+        objects[i].m_foo2 = (float)(i % 3);
+        objects[i].m_bar = i % 2 == 0 ? "even" : "odd";
+    }
+    testRoundTrip(objects, true, meta::ColumnEncoding::RAW, "columnar random values, raw");
+
+    for (size_t i = 0; i < objects.size(); ++i)
+        objects[i].m_foo = (i / 50) % 2 == 0 ? INT_MAX : INT_MIN;
+    testRoundTrip(objects, true, meta::ColumnEncoding::RLE, "columnar long runs, rle");
+
+    // INT_MAX to INT_MIN and back : the differences wrap around
+    for (size_t i = 0; i < objects.size(); ++i)
+        objects[i].m_foo = i % 2 == 0 ? INT_MAX : INT_MIN;
+    testRoundTrip(objects, true, meta::ColumnEncoding::DELTA, "columnar wrapping deltas, delta");
+
+    // sequential ids going past INT_MAX
+    for (size_t i = 0; i < objects.size(); ++i)
+        objects[i].m_foo = (int)(uint32_t)(0x7FFFFF9Cu + i);
+    testRoundTrip(objects, true, meta::ColumnEncoding::DELTA_RLE, "columnar wrapping sequential ids, delta rle");
+    testRoundTrip(objects, false, meta::ColumnEncoding::RAW, "columnar wrapping sequential ids, raw");
+
+    // only runs : any count fits in the columns, the caller bounds it
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        objects[i].m_foo = 1;
+        objects[i].m_foo2 = 2.0f;
+        objects[i].m_bar = "run";
+    }
+    meta::BinaryArena runArena;
+    meta::SaveColumns(objects, runArena);
+    const uint64_t corruptedCount = 1ull << 44;
+    std::memcpy(runArena.GetData(), &corruptedCount, sizeof(corruptedCount));
+    std::vector<Test> loadedObjects;
+    meta::BinaryReader runReader(runArena.GetData(), runArena.GetSize());
+    isPassing = check(!meta::LoadColumns(loadedObjects, runReader, 1000000), "columnar corrupted count of runs, bounded by the caller") && isPassing;
+    return isPassing;
+}
+
+// Columnar save of 1M Test objects with repetitive values (sequential ids, objects grouped by layer), compared with the row format.
+bool testColumnarSerializationBenchmark()
+{
+    const size_t objectCount = 1000000;
+    std::vector<Test> objects(objectCount);
+    for (size_t i = 0; i < objectCount; ++i)
+    {
+        objects[i].m_foo = (int)i;
+        objects[i].m_foo2 = (i / 64) * 0.5f;
+        objects[i].m_bar = "layer_" + std::to_string(i / 1000);
+    }
+
+    meta::BinaryArena rowArena;
+    meta::SaveBinaryArray(objects.data(), objects.size(), rowArena);
+
+    meta::BinaryArena arena;
+    auto begin = std::chrono::high_resolution_clock::now();
+    meta::SaveColumns(objects, arena);
+    double saveSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    std::vector<Test> loadedObjects;
+    meta::BinaryReader reader(arena.GetData(), arena.GetSize());
+    begin = std::chrono::high_resolution_clock::now();
+    const bool isLoaded = meta::LoadColumns(loadedObjects, reader) && reader.IsAtEnd();
+    double loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    bool isSame = isLoaded && loadedObjects.size() == objectCount;
+    for (size_t i = 0; i < objectCount && isSame; ++i)
+        isSame = loadedObjects[i].m_foo == objects[i].m_foo && loadedObjects[i].m_foo2 == objects[i].m_foo2 && loadedObjects[i].m_bar == objects[i].m_bar;
+
+    // throughput in objects bytes, as written by the row format
+    const double megabytes = rowArena.GetSize() / (1024.0 * 1024.0);
+    std::cout << "columnar serialization benchmark (" << objectCount << " objects)" << std::endl;
+    std::cout << "  size : " << arena.GetSize() << " bytes, row format " << rowArena.GetSize() << " bytes" << std::endl;
+    std::cout << "  save : " << megabytes / saveSeconds << " MB/s" << std::endl;
+    std::cout << "  load : " << megabytes / loadSeconds << " MB/s" << std::endl;
+    return check(isSame, "columnar serialization benchmark round trip");
+}
+
+// readFile, FileContent and AsyncFileReader on an empty file, a small binary file, a file big enough to be mapped, and a missing file.
+// The files are written in the temporary directory and removed at the end.
+bool testFileReading()
+{
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "gear_file_reading_test";
+    std::filesystem::create_directories(directory);
+
+    std::vector<std::string> contents = { std::string(), std::string("line\r\nwith\0zero", 16), std::string() };
+    for (size_t i = 0; i < 2 * fileUtils::FileContent::s_defaultMappingThreshold; ++i)
+        contents[2].push_back((char)(i * 7));
+
+    std::vector<std::string> filePaths;
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        filePaths.push_back((directory / ("file_" + std::to_string(i) + ".bin")).string());
+        std::ofstream stream(filePaths.back(), std::ios::binary);
+        stream.write(contents[i].data(), contents[i].size());
+    }
+    const std::string missingFilePath = (directory / "missing.bin").string();
+
+    bool isPassing = true;
+    std::vector<char> buffer;
+    fileUtils::FileContent content;
+    for (size_t i = 0; i < contents.size(); ++i)
+    {
+        const bool isRead = fileUtils::readFile(filePaths[i], buffer);
+        isPassing = check(isRead && std::string(buffer.data(), buffer.size()) == contents[i], "readFile content") && isPassing;
+        const std::vector<char> newBuffer = fileUtils::readFile(filePaths[i]);
+        isPassing = check(std::string(newBuffer.data(), newBuffer.size()) == contents[i], "readFile content in a new array") && isPassing;
+
+        const bool isOpen = content.open(filePaths[i]);
+        isPassing = check(isOpen && std::string((const char*)content.getData(), content.getSize()) == contents[i]
+            && content.isMapped() == (contents[i].size() >= fileUtils::FileContent::s_defaultMappingThreshold), "FileContent content") && isPassing;
+    }
+    content.close();
+    isPassing = check(!fileUtils::readFile(missingFilePath, buffer) && buffer.empty() && !content.open(missingFilePath) && !content.isOpen(), "missing file fails to read") && isPassing;
+
+    {
+        fileUtils::AsyncFileReader reader;
+        std::vector<std::string> prefetchedFilePaths = filePaths;
+        prefetchedFilePaths.pop_back();
+        prefetchedFilePaths.push_back(missingFilePath);
+        reader.prefetch(prefetchedFilePaths);
+
+        // the last file isn't prefetched, it is read by this thread
+        for (size_t i = 0; i < contents.size(); ++i)
+        {
+            const bool isTaken = reader.take(filePaths[i], buffer);
+            isPassing = check(isTaken && std::string(buffer.data(), buffer.size()) == contents[i], "AsyncFileReader content") && isPassing;
+        }
+        isPassing = check(!reader.take(missingFilePath, buffer) && reader.getPendingCount() == 0, "AsyncFileReader missing file") && isPassing;
+    }
+
+    std::filesystem::remove_all(directory);
+    return isPassing;
+}
+
+// Many small files (as a folder of shaders and icons), read the way readFile used to (text mode, seek to get the size),
+// with a reused buffer, through FileContent, and prefetched by the AsyncFileReader. The files are in the system cache after the first pass.
+bool testFileReadingBenchmark()
+{
+    const int fileCount = 2000;
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "gear_file_reading_benchmark";
+    std::filesystem::create_directories(directory);
+
+    std::vector<std::string> filePaths;
+    for (int i = 0; i < fileCount; ++i)
+    {
+        filePaths.push_back((directory / ("file_" + std::to_string(i) + ".bin")).string());
+        std::ofstream stream(filePaths.back(), std::ios::binary);
+        const std::string content((size_t)(512 + (i * 37) % 3584), (char)('a' + i % 26));
+        stream.write(content.data(), content.size());
+    }
+
+    auto checksumOf = [](const char* data, size_t size) { unsigned long long checksum = size; for (size_t i = 0; i < size; ++i) checksum = checksum * 31 + (unsigned char)data[i]; return checksum; };
+
+    // the files are in the system cache for every pass
+    std::vector<char> buffer;
+    for (const auto& filePath : filePaths)
+    {
+        fileUtils::readFile(filePath, buffer);
+    }
+
+    unsigned long long legacyChecksum = 0;
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (const auto& filePath : filePaths)
+    {
+        std::ifstream fileIn(filePath);
+        fileIn.seekg(0, fileIn.end);
+        int fileSize = (int)fileIn.tellg();
+        fileIn.seekg(0, fileIn.beg);
+        std::vector<char> output(fileSize);
+        fileIn.read(&output[0], fileSize);
+        legacyChecksum += checksumOf(output.data(), output.size());
+    }
+    double legacySeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    unsigned long long bufferChecksum = 0;
+    begin = std::chrono::high_resolution_clock::now();
+    for (const auto& filePath : filePaths)
+    {
+        fileUtils::readFile(filePath, buffer);
+        bufferChecksum += checksumOf(buffer.data(), buffer.size());
+    }
+    double bufferSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    unsigned long long contentChecksum = 0;
+    fileUtils::FileContent content;
+    begin = std::chrono::high_resolution_clock::now();
+    for (const auto& filePath : filePaths)
+    {
+        content.open(filePath);
+        contentChecksum += checksumOf((const char*)content.getData(), content.getSize());
+    }
+    double contentSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    // the time the main thread waits for the files is what the prefetch doesn't hide
+    unsigned long long asyncChecksum = 0;
+    double takeSeconds = 0;
+    begin = std::chrono::high_resolution_clock::now();
+    {
+        fileUtils::AsyncFileReader reader;
+        reader.prefetch(filePaths);
+        for (const auto& filePath : filePaths)
+        {
+            auto takeBegin = std::chrono::high_resolution_clock::now();
+            reader.take(filePath, buffer);
+            takeSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - takeBegin).count();
+            asyncChecksum += checksumOf(buffer.data(), buffer.size());
+        }
+    }
+    double asyncSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - begin).count();
+
+    std::filesystem::remove_all(directory);
+
+    std::cout << "file reading benchmark (" << fileCount << " files)" << std::endl;
+    std::cout << "  text mode, new array : " << legacySeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  readFile, reused buffer : " << bufferSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  FileContent : " << contentSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  AsyncFileReader, prefetch then take : " << asyncSeconds * 1000.0 << " ms, " << takeSeconds * 1000.0 << " ms waiting in take" << std::endl;
+    return check(legacyChecksum == bufferChecksum && bufferChecksum == contentChecksum && contentChecksum == asyncChecksum, "file reading benchmark checksum");
+}
+
+int main(int argc, char** argv)
+{
+    // the benchmarks take a few seconds, they only run with --benchmark
+    bool isBenchmarking = false;
+    for (int i = 1; i < argc; ++i)
+        isBenchmarking = isBenchmarking || std::string(argv[i]) == "--benchmark";
+
     //testForeEachTuple();
+    bool isPassing = true;
+    isPassing = testGlyphLookupTable() && isPassing;
     testMetaReflection();
+    isPassing = testPropertyLookup() && isPassing;
+    isPassing = testBinarySerialization() && isPassing;
+    isPassing = testColumnarSerialization() && isPassing;
+    isPassing = testFileReading() && isPassing;
+    if (isBenchmarking)
+    {
+        isPassing = testGlyphLookupBenchmark() && isPassing;
+        isPassing = testPropertyLookupBenchmark() && isPassing;
+        isPassing = testBinarySerializationBenchmark() && isPassing;
+        isPassing = testColumnarSerializationBenchmark() && isPassing;
+        isPassing = testFileReadingBenchmark() && isPassing;
+    }
     //testMetadatas();
     //testObjectRef();
+    if (!isPassing)
+        return EXIT_FAILURE;
+    if (isBenchmarking)
+        return EXIT_SUCCESS;
+
     std::cin.get();
     testApplication();
+    return EXIT_SUCCESS;
 }
\ No newline at end of file